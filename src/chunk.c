@@ -5,28 +5,77 @@
  */
 #include "chunk.h"
 
+#include "chunk_pool.h"
 #include "libmr_integration.h"
 
 #include "rmutil/alloc.h"
 
+static void computeStats(Chunk *chunk) {
+    ChunkStats_Reset(&chunk->stats);
+    for (size_t i = 0; i < chunk->num_samples; ++i) {
+        ChunkStats_Append(&chunk->stats, chunk->timestamps[i], chunk->values[i]);
+    }
+    chunk->statsDirty = false;
+}
+
+// Resize the timestamps and values arrays
+static void reallocSamples(Chunk *chunk, size_t capacity) {
+    chunk->timestamps = ChunkPool_Realloc(chunk->timestamps,
+                                          chunk->capacity * sizeof(timestamp_t),
+                                          capacity * sizeof(timestamp_t));
+    chunk->values = ChunkPool_Realloc(
+        chunk->values, chunk->capacity * sizeof(double), capacity * sizeof(double));
+    chunk->capacity = capacity;
+}
+
+// Index of the first sample with a timestamp >= ts, num_samples if there is none
+static size_t lowerBound(const Chunk *chunk, timestamp_t ts) {
+    size_t lo = 0, hi = chunk->num_samples;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunk->timestamps[mid] < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Index of the first sample with a timestamp > ts, num_samples if there is none
+static size_t upperBound(const Chunk *chunk, timestamp_t ts) {
+    size_t lo = 0, hi = chunk->num_samples;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (chunk->timestamps[mid] <= ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
 Chunk_t *Uncompressed_NewChunk(size_t size) {
-    Chunk *newChunk = (Chunk *)malloc(sizeof(Chunk));
+    Chunk *newChunk = (Chunk *)ChunkPool_Calloc(sizeof(Chunk));
     newChunk->base_timestamp = 0;
     newChunk->num_samples = 0;
     newChunk->size = size;
-    newChunk->samples = (Sample *)malloc(size);
+    reallocSamples(newChunk, size / SAMPLE_SIZE);
+    ChunkStats_Reset(&newChunk->stats);
 #ifdef DEBUG
-    memset(newChunk->samples, 0, size);
+    memset(newChunk->timestamps, 0, (size / SAMPLE_SIZE) * sizeof(timestamp_t));
+    memset(newChunk->values, 0, (size / SAMPLE_SIZE) * sizeof(double));
 #endif
 
     return newChunk;
 }
 
 void Uncompressed_FreeChunk(Chunk_t *chunk) {
-    if (((Chunk *)chunk)->samples) {
-        free(((Chunk *)chunk)->samples);
-    }
-    free(chunk);
+    Chunk *regChunk = (Chunk *)chunk;
+    ChunkPool_Free(regChunk->timestamps, regChunk->capacity * sizeof(timestamp_t));
+    ChunkPool_Free(regChunk->values, regChunk->capacity * sizeof(double));
+    ChunkPool_Free(chunk, sizeof(Chunk));
 }
 
 /**
@@ -41,19 +90,43 @@ Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk) {
 
     // create chunk and copy samples
     Chunk *newChunk = Uncompressed_NewChunk(split * SAMPLE_SIZE);
-    for (size_t i = 0; i < split; ++i) {
-        Sample *sample = &curChunk->samples[curNumSamples + i];
-        Uncompressed_AddSample(newChunk, sample);
-    }
+    memcpy(newChunk->timestamps, curChunk->timestamps + curNumSamples, split * sizeof(timestamp_t));
+    memcpy(newChunk->values, curChunk->values + curNumSamples, split * sizeof(double));
+    newChunk->num_samples = split;
+    newChunk->base_timestamp = split > 0 ? newChunk->timestamps[0] : 0;
+    computeStats(newChunk);
 
     // update current chunk
     curChunk->num_samples = curNumSamples;
     curChunk->size = curNumSamples * SAMPLE_SIZE;
-    curChunk->samples = realloc(curChunk->samples, curChunk->size);
+    reallocSamples(curChunk, curNumSamples);
+    computeStats(curChunk);
 
     return newChunk;
 }
 
+Chunk_t *Uncompressed_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize) {
+    const Chunk *first = chunk, *second = next;
+    size_t numSamples = first->num_samples + second->num_samples;
+    if (numSamples * SAMPLE_SIZE > maxSize) {
+        return NULL;
+    }
+
+    Chunk *merged = Uncompressed_NewChunk(numSamples * SAMPLE_SIZE);
+    memcpy(merged->timestamps, first->timestamps, first->num_samples * sizeof(timestamp_t));
+    memcpy(merged->values, first->values, first->num_samples * sizeof(double));
+    memcpy(merged->timestamps + first->num_samples,
+           second->timestamps,
+           second->num_samples * sizeof(timestamp_t));
+    memcpy(merged->values + first->num_samples,
+           second->values,
+           second->num_samples * sizeof(double));
+    merged->num_samples = numSamples;
+    merged->base_timestamp = numSamples > 0 ? merged->timestamps[0] : 0;
+    computeStats(merged);
+    return merged;
+}
+
 /**
  * Deep copy of src chunk to dst
  * @param src: src chunk
@@ -61,10 +134,14 @@ Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk) {
  */
 Chunk_t *Uncompressed_CloneChunk(const Chunk_t *src) {
     const Chunk *_src = src;
-    Chunk *dst = (Chunk *)malloc(sizeof(Chunk));
+    Chunk *dst = (Chunk *)ChunkPool_Alloc(sizeof(Chunk));
     memcpy(dst, _src, sizeof(Chunk));
-    dst->samples = (Sample *)malloc(dst->size);
-    memcpy(dst->samples, _src->samples, dst->size);
+    dst->timestamps = NULL;
+    dst->values = NULL;
+    dst->capacity = 0;
+    reallocSamples(dst, _src->capacity);
+    memcpy(dst->timestamps, _src->timestamps, _src->num_samples * sizeof(timestamp_t));
+    memcpy(dst->values, _src->values, _src->num_samples * sizeof(double));
     return dst;
 }
 
@@ -76,22 +153,18 @@ u_int64_t Uncompressed_NumOfSample(Chunk_t *chunk) {
     return ((Chunk *)chunk)->num_samples;
 }
 
-static Sample *ChunkGetSample(Chunk *chunk, int index) {
-    return &chunk->samples[index];
-}
-
 timestamp_t Uncompressed_GetLastTimestamp(Chunk_t *chunk) {
     if (unlikely(((Chunk *)chunk)->num_samples == 0)) { // empty chunks are being removed
         RedisModule_Log(mr_staticCtx, "error", "Trying to get the last timestamp of empty chunk");
     }
-    return ChunkGetSample(chunk, ((Chunk *)chunk)->num_samples - 1)->timestamp;
+    return ((Chunk *)chunk)->timestamps[((Chunk *)chunk)->num_samples - 1];
 }
 
 double Uncompressed_GetLastValue(Chunk_t *chunk) {
     if (unlikely(((Chunk *)chunk)->num_samples == 0)) { // empty chunks are being removed
         RedisModule_Log(mr_staticCtx, "error", "Trying to get the last value of empty chunk");
     }
-    return ChunkGetSample(chunk, ((Chunk *)chunk)->num_samples - 1)->value;
+    return ((Chunk *)chunk)->values[((Chunk *)chunk)->num_samples - 1];
 }
 
 timestamp_t Uncompressed_GetFirstTimestamp(Chunk_t *chunk) {
@@ -100,12 +173,24 @@ timestamp_t Uncompressed_GetFirstTimestamp(Chunk_t *chunk) {
         // Only the first chunk can be empty since we delete empty chunks
         return 0;
     }
-    return ChunkGetSample(chunk, 0)->timestamp;
+    return ((Chunk *)chunk)->timestamps[0];
+}
+
+const ChunkStats *Uncompressed_GetStats(const Chunk_t *chunk) {
+    Chunk *regChunk = (Chunk *)chunk; // the stats are cached in the chunk
+    if (regChunk->statsDirty) {
+        computeStats(regChunk);
+    }
+    return regChunk->stats.valid ? &regChunk->stats : NULL;
 }
 
 ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample) {
     Chunk *regChunk = (Chunk *)chunk;
     if (IsChunkFull(regChunk)) {
+        // the chunk won't be appended to anymore, release the room left by upserts
+        if (regChunk->capacity > regChunk->num_samples) {
+            reallocSamples(regChunk, regChunk->num_samples);
+        }
         return CR_END;
     }
 
@@ -114,14 +199,18 @@ ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample) {
         regChunk->base_timestamp = sample->timestamp;
     }
 
-    regChunk->samples[regChunk->num_samples] = *sample;
+    regChunk->timestamps[regChunk->num_samples] = sample->timestamp;
+    regChunk->values[regChunk->num_samples] = sample->value;
     regChunk->num_samples++;
+    if (!regChunk->statsDirty) {
+        ChunkStats_Append(&regChunk->stats, sample->timestamp, sample->value);
+    }
 
     return CR_OK;
 }
 
 /**
- * TODO: describe me
+ * Insert a sample at idx, growing the chunk by a sample when it is full
  * @param chunk
  * @param idx
  * @param sample
@@ -129,14 +218,21 @@ ChunkResult Uncompressed_AddSample(Chunk_t *chunk, Sample *sample) {
 static void upsertChunk(Chunk *chunk, size_t idx, Sample *sample) {
     if (chunk->num_samples == chunk->size / SAMPLE_SIZE) {
         chunk->size += sizeof(Sample);
-        chunk->samples = realloc(chunk->samples, chunk->size);
+    }
+    if (chunk->num_samples == chunk->capacity) {
+        // grow geometrically so that backfilling a full chunk isn't quadratic
+        reallocSamples(chunk, chunk->capacity + chunk->capacity / 4 + 1);
     }
     if (idx < chunk->num_samples) { // sample is not last
-        memmove(&chunk->samples[idx + 1],
-                &chunk->samples[idx],
-                (chunk->num_samples - idx) * sizeof(Sample));
+        memmove(&chunk->timestamps[idx + 1],
+                &chunk->timestamps[idx],
+                (chunk->num_samples - idx) * sizeof(timestamp_t));
+        memmove(&chunk->values[idx + 1],
+                &chunk->values[idx],
+                (chunk->num_samples - idx) * sizeof(double));
     }
-    chunk->samples[idx] = *sample;
+    chunk->timestamps[idx] = sample->timestamp;
+    chunk->values[idx] = sample->value;
     chunk->num_samples++;
 }
 
@@ -150,23 +246,20 @@ ChunkResult Uncompressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolic
     *size = 0;
     Chunk *regChunk = (Chunk *)uCtx->inChunk;
     timestamp_t ts = uCtx->sample.timestamp;
-    short numSamples = regChunk->num_samples;
+    unsigned int numSamples = regChunk->num_samples;
     // find sample location
-    size_t i = 0;
-    Sample *sample = NULL;
-    for (; i < numSamples; ++i) {
-        sample = ChunkGetSample(regChunk, i);
-        if (ts <= sample->timestamp) {
-            break;
-        }
-    }
+    size_t i = lowerBound(regChunk, ts);
     // update value in case timestamp exists
-    if (sample != NULL && ts == sample->timestamp) {
-        ChunkResult cr = handleDuplicateSample(duplicatePolicy, *sample, &uCtx->sample);
+    if (i < numSamples && ts == regChunk->timestamps[i]) {
+        Sample sample = { .timestamp = ts, .value = regChunk->values[i] };
+        ChunkResult cr = handleDuplicateSample(duplicatePolicy, sample, &uCtx->sample);
         if (cr != CR_OK) {
             return CR_ERR;
         }
-        regChunk->samples[i].value = uCtx->sample.value;
+        uCtx->replaced = true;
+        uCtx->oldValue = sample.value;
+        regChunk->values[i] = uCtx->sample.value;
+        regChunk->statsDirty = true;
         return CR_OK;
     }
 
@@ -175,26 +268,32 @@ ChunkResult Uncompressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolic
     }
 
     upsertChunk(regChunk, i, &uCtx->sample);
+    if (i == numSamples && !regChunk->statsDirty) {
+        ChunkStats_Append(&regChunk->stats, ts, uCtx->sample.value);
+    } else {
+        regChunk->statsDirty = true;
+    }
     *size = 1;
     return CR_OK;
 }
 
 size_t Uncompressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs) {
     Chunk *regChunk = (Chunk *)chunk;
-    Sample *newSamples = (Sample *)malloc(regChunk->size);
-    size_t i = 0;
-    size_t new_count = 0;
-    for (; i < regChunk->num_samples; ++i) {
-        if (regChunk->samples[i].timestamp >= startTs && regChunk->samples[i].timestamp <= endTs) {
-            continue;
-        }
-        newSamples[new_count++] = regChunk->samples[i];
+    size_t si = lowerBound(regChunk, startTs);
+    size_t ei = upperBound(regChunk, endTs);
+    if (ei <= si) {
+        return 0;
     }
-    size_t deleted_count = regChunk->num_samples - new_count;
-    free(regChunk->samples);
-    regChunk->samples = newSamples;
+    size_t tail = regChunk->num_samples - ei;
+    memmove(&regChunk->timestamps[si], &regChunk->timestamps[ei], tail * sizeof(timestamp_t));
+    memmove(&regChunk->values[si], &regChunk->values[ei], tail * sizeof(double));
+    size_t deleted_count = ei - si;
+    size_t new_count = regChunk->num_samples - deleted_count;
     regChunk->num_samples = new_count;
-    regChunk->base_timestamp = newSamples[0].timestamp;
+    if (new_count > 0) {
+        regChunk->base_timestamp = regChunk->timestamps[0];
+    }
+    computeStats(regChunk);
     return deleted_count;
 }
 
@@ -215,7 +314,6 @@ void reverseEnrichedChunk(EnrichedChunk *enrichedChunk) {
     enrichedChunk->rev = true;
 }
 
-// TODO: can be optimized further using binary search
 void Uncompressed_ProcessChunk(const Chunk_t *chunk,
                                uint64_t start,
                                uint64_t end,
@@ -225,49 +323,32 @@ void Uncompressed_ProcessChunk(const Chunk_t *chunk,
     ResetEnrichedChunk(enrichedChunk);
     if (unlikely(!_chunk || _chunk->num_samples == 0 || end < start ||
                  _chunk->base_timestamp > end ||
-                 _chunk->samples[_chunk->num_samples - 1].timestamp < start)) {
+                 _chunk->timestamps[_chunk->num_samples - 1] < start)) {
         return;
     }
 
-    size_t si = _chunk->num_samples, ei = _chunk->num_samples - 1, i = 0;
-
-    // find start index
-    for (; i < _chunk->num_samples; i++) {
-        if (_chunk->samples[i].timestamp >= start) {
-            si = i;
-            break;
-        }
-    }
-
-    if (si == _chunk->num_samples) { // all TS are smaller than start
-        return;
-    }
-
-    // find end index
-    for (; i < _chunk->num_samples; i++) {
-        if (_chunk->samples[i].timestamp > end) {
-            ei = i - 1;
-            break;
-        }
-    }
-
-    enrichedChunk->samples.num_samples = ei - si + 1;
-    if (enrichedChunk->samples.num_samples == 0) {
+    size_t si = lowerBound(_chunk, start);
+    size_t ei = upperBound(_chunk, end);
+    if (ei <= si) {
         return;
     }
+    enrichedChunk->samples.num_samples = ei - si;
+    ei--; // index of the last sample in range
+    size_t i;
 
     if (unlikely(reverse)) {
         for (i = 0; i < enrichedChunk->samples.num_samples; ++i) {
-            enrichedChunk->samples.timestamps[i] = _chunk->samples[ei - i].timestamp;
-            enrichedChunk->samples.values[i] = _chunk->samples[ei - i].value;
+            enrichedChunk->samples.timestamps[i] = _chunk->timestamps[ei - i];
+            enrichedChunk->samples.values[i] = _chunk->values[ei - i];
         }
         enrichedChunk->rev = true;
     } else {
-        for (i = 0; i < enrichedChunk->samples.num_samples;
-             ++i) { // use memcpy once chunk becomes columned
-            enrichedChunk->samples.timestamps[i] = _chunk->samples[i + si].timestamp;
-            enrichedChunk->samples.values[i] = _chunk->samples[i + si].value;
-        }
+        memcpy(enrichedChunk->samples.timestamps,
+               _chunk->timestamps + si,
+               enrichedChunk->samples.num_samples * sizeof(timestamp_t));
+        memcpy(enrichedChunk->samples.values,
+               _chunk->values + si,
+               enrichedChunk->samples.num_samples * sizeof(double));
         enrichedChunk->rev = false;
     }
     return;
@@ -275,9 +356,11 @@ void Uncompressed_ProcessChunk(const Chunk_t *chunk,
 
 size_t Uncompressed_GetChunkSize(Chunk_t *chunk, bool includeStruct) {
     Chunk *uncompChunk = chunk;
-    size_t size = uncompChunk->size;
-    size += includeStruct ? sizeof(*uncompChunk) : 0;
-    return size;
+    if (includeStruct) {
+        // memory usage, including the room left for upserts
+        return uncompChunk->capacity * SAMPLE_SIZE + sizeof(*uncompChunk);
+    }
+    return uncompChunk->size;
 }
 
 typedef void (*SaveUnsignedFunc)(void *, uint64_t);
@@ -293,19 +376,36 @@ static void Uncompressed_GenericSerialize(Chunk_t *chunk,
     saveUnsigned(ctx, uncompchunk->num_samples);
     saveUnsigned(ctx, uncompchunk->size);
 
-    saveStringBuffer(ctx, (char *)uncompchunk->samples, uncompchunk->size);
+    // the samples are serialized as an array of Sample
+    Sample *samples = calloc(1, uncompchunk->size);
+    for (size_t i = 0; i < uncompchunk->num_samples; ++i) {
+        samples[i].timestamp = uncompchunk->timestamps[i];
+        samples[i].value = uncompchunk->values[i];
+    }
+    saveStringBuffer(ctx, (char *)samples, uncompchunk->size);
+    free(samples);
+}
+
+static void setSamples(Chunk *chunk, const Sample *samples) {
+    reallocSamples(chunk, chunk->size / SAMPLE_SIZE);
+    for (size_t i = 0; i < chunk->num_samples; ++i) {
+        chunk->timestamps[i] = samples[i].timestamp;
+        chunk->values[i] = samples[i].value;
+    }
 }
 
 #define UNCOMPRESSED_DESERIALIZE(chunk, ctx, load_unsigned, loadStringBuffer, ...)                 \
     do {                                                                                           \
-        Chunk *uncompchunk = (Chunk *)calloc(1, sizeof(*uncompchunk));                             \
+        Chunk *uncompchunk = (Chunk *)ChunkPool_Calloc(sizeof(*uncompchunk));                      \
                                                                                                    \
         uncompchunk->base_timestamp = load_unsigned(ctx, ##__VA_ARGS__);                           \
         uncompchunk->num_samples = load_unsigned(ctx, ##__VA_ARGS__);                              \
         uncompchunk->size = load_unsigned(ctx, ##__VA_ARGS__);                                     \
         size_t string_buffer_size;                                                                 \
-        uncompchunk->samples =                                                                     \
-            (Sample *)loadStringBuffer(ctx, &string_buffer_size, ##__VA_ARGS__);                   \
+        Sample *samples = (Sample *)loadStringBuffer(ctx, &string_buffer_size, ##__VA_ARGS__);     \
+        setSamples(uncompchunk, samples);                                                          \
+        free(samples);                                                                             \
+        computeStats(uncompchunk);                                                                 \
         *chunk = (Chunk_t *)uncompchunk;                                                           \
         return TSDB_OK;                                                                            \
                                                                                                    \
@@ -338,3 +438,10 @@ int Uncompressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
     UNCOMPRESSED_DESERIALIZE(
         chunk, sctx, MR_SerializationCtxReadeLongLongWrapper, MR_ownedBufferFrom);
 }
+
+Chunk_t *Uncompressed_DefragChunk(RedisModuleDefragCtx *ctx, Chunk_t *chunk) {
+    Chunk *regChunk = ChunkPool_Defrag(ctx, chunk);
+    regChunk->timestamps = ChunkPool_Defrag(ctx, regChunk->timestamps);
+    regChunk->values = ChunkPool_Defrag(ctx, regChunk->values);
+    return regChunk;
+}
@@ -14,9 +14,14 @@
 typedef struct Chunk
 {
     timestamp_t base_timestamp;
-    Sample *samples;
+    // the samples are stored as separate arrays of timestamps and values
+    timestamp_t *timestamps;
+    double *values;
     unsigned int num_samples;
+    size_t capacity; // number of allocated samples, at least size / SAMPLE_SIZE
     size_t size;
+    ChunkStats stats;
+    bool statsDirty; // stats are recomputed on demand after out of order insertions
 } Chunk;
 
 Chunk_t *Uncompressed_NewChunk(size_t size);
@@ -28,6 +33,7 @@ void Uncompressed_FreeChunk(Chunk_t *chunk);
  * @return
  */
 Chunk_t *Uncompressed_SplitChunk(Chunk_t *chunk);
+Chunk_t *Uncompressed_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize);
 Chunk_t *Uncompressed_CloneChunk(const Chunk_t *src);
 size_t Uncompressed_GetChunkSize(Chunk_t *chunk, bool includeStruct);
 
@@ -53,6 +59,7 @@ u_int64_t Uncompressed_NumOfSample(Chunk_t *chunk);
 timestamp_t Uncompressed_GetLastTimestamp(Chunk_t *chunk);
 double Uncompressed_GetLastValue(Chunk_t *chunk);
 timestamp_t Uncompressed_GetFirstTimestamp(Chunk_t *chunk);
+const ChunkStats *Uncompressed_GetStats(const Chunk_t *chunk);
 
 void reverseEnrichedChunk(EnrichedChunk *enrichedChunk);
 void Uncompressed_ProcessChunk(const Chunk_t *chunk,
@@ -69,6 +76,9 @@ int Uncompressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
 void Uncompressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx);
 int Uncompressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx);
 
+// Defrag
+Chunk_t *Uncompressed_DefragChunk(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
+
 // this is just a temporary wrapper function that ignores error in order to preserve the common api
 void MR_SerializationCtxWriteLongLongWrapper(WriteSerializationCtx *sctx, long long val);
 
@@ -0,0 +1,116 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#include "chunk_dir.h"
+
+#include "chunk_pool.h"
+
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define CHUNK_DIR_INIT_CAPACITY 4
+
+ChunkDir *ChunkDir_New() {
+    ChunkDir *dir = (ChunkDir *)malloc(sizeof(ChunkDir));
+    dir->entries = (ChunkDirEntry *)malloc(CHUNK_DIR_INIT_CAPACITY * sizeof(ChunkDirEntry));
+    dir->size = 0;
+    dir->capacity = CHUNK_DIR_INIT_CAPACITY;
+    return dir;
+}
+
+void ChunkDir_Free(ChunkDir *dir) {
+    free(dir->entries);
+    free(dir);
+}
+
+ChunkDir *ChunkDir_Defrag(RedisModuleDefragCtx *ctx, ChunkDir *dir) {
+    dir = ChunkPool_Defrag(ctx, dir);
+    dir->entries = ChunkPool_Defrag(ctx, dir->entries);
+    return dir;
+}
+
+size_t ChunkDir_Floor(const ChunkDir *dir, timestamp_t ts) {
+    // first entry starting after ts
+    size_t lo = 0, hi = dir->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (dir->entries[mid].firstTs <= ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo > 0 ? lo - 1 : 0;
+}
+
+size_t ChunkDir_Ceil(const ChunkDir *dir, timestamp_t ts) {
+    size_t lo = 0, hi = dir->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (dir->entries[mid].lastTs < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+static inline void readBounds(ChunkDirEntry *entry, const ChunkFuncs *funcs) {
+    entry->count = funcs->GetNumOfSample(entry->chunk);
+    if (entry->count == 0) {
+        entry->firstTs = entry->lastTs = 0;
+    } else {
+        entry->firstTs = funcs->GetFirstTimestamp(entry->chunk);
+        entry->lastTs = funcs->GetLastTimestamp(entry->chunk);
+    }
+}
+
+size_t ChunkDir_Insert(ChunkDir *dir, Chunk_t *chunk, const ChunkFuncs *funcs) {
+    ChunkDirEntry entry = { .chunk = chunk };
+    readBounds(&entry, funcs);
+
+    if (dir->size == dir->capacity) {
+        dir->capacity *= 2;
+        dir->entries =
+            (ChunkDirEntry *)realloc(dir->entries, dir->capacity * sizeof(ChunkDirEntry));
+    }
+
+    // new chunks are usually appended, an empty one can only be the last chunk
+    size_t idx = dir->size;
+    if (idx > 0 && entry.count > 0 && entry.firstTs < dir->entries[idx - 1].firstTs) {
+        idx = ChunkDir_Floor(dir, entry.firstTs);
+        if (dir->entries[idx].firstTs <= entry.firstTs) {
+            idx++;
+        }
+        memmove(&dir->entries[idx + 1],
+                &dir->entries[idx],
+                (dir->size - idx) * sizeof(ChunkDirEntry));
+    }
+    dir->entries[idx] = entry;
+    dir->size++;
+    return idx;
+}
+
+void ChunkDir_Remove(ChunkDir *dir, size_t idx, size_t count) {
+    memmove(&dir->entries[idx],
+            &dir->entries[idx + count],
+            (dir->size - idx - count) * sizeof(ChunkDirEntry));
+    dir->size -= count;
+}
+
+void ChunkDir_Refresh(ChunkDir *dir, size_t idx, const ChunkFuncs *funcs) {
+    readBounds(&dir->entries[idx], funcs);
+}
+
+void ChunkDir_Append(ChunkDir *dir, timestamp_t ts) {
+    ChunkDirEntry *entry = ChunkDir_Last(dir);
+    if (entry->count == 0) {
+        entry->firstTs = ts;
+    }
+    entry->lastTs = ts;
+    entry->count++;
+}
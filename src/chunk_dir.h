@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#ifndef CHUNK_DIR_H
+#define CHUNK_DIR_H
+
+#include "generic_chunk.h"
+
+#include <stddef.h>    // size_t
+#include <sys/types.h> // u_int_t
+
+// Bounds of a chunk as last seen by the directory. An empty chunk has zeroed bounds.
+typedef struct ChunkDirEntry
+{
+    timestamp_t firstTs;
+    timestamp_t lastTs;
+    u_int64_t count;
+    Chunk_t *chunk;
+} ChunkDirEntry;
+
+// The chunks of a series, sorted by first timestamp. Chunks never overlap, so the entries are
+// sorted by last timestamp as well. Callers must refresh an entry after modifying its chunk.
+typedef struct ChunkDir
+{
+    ChunkDirEntry *entries;
+    size_t size;
+    size_t capacity;
+} ChunkDir;
+
+ChunkDir *ChunkDir_New();
+// Doesn't free the chunks
+void ChunkDir_Free(ChunkDir *dir);
+// Moves the directory during active defrag, the chunks are left in place. Returns the directory's
+// new address.
+ChunkDir *ChunkDir_Defrag(struct RedisModuleDefragCtx *ctx, ChunkDir *dir);
+
+static inline size_t ChunkDir_Size(const ChunkDir *dir) {
+    return dir->size;
+}
+
+static inline ChunkDirEntry *ChunkDir_At(const ChunkDir *dir, size_t idx) {
+    return &dir->entries[idx];
+}
+
+static inline ChunkDirEntry *ChunkDir_Last(const ChunkDir *dir) {
+    return &dir->entries[dir->size - 1];
+}
+
+// Index of the last entry whose first timestamp is <= ts, 0 if there is none
+size_t ChunkDir_Floor(const ChunkDir *dir, timestamp_t ts);
+// Index of the first entry whose last timestamp is >= ts, size if there is none
+size_t ChunkDir_Ceil(const ChunkDir *dir, timestamp_t ts);
+
+// Inserts the chunk by its first timestamp, an empty chunk is appended. Returns its index.
+size_t ChunkDir_Insert(ChunkDir *dir, Chunk_t *chunk, const ChunkFuncs *funcs);
+// Removes count entries starting at idx
+void ChunkDir_Remove(ChunkDir *dir, size_t idx, size_t count);
+// Re-reads the bounds of the entry's chunk
+void ChunkDir_Refresh(ChunkDir *dir, size_t idx, const ChunkFuncs *funcs);
+// Accounts a sample appended to the last chunk
+void ChunkDir_Append(ChunkDir *dir, timestamp_t ts);
+
+#endif // CHUNK_DIR_H
@@ -0,0 +1,193 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#include "chunk_pool.h"
+
+#include <stdbool.h>
+#include <stdlib.h> // malloc
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define CHUNK_POOL_MIN_SIZE 16
+// the classes are multiples of CHUNK_POOL_MIN_SIZE up to CHUNK_POOL_SMALL_SIZE, above it each
+// power of two is split in CHUNK_POOL_CLASSES_PER_DOUBLING classes like jemalloc's bins
+#define CHUNK_POOL_SMALL_SIZE 64
+#define CHUNK_POOL_SMALL_SIZE_LOG2 6
+#define CHUNK_POOL_CLASSES_PER_DOUBLING 4
+#define CHUNK_POOL_MAX_SIZE_LOG2 16
+#define CHUNK_POOL_NUM_CLASSES                                                                     \
+    (CHUNK_POOL_SMALL_SIZE / CHUNK_POOL_MIN_SIZE +                                                 \
+     (CHUNK_POOL_MAX_SIZE_LOG2 - CHUNK_POOL_SMALL_SIZE_LOG2) * CHUNK_POOL_CLASSES_PER_DOUBLING)
+
+// free buffers are linked through their first bytes
+typedef struct FreeBuffer
+{
+    struct FreeBuffer *next;
+} FreeBuffer;
+
+typedef struct PoolClass
+{
+    // chunks cloned for LibMR are released by its threads
+    bool lock;
+    FreeBuffer *free;
+    size_t cached;
+    size_t allocations;
+    size_t reused;
+    size_t frees;
+} PoolClass;
+
+static PoolClass classes[CHUNK_POOL_NUM_CLASSES];
+
+static inline void lockClass(PoolClass *poolClass) {
+    while (__atomic_test_and_set(&poolClass->lock, __ATOMIC_ACQUIRE)) {
+    }
+}
+
+static inline void unlockClass(PoolClass *poolClass) {
+    __atomic_clear(&poolClass->lock, __ATOMIC_RELEASE);
+}
+
+// Index of the class of size, which must be <= CHUNK_POOL_MAX_SIZE, its size is set in classSize
+static size_t classIndex(size_t size, size_t *classSize) {
+    if (size <= CHUNK_POOL_SMALL_SIZE) {
+        size_t index = size == 0 ? 0 : (size - 1) / CHUNK_POOL_MIN_SIZE;
+        *classSize = (index + 1) * CHUNK_POOL_MIN_SIZE;
+        return index;
+    }
+    // size is in (2^lg, 2^(lg+1)]
+    size_t lg = 63 - __builtin_clzll(size - 1);
+    size_t spacing = (size_t)1 << (lg - 2);
+    size_t base = (size_t)1 << lg;
+    size_t step = (size - base + spacing - 1) / spacing;
+    *classSize = base + step * spacing;
+    return CHUNK_POOL_SMALL_SIZE / CHUNK_POOL_MIN_SIZE +
+           (lg - CHUNK_POOL_SMALL_SIZE_LOG2) * CHUNK_POOL_CLASSES_PER_DOUBLING + step - 1;
+}
+
+// Size of the class at index
+static size_t classSizeAt(size_t index) {
+    size_t smallClasses = CHUNK_POOL_SMALL_SIZE / CHUNK_POOL_MIN_SIZE;
+    if (index < smallClasses) {
+        return (index + 1) * CHUNK_POOL_MIN_SIZE;
+    }
+    index -= smallClasses;
+    size_t lg = CHUNK_POOL_SMALL_SIZE_LOG2 + index / CHUNK_POOL_CLASSES_PER_DOUBLING;
+    size_t step = index % CHUNK_POOL_CLASSES_PER_DOUBLING + 1;
+    return ((size_t)1 << lg) + step * ((size_t)1 << (lg - 2));
+}
+
+size_t ChunkPool_ClassSize(size_t size) {
+    if (size > CHUNK_POOL_MAX_SIZE) {
+        return size;
+    }
+    size_t classSize;
+    classIndex(size, &classSize);
+    return classSize;
+}
+
+void *ChunkPool_Alloc(size_t size) {
+    if (size > CHUNK_POOL_MAX_SIZE) {
+        return malloc(size);
+    }
+    size_t classSize;
+    PoolClass *poolClass = &classes[classIndex(size, &classSize)];
+    lockClass(poolClass);
+    FreeBuffer *buf = poolClass->free;
+    poolClass->allocations++;
+    if (buf) {
+        poolClass->free = buf->next;
+        poolClass->cached--;
+        poolClass->reused++;
+    }
+    unlockClass(poolClass);
+    return buf ? (void *)buf : malloc(classSize);
+}
+
+void *ChunkPool_Calloc(size_t size) {
+    void *ptr = ChunkPool_Alloc(size);
+    memset(ptr, 0, size);
+    return ptr;
+}
+
+void ChunkPool_Free(void *ptr, size_t size) {
+    if (!ptr) {
+        return;
+    }
+    if (size > CHUNK_POOL_MAX_SIZE) {
+        free(ptr);
+        return;
+    }
+    size_t classSize;
+    PoolClass *poolClass = &classes[classIndex(size, &classSize)];
+    bool cache;
+    lockClass(poolClass);
+    poolClass->frees++;
+    cache = (poolClass->cached + 1) * classSize <= CHUNK_POOL_CLASS_CACHE;
+    if (cache) {
+        FreeBuffer *buf = ptr;
+        buf->next = poolClass->free;
+        poolClass->free = buf;
+        poolClass->cached++;
+    }
+    unlockClass(poolClass);
+    if (!cache) {
+        free(ptr);
+    }
+}
+
+void *ChunkPool_Realloc(void *ptr, size_t oldSize, size_t newSize) {
+    if (!ptr) {
+        return ChunkPool_Alloc(newSize);
+    }
+    if (oldSize > CHUNK_POOL_MAX_SIZE && newSize > CHUNK_POOL_MAX_SIZE) {
+        return realloc(ptr, newSize);
+    }
+    if (ChunkPool_ClassSize(oldSize) == ChunkPool_ClassSize(newSize)) {
+        return ptr;
+    }
+    void *newPtr = ChunkPool_Alloc(newSize);
+    memcpy(newPtr, ptr, oldSize < newSize ? oldSize : newSize);
+    ChunkPool_Free(ptr, oldSize);
+    return newPtr;
+}
+
+void *ChunkPool_Defrag(RedisModuleDefragCtx *ctx, void *ptr) {
+    if (!ptr) {
+        return NULL;
+    }
+    void *moved = RedisModule_DefragAlloc(ctx, ptr);
+    return moved ? moved : ptr;
+}
+
+void ChunkPool_Trim(void) {
+    for (size_t i = 0; i < CHUNK_POOL_NUM_CLASSES; ++i) {
+        PoolClass *poolClass = &classes[i];
+        lockClass(poolClass);
+        FreeBuffer *buf = poolClass->free;
+        poolClass->free = NULL;
+        poolClass->cached = 0;
+        unlockClass(poolClass);
+        while (buf) {
+            FreeBuffer *next = buf->next;
+            free(buf);
+            buf = next;
+        }
+    }
+}
+
+void ChunkPool_GetStats(ChunkPoolStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i < CHUNK_POOL_NUM_CLASSES; ++i) {
+        PoolClass *poolClass = &classes[i];
+        lockClass(poolClass);
+        stats->allocations += poolClass->allocations;
+        stats->reused += poolClass->reused;
+        stats->frees += poolClass->frees;
+        stats->cachedBuffers += poolClass->cached;
+        stats->cachedBytes += poolClass->cached * classSizeAt(i);
+        unlockClass(poolClass);
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#ifndef CHUNK_POOL_H
+#define CHUNK_POOL_H
+
+#include "redismodule.h"
+
+#include <stddef.h> // size_t
+
+// Allocator of the chunk buffers and headers. Sizes are rounded up to size classes matching the
+// allocator's bins, freed buffers are kept per class and handed out again so that chunks which are
+// created and released all the time don't go through the allocator. Buffers larger than
+// CHUNK_POOL_MAX_SIZE are allocated directly. The size of a buffer must be passed back on free and
+// realloc, it is what selects its class.
+#define CHUNK_POOL_MAX_SIZE (64 * 1024)
+// bytes of free buffers a class keeps at most
+#define CHUNK_POOL_CLASS_CACHE (256 * 1024)
+
+typedef struct ChunkPoolStats
+{
+    size_t allocations;   // buffers handed out
+    size_t reused;        // buffers handed out from the cache
+    size_t frees;         // buffers given back
+    size_t cachedBuffers; // buffers currently in the cache
+    size_t cachedBytes;   // bytes currently in the cache
+} ChunkPoolStats;
+
+void *ChunkPool_Alloc(size_t size);
+void *ChunkPool_Calloc(size_t size);
+// Keeps ptr when both sizes fall in the same class
+void *ChunkPool_Realloc(void *ptr, size_t oldSize, size_t newSize);
+void ChunkPool_Free(void *ptr, size_t size);
+
+// Size actually reserved for a buffer of size bytes
+size_t ChunkPool_ClassSize(size_t size);
+
+// Moves a buffer during active defrag, returns ptr if it wasn't moved
+void *ChunkPool_Defrag(RedisModuleDefragCtx *ctx, void *ptr);
+// Releases the cached buffers to the allocator
+void ChunkPool_Trim(void);
+
+void ChunkPool_GetStats(ChunkPoolStats *stats);
+
+#endif // CHUNK_POOL_H
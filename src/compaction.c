@@ -6,12 +6,14 @@
 #include "compaction.h"
 
 #include "load_io_error_macros.h"
+#include "quantile_sketch.h"
 #include "rdb.h"
 
 #include "rmutil/alloc.h"
 #include "compactions/compaction_common.h"
 #include "compactions/compaction_avx512f.h"
 #include "compactions/compaction_avx2.h"
+#include "compactions/compaction_sse2.h"
 #include "utils/arch_features.h"
 
 #include <ctype.h>
@@ -30,18 +32,6 @@ typedef struct FirstValueContext
     char isResetted;
 } FirstValueContext;
 
-typedef struct SingleValueContext
-{
-    double value;
-} SingleValueContext;
-
-typedef struct AvgContext
-{
-    double val;
-    double cnt;
-    bool isOverflow;
-} AvgContext;
-
 typedef struct TwaContext
 {
     double res;
@@ -56,13 +46,6 @@ typedef struct TwaContext
     int64_t iteration;
 } TwaContext;
 
-typedef struct StdContext
-{
-    double sum;
-    double sum_2; // sum of (values^2)
-    u_int64_t cnt;
-} StdContext;
-
 void finalize_empty_with_NAN(__unused void *contextPtr, double *value) {
     *value = NAN;
 }
@@ -218,6 +201,36 @@ void AvgAddValue(void *contextPtr, double value, __attribute__((unused)) timesta
     }
 }
 
+void AvgAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei) {
+    for (size_t i = si; i <= ei; ++i) {
+        AvgAddValue(context, values[i], 0);
+    }
+}
+
+void AvgAppendChunkStats(void *contextPtr, const ChunkStats *stats, __unused bool reverse) {
+    AvgContext *context = (AvgContext *)contextPtr;
+    double sum = context->val + stats->sum;
+    if (likely(!context->isOverflow && isfinite(sum))) {
+        context->val = sum;
+        context->cnt += stats->count;
+        return;
+    }
+
+    // keep the running average instead of the sum, as AvgAddValue does on overflow
+    long double cnt = context->cnt + stats->count;
+    long double ld_val = context->val;
+    if (!context->isOverflow) {
+        ld_val /= context->cnt;
+    }
+    ld_val = ld_val * (context->cnt / cnt) + (long double)stats->sum / cnt;
+    context->val = ld_val;
+    context->cnt = cnt;
+    context->isOverflow = true;
+}
+
 void AvgFinalize(void *contextPtr, double *value) {
     AvgContext *context = (AvgContext *)contextPtr;
     assert(context->cnt > 0);
@@ -433,6 +446,18 @@ void StdAddValue(void *contextPtr, double value, __attribute__((unused)) timesta
     context->sum_2 += value * value;
 }
 
+void StdAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei) {
+    StdContext *stdContext = (StdContext *)context;
+    for (size_t i = si; i <= ei; ++i) {
+        stdContext->sum += values[i];
+        stdContext->sum_2 += values[i] * values[i];
+    }
+    stdContext->cnt += ei - si + 1;
+}
+
 static inline double variance(double sum, double sum_2, double count) {
     if (count == 0) {
         return 0;
@@ -505,6 +530,7 @@ void rm_free(void *ptr) {
 static AggregationClass aggWAvg = { .type = TS_AGG_TWA,
                                     .createContext = TwaCreateContext,
                                     .appendValue = TwaAddValue,
+                                    .appendChunkStats = NULL,
                                     .freeContext = rm_free,
                                     .finalize = TwaFinalize,
                                     .finalizeEmpty = finalize_empty_with_NAN,
@@ -515,12 +541,14 @@ static AggregationClass aggWAvg = { .type = TS_AGG_TWA,
                                     .addNextBucketFirstSample = TwaAddNextBucketFirstSample,
                                     .getLastSample = TwaGetLastSample,
                                     .resetContext = TwaReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = TwaCloneContext };
 
 static AggregationClass aggAvg = { .type = TS_AGG_AVG,
                                    .createContext = AvgCreateContext,
                                    .appendValue = AvgAddValue,
                                    .appendValueVec = NULL, /* determined on run time */
+                                   .appendChunkStats = AvgAppendChunkStats,
                                    .freeContext = rm_free,
                                    .finalize = AvgFinalize,
                                    .finalizeEmpty = finalize_empty_with_NAN,
@@ -531,12 +559,14 @@ static AggregationClass aggAvg = { .type = TS_AGG_AVG,
                                    .addNextBucketFirstSample = NULL,
                                    .getLastSample = NULL,
                                    .resetContext = AvgReset,
+                                   .updateFinalized = NULL,
                                    .cloneContext = AvgCloneContext };
 
 static AggregationClass aggStdP = { .type = TS_AGG_STD_P,
                                     .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
                                     .appendValueVec = NULL, /* determined on run time */
+                                    .appendChunkStats = NULL,
                                     .freeContext = rm_free,
                                     .finalize = StdPopulationFinalize,
                                     .finalizeEmpty = finalize_empty_with_NAN,
@@ -547,12 +577,14 @@ static AggregationClass aggStdP = { .type = TS_AGG_STD_P,
                                     .addNextBucketFirstSample = NULL,
                                     .getLastSample = NULL,
                                     .resetContext = StdReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = StdCloneContext };
 
 static AggregationClass aggStdS = { .type = TS_AGG_STD_S,
                                     .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
                                     .appendValueVec = NULL, /* determined on run time */
+                                    .appendChunkStats = NULL,
                                     .freeContext = rm_free,
                                     .finalize = StdSamplesFinalize,
                                     .finalizeEmpty = finalize_empty_with_NAN,
@@ -563,12 +595,14 @@ static AggregationClass aggStdS = { .type = TS_AGG_STD_S,
                                     .addNextBucketFirstSample = NULL,
                                     .getLastSample = NULL,
                                     .resetContext = StdReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = StdCloneContext };
 
 static AggregationClass aggVarP = { .type = TS_AGG_VAR_P,
                                     .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
                                     .appendValueVec = NULL, /* determined on run time */
+                                    .appendChunkStats = NULL,
                                     .freeContext = rm_free,
                                     .finalize = VarPopulationFinalize,
                                     .finalizeEmpty = finalize_empty_with_NAN,
@@ -579,12 +613,14 @@ static AggregationClass aggVarP = { .type = TS_AGG_VAR_P,
                                     .addNextBucketFirstSample = NULL,
                                     .getLastSample = NULL,
                                     .resetContext = StdReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = StdCloneContext };
 
 static AggregationClass aggVarS = { .type = TS_AGG_VAR_S,
                                     .createContext = StdCreateContext,
                                     .appendValue = StdAddValue,
                                     .appendValueVec = NULL, /* determined on run time */
+                                    .appendChunkStats = NULL,
                                     .freeContext = rm_free,
                                     .finalize = VarSamplesFinalize,
                                     .finalizeEmpty = finalize_empty_with_NAN,
@@ -595,6 +631,7 @@ static AggregationClass aggVarS = { .type = TS_AGG_VAR_S,
                                     .addNextBucketFirstSample = NULL,
                                     .getLastSample = NULL,
                                     .resetContext = StdReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = StdCloneContext };
 
 void *MaxMinCreateContext(__unused bool reverse) {
@@ -623,6 +660,20 @@ void MaxAppendValuesVec(void *__restrict__ context,
     }
 }
 
+void MaxAppendChunkStats(void *context, const ChunkStats *stats, __unused bool reverse) {
+    double value = stats->max;
+    _AssignIfGreater(&((MaxMinContext *)context)->maxValue, &value);
+}
+
+// the bucket has to be rescanned when its max was replaced by a smaller value
+bool MaxUpdateFinalized(double *aggValue, double value, bool replaced, double oldValue) {
+    if (value >= *aggValue) {
+        *aggValue = value;
+        return true;
+    }
+    return !replaced || oldValue < *aggValue;
+}
+
 void MinAppendValue(void *contextPtr, double value, __attribute__((unused)) timestamp_t ts) {
     MaxMinContext *context = (MaxMinContext *)contextPtr;
     if (value < context->minValue) {
@@ -630,6 +681,31 @@ void MinAppendValue(void *contextPtr, double value, __attribute__((unused)) time
     }
 }
 
+void MinAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei) {
+    for (size_t i = si; i <= ei; ++i) {
+        MinAppendValue(context, values[i], 0);
+    }
+}
+
+void MinAppendChunkStats(void *contextPtr, const ChunkStats *stats, __unused bool reverse) {
+    MaxMinContext *context = (MaxMinContext *)contextPtr;
+    if (stats->min < context->minValue) {
+        context->minValue = stats->min;
+    }
+}
+
+// the bucket has to be rescanned when its min was replaced by a larger value
+bool MinUpdateFinalized(double *aggValue, double value, bool replaced, double oldValue) {
+    if (value <= *aggValue) {
+        *aggValue = value;
+        return true;
+    }
+    return !replaced || oldValue > *aggValue;
+}
+
 void MaxMinAppendValue(void *contextPtr, double value, __attribute__((unused)) timestamp_t ts) {
     MaxMinContext *context = (MaxMinContext *)contextPtr;
     if (value > context->maxValue) {
@@ -640,6 +716,25 @@ void MaxMinAppendValue(void *contextPtr, double value, __attribute__((unused)) t
     }
 }
 
+void MaxMinAppendValuesVec(void *__restrict__ context,
+                           double *__restrict__ values,
+                           size_t si,
+                           size_t ei) {
+    for (size_t i = si; i <= ei; ++i) {
+        MaxMinAppendValue(context, values[i], 0);
+    }
+}
+
+void MaxMinAppendChunkStats(void *contextPtr, const ChunkStats *stats, __unused bool reverse) {
+    MaxMinContext *context = (MaxMinContext *)contextPtr;
+    if (stats->max > context->maxValue) {
+        context->maxValue = stats->max;
+    }
+    if (stats->min < context->minValue) {
+        context->minValue = stats->min;
+    }
+}
+
 void MaxFinalize(void *contextPtr, double *value) {
     MaxMinContext *context = (MaxMinContext *)contextPtr;
     *value = context->maxValue;
@@ -681,11 +776,54 @@ void SumAppendValue(void *contextPtr, double value, __attribute__((unused)) time
     context->value += value;
 }
 
+void SumAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei) {
+    SingleValueContext *sumContext = (SingleValueContext *)context;
+    for (size_t i = si; i <= ei; ++i) {
+        sumContext->value += values[i];
+    }
+}
+
+void SumAppendChunkStats(void *contextPtr, const ChunkStats *stats, __unused bool reverse) {
+    FirstValueContext *context = (FirstValueContext *)contextPtr;
+    context->value += stats->sum;
+}
+
+bool SumUpdateFinalized(double *aggValue, double value, bool replaced, double oldValue) {
+    *aggValue += replaced ? value - oldValue : value;
+    return true;
+}
+
 void CountAppendValue(void *contextPtr, double value, __attribute__((unused)) timestamp_t ts) {
     FirstValueContext *context = (FirstValueContext *)contextPtr;
     context->value++;
 }
 
+// the values don't matter, no need for a vectorized version
+void CountAppendValuesVec(void *__restrict__ context,
+                          __unused double *__restrict__ values,
+                          size_t si,
+                          size_t ei) {
+    ((SingleValueContext *)context)->value += ei - si + 1;
+}
+
+void CountAppendChunkStats(void *contextPtr, const ChunkStats *stats, __unused bool reverse) {
+    FirstValueContext *context = (FirstValueContext *)contextPtr;
+    context->value += stats->count;
+}
+
+bool CountUpdateFinalized(double *aggValue,
+                          __unused double value,
+                          bool replaced,
+                          __unused double oldValue) {
+    if (!replaced) {
+        (*aggValue)++;
+    }
+    return true;
+}
+
 void CountFinalize(void *contextPtr, double *val) {
     FirstValueContext *context = (FirstValueContext *)contextPtr;
     *val = context->value;
@@ -699,15 +837,46 @@ void FirstAppendValue(void *contextPtr, double value, __attribute__((unused)) ti
     }
 }
 
+// values are in time order, only the first one of the bucket is read
+void FirstAppendValuesVec(void *__restrict__ context,
+                          double *__restrict__ values,
+                          size_t si,
+                          __unused size_t ei) {
+    FirstAppendValue(context, values[si], 0);
+}
+
+// the first appended sample is the last one of the chunk when iterating in reverse
+void FirstAppendChunkStats(void *contextPtr, const ChunkStats *stats, bool reverse) {
+    FirstValueContext *context = (FirstValueContext *)contextPtr;
+    if (context->isResetted) {
+        context->isResetted = FALSE;
+        context->value = reverse ? stats->last.value : stats->first.value;
+    }
+}
+
 void LastAppendValue(void *contextPtr, double value, __attribute__((unused)) timestamp_t ts) {
     SingleValueContext *context = (SingleValueContext *)contextPtr;
     context->value = value;
 }
 
+// values are in time order, only the last one of the bucket is read
+void LastAppendValuesVec(void *__restrict__ context,
+                         double *__restrict__ values,
+                         __unused size_t si,
+                         size_t ei) {
+    LastAppendValue(context, values[ei], 0);
+}
+
+void LastAppendChunkStats(void *contextPtr, const ChunkStats *stats, bool reverse) {
+    SingleValueContext *context = (SingleValueContext *)contextPtr;
+    context->value = reverse ? stats->first.value : stats->last.value;
+}
+
 static AggregationClass aggMax = { .type = TS_AGG_MAX,
                                    .createContext = MaxMinCreateContext,
                                    .appendValue = MaxAppendValue,
                                    .appendValueVec = NULL, /* determined on run time */
+                                   .appendChunkStats = MaxAppendChunkStats,
                                    .freeContext = rm_free,
                                    .finalize = MaxFinalize,
                                    .finalizeEmpty = finalize_empty_with_NAN,
@@ -718,12 +887,14 @@ static AggregationClass aggMax = { .type = TS_AGG_MAX,
                                    .addNextBucketFirstSample = NULL,
                                    .getLastSample = NULL,
                                    .resetContext = MaxMinReset,
+                                   .updateFinalized = MaxUpdateFinalized,
                                    .cloneContext = MaxMinCloneContext };
 
 static AggregationClass aggMin = { .type = TS_AGG_MIN,
                                    .createContext = MaxMinCreateContext,
                                    .appendValue = MinAppendValue,
                                    .appendValueVec = NULL, /* determined on run time */
+                                   .appendChunkStats = MinAppendChunkStats,
                                    .freeContext = rm_free,
                                    .finalize = MinFinalize,
                                    .finalizeEmpty = finalize_empty_with_NAN,
@@ -734,12 +905,14 @@ static AggregationClass aggMin = { .type = TS_AGG_MIN,
                                    .addNextBucketFirstSample = NULL,
                                    .getLastSample = NULL,
                                    .resetContext = MaxMinReset,
+                                   .updateFinalized = MinUpdateFinalized,
                                    .cloneContext = MaxMinCloneContext };
 
 static AggregationClass aggSum = { .type = TS_AGG_SUM,
                                    .createContext = SingleValueCreateContext,
                                    .appendValue = SumAppendValue,
                                    .appendValueVec = NULL, /* determined on run time */
+                                   .appendChunkStats = SumAppendChunkStats,
                                    .freeContext = rm_free,
                                    .finalize = SingleValueFinalize,
                                    .finalizeEmpty = finalize_empty_with_ZERO,
@@ -750,12 +923,14 @@ static AggregationClass aggSum = { .type = TS_AGG_SUM,
                                    .addNextBucketFirstSample = NULL,
                                    .getLastSample = NULL,
                                    .resetContext = SingleValueReset,
+                                   .updateFinalized = SumUpdateFinalized,
                                    .cloneContext = SingleValueCloneContext };
 
 static AggregationClass aggCount = { .type = TS_AGG_COUNT,
                                      .createContext = SingleValueCreateContext,
                                      .appendValue = CountAppendValue,
                                      .appendValueVec = NULL, /* determined on run time */
+                                     .appendChunkStats = CountAppendChunkStats,
                                      .freeContext = rm_free,
                                      .finalize = CountFinalize,
                                      .finalizeEmpty = finalize_empty_with_ZERO,
@@ -766,12 +941,14 @@ static AggregationClass aggCount = { .type = TS_AGG_COUNT,
                                      .addNextBucketFirstSample = NULL,
                                      .getLastSample = NULL,
                                      .resetContext = SingleValueReset,
+                                     .updateFinalized = CountUpdateFinalized,
                                      .cloneContext = SingleValueCloneContext };
 
 static AggregationClass aggFirst = { .type = TS_AGG_FIRST,
                                      .createContext = FirstValueCreateContext,
                                      .appendValue = FirstAppendValue,
-                                     .appendValueVec = NULL, /* determined on run time */
+                                     .appendValueVec = FirstAppendValuesVec,
+                                     .appendChunkStats = FirstAppendChunkStats,
                                      .freeContext = rm_free,
                                      .finalize = FirstValueFinalize,
                                      .finalizeEmpty = finalize_empty_with_NAN,
@@ -782,12 +959,14 @@ static AggregationClass aggFirst = { .type = TS_AGG_FIRST,
                                      .addNextBucketFirstSample = NULL,
                                      .getLastSample = NULL,
                                      .resetContext = FirstValueReset,
+                                     .updateFinalized = NULL,
                                      .cloneContext = FirstValueCloneContext };
 
 static AggregationClass aggLast = { .type = TS_AGG_LAST,
                                     .createContext = SingleValueCreateContext,
                                     .appendValue = LastAppendValue,
-                                    .appendValueVec = NULL, /* determined on run time */
+                                    .appendValueVec = LastAppendValuesVec,
+                                    .appendChunkStats = LastAppendChunkStats,
                                     .freeContext = rm_free,
                                     .finalize = SingleValueFinalize,
                                     .finalizeEmpty = finalize_empty_last_value,
@@ -798,12 +977,14 @@ static AggregationClass aggLast = { .type = TS_AGG_LAST,
                                     .addNextBucketFirstSample = NULL,
                                     .getLastSample = NULL,
                                     .resetContext = LastValueReset,
+                                    .updateFinalized = NULL,
                                     .cloneContext = SingleValueCloneContext };
 
 static AggregationClass aggRange = { .type = TS_AGG_RANGE,
                                      .createContext = MaxMinCreateContext,
                                      .appendValue = MaxMinAppendValue,
                                      .appendValueVec = NULL, /* determined on run time */
+                                     .appendChunkStats = MaxMinAppendChunkStats,
                                      .freeContext = rm_free,
                                      .finalize = RangeFinalize,
                                      .finalizeEmpty = finalize_empty_with_NAN,
@@ -814,22 +995,356 @@ static AggregationClass aggRange = { .type = TS_AGG_RANGE,
                                      .addNextBucketFirstSample = NULL,
                                      .getLastSample = NULL,
                                      .resetContext = MaxMinReset,
+                                     .updateFinalized = NULL,
                                      .cloneContext = MaxMinCloneContext };
 
+void *QuantileCreateContext(__unused bool reverse) {
+    return QuantileSketch_New();
+}
+
+void QuantileFreeContext(void *contextPtr) {
+    QuantileSketch_Free((QuantileSketch *)contextPtr);
+}
+
+void *QuantileCloneContext(void *contextPtr) {
+    QuantileSketch *clone = QuantileSketch_New();
+    QuantileSketch_Merge(clone, (QuantileSketch *)contextPtr);
+    return clone;
+}
+
+void QuantileAppendValue(void *contextPtr, double value, __unused timestamp_t ts) {
+    QuantileSketch_Add((QuantileSketch *)contextPtr, value);
+}
+
+void QuantileReset(void *contextPtr) {
+    QuantileSketch_Reset((QuantileSketch *)contextPtr);
+}
+
+void P50Finalize(void *contextPtr, double *value) {
+    *value = QuantileSketch_Quantile((QuantileSketch *)contextPtr, 0.5);
+}
+
+void P90Finalize(void *contextPtr, double *value) {
+    *value = QuantileSketch_Quantile((QuantileSketch *)contextPtr, 0.9);
+}
+
+void P95Finalize(void *contextPtr, double *value) {
+    *value = QuantileSketch_Quantile((QuantileSketch *)contextPtr, 0.95);
+}
+
+void P99Finalize(void *contextPtr, double *value) {
+    *value = QuantileSketch_Quantile((QuantileSketch *)contextPtr, 0.99);
+}
+
+void P999Finalize(void *contextPtr, double *value) {
+    *value = QuantileSketch_Quantile((QuantileSketch *)contextPtr, 0.999);
+}
+
+static void quantileStoreWrite(const QuantileStore *store, RedisModuleIO *io) {
+    RedisModule_SaveSigned(io, store->offset);
+    RedisModule_SaveUnsigned(io, store->length);
+    for (uint32_t i = 0; i < store->length; ++i) {
+        RedisModule_SaveUnsigned(io, store->counts[i]);
+    }
+}
+
+void QuantileWriteContext(void *contextPtr, RedisModuleIO *io) {
+    QuantileSketch *sketch = (QuantileSketch *)contextPtr;
+    RedisModule_SaveUnsigned(io, sketch->zeroCount);
+    RedisModule_SaveDouble(io, sketch->min);
+    RedisModule_SaveDouble(io, sketch->max);
+    quantileStoreWrite(&sketch->positive, io);
+    quantileStoreWrite(&sketch->negative, io);
+}
+
+static int quantileStoreRead(QuantileSketch *sketch, bool negative, RedisModuleIO *io) {
+    int64_t offset = LoadSigned_IOError(io, goto err);
+    uint64_t length = LoadUnsigned_IOError(io, goto err);
+    if (length > QUANTILE_SKETCH_MAX_BINS) {
+        goto err;
+    }
+    for (uint64_t i = 0; i < length; ++i) {
+        uint64_t count = LoadUnsigned_IOError(io, goto err);
+        QuantileSketch_AddBin(sketch, negative, offset + i, count);
+    }
+    return TSDB_OK;
+err:
+    return TSDB_ERROR;
+}
+
+int QuantileReadContext(void *contextPtr, RedisModuleIO *io, __unused int encver) {
+    QuantileSketch *sketch = (QuantileSketch *)contextPtr;
+    QuantileSketch_Reset(sketch);
+    sketch->zeroCount = LoadUnsigned_IOError(io, goto err);
+    sketch->count = sketch->zeroCount;
+    sketch->min = LoadDouble_IOError(io, goto err);
+    sketch->max = LoadDouble_IOError(io, goto err);
+    if (quantileStoreRead(sketch, false, io) != TSDB_OK ||
+        quantileStoreRead(sketch, true, io) != TSDB_OK) {
+        goto err;
+    }
+    return TSDB_OK;
+err:
+    return TSDB_ERROR;
+}
+
+static AggregationClass aggP50 = { .type = TS_AGG_P50,
+                                   .createContext = QuantileCreateContext,
+                                   .appendValue = QuantileAppendValue,
+                                   .appendValueVec = NULL,
+                                   .appendChunkStats = NULL,
+                                   .freeContext = QuantileFreeContext,
+                                   .finalize = P50Finalize,
+                                   .finalizeEmpty = finalize_empty_with_NAN,
+                                   .writeContext = QuantileWriteContext,
+                                   .readContext = QuantileReadContext,
+                                   .addBucketParams = NULL,
+                                   .addPrevBucketLastSample = NULL,
+                                   .addNextBucketFirstSample = NULL,
+                                   .getLastSample = NULL,
+                                   .resetContext = QuantileReset,
+                                   .updateFinalized = NULL,
+                                   .cloneContext = QuantileCloneContext };
+
+static AggregationClass aggP90 = { .type = TS_AGG_P90,
+                                   .createContext = QuantileCreateContext,
+                                   .appendValue = QuantileAppendValue,
+                                   .appendValueVec = NULL,
+                                   .appendChunkStats = NULL,
+                                   .freeContext = QuantileFreeContext,
+                                   .finalize = P90Finalize,
+                                   .finalizeEmpty = finalize_empty_with_NAN,
+                                   .writeContext = QuantileWriteContext,
+                                   .readContext = QuantileReadContext,
+                                   .addBucketParams = NULL,
+                                   .addPrevBucketLastSample = NULL,
+                                   .addNextBucketFirstSample = NULL,
+                                   .getLastSample = NULL,
+                                   .resetContext = QuantileReset,
+                                   .updateFinalized = NULL,
+                                   .cloneContext = QuantileCloneContext };
+
+static AggregationClass aggP95 = { .type = TS_AGG_P95,
+                                   .createContext = QuantileCreateContext,
+                                   .appendValue = QuantileAppendValue,
+                                   .appendValueVec = NULL,
+                                   .appendChunkStats = NULL,
+                                   .freeContext = QuantileFreeContext,
+                                   .finalize = P95Finalize,
+                                   .finalizeEmpty = finalize_empty_with_NAN,
+                                   .writeContext = QuantileWriteContext,
+                                   .readContext = QuantileReadContext,
+                                   .addBucketParams = NULL,
+                                   .addPrevBucketLastSample = NULL,
+                                   .addNextBucketFirstSample = NULL,
+                                   .getLastSample = NULL,
+                                   .resetContext = QuantileReset,
+                                   .updateFinalized = NULL,
+                                   .cloneContext = QuantileCloneContext };
+
+static AggregationClass aggP99 = { .type = TS_AGG_P99,
+                                   .createContext = QuantileCreateContext,
+                                   .appendValue = QuantileAppendValue,
+                                   .appendValueVec = NULL,
+                                   .appendChunkStats = NULL,
+                                   .freeContext = QuantileFreeContext,
+                                   .finalize = P99Finalize,
+                                   .finalizeEmpty = finalize_empty_with_NAN,
+                                   .writeContext = QuantileWriteContext,
+                                   .readContext = QuantileReadContext,
+                                   .addBucketParams = NULL,
+                                   .addPrevBucketLastSample = NULL,
+                                   .addNextBucketFirstSample = NULL,
+                                   .getLastSample = NULL,
+                                   .resetContext = QuantileReset,
+                                   .updateFinalized = NULL,
+                                   .cloneContext = QuantileCloneContext };
+
+static AggregationClass aggP999 = { .type = TS_AGG_P999,
+                                    .createContext = QuantileCreateContext,
+                                    .appendValue = QuantileAppendValue,
+                                    .appendValueVec = NULL,
+                                    .appendChunkStats = NULL,
+                                    .freeContext = QuantileFreeContext,
+                                    .finalize = P999Finalize,
+                                    .finalizeEmpty = finalize_empty_with_NAN,
+                                    .writeContext = QuantileWriteContext,
+                                    .readContext = QuantileReadContext,
+                                    .addBucketParams = NULL,
+                                    .addPrevBucketLastSample = NULL,
+                                    .addNextBucketFirstSample = NULL,
+                                    .getLastSample = NULL,
+                                    .resetContext = QuantileReset,
+                                    .updateFinalized = NULL,
+                                    .cloneContext = QuantileCloneContext };
+
+typedef struct MultiAggContext
+{
+    size_t count;
+    AggregationClass *classes[MAX_AGGREGATIONS];
+    void *contexts[MAX_AGGREGATIONS];
+    double values[MAX_AGGREGATIONS]; // of the last finalized bucket
+} MultiAggContext;
+
+void *MultiAggCreateContext(AggregationClass *const *classes, size_t count, bool reverse) {
+    MultiAggContext *context = (MultiAggContext *)malloc(sizeof(MultiAggContext));
+    context->count = count;
+    for (size_t i = 0; i < count; ++i) {
+        context->classes[i] = classes[i];
+        context->contexts[i] = classes[i]->createContext(reverse);
+        context->values[i] = NAN;
+    }
+    return context;
+}
+
+void MultiAggFreeContext(void *contextPtr) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->freeContext(context->contexts[i]);
+    }
+    free(context);
+}
+
+void MultiAggAppendValue(void *contextPtr, double value, timestamp_t ts) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->appendValue(context->contexts[i], value, ts);
+    }
+}
+
+void MultiAggAppendValuesVec(void *__restrict__ contextPtr,
+                             double *__restrict__ values,
+                             size_t si,
+                             size_t ei) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->appendValueVec(context->contexts[i], values, si, ei);
+    }
+}
+
+void MultiAggAppendChunkStats(void *contextPtr, const ChunkStats *stats, bool reverse) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->appendChunkStats(context->contexts[i], stats, reverse);
+    }
+}
+
+void MultiAggReset(void *contextPtr) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->resetContext(context->contexts[i]);
+    }
+}
+
+void MultiAggFinalize(void *contextPtr, double *value) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->finalize(context->contexts[i], &context->values[i]);
+    }
+    *value = context->values[0];
+}
+
+void MultiAggFinalizeEmpty(void *contextPtr, double *value) {
+    MultiAggContext *context = (MultiAggContext *)contextPtr;
+    for (size_t i = 0; i < context->count; ++i) {
+        context->classes[i]->finalizeEmpty(context->contexts[i], &context->values[i]);
+    }
+    *value = context->values[0];
+}
+
+const double *MultiAggValues(const void *contextPtr) {
+    return ((const MultiAggContext *)contextPtr)->values;
+}
+
+static AggregationClass aggMulti = { .type = TS_AGG_NONE,
+                                     .createContext = NULL, /* MultiAggCreateContext */
+                                     .appendValue = MultiAggAppendValue,
+                                     .appendValueVec = MultiAggAppendValuesVec,
+                                     .appendChunkStats = MultiAggAppendChunkStats,
+                                     .freeContext = MultiAggFreeContext,
+                                     .finalize = MultiAggFinalize,
+                                     .finalizeEmpty = MultiAggFinalizeEmpty,
+                                     .writeContext = NULL,
+                                     .readContext = NULL,
+                                     .addBucketParams = NULL,
+                                     .addPrevBucketLastSample = NULL,
+                                     .addNextBucketFirstSample = NULL,
+                                     .getLastSample = NULL,
+                                     .resetContext = MultiAggReset,
+                                     .updateFinalized = NULL,
+                                     .cloneContext = NULL };
+
+void MultiAggInitClass(AggregationClass *out, AggregationClass *const *classes, size_t count) {
+    *out = aggMulti;
+    for (size_t i = 0; i < count; ++i) {
+        if (!classes[i]->appendValueVec) {
+            out->appendValueVec = NULL;
+        }
+        if (!classes[i]->appendChunkStats) {
+            out->appendChunkStats = NULL;
+        }
+    }
+}
+
+// The kernels of the aggregations whose buckets only depend on the values of their samples
+typedef struct AppendValuesKernels
+{
+    void (*max)(void *__restrict__, double *__restrict__, size_t, size_t);
+    void (*min)(void *__restrict__, double *__restrict__, size_t, size_t);
+    void (*range)(void *__restrict__, double *__restrict__, size_t, size_t);
+    void (*sum)(void *__restrict__, double *__restrict__, size_t, size_t);
+    void (*avg)(void *__restrict__, double *__restrict__, size_t, size_t);
+    void (*std)(void *__restrict__, double *__restrict__, size_t, size_t);
+} AppendValuesKernels;
+
+static void setAppendValuesKernels(const AppendValuesKernels *kernels) {
+    aggMax.appendValueVec = kernels->max;
+    aggMin.appendValueVec = kernels->min;
+    aggRange.appendValueVec = kernels->range;
+    aggSum.appendValueVec = kernels->sum;
+    aggAvg.appendValueVec = kernels->avg;
+    aggStdP.appendValueVec = kernels->std;
+    aggStdS.appendValueVec = kernels->std;
+    aggVarP.appendValueVec = kernels->std;
+    aggVarS.appendValueVec = kernels->std;
+}
+
 void initGlobalCompactionFunctions() {
     const X86Features *features = getArchitectureOptimization();
-    aggMax.appendValueVec = MaxAppendValuesVec;
+    aggCount.appendValueVec = CountAppendValuesVec;
+    setAppendValuesKernels(&(AppendValuesKernels){ .max = MaxAppendValuesVec,
+                                                   .min = MinAppendValuesVec,
+                                                   .range = MaxMinAppendValuesVec,
+                                                   .sum = SumAppendValuesVec,
+                                                   .avg = AvgAppendValuesVec,
+                                                   .std = StdAppendValuesVec });
 
 #if defined(__x86_64__)
     if (!features) {
         return;
-        /* remove this comment to enable avx512
-     } else if (features->avx512f) {
-            aggMax.appendValueVec = MaxAppendValuesAVX512F;
-            return;
-        }*/
+    } else if (features->avx512f) {
+        setAppendValuesKernels(&(AppendValuesKernels){ .max = MaxAppendValuesAVX512F,
+                                                       .min = MinAppendValuesAVX512F,
+                                                       .range = MaxMinAppendValuesAVX512F,
+                                                       .sum = SumAppendValuesAVX512F,
+                                                       .avg = AvgAppendValuesAVX512F,
+                                                       .std = StdAppendValuesAVX512F });
+        return;
     } else if (features->avx2) {
-        aggMax.appendValueVec = MaxAppendValuesAVX2;
+        setAppendValuesKernels(&(AppendValuesKernels){ .max = MaxAppendValuesAVX2,
+                                                       .min = MinAppendValuesAVX2,
+                                                       .range = MaxMinAppendValuesAVX2,
+                                                       .sum = SumAppendValuesAVX2,
+                                                       .avg = AvgAppendValuesAVX2,
+                                                       .std = StdAppendValuesAVX2 });
+        return;
+    } else if (features->sse2) {
+        setAppendValuesKernels(&(AppendValuesKernels){ .max = MaxAppendValuesSSE2,
+                                                       .min = MinAppendValuesSSE2,
+                                                       .range = MaxMinAppendValuesSSE2,
+                                                       .sum = SumAppendValuesSSE2,
+                                                       .avg = AvgAppendValuesSSE2,
+                                                       .std = StdAppendValuesSSE2 });
         return;
     }
 #endif // __x86_64__
@@ -863,10 +1378,20 @@ int StringLenAggTypeToEnum(const char *agg_type, size_t len) {
             result = TS_AGG_AVG;
         } else if (strncmp(agg_type_lower, "twa", len) == 0) {
             result = TS_AGG_TWA;
+        } else if (strncmp(agg_type_lower, "p50", len) == 0) {
+            result = TS_AGG_P50;
+        } else if (strncmp(agg_type_lower, "p90", len) == 0) {
+            result = TS_AGG_P90;
+        } else if (strncmp(agg_type_lower, "p95", len) == 0) {
+            result = TS_AGG_P95;
+        } else if (strncmp(agg_type_lower, "p99", len) == 0) {
+            result = TS_AGG_P99;
         }
     } else if (len == 4) {
         if (strncmp(agg_type_lower, "last", len) == 0) {
             result = TS_AGG_LAST;
+        } else if (strncmp(agg_type_lower, "p999", len) == 0) {
+            result = TS_AGG_P999;
         }
     } else if (len == 5) {
         if (strncmp(agg_type_lower, "count", len) == 0) {
@@ -916,6 +1441,16 @@ const char *AggTypeEnumToString(TS_AGG_TYPES_T aggType) {
             return "LAST";
         case TS_AGG_RANGE:
             return "RANGE";
+        case TS_AGG_P50:
+            return "P50";
+        case TS_AGG_P90:
+            return "P90";
+        case TS_AGG_P95:
+            return "P95";
+        case TS_AGG_P99:
+            return "P99";
+        case TS_AGG_P999:
+            return "P999";
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -952,6 +1487,16 @@ const char *AggTypeEnumToStringLowerCase(TS_AGG_TYPES_T aggType) {
             return "last";
         case TS_AGG_RANGE:
             return "range";
+        case TS_AGG_P50:
+            return "p50";
+        case TS_AGG_P90:
+            return "p90";
+        case TS_AGG_P95:
+            return "p95";
+        case TS_AGG_P99:
+            return "p99";
+        case TS_AGG_P999:
+            return "p999";
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -988,6 +1533,16 @@ AggregationClass *GetAggClass(TS_AGG_TYPES_T aggType) {
             return &aggLast;
         case TS_AGG_RANGE:
             return &aggRange;
+        case TS_AGG_P50:
+            return &aggP50;
+        case TS_AGG_P90:
+            return &aggP90;
+        case TS_AGG_P95:
+            return &aggP95;
+        case TS_AGG_P99:
+            return &aggP99;
+        case TS_AGG_P999:
+            return &aggP999;
         case TS_AGG_NONE:
         case TS_AGG_INVALID:
         case TS_AGG_TYPES_MAX:
@@ -18,10 +18,14 @@ typedef struct AggregationClass
     void *(*createContext)(bool reverse);
     void (*freeContext)(void *context);
     void (*appendValue)(void *context, double value, timestamp_t ts);
+    // Appends values[si..ei], which are in time order, at once. NULL when the aggregation needs the
+    // timestamps of the samples.
     void (*appendValueVec)(void *__restrict__ context,
                            double *__restrict__ values,
                            size_t si,
                            size_t ei);
+    // Appends all the samples summarized by `stats` at once, NULL when not supported
+    void (*appendChunkStats)(void *context, const ChunkStats *stats, bool reverse);
     void (*resetContext)(void *context);
     void (*writeContext)(void *context, RedisModuleIO *io);
     int (*readContext)(void *context, RedisModuleIO *io, int encver);
@@ -38,8 +42,24 @@ typedef struct AggregationClass
     void (*finalize)(void *context, double *value);
     void (*finalizeEmpty)(void *contextPtr, double *value); // assigns empty value to value
     void *(*cloneContext)(void *contextPtr);                // return cloned context
+    // Folds an upserted sample into the finalized value of a closed bucket, oldValue is the value
+    // it replaced if any. Returns false when the bucket has to be recomputed from its samples.
+    // NULL when the finalized value isn't enough to update it.
+    bool (*updateFinalized)(double *aggValue, double value, bool replaced, double oldValue);
 } AggregationClass;
 
+// AGGREGATION accepts a list of aggregators which share a single bucketing pass: every sample is
+// appended to all of their contexts, which are kept in one multi aggregation context.
+#define MAX_AGGREGATIONS (TS_AGG_TYPES_MAX - 1)
+
+void *MultiAggCreateContext(AggregationClass *const *classes, size_t count, bool reverse);
+// Sets out to the class of a MultiAggCreateContext context. Its finalize reports the value of the
+// first aggregation. appendValueVec and appendChunkStats are set only when all of classes have
+// them.
+void MultiAggInitClass(AggregationClass *out, AggregationClass *const *classes, size_t count);
+// The values of all the aggregations in the last finalized bucket
+const double *MultiAggValues(const void *context);
+
 AggregationClass *GetAggClass(TS_AGG_TYPES_T aggType);
 int StringAggTypeToEnum(const char *agg_type);
 int RMStringLenAggTypeToEnum(RedisModuleString *aggTypeStr);
@@ -1,5 +1,6 @@
 #include "compaction_common.h"
 #include <immintrin.h>
+#include <math.h> // isfinite
 
 void MaxAppendValuesAVX2(void *__restrict__ context,
                          double *__restrict__ values,
@@ -49,3 +50,137 @@ void MaxAppendValuesAVX2(void *__restrict__ context,
 
     return;
 }
+
+// Unlike max, the kernels below use unaligned loads, the accumulators start from the context so
+// that a NaN lane is skipped by min/max as the scalar versions do
+
+static really_inline double reduceAddAVX2(__m256d vec) {
+    __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(vec), _mm256_extractf128_pd(vec, 1));
+    return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+}
+
+void MinAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_AVX2 * 2) {
+        MinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m256d min_avx = _mm256_set1_pd(res->minValue);
+    for (; si + VECTOR_SIZE_AVX2 <= ei + 1; si += VECTOR_SIZE_AVX2) {
+        // the second operand is returned when one of them is NaN
+        min_avx = _mm256_min_pd(_mm256_loadu_pd(&values[si]), min_avx);
+    }
+
+    double vec[VECTOR_SIZE_AVX2];
+    _mm256_storeu_pd(vec, min_avx);
+    MinAppendValuesVec(context, vec, 0, VECTOR_SIZE_AVX2 - 1);
+    if (si <= ei) {
+        MinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+void MaxMinAppendValuesAVX2(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_AVX2 * 2) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m256d min_avx = _mm256_set1_pd(res->minValue);
+    __m256d max_avx = _mm256_set1_pd(res->maxValue);
+    for (; si + VECTOR_SIZE_AVX2 <= ei + 1; si += VECTOR_SIZE_AVX2) {
+        __m256d values_avx = _mm256_loadu_pd(&values[si]);
+        min_avx = _mm256_min_pd(values_avx, min_avx);
+        max_avx = _mm256_max_pd(values_avx, max_avx);
+    }
+
+    double vec[VECTOR_SIZE_AVX2 * 2];
+    _mm256_storeu_pd(vec, min_avx);
+    _mm256_storeu_pd(&vec[VECTOR_SIZE_AVX2], max_avx);
+    MaxMinAppendValuesVec(context, vec, 0, VECTOR_SIZE_AVX2 * 2 - 1);
+    if (si <= ei) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+// Sums values[si..ei], and their squares when sum_2 isn't NULL
+static really_inline void sumAVX2(const double *__restrict__ values,
+                                  size_t si,
+                                  size_t ei,
+                                  double *sum,
+                                  double *sum_2) {
+    __m256d sum_avx = _mm256_setzero_pd();
+    __m256d sum_2_avx = _mm256_setzero_pd();
+    for (; si + VECTOR_SIZE_AVX2 <= ei + 1; si += VECTOR_SIZE_AVX2) {
+        __m256d values_avx = _mm256_loadu_pd(&values[si]);
+        sum_avx = _mm256_add_pd(sum_avx, values_avx);
+        if (sum_2) {
+            sum_2_avx = _mm256_add_pd(sum_2_avx, _mm256_mul_pd(values_avx, values_avx));
+        }
+    }
+    *sum = reduceAddAVX2(sum_avx);
+    if (sum_2) {
+        *sum_2 = reduceAddAVX2(sum_2_avx);
+    }
+    for (; si <= ei; ++si) {
+        *sum += values[si];
+        if (sum_2) {
+            *sum_2 += values[si] * values[si];
+        }
+    }
+}
+
+void SumAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_AVX2 * 2) {
+        SumAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumAVX2(values, si, ei, &sum, NULL);
+    ((SingleValueContext *)context)->value += sum;
+}
+
+void AvgAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    AvgContext *avgContext = (AvgContext *)context;
+    if ((ei - si + 1) < VECTOR_SIZE_AVX2 * 2 || avgContext->isOverflow) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumAVX2(values, si, ei, &sum, NULL);
+    if (unlikely(!isfinite(avgContext->val + sum))) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    avgContext->val += sum;
+    avgContext->cnt += ei - si + 1;
+}
+
+void StdAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_AVX2 * 2) {
+        StdAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    StdContext *stdContext = (StdContext *)context;
+    double sum, sum_2;
+    sumAVX2(values, si, ei, &sum, &sum_2);
+    stdContext->sum += sum;
+    stdContext->sum_2 += sum_2;
+    stdContext->cnt += ei - si + 1;
+}
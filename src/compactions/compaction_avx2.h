@@ -10,5 +10,25 @@ void MaxAppendValuesAVX2(void *__restrict__ context,
                          double *__restrict__ values,
                          size_t si,
                          size_t ei);
+void MinAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void MaxMinAppendValuesAVX2(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
+void SumAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void AvgAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void StdAppendValuesAVX2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
 
 #endif // COMPACTION_AVX2_H
@@ -1,5 +1,6 @@
 #include "compaction_common.h"
 #include <immintrin.h>
+#include <math.h> // isfinite
 
 void MaxAppendValuesAVX512F(void *__restrict__ context,
                             double *__restrict__ values,
@@ -49,3 +50,131 @@ void MaxAppendValuesAVX512F(void *__restrict__ context,
 
     return;
 }
+
+// See compaction_avx2.c, the same kernels on 8 lanes
+
+void MinAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE * 2) {
+        MinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m512d min_avx512 = _mm512_set1_pd(res->minValue);
+    for (; si + VECTOR_SIZE <= ei + 1; si += VECTOR_SIZE) {
+        // the second operand is returned when one of them is NaN
+        min_avx512 = _mm512_min_pd(_mm512_loadu_pd(&values[si]), min_avx512);
+    }
+
+    double vec[VECTOR_SIZE];
+    _mm512_storeu_pd(vec, min_avx512);
+    MinAppendValuesVec(context, vec, 0, VECTOR_SIZE - 1);
+    if (si <= ei) {
+        MinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+void MaxMinAppendValuesAVX512F(void *__restrict__ context,
+                               double *__restrict__ values,
+                               size_t si,
+                               size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE * 2) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m512d min_avx512 = _mm512_set1_pd(res->minValue);
+    __m512d max_avx512 = _mm512_set1_pd(res->maxValue);
+    for (; si + VECTOR_SIZE <= ei + 1; si += VECTOR_SIZE) {
+        __m512d values_avx512 = _mm512_loadu_pd(&values[si]);
+        min_avx512 = _mm512_min_pd(values_avx512, min_avx512);
+        max_avx512 = _mm512_max_pd(values_avx512, max_avx512);
+    }
+
+    double vec[VECTOR_SIZE * 2];
+    _mm512_storeu_pd(vec, min_avx512);
+    _mm512_storeu_pd(&vec[VECTOR_SIZE], max_avx512);
+    MaxMinAppendValuesVec(context, vec, 0, VECTOR_SIZE * 2 - 1);
+    if (si <= ei) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+// Sums values[si..ei], and their squares when sum_2 isn't NULL
+static really_inline void sumAVX512F(const double *__restrict__ values,
+                                     size_t si,
+                                     size_t ei,
+                                     double *sum,
+                                     double *sum_2) {
+    __m512d sum_avx512 = _mm512_setzero_pd();
+    __m512d sum_2_avx512 = _mm512_setzero_pd();
+    for (; si + VECTOR_SIZE <= ei + 1; si += VECTOR_SIZE) {
+        __m512d values_avx512 = _mm512_loadu_pd(&values[si]);
+        sum_avx512 = _mm512_add_pd(sum_avx512, values_avx512);
+        if (sum_2) {
+            sum_2_avx512 = _mm512_add_pd(sum_2_avx512, _mm512_mul_pd(values_avx512, values_avx512));
+        }
+    }
+    *sum = _mm512_reduce_add_pd(sum_avx512);
+    if (sum_2) {
+        *sum_2 = _mm512_reduce_add_pd(sum_2_avx512);
+    }
+    for (; si <= ei; ++si) {
+        *sum += values[si];
+        if (sum_2) {
+            *sum_2 += values[si] * values[si];
+        }
+    }
+}
+
+void SumAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE * 2) {
+        SumAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumAVX512F(values, si, ei, &sum, NULL);
+    ((SingleValueContext *)context)->value += sum;
+}
+
+void AvgAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    AvgContext *avgContext = (AvgContext *)context;
+    if ((ei - si + 1) < VECTOR_SIZE * 2 || avgContext->isOverflow) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumAVX512F(values, si, ei, &sum, NULL);
+    if (unlikely(!isfinite(avgContext->val + sum))) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    avgContext->val += sum;
+    avgContext->cnt += ei - si + 1;
+}
+
+void StdAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE * 2) {
+        StdAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    StdContext *stdContext = (StdContext *)context;
+    double sum, sum_2;
+    sumAVX512F(values, si, ei, &sum, &sum_2);
+    stdContext->sum += sum;
+    stdContext->sum_2 += sum_2;
+    stdContext->cnt += ei - si + 1;
+}
@@ -10,5 +10,25 @@ void MaxAppendValuesAVX512F(void *__restrict__ context,
                             double *__restrict__ values,
                             size_t si,
                             size_t ei);
+void MinAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
+void MaxMinAppendValuesAVX512F(void *__restrict__ context,
+                               double *__restrict__ values,
+                               size_t si,
+                               size_t ei);
+void SumAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
+void AvgAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
+void StdAppendValuesAVX512F(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
 
 #endif // COMPACTION_AVX512F_H
@@ -10,13 +10,16 @@
 #include <stdio.h>
 #include <float.h>
 #include <stdint.h>
+#include <sys/types.h>
 #include "../consts.h"
 #include "compaction_avx512f.h"
 
 #define CACHE_LINE_SIZE 64
 #define ALIGN_SIZE_AVX2 32
+#define ALIGN_SIZE_SSE2 16
 #define VECTOR_SIZE (CACHE_LINE_SIZE/sizeof(double))
 #define VECTOR_SIZE_AVX2 (ALIGN_SIZE_AVX2/sizeof(double))
+#define VECTOR_SIZE_SSE2 (ALIGN_SIZE_SSE2/sizeof(double))
 
 #define _DOUBLE_MIN (((double)-1.0) * DBL_MAX)
 
@@ -26,6 +29,25 @@ typedef struct MaxMinContext
     double maxValue;
 } MaxMinContext;
 
+typedef struct SingleValueContext
+{
+    double value;
+} SingleValueContext;
+
+typedef struct AvgContext
+{
+    double val;
+    double cnt;
+    bool isOverflow;
+} AvgContext;
+
+typedef struct StdContext
+{
+    double sum;
+    double sum_2; // sum of (values^2)
+    u_int64_t cnt;
+} StdContext;
+
 static really_inline void _AssignIfGreater(double *__restrict__ value, double *__restrict__ newValues)
 {
     if(*newValues > *value) {
@@ -33,10 +55,36 @@ static really_inline void _AssignIfGreater(double *__restrict__ value, double *_
     }
 }
 
+// The scalar versions, the vectorized ones fall back to them for short ranges
 void MaxAppendValuesVec(void *__restrict__ context,
                         double *__restrict__ values,
                         size_t si,
                         size_t ei);
+void MinAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei);
+void MaxMinAppendValuesVec(void *__restrict__ context,
+                           double *__restrict__ values,
+                           size_t si,
+                           size_t ei);
+void SumAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei);
+void CountAppendValuesVec(void *__restrict__ context,
+                          double *__restrict__ values,
+                          size_t si,
+                          size_t ei);
+// The vectorized versions fall back to it once the sum overflows
+void AvgAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei);
+void StdAppendValuesVec(void *__restrict__ context,
+                        double *__restrict__ values,
+                        size_t si,
+                        size_t ei);
 
 static really_inline bool is_aligned(void *p, int N)
 {
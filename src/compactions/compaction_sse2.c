@@ -0,0 +1,159 @@
+#include "compaction_common.h"
+#include <emmintrin.h>
+#include <math.h> // isfinite
+
+// SSE2 is part of x86_64, these are the kernels used when there is no AVX2. The accumulators start
+// from the context so that a NaN lane is skipped by min/max as the scalar versions do.
+
+void MaxAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2) {
+        MaxAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m128d max_sse = _mm_set1_pd(res->maxValue);
+    for (; si + VECTOR_SIZE_SSE2 <= ei + 1; si += VECTOR_SIZE_SSE2) {
+        // the second operand is returned when one of them is NaN
+        max_sse = _mm_max_pd(_mm_loadu_pd(&values[si]), max_sse);
+    }
+
+    double vec[VECTOR_SIZE_SSE2];
+    _mm_storeu_pd(vec, max_sse);
+    MaxAppendValuesVec(context, vec, 0, VECTOR_SIZE_SSE2 - 1);
+    if (si <= ei) {
+        MaxAppendValuesVec(context, values, si, ei);
+    }
+}
+
+static really_inline double reduceAddSSE2(__m128d vec) {
+    return _mm_cvtsd_f64(_mm_add_sd(vec, _mm_unpackhi_pd(vec, vec)));
+}
+
+void MinAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2) {
+        MinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m128d min_sse = _mm_set1_pd(res->minValue);
+    for (; si + VECTOR_SIZE_SSE2 <= ei + 1; si += VECTOR_SIZE_SSE2) {
+        min_sse = _mm_min_pd(_mm_loadu_pd(&values[si]), min_sse);
+    }
+
+    double vec[VECTOR_SIZE_SSE2];
+    _mm_storeu_pd(vec, min_sse);
+    MinAppendValuesVec(context, vec, 0, VECTOR_SIZE_SSE2 - 1);
+    if (si <= ei) {
+        MinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+void MaxMinAppendValuesSSE2(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+        return;
+    }
+
+    MaxMinContext *res = (MaxMinContext *)context;
+    __m128d min_sse = _mm_set1_pd(res->minValue);
+    __m128d max_sse = _mm_set1_pd(res->maxValue);
+    for (; si + VECTOR_SIZE_SSE2 <= ei + 1; si += VECTOR_SIZE_SSE2) {
+        __m128d values_sse = _mm_loadu_pd(&values[si]);
+        min_sse = _mm_min_pd(values_sse, min_sse);
+        max_sse = _mm_max_pd(values_sse, max_sse);
+    }
+
+    double vec[VECTOR_SIZE_SSE2 * 2];
+    _mm_storeu_pd(vec, min_sse);
+    _mm_storeu_pd(&vec[VECTOR_SIZE_SSE2], max_sse);
+    MaxMinAppendValuesVec(context, vec, 0, VECTOR_SIZE_SSE2 * 2 - 1);
+    if (si <= ei) {
+        MaxMinAppendValuesVec(context, values, si, ei);
+    }
+}
+
+// Sums values[si..ei], and their squares when sum_2 isn't NULL
+static really_inline void sumSSE2(const double *__restrict__ values,
+                                  size_t si,
+                                  size_t ei,
+                                  double *sum,
+                                  double *sum_2) {
+    __m128d sum_sse = _mm_setzero_pd();
+    __m128d sum_2_sse = _mm_setzero_pd();
+    for (; si + VECTOR_SIZE_SSE2 <= ei + 1; si += VECTOR_SIZE_SSE2) {
+        __m128d values_sse = _mm_loadu_pd(&values[si]);
+        sum_sse = _mm_add_pd(sum_sse, values_sse);
+        if (sum_2) {
+            sum_2_sse = _mm_add_pd(sum_2_sse, _mm_mul_pd(values_sse, values_sse));
+        }
+    }
+    *sum = reduceAddSSE2(sum_sse);
+    if (sum_2) {
+        *sum_2 = reduceAddSSE2(sum_2_sse);
+    }
+    for (; si <= ei; ++si) {
+        *sum += values[si];
+        if (sum_2) {
+            *sum_2 += values[si] * values[si];
+        }
+    }
+}
+
+void SumAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2) {
+        SumAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumSSE2(values, si, ei, &sum, NULL);
+    ((SingleValueContext *)context)->value += sum;
+}
+
+void AvgAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    AvgContext *avgContext = (AvgContext *)context;
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2 || avgContext->isOverflow) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    double sum;
+    sumSSE2(values, si, ei, &sum, NULL);
+    if (unlikely(!isfinite(avgContext->val + sum))) {
+        AvgAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    avgContext->val += sum;
+    avgContext->cnt += ei - si + 1;
+}
+
+void StdAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei) {
+    if ((ei - si + 1) < VECTOR_SIZE_SSE2 * 2) {
+        StdAppendValuesVec(context, values, si, ei);
+        return;
+    }
+    StdContext *stdContext = (StdContext *)context;
+    double sum, sum_2;
+    sumSSE2(values, si, ei, &sum, &sum_2);
+    stdContext->sum += sum;
+    stdContext->sum_2 += sum_2;
+    stdContext->cnt += ei - si + 1;
+}
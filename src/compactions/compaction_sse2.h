@@ -6,5 +6,29 @@
 #ifndef COMPACTION_SSE2_H
 #define COMPACTION_SSE2_H
 
+void MaxAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void MinAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void MaxMinAppendValuesSSE2(void *__restrict__ context,
+                            double *__restrict__ values,
+                            size_t si,
+                            size_t ei);
+void SumAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void AvgAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
+void StdAppendValuesSSE2(void *__restrict__ context,
+                         double *__restrict__ values,
+                         size_t si,
+                         size_t ei);
 
-#endif //COMPACTION_SSE2_H
+#endif // COMPACTION_SSE2_H
@@ -8,6 +8,7 @@
 
 #include "LibMR/src/mr.h"
 #include "chunk.h"
+#include "chunk_pool.h"
 #include "generic_chunk.h"
 
 #include <assert.h> // assert
@@ -19,46 +20,61 @@
 
 #define BIT 8
 #define CHUNK_RESIZE_STEP 32
+// number of samples decoded at a time by ProcessChunk
+#define DECOMPRESS_BLOCK_SIZE 64
 
 /*********************
  *  Chunk functions  *
  *********************/
 Chunk_t *Compressed_NewChunk(size_t size) {
     _log_if(size % 8 != 0, "chunk size isn't multiplication of 8");
-    CompressedChunk *chunk = (CompressedChunk *)calloc(1, sizeof(CompressedChunk));
+    CompressedChunk *chunk = (CompressedChunk *)ChunkPool_Calloc(sizeof(CompressedChunk));
     chunk->size = size;
-    chunk->data = (u_int64_t *)calloc(chunk->size, sizeof(char));
+    chunk->data = (u_int64_t *)ChunkPool_Calloc(chunk->size * sizeof(char));
 #ifdef DEBUG
     memset(chunk->data, 0, chunk->size);
 #endif
     chunk->prevLeading = 32;
     chunk->prevTrailing = 32;
     chunk->prevTimestamp = 0;
+    ChunkStats_Reset(&chunk->stats);
+    return chunk;
+}
+
+Chunk_t *Decimal_NewChunk(size_t size) {
+    CompressedChunk *chunk = Compressed_NewChunk(size);
+    chunk->codec = VALUE_CODEC_DECIMAL;
     return chunk;
 }
 
 void Compressed_FreeChunk(Chunk_t *chunk) {
     CompressedChunk *cmpChunk = chunk;
     if (cmpChunk->data) {
-        free(cmpChunk->data);
+        ChunkPool_Free(cmpChunk->data, cmpChunk->size);
     }
     cmpChunk->data = NULL;
-    free(chunk);
+    free(cmpChunk->checkpoints);
+    ChunkPool_Free(chunk, sizeof(CompressedChunk));
 }
 
 Chunk_t *Compressed_CloneChunk(const Chunk_t *chunk) {
     const CompressedChunk *oldChunk = chunk;
-    CompressedChunk *newChunk = malloc(sizeof(CompressedChunk));
+    CompressedChunk *newChunk = ChunkPool_Alloc(sizeof(CompressedChunk));
     memcpy(newChunk, oldChunk, sizeof(CompressedChunk));
-    newChunk->data = malloc(newChunk->size);
+    newChunk->data = ChunkPool_Alloc(newChunk->size);
     memcpy(newChunk->data, oldChunk->data, oldChunk->size);
+    newChunk->checkpoints = NULL;
+    if (oldChunk->checkpointsCount) {
+        size_t checkpointsSize = oldChunk->checkpointsCount * sizeof(CompressedCheckpoint);
+        newChunk->checkpoints = malloc(checkpointsSize);
+        memcpy(newChunk->checkpoints, oldChunk->checkpoints, checkpointsSize);
+    }
     return newChunk;
 }
 
-static void swapChunks(CompressedChunk *a, CompressedChunk *b) {
-    CompressedChunk tmp = *a;
-    *a = *b;
-    *b = tmp;
+// Bytes of the buffer holding encoded data
+static inline size_t usedSize(const CompressedChunk *chunk) {
+    return (chunk->idx + BIT - 1) / BIT;
 }
 
 static void ensureAddSample(CompressedChunk *chunk, Sample *sample) {
@@ -66,7 +82,8 @@ static void ensureAddSample(CompressedChunk *chunk, Sample *sample) {
     if (res != CR_OK) {
         int oldsize = chunk->size;
         chunk->size += CHUNK_RESIZE_STEP;
-        chunk->data = (u_int64_t *)realloc(chunk->data, chunk->size * sizeof(char));
+        chunk->data =
+            (u_int64_t *)ChunkPool_Realloc(chunk->data, oldsize, chunk->size * sizeof(char));
         memset((char *)chunk->data + oldsize, 0, CHUNK_RESIZE_STEP);
         // printf("Chunk extended to %lu \n", chunk->size);
         res = Compressed_AddSample(chunk, sample);
@@ -74,7 +91,7 @@ static void ensureAddSample(CompressedChunk *chunk, Sample *sample) {
     }
 }
 
-static void trimChunk(CompressedChunk *chunk) {
+void Compressed_TrimChunk(CompressedChunk *chunk) {
     int excess = (chunk->size * BIT - chunk->idx) / BIT;
 
     if (unlikely(chunk->size * BIT < chunk->idx)) {
@@ -91,7 +108,7 @@ static void trimChunk(CompressedChunk *chunk) {
         // align to 8 bytes (u_int64_t) otherwise we will have an heap overflow in gorilla.c because
         // each write happens in 8 bytes blocks.
         newSize += sizeof(binary_t) - (newSize % sizeof(binary_t));
-        chunk->data = realloc(chunk->data, newSize);
+        chunk->data = ChunkPool_Realloc(chunk->data, chunk->size, newSize);
         chunk->size = newSize;
     }
 }
@@ -101,80 +118,134 @@ Chunk_t *Compressed_SplitChunk(Chunk_t *chunk) {
     size_t split = curChunk->count / 2;
     size_t curNumSamples = curChunk->count - split;
 
-    // add samples in new chunks
-    size_t i = 0;
+    // find the first sample of the second half, starting from the closest checkpoint
+    Compressed_Iterator iter = { .chunk = curChunk };
+    int64_t checkpoint = (int64_t)curChunk->checkpointsCount - 1;
+    while (checkpoint >= 0 && curChunk->checkpoints[checkpoint].count > curNumSamples) {
+        checkpoint--;
+    }
+    Compressed_ChunkIteratorSeek(&iter, checkpoint);
     Sample sample;
-    ChunkIter_t *iter = Compressed_NewChunkIterator(curChunk);
-    CompressedChunk *newChunk1 = Compressed_NewChunk(curChunk->size);
-    CompressedChunk *newChunk2 = Compressed_NewChunk(curChunk->size);
-    for (; i < curNumSamples; ++i) {
-        Compressed_ChunkIteratorGetNext(iter, &sample);
-        ensureAddSample(newChunk1, &sample);
+    while (iter.count < curNumSamples) {
+        Compressed_ChunkIteratorGetNext(&iter, &sample);
     }
-    for (; i < curChunk->count; ++i) {
-        Compressed_ChunkIteratorGetNext(iter, &sample);
-        ensureAddSample(newChunk2, &sample);
+    Compressed_Iterator pos = iter;
+
+    // the second half is re-encoded, the encoding of its first samples depends on the state of
+    // the first half so it can't be copied
+    size_t newSize = ((curChunk->idx - pos.idx) / 64 + 2) * sizeof(u_int64_t);
+    CompressedChunk *newChunk = Compressed_NewChunk(newSize);
+    newChunk->codec = curChunk->codec;
+    timestamp_t timestamps[DECOMPRESS_BLOCK_SIZE];
+    double values[DECOMPRESS_BLOCK_SIZE];
+    u_int64_t n;
+    while ((n = Compressed_ChunkIteratorGetNextBlock(
+                &iter, timestamps, values, DECOMPRESS_BLOCK_SIZE)) > 0) {
+        for (u_int64_t i = 0; i < n; ++i) {
+            sample.timestamp = timestamps[i];
+            sample.value = values[i];
+            ensureAddSample(newChunk, &sample);
+        }
     }
 
-    trimChunk(newChunk1);
-    trimChunk(newChunk2);
-    swapChunks(curChunk, newChunk1);
+    // the first half keeps its bitstream, truncated at the split point
+    Compressed_Truncate(curChunk, &pos);
+    Compressed_TrimChunk(curChunk);
+    Compressed_TrimChunk(newChunk);
+
+    return newChunk;
+}
 
-    Compressed_FreeChunkIterator(iter);
-    Compressed_FreeChunk(newChunk1);
+Chunk_t *Compressed_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize) {
+    const CompressedChunk *first = chunk, *second = next;
+    if (first->codec != second->codec || usedSize(first) + usedSize(second) > maxSize) {
+        return NULL;
+    }
 
-    return newChunk2;
+    // the first chunk keeps its bitstream, the samples of the second are re-encoded after it
+    CompressedChunk *merged = Compressed_CloneChunk(first);
+    Compressed_Iterator iter;
+    Compressed_ResetChunkIterator(&iter, second);
+    timestamp_t timestamps[DECOMPRESS_BLOCK_SIZE];
+    double values[DECOMPRESS_BLOCK_SIZE];
+    u_int64_t n;
+    while ((n = Compressed_ChunkIteratorGetNextBlock(
+                &iter, timestamps, values, DECOMPRESS_BLOCK_SIZE)) > 0) {
+        for (u_int64_t i = 0; i < n; ++i) {
+            Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+            ensureAddSample(merged, &sample);
+        }
+    }
+    Compressed_TrimChunk(merged);
+    return merged;
 }
 
-ChunkResult Compressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy) {
-    *size = 0;
-    ChunkResult rv = CR_OK;
-    ChunkResult nextRes = CR_OK;
-    CompressedChunk *oldChunk = (CompressedChunk *)uCtx->inChunk;
+/*
+ * Truncate the chunk at `pos` and re-encode the samples which followed it: `insert` when not NULL,
+ * then `next` when `res` is CR_OK, then the remaining samples of `iter`.
+ * `pos` and `iter` must be iterators over `chunk`, `pos` not ahead of `iter`.
+ */
+static void rewriteSuffix(CompressedChunk *chunk,
+                          const Compressed_Iterator *pos,
+                          Compressed_Iterator *iter,
+                          ChunkResult res,
+                          Sample *next,
+                          Sample *insert) {
+    u_int64_t n = (res == CR_OK) ? 1 + chunk->count - iter->count : 0;
+    timestamp_t *timestamps = NULL;
+    double *values = NULL;
+    if (n > 0) {
+        timestamps = malloc(n * sizeof(timestamp_t));
+        values = malloc(n * sizeof(double));
+        timestamps[0] = next->timestamp;
+        values[0] = next->value;
+        Compressed_ChunkIteratorGetNextBlock(iter, timestamps + 1, values + 1, n - 1);
+    }
+
+    Compressed_Truncate(chunk, pos);
+    if (insert) {
+        ensureAddSample(chunk, insert);
+    }
+    for (u_int64_t i = 0; i < n; ++i) {
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        ensureAddSample(chunk, &sample);
+    }
 
-    size_t newSize = oldChunk->size;
+    free(timestamps);
+    free(values);
+}
 
-    CompressedChunk *newChunk = Compressed_NewChunk(newSize);
-    Compressed_Iterator *iter = Compressed_NewChunkIterator(oldChunk);
+ChunkResult Compressed_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy) {
+    *size = 0;
+    CompressedChunk *chunk = (CompressedChunk *)uCtx->inChunk;
     timestamp_t ts = uCtx->sample.timestamp;
-    int numSamples = oldChunk->count;
 
-    size_t i = 0;
+    // find the insertion point, starting from the last checkpoint preceding it
+    Compressed_Iterator iter = { .chunk = chunk };
+    Compressed_ChunkIteratorSeek(&iter, Compressed_FindCheckpoint(chunk, ts));
+    Compressed_Iterator pos = iter;
     Sample iterSample;
-    for (; i < numSamples; ++i) {
-        nextRes = Compressed_ChunkIteratorGetNext(iter, &iterSample);
-        if (iterSample.timestamp >= ts) {
-            break;
-        }
-        ensureAddSample(newChunk, &iterSample);
+    ChunkResult res;
+    while ((res = Compressed_ChunkIteratorGetNext(&iter, &iterSample)) == CR_OK &&
+           iterSample.timestamp < ts) {
+        pos = iter;
     }
 
-    if (ts == iterSample.timestamp) {
+    if (res == CR_OK && iterSample.timestamp == ts) {
         ChunkResult cr = handleDuplicateSample(duplicatePolicy, iterSample, &uCtx->sample);
         if (cr != CR_OK) {
-            Compressed_FreeChunkIterator(iter);
-            Compressed_FreeChunk(newChunk);
             return CR_ERR;
         }
-        nextRes = Compressed_ChunkIteratorGetNext(iter, &iterSample);
+        uCtx->replaced = true;
+        uCtx->oldValue = iterSample.value;
+        res = Compressed_ChunkIteratorGetNext(&iter, &iterSample);
         *size = -1; // we skipped a sample
     }
-    // upsert the sample
-    ensureAddSample(newChunk, &uCtx->sample);
-    *size += 1;
-
-    if (i < numSamples) {
-        while (nextRes == CR_OK) {
-            ensureAddSample(newChunk, &iterSample);
-            nextRes = Compressed_ChunkIteratorGetNext(iter, &iterSample);
-        }
-    }
-
-    swapChunks(newChunk, oldChunk);
 
-    Compressed_FreeChunkIterator(iter);
-    Compressed_FreeChunk(newChunk);
-    return rv;
+    // the bitstream up to the insertion point is kept, only the suffix is re-encoded
+    rewriteSuffix(chunk, &pos, &iter, res, &iterSample, &uCtx->sample);
+    *size += 1;
+    return CR_OK;
 }
 
 ChunkResult Compressed_AddSample(Chunk_t *chunk, Sample *sample) {
@@ -207,38 +278,51 @@ double Compressed_GetLastValue(Chunk_t *chunk) {
     return ((CompressedChunk *)chunk)->prevValue.d;
 }
 
+const ChunkStats *Compressed_GetStats(const Chunk_t *chunk) {
+    const CompressedChunk *cmpChunk = chunk;
+    return cmpChunk->stats.valid ? &cmpChunk->stats : NULL;
+}
+
 size_t Compressed_GetChunkSize(Chunk_t *chunk, bool includeStruct) {
     CompressedChunk *cmpChunk = chunk;
     size_t size = cmpChunk->size * sizeof(char);
-    size += includeStruct ? sizeof(*cmpChunk) : 0;
+    size += includeStruct
+                ? sizeof(*cmpChunk) + cmpChunk->checkpointsCount * sizeof(CompressedCheckpoint)
+                : 0;
     return size;
 }
 
 size_t Compressed_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs) {
-    CompressedChunk *oldChunk = (CompressedChunk *)chunk;
-    size_t newSize = oldChunk->size; // mem size
-    CompressedChunk *newChunk = Compressed_NewChunk(newSize);
-    Compressed_Iterator *iter = Compressed_NewChunkIterator(oldChunk);
-    size_t i = 0;
-    size_t deleted_count = 0;
+    CompressedChunk *cmpChunk = (CompressedChunk *)chunk;
+    if (cmpChunk->count == 0 || startTs > cmpChunk->prevTimestamp ||
+        endTs < cmpChunk->baseTimestamp) {
+        return 0;
+    }
+
+    // find the first sample to delete, starting from the last checkpoint preceding it
+    Compressed_Iterator iter = { .chunk = cmpChunk };
+    Compressed_ChunkIteratorSeek(&iter, Compressed_FindCheckpoint(cmpChunk, startTs));
+    Compressed_Iterator pos = iter;
     Sample iterSample;
-    int numSamples = oldChunk->count; // sample size
-    for (; i < numSamples; ++i) {
-        Compressed_ChunkIteratorGetNext(iter, &iterSample);
-        if (iterSample.timestamp >= startTs && iterSample.timestamp <= endTs) {
-            // in delete range, skip adding to the new chunk
-            deleted_count++;
-            continue;
-        }
-        ensureAddSample(newChunk, &iterSample);
+    ChunkResult res;
+    while ((res = Compressed_ChunkIteratorGetNext(&iter, &iterSample)) == CR_OK &&
+           iterSample.timestamp < startTs) {
+        pos = iter;
+    }
+
+    size_t deleted_count = 0;
+    while (res == CR_OK && iterSample.timestamp <= endTs) {
+        // in delete range, skip re-encoding
+        deleted_count++;
+        res = Compressed_ChunkIteratorGetNext(&iter, &iterSample);
+    }
+
+    if (deleted_count > 0) {
+        rewriteSuffix(cmpChunk, &pos, &iter, res, &iterSample, NULL);
     }
-    swapChunks(newChunk, oldChunk);
-    Compressed_FreeChunkIterator(iter);
-    Compressed_FreeChunk(newChunk);
     return deleted_count;
 }
 
-// TODO: convert to template and unify with decompressChunk when moving to RUST
 // decompress chunk reverse
 static inline void decompressChunkReverse(const CompressedChunk *compressedChunk,
                                           uint64_t start,
@@ -246,70 +330,36 @@ static inline void decompressChunkReverse(const CompressedChunk *compressedChunk
                                           EnrichedChunk *enrichedChunk) {
     uint64_t numSamples = compressedChunk->count;
     uint64_t lastTS = compressedChunk->prevTimestamp;
-    Sample sample;
     ResetEnrichedChunk(enrichedChunk);
     if (unlikely(numSamples == 0 || end < start || compressedChunk->baseTimestamp > end ||
                  lastTS < start)) {
         return;
     }
 
-    Compressed_Iterator *iter = Compressed_NewChunkIterator(compressedChunk);
+    Compressed_Iterator iter;
+    Compressed_ResetChunkIterator(&iter, compressedChunk);
+    Compressed_ChunkIteratorSeek(&iter, Compressed_FindCheckpoint(compressedChunk, start));
     timestamp_t *timestamps_ptr = enrichedChunk->samples.timestamps + numSamples - 1;
     double *values_ptr = enrichedChunk->samples.values + numSamples - 1;
-
-    // find the first sample which is greater than start
-    Compressed_ChunkIteratorGetNext(iter, &sample);
-    while (sample.timestamp < start && iter->count < numSamples) {
-        Compressed_ChunkIteratorGetNext(iter, &sample);
-    }
-
-    if (unlikely(sample.timestamp > end)) {
-        // occurs when the are TS smaller than start and larger than end but nothing in the range.
-        Compressed_FreeChunkIterator(iter);
-        return;
-    }
-    *timestamps_ptr-- = sample.timestamp;
-    *values_ptr-- = sample.value;
-
-    if (lastTS > end) { // the range not include the whole chunk
-        // 4 samples per iteration
-        const size_t n = numSamples >= 4 ? numSamples - 4 : 0;
-        while (iter->count < n) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
-            if (unlikely(*(timestamps_ptr + 1) > end)) {
-                while (*(timestamps_ptr + 1) > end) {
-                    ++timestamps_ptr;
-                    ++values_ptr;
-                }
-                goto _done;
-            }
+    timestamp_t timestamps[DECOMPRESS_BLOCK_SIZE];
+    double values[DECOMPRESS_BLOCK_SIZE];
+
+    // decode a block at a time and write the samples within the range from the end of the buffer
+    while (iter.count < numSamples) {
+        uint64_t n =
+            Compressed_ChunkIteratorGetNextBlock(&iter, timestamps, values, DECOMPRESS_BLOCK_SIZE);
+        if (timestamps[n - 1] < start) {
+            continue;
         }
-
-        // left-overs
-        while (iter->count < numSamples) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            if (sample.timestamp > end) {
+        for (uint64_t i = 0; i < n; ++i) {
+            if (timestamps[i] < start) {
+                continue;
+            }
+            if (timestamps[i] > end) {
                 goto _done;
             }
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
-        }
-    } else {
-        while (iter->count < numSamples) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr-- = sample.timestamp;
-            *values_ptr-- = sample.value;
+            *timestamps_ptr-- = timestamps[i];
+            *values_ptr-- = values[i];
         }
     }
 
@@ -319,10 +369,6 @@ _done:
     enrichedChunk->samples.num_samples =
         enrichedChunk->samples.og_timestamps + numSamples - enrichedChunk->samples.timestamps;
     enrichedChunk->rev = true;
-
-    Compressed_FreeChunkIterator(iter);
-
-    return;
 }
 
 // decompress chunk
@@ -332,80 +378,49 @@ static inline void decompressChunk(const CompressedChunk *compressedChunk,
                                    EnrichedChunk *enrichedChunk) {
     uint64_t numSamples = compressedChunk->count;
     uint64_t lastTS = compressedChunk->prevTimestamp;
-    Sample sample;
-    ChunkResult res;
     ResetEnrichedChunk(enrichedChunk);
     if (unlikely(numSamples == 0 || end < start || compressedChunk->baseTimestamp > end ||
                  lastTS < start)) {
         return;
     }
 
-    Compressed_Iterator *iter = Compressed_NewChunkIterator(compressedChunk);
-    timestamp_t *timestamps_ptr = enrichedChunk->samples.timestamps;
-    double *values_ptr = enrichedChunk->samples.values;
+    Compressed_Iterator iter;
+    Compressed_ResetChunkIterator(&iter, compressedChunk);
+    Compressed_ChunkIteratorSeek(&iter, Compressed_FindCheckpoint(compressedChunk, start));
+    timestamp_t *timestamps = enrichedChunk->samples.timestamps;
+    double *values = enrichedChunk->samples.values;
+    uint64_t n;
+
+    // skip the blocks which end before start, lastTS >= start so we'll always find one
+    do {
+        n = Compressed_ChunkIteratorGetNextBlock(&iter, timestamps, values, DECOMPRESS_BLOCK_SIZE);
+    } while (timestamps[n - 1] < start);
 
     // find the first sample which is greater than start
-    res = Compressed_ChunkIteratorGetNext(iter, &sample);
-    while (sample.timestamp < start && res == CR_OK) {
-        res = Compressed_ChunkIteratorGetNext(iter, &sample);
+    uint64_t first = 0;
+    while (timestamps[first] < start) {
+        ++first;
     }
-
-    if (unlikely(sample.timestamp > end)) {
-        // occurs when the are TS smaller than start and larger than end but nothing in the range.
-        Compressed_FreeChunkIterator(iter);
-        return;
+    if (first > 0) {
+        n -= first;
+        memmove(timestamps, timestamps + first, n * sizeof(*timestamps));
+        memmove(values, values + first, n * sizeof(*values));
     }
-    *timestamps_ptr++ = sample.timestamp;
-    *values_ptr++ = sample.value;
 
     if (lastTS > end) { // the range not include the whole chunk
-        // 4 samples per iteration
-        const size_t n = numSamples >= 4 ? numSamples - 4 : 0;
-        while (iter->count < n) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
-            if (unlikely(*(timestamps_ptr - 1) > end)) {
-                while (*(timestamps_ptr - 1) > end) {
-                    --timestamps_ptr;
-                    --values_ptr;
-                }
-                goto _done;
-            }
+        while (timestamps[n - 1] <= end && iter.count < numSamples) {
+            n += Compressed_ChunkIteratorGetNextBlock(
+                &iter, timestamps + n, values + n, DECOMPRESS_BLOCK_SIZE);
         }
-
-        // left-overs
-        while (iter->count < numSamples) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            if (sample.timestamp > end) {
-                goto _done;
-            }
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
+        while (n > 0 && timestamps[n - 1] > end) {
+            --n;
         }
     } else {
-        while (iter->count < numSamples) {
-            Compressed_ChunkIteratorGetNext(iter, &sample);
-            *timestamps_ptr++ = sample.timestamp;
-            *values_ptr++ = sample.value;
-        }
+        n += Compressed_ChunkIteratorGetNextBlock(
+            &iter, timestamps + n, values + n, numSamples - iter.count);
     }
 
-_done:
-    enrichedChunk->samples.num_samples = timestamps_ptr - enrichedChunk->samples.timestamps;
-
-    Compressed_FreeChunkIterator(iter);
-
-    return;
+    enrichedChunk->samples.num_samples = n;
 }
 
 /************************
@@ -421,16 +436,7 @@ void Compressed_ResetChunkIterator(ChunkIter_t *iterator, const Chunk_t *chunk)
     const CompressedChunk *compressedChunk = chunk;
     Compressed_Iterator *iter = (Compressed_Iterator *)iterator;
     iter->chunk = (CompressedChunk *)compressedChunk;
-    iter->idx = 0;
-    iter->count = 0;
-
-    iter->prevDelta = 0;
-    iter->prevTS = compressedChunk->baseTimestamp;
-    iter->prevValue.d = compressedChunk->baseValue.d;
-    iter->leading = 32;
-    iter->trailing = 32;
-    iter->blocksize = 0;
-    iterator = (ChunkIter_t *)iter;
+    Compressed_ChunkIteratorSeek(iter, -1);
 }
 
 ChunkIter_t *Compressed_NewChunkIterator(const Chunk_t *chunk) {
@@ -484,14 +490,27 @@ static void Compressed_Serialize(Chunk_t *chunk,
     saveUnsigned(ctx, compchunk->prevValue.u);
     saveUnsigned(ctx, compchunk->prevLeading);
     saveUnsigned(ctx, compchunk->prevTrailing);
+    if (compchunk->codec == VALUE_CODEC_DECIMAL) {
+        saveUnsigned(ctx, compchunk->scale);
+        saveUnsigned(ctx, compchunk->decimalCount);
+        saveUnsigned(ctx, compchunk->prevDecimal);
+        saveUnsigned(ctx, compchunk->prevDecimalDelta);
+    }
     saveStringBuffer(ctx, (char *)compchunk->data, compchunk->size);
 }
 
-#define COMPRESSED_DESERIALIZE(chunk, ctx, readUnsigned, readStringBuffer, ...)                    \
+#define COMPRESSED_DESERIALIZE(chunk, ctx, valueCodec, readUnsigned, readStringBuffer, ...)        \
     do {                                                                                           \
-        CompressedChunk *compchunk = (CompressedChunk *)malloc(sizeof(*compchunk));                \
+        CompressedChunk *compchunk = (CompressedChunk *)ChunkPool_Alloc(sizeof(*compchunk));       \
                                                                                                    \
         compchunk->data = NULL;                                                                    \
+        compchunk->checkpoints = NULL;                                                             \
+        compchunk->checkpointsCount = 0;                                                           \
+        compchunk->codec = (valueCodec);                                                           \
+        compchunk->scale = 0;                                                                      \
+        compchunk->decimalCount = 0;                                                               \
+        compchunk->prevDecimal = 0;                                                                \
+        compchunk->prevDecimalDelta = 0;                                                           \
         compchunk->size = readUnsigned(ctx, ##__VA_ARGS__);                                        \
         compchunk->count = readUnsigned(ctx, ##__VA_ARGS__);                                       \
         compchunk->idx = readUnsigned(ctx, ##__VA_ARGS__);                                         \
@@ -502,9 +521,20 @@ static void Compressed_Serialize(Chunk_t *chunk,
         compchunk->prevValue.u = readUnsigned(ctx, ##__VA_ARGS__);                                 \
         compchunk->prevLeading = readUnsigned(ctx, ##__VA_ARGS__);                                 \
         compchunk->prevTrailing = readUnsigned(ctx, ##__VA_ARGS__);                                \
+        if (compchunk->codec == VALUE_CODEC_DECIMAL) {                                             \
+            compchunk->scale = readUnsigned(ctx, ##__VA_ARGS__);                                   \
+            compchunk->decimalCount = readUnsigned(ctx, ##__VA_ARGS__);                            \
+            compchunk->prevDecimal = (int64_t)readUnsigned(ctx, ##__VA_ARGS__);                    \
+            compchunk->prevDecimalDelta = (int64_t)readUnsigned(ctx, ##__VA_ARGS__);               \
+        }                                                                                          \
                                                                                                    \
         size_t len;                                                                                \
-        compchunk->data = (uint64_t *)readStringBuffer(ctx, &len, ##__VA_ARGS__);                  \
+        char *buf = readStringBuffer(ctx, &len, ##__VA_ARGS__);                                    \
+        /* the buffer is owned by the loader, the chunk data lives in the pool */                  \
+        compchunk->data = (uint64_t *)ChunkPool_Calloc(compchunk->size);                           \
+        memcpy(compchunk->data, buf, min(len, compchunk->size));                                   \
+        free(buf);                                                                                 \
+        Compressed_RebuildMetadata(compchunk);                                                     \
         *chunk = (Chunk_t *)compchunk;                                                             \
         return TSDB_OK;                                                                            \
                                                                                                    \
@@ -524,7 +554,13 @@ void Compressed_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io) {
 }
 
 int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
-    COMPRESSED_DESERIALIZE(chunk, io, LoadUnsigned_IOError, LoadStringBuffer_IOError, goto err);
+    COMPRESSED_DESERIALIZE(
+        chunk, io, VALUE_CODEC_GORILLA, LoadUnsigned_IOError, LoadStringBuffer_IOError, goto err);
+}
+
+int Decimal_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
+    COMPRESSED_DESERIALIZE(
+        chunk, io, VALUE_CODEC_DECIMAL, LoadUnsigned_IOError, LoadStringBuffer_IOError, goto err);
 }
 
 void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
@@ -535,6 +571,27 @@ void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
 }
 
 int Compressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
-    COMPRESSED_DESERIALIZE(
-        chunk, sctx, MR_SerializationCtxReadeLongLongWrapper, MR_ownedBufferFrom);
+    COMPRESSED_DESERIALIZE(chunk,
+                           sctx,
+                           VALUE_CODEC_GORILLA,
+                           MR_SerializationCtxReadeLongLongWrapper,
+                           MR_ownedBufferFrom);
+}
+
+int Decimal_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
+    COMPRESSED_DESERIALIZE(chunk,
+                           sctx,
+                           VALUE_CODEC_DECIMAL,
+                           MR_SerializationCtxReadeLongLongWrapper,
+                           MR_ownedBufferFrom);
+}
+
+/*********************
+ *  Defrag           *
+ *********************/
+Chunk_t *Compressed_DefragChunk(RedisModuleDefragCtx *ctx, Chunk_t *chunk) {
+    CompressedChunk *cmpChunk = ChunkPool_Defrag(ctx, chunk);
+    cmpChunk->data = ChunkPool_Defrag(ctx, cmpChunk->data);
+    cmpChunk->checkpoints = ChunkPool_Defrag(ctx, cmpChunk->checkpoints);
+    return cmpChunk;
 }
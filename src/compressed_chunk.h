@@ -15,9 +15,14 @@
 
 // Initialize compressed chunk
 Chunk_t *Compressed_NewChunk(size_t size);
+// Initialize compressed chunk which stores its values as decimals when possible
+Chunk_t *Decimal_NewChunk(size_t size);
 void Compressed_FreeChunk(Chunk_t *chunk);
 Chunk_t *Compressed_CloneChunk(const Chunk_t *chunk);
 Chunk_t *Compressed_SplitChunk(Chunk_t *chunk);
+Chunk_t *Compressed_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize);
+// Shrink the chunk buffer to the encoded data
+void Compressed_TrimChunk(CompressedChunk *chunk);
 
 // Append a sample to a compressed chunk
 ChunkResult Compressed_AddSample(Chunk_t *chunk, Sample *sample);
@@ -41,14 +46,20 @@ u_int64_t Compressed_ChunkNumOfSample(Chunk_t *chunk);
 timestamp_t Compressed_GetFirstTimestamp(Chunk_t *chunk);
 timestamp_t Compressed_GetLastTimestamp(Chunk_t *chunk);
 double Compressed_GetLastValue(Chunk_t *chunk);
+const ChunkStats *Compressed_GetStats(const Chunk_t *chunk);
 
 // RDB
 void Compressed_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io);
 int Compressed_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
+int Decimal_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
 
 // LibMR
 void Compressed_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx);
 int Compressed_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx);
+int Decimal_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx);
+
+// Defrag
+Chunk_t *Compressed_DefragChunk(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
 
 /* Used in tests */
 u_int64_t getIterIdx(ChunkIter_t *iter);
@@ -31,6 +31,12 @@ const char *ChunkTypeToString(int options) {
     if (options & SERIES_OPT_COMPRESSED_GORILLA) {
         return COMPRESSED_GORILLA_ARG_STR;
     }
+    if (options & SERIES_OPT_COMPRESSED_DECIMAL) {
+        return COMPRESSED_DECIMAL_ARG_STR;
+    }
+    if (options & SERIES_OPT_HYBRID) {
+        return HYBRID_ARG_STR;
+    }
     return "invalid";
 }
 
@@ -86,10 +92,14 @@ int ReadConfig(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         RedisModule_Log(ctx, "warning", "Unable to parse argument after CHUNK_SIZE_BYTES");
         return TSDB_ERROR;
     }
-    RedisModule_Log(ctx,
-                    "notice",
-                    "loaded default CHUNK_SIZE_BYTES policy: %lld",
-                    TSGlobalConfig.chunkSizeBytes);
+    if (TSGlobalConfig.chunkSizeBytes == CHUNK_SIZE_AUTO) {
+        RedisModule_Log(ctx, "notice", "loaded default CHUNK_SIZE_BYTES policy: AUTO");
+    } else {
+        RedisModule_Log(ctx,
+                        "notice",
+                        "loaded default CHUNK_SIZE_BYTES policy: %lld",
+                        TSGlobalConfig.chunkSizeBytes);
+    }
 
     TSGlobalConfig.duplicatePolicy = DEFAULT_DUPLICATE_POLICY;
     if (ParseDuplicatePolicy(
@@ -128,11 +138,17 @@ int ReadConfig(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         chunk_type_cstr = RedisModule_StringPtrLen(chunk_type, &len);
 
         if (strncmp(chunk_type_cstr, COMPRESSED_GORILLA_ARG_STR, len) == 0) {
-            TSGlobalConfig.options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            TSGlobalConfig.options &= ~SERIES_OPT_ENCODING_MASK;
             TSGlobalConfig.options |= SERIES_OPT_COMPRESSED_GORILLA;
         } else if (strncmp(chunk_type_cstr, UNCOMPRESSED_ARG_STR, len) == 0) {
-            TSGlobalConfig.options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            TSGlobalConfig.options &= ~SERIES_OPT_ENCODING_MASK;
             TSGlobalConfig.options |= SERIES_OPT_UNCOMPRESSED;
+        } else if (strncmp(chunk_type_cstr, COMPRESSED_DECIMAL_ARG_STR, len) == 0) {
+            TSGlobalConfig.options &= ~SERIES_OPT_ENCODING_MASK;
+            TSGlobalConfig.options |= SERIES_OPT_COMPRESSED_DECIMAL;
+        } else if (strncmp(chunk_type_cstr, HYBRID_ARG_STR, len) == 0) {
+            TSGlobalConfig.options &= ~SERIES_OPT_ENCODING_MASK;
+            TSGlobalConfig.options |= SERIES_OPT_HYBRID;
         } else {
             RedisModule_Log(ctx, "warning", "unknown series ENCODING type: %s\n", chunk_type_cstr);
             return TSDB_ERROR;
@@ -147,6 +163,47 @@ int ReadConfig(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     } else {
         TSGlobalConfig.numThreads = 3;
     }
+    TSGlobalConfig.oooStagingSize = 0;
+    if (argc > 1 && RMUtil_ArgIndex("OOO_STAGING_SIZE", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "OOO_STAGING_SIZE", argv, argc, "l", &TSGlobalConfig.oooStagingSize) !=
+                REDISMODULE_OK ||
+            TSGlobalConfig.oooStagingSize < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after OOO_STAGING_SIZE");
+            return TSDB_ERROR;
+        }
+        RedisModule_Log(
+            ctx, "notice", "loaded OOO_STAGING_SIZE: %lld", TSGlobalConfig.oooStagingSize);
+    }
+    TSGlobalConfig.oooStagingMaxAge = OOO_STAGING_MAX_AGE_DEFAULT;
+    if (argc > 1 && RMUtil_ArgIndex("OOO_STAGING_MAX_AGE", argv, argc) >= 0) {
+        if (RMUtil_ParseArgsAfter(
+                "OOO_STAGING_MAX_AGE", argv, argc, "l", &TSGlobalConfig.oooStagingMaxAge) !=
+                REDISMODULE_OK ||
+            TSGlobalConfig.oooStagingMaxAge < 0) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after OOO_STAGING_MAX_AGE");
+            return TSDB_ERROR;
+        }
+        RedisModule_Log(
+            ctx, "notice", "loaded OOO_STAGING_MAX_AGE: %lld", TSGlobalConfig.oooStagingMaxAge);
+    }
+    TSGlobalConfig.rollupQueries = false;
+    if (argc > 1 && RMUtil_ArgIndex("ROLLUP_QUERIES", argv, argc) >= 0) {
+        RedisModuleString *rollupQueries;
+        if (RMUtil_ParseArgsAfter("ROLLUP_QUERIES", argv, argc, "s", &rollupQueries) !=
+            REDISMODULE_OK) {
+            RedisModule_Log(ctx, "warning", "Unable to parse argument after ROLLUP_QUERIES");
+            return TSDB_ERROR;
+        }
+        const char *rollupQueries_cstr = RedisModule_StringPtrLen(rollupQueries, NULL);
+        if (!strcasecmp(rollupQueries_cstr, "enable")) {
+            TSGlobalConfig.rollupQueries = true;
+        } else if (strcasecmp(rollupQueries_cstr, "disable")) {
+            RedisModule_Log(ctx, "warning", "ROLLUP_QUERIES should be enable or disable");
+            return TSDB_ERROR;
+        }
+        RedisModule_Log(ctx, "notice", "loaded ROLLUP_QUERIES: %s", rollupQueries_cstr);
+    }
     TSGlobalConfig.forceSaveCrossRef = false;
     if (argc > 1 && RMUtil_ArgIndex("DEUBG_FORCE_RULE_DUMP", argv, argc) >= 0) {
         RedisModuleString *forceSaveCrossRef;
@@ -21,6 +21,9 @@ typedef struct
     int hasGlobalConfig;
     DuplicatePolicy duplicatePolicy;
     long long numThreads;   // number of threads used by libMR
+    long long oooStagingSize;   // max out of order samples staged per series, 0 to disable staging
+    long long oooStagingMaxAge; // a sample appended this far past the staged ones merges them
+    bool rollupQueries;     // aggregated range queries may read a compaction of the series
     bool forceSaveCrossRef; // Internal debug configuration param
 } TSConfig;
 
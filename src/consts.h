@@ -48,6 +48,9 @@
 #define Chunk_SIZE_BYTES_SECS           4096LL   // fills one page 4096
 #define SPLIT_FACTOR                    1.2
 #define DEFAULT_DUPLICATE_POLICY        DP_BLOCK
+#define OOO_STAGING_MAX_AGE_DEFAULT     1000LL   // milliseconds
+#define SERIES_INLINE_SAMPLES           32       // samples a new series keeps before its first chunk
+#define CHUNK_SIZE_AUTO                 -1LL     // CHUNK_SIZE AUTO, the series picks its chunk sizes
 
 /* TS.Range Aggregation types */
 typedef enum {
@@ -66,7 +69,12 @@ typedef enum {
     TS_AGG_VAR_P,
     TS_AGG_VAR_S,
     TS_AGG_TWA,
-    TS_AGG_TYPES_MAX // 13
+    TS_AGG_P50,
+    TS_AGG_P90,
+    TS_AGG_P95,
+    TS_AGG_P99,
+    TS_AGG_P999,
+    TS_AGG_TYPES_MAX // 18
 } TS_AGG_TYPES_T;
 
 
@@ -86,6 +94,16 @@ typedef enum DuplicatePolicy {
 
 #define SERIES_OPT_COMPRESSED_GORILLA 0x2
 
+#define SERIES_OPT_COMPRESSED_DECIMAL 0x4
+
+#define SERIES_OPT_HYBRID 0x8
+
+#define SERIES_OPT_AUTO_CHUNK_SIZE 0x10
+
+#define SERIES_OPT_ENCODING_MASK                                                                   \
+    (SERIES_OPT_UNCOMPRESSED | SERIES_OPT_COMPRESSED_GORILLA | SERIES_OPT_COMPRESSED_DECIMAL |     \
+     SERIES_OPT_HYBRID)
+
 #define SERIES_OPT_DEFAULT_COMPRESSION SERIES_OPT_COMPRESSED_GORILLA
 
 /* Chunk enum */
@@ -101,6 +119,9 @@ typedef enum {
 #define TS_ADD_DUPLICATE_POLICY_ARG "ON_DUPLICATE"
 #define UNCOMPRESSED_ARG_STR "uncompressed"
 #define COMPRESSED_GORILLA_ARG_STR "compressed"
+#define COMPRESSED_DECIMAL_ARG_STR "decimal"
+#define HYBRID_ARG_STR "hybrid"
+#define CHUNK_SIZE_AUTO_ARG_STR "AUTO"
 
 // DC - Don't Care (Arbitrary value) 
 #define DC 0
@@ -9,6 +9,9 @@
 
 void ResetEnrichedChunk(EnrichedChunk *chunk) {
     chunk->rev = false;
+    chunk->stats = NULL;
+    chunk->aggValues = NULL;
+    chunk->numAggValues = 0;
     chunk->samples.num_samples = 0;
     chunk->samples.timestamps = chunk->samples.og_timestamps;
     chunk->samples.values = chunk->samples.og_values;
@@ -17,6 +20,9 @@ void ResetEnrichedChunk(EnrichedChunk *chunk) {
 EnrichedChunk *NewEnrichedChunk() {
     EnrichedChunk *chunk = (EnrichedChunk *)malloc(sizeof(EnrichedChunk));
     chunk->rev = false;
+    chunk->stats = NULL;
+    chunk->aggValues = NULL;
+    chunk->numAggValues = 0;
     chunk->samples.num_samples = 0;
     chunk->samples.size = 0;
     chunk->samples.og_timestamps = NULL;
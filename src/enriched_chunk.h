@@ -19,10 +19,19 @@ typedef struct Samples
     size_t size;                // num of maximal samples which can be contained
 } Samples;
 
+struct ChunkStats;
+
 typedef struct EnrichedChunk
 {
     Samples samples;
     bool rev;
+    // When set, the chunk was summarized instead of decoded: samples holds only its first sample
+    // in iteration order and stats describes all of its samples
+    const struct ChunkStats *stats;
+    // Set by an aggregation of several aggregation types: the values of all of them for the sample
+    // i start at aggValues[i * numAggValues], samples.values holds those of the first one
+    const double *aggValues;
+    size_t numAggValues;
 } EnrichedChunk;
 
 EnrichedChunk *NewEnrichedChunk();
@@ -190,6 +190,10 @@ EnrichedChunk *SeriesFilterValIterator_GetNextChunk(struct AbstractIterator *bas
     assert(self->byValueArgs.hasValue);
 
     while ((enrichedChunk = self->base.input->GetNext(self->base.input))) {
+        if (enrichedChunk->stats) {
+            // summarized chunks are entirely within the filter
+            return enrichedChunk;
+        }
         // currently if the query reversed the chunk will be already reversed here
         // assert(self->reverse == enrichedChunk->rev);
         for (i = 0; i < enrichedChunk->samples.num_samples; ++i) {
@@ -219,7 +223,8 @@ SeriesFilterValIterator *SeriesFilterValIterator_New(AbstractIterator *input,
 }
 
 AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
-                                             AggregationClass *aggregation,
+                                             AggregationClass *const *aggregations,
+                                             size_t numAggregations,
                                              int64_t aggregationTimeDelta,
                                              timestamp_t timestampAlignment,
                                              bool reverse,
@@ -232,10 +237,19 @@ AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
     iter->base.GetNext = AggregationIterator_GetNextChunk;
     iter->base.Close = AggregationIterator_Close;
     iter->base.input = input;
-    iter->aggregation = aggregation;
+    iter->numAggregations = numAggregations;
+    iter->bucketValues = NULL;
+    iter->bucketValuesSize = 0;
+    if (numAggregations > 1) {
+        MultiAggInitClass(&iter->multiAggregation, aggregations, numAggregations);
+        iter->aggregation = &iter->multiAggregation;
+        iter->aggregationContext = MultiAggCreateContext(aggregations, numAggregations, reverse);
+    } else {
+        iter->aggregation = aggregations[0];
+        iter->aggregationContext = iter->aggregation->createContext(reverse);
+    }
     iter->timestampAlignment = timestampAlignment;
     iter->aggregationTimeDelta = aggregationTimeDelta;
-    iter->aggregationContext = iter->aggregation->createContext(reverse);
     iter->aggregationLastTimestamp = 0;
     iter->hasUnFinalizedContext = false;
     iter->reverse = reverse;
@@ -254,29 +268,62 @@ AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
     return iter;
 }
 
-static inline void finalizeBucket(Samples *samples, size_t index, const AggregationIterator *self) {
+// Keeps the values of all the aggregations of the bucket at index when there are several
+static void storeBucketValues(AggregationIterator *self, size_t index) {
+    size_t n = self->numAggregations;
+    if (n < 2) {
+        return;
+    }
+    if (index >= self->bucketValuesSize) {
+        self->bucketValuesSize = max(index + 1, 2 * self->bucketValuesSize);
+        self->bucketValues =
+            realloc(self->bucketValues, self->bucketValuesSize * n * sizeof(double));
+    }
+    memcpy(&self->bucketValues[index * n],
+           MultiAggValues(self->aggregationContext),
+           n * sizeof(double));
+}
+
+static inline void setBucketValues(EnrichedChunk *chunk, const AggregationIterator *self) {
+    chunk->aggValues = self->bucketValues;
+    chunk->numAggValues = self->numAggregations;
+}
+
+static inline void finalizeBucket(Samples *samples, size_t index, AggregationIterator *self) {
     self->aggregation->finalize(self->aggregationContext, &samples->values[index]);
+    storeBucketValues(self, index);
     samples->timestamps[index] =
         calc_bucket_ts(self->bucketTS, self->aggregationLastTimestamp, self->aggregationTimeDelta);
     self->aggregation->resetContext(self->aggregationContext);
 }
 
-// assumes num of samples > si + 1, returns -1 when no such an index
+// Last index from si whose timestamp is before timestamp, -1 when there is none. Buckets are
+// usually much shorter than the chunk, the end is found by galloping from si and then searching
+// between the last two probes, which costs O(log(bucket samples)) comparisons.
 static int64_t findLastIndexbeforeTS(const EnrichedChunk *chunk,
                                      timestamp_t timestamp,
                                      int64_t si) {
     timestamp_t *timestamps = chunk->samples.timestamps;
-    int64_t h = chunk->samples.num_samples - 1;
+    int64_t n = chunk->samples.num_samples;
     if (unlikely(timestamps[si] >= timestamp)) {
         // the first sample of the current range finalize prev chunk bucket
         return -1;
     }
-    if (timestamps[h] < timestamp) { // range of size 1 will be handled here
-        return h;
+
+    int64_t l = si, h = si + 1;
+    while (h < n && timestamps[h] < timestamp) {
+        l = h;
+        h = si + 2 * (h - si);
+    }
+    if (h >= n) {
+        h = n - 1;
+        if (timestamps[h] < timestamp) { // the bucket goes on in the next chunk
+            return h;
+        }
     }
 
-    int64_t m, l = si;
-    assert(h > l);      // from here h > l
+    int64_t m;
+    // timestamps[l] < timestamp <= timestamps[h]
     while (l < h - 1) { // if l == h-1 it means l has the result
         m = (l + h) / 2;
         if (timestamps[m] < timestamp) {
@@ -310,12 +357,13 @@ static void fillEmptyBucketWithValueIncIter(size_t *write_index,
 static void fillEmptyBucketsWithDefaultVals(size_t *write_index,
                                             timestamp_t cur_ts,
                                             Samples *samples,
-                                            const AggregationIterator *self,
+                                            AggregationIterator *self,
                                             size_t n_empty_buckets,
                                             bool reversed) {
     double val;
     for (size_t i = 0; i < n_empty_buckets; ++i) {
         self->aggregation->finalizeEmpty(self->aggregationContext, &val);
+        storeBucketValues(self, *write_index);
         fillEmptyBucketWithValueIncIter(
             write_index,
             &cur_ts,
@@ -487,7 +535,7 @@ static void fillEmptyBuckets(Samples *samples,
                              size_t *write_index,
                              timestamp_t first_bucket_ts,
                              timestamp_t end_bucket_ts,
-                             const AggregationIterator *self,
+                             AggregationIterator *self,
                              bool reversed,
                              int64_t *read_index) {
     int64_t agg_time_delta = self->aggregationTimeDelta;
@@ -603,6 +651,7 @@ EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter) {
                                  &si);
                 si++;
                 self->aux_chunk->samples.num_samples = agg_n_samples;
+                setBucketValues(self->aux_chunk, self);
                 return self->aux_chunk;
             } else if (!self->handled_twa_empty_suffix) {
                 self->handled_twa_empty_suffix = true;
@@ -635,6 +684,7 @@ EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter) {
                                  &si);
                 si++;
                 self->aux_chunk->samples.num_samples = agg_n_samples;
+                setBucketValues(self->aux_chunk, self);
                 return self->aux_chunk;
             } else {
                 return NULL;
@@ -723,8 +773,8 @@ EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter) {
         // currently if the query reversed the chunk will be already revered here
         assert(self->reverse == enrichedChunk->rev);
         Samples *samples = &enrichedChunk->samples;
-        if (self->aggregation->type == TS_AGG_MAX &&
-            !is_reversed) { // Currently only implemented vectorization for specific case
+        // the aggregations which don't need the timestamps append the samples of a bucket at once
+        if (aggregation->appendValueVec && !is_reversed && !enrichedChunk->stats) {
             while (si < samples->num_samples) {
                 ei = findLastIndexbeforeTS(enrichedChunk, contextScope, si);
                 if (likely(ei >= 0)) {
@@ -859,7 +909,13 @@ EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter) {
                     }
                 }
 
-                appendValue(aggregationContext, sample.value, sample.timestamp);
+                if (unlikely(enrichedChunk->stats != NULL)) {
+                    // a summarized chunk, all of its samples are in the current bucket
+                    aggregation->appendChunkStats(
+                        aggregationContext, enrichedChunk->stats, is_reversed);
+                } else {
+                    appendValue(aggregationContext, sample.value, sample.timestamp);
+                }
                 si++;
             }
         }
@@ -867,6 +923,8 @@ EnrichedChunk *AggregationIterator_GetNextChunk(struct AbstractIterator *iter) {
         if (agg_n_samples > 0) {
             self->prev_ts = enrichedChunk->samples.timestamps[agg_n_samples - 1];
             enrichedChunk->samples.num_samples = agg_n_samples;
+            enrichedChunk->stats = NULL;
+            setBucketValues(enrichedChunk, self);
             return enrichedChunk;
         }
         enrichedChunk = input->GetNext(input);
@@ -895,6 +953,7 @@ _finalize:
         }
     }
     aggregation->finalize(aggregationContext, &value); // last bucket, no need to addBucketParams
+    storeBucketValues(self, 0);
     self->aux_chunk->samples.timestamps[0] =
         calc_bucket_ts(self->bucketTS, self->aggregationLastTimestamp, self->aggregationTimeDelta);
     self->aux_chunk->samples.values[0] = value;
@@ -932,6 +991,7 @@ _finalize:
         }
     }
     self->aux_chunk->samples.num_samples = n_samples;
+    setBucketValues(self->aux_chunk, self);
     return self->aux_chunk;
 }
 
@@ -939,6 +999,7 @@ void AggregationIterator_Close(struct AbstractIterator *iterator) {
     AggregationIterator *self = (AggregationIterator *)iterator;
     iterator->input->Close(iterator->input);
     self->aggregation->freeContext(self->aggregationContext);
+    free(self->bucketValues);
     FreeEnrichedChunk(self->aux_chunk);
     free(iterator);
 }
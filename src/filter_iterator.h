@@ -41,6 +41,10 @@ typedef struct AggregationIterator
 {
     AbstractIterator base;
     AggregationClass *aggregation;
+    AggregationClass multiAggregation; // the class of aggregation when there are several types
+    size_t numAggregations;
+    double *bucketValues;    // the values of all the aggregations per bucket when there are several
+    size_t bucketValuesSize; // num of buckets bucketValues can hold
     int64_t aggregationTimeDelta;
     timestamp_t timestampAlignment;
     void *aggregationContext;
@@ -60,7 +64,8 @@ typedef struct AggregationIterator
 } AggregationIterator;
 
 AggregationIterator *AggregationIterator_New(struct AbstractIterator *input,
-                                             AggregationClass *aggregation,
+                                             AggregationClass *const *aggregations,
+                                             size_t numAggregations,
                                              int64_t aggregationTimeDelta,
                                              timestamp_t timestampAlignment,
                                              bool reverse,
@@ -2,6 +2,7 @@
 
 #include "chunk.h"
 #include "compressed_chunk.h"
+#include "hybrid_chunk.h"
 
 #include <ctype.h>
 #include <math.h>
@@ -11,6 +12,7 @@ static const ChunkFuncs regChunk = {
     .NewChunk = Uncompressed_NewChunk,
     .FreeChunk = Uncompressed_FreeChunk,
     .SplitChunk = Uncompressed_SplitChunk,
+    .MergeChunk = Uncompressed_MergeChunk,
     .CloneChunk = Uncompressed_CloneChunk,
 
     .AddSample = Uncompressed_AddSample,
@@ -24,11 +26,14 @@ static const ChunkFuncs regChunk = {
     .GetLastTimestamp = Uncompressed_GetLastTimestamp,
     .GetLastValue = Uncompressed_GetLastValue,
     .GetFirstTimestamp = Uncompressed_GetFirstTimestamp,
+    .GetStats = Uncompressed_GetStats,
 
     .SaveToRDB = Uncompressed_SaveToRDB,
     .LoadFromRDB = Uncompressed_LoadFromRDB,
     .MRSerialize = Uncompressed_MRSerialize,
     .MRDeserialize = Uncompressed_MRDeserialize,
+
+    .DefragChunk = Uncompressed_DefragChunk,
 };
 
 static const ChunkFuncs comprChunk = {
@@ -36,6 +41,7 @@ static const ChunkFuncs comprChunk = {
     .FreeChunk = Compressed_FreeChunk,
     .CloneChunk = Compressed_CloneChunk,
     .SplitChunk = Compressed_SplitChunk,
+    .MergeChunk = Compressed_MergeChunk,
 
     .AddSample = Compressed_AddSample,
     .UpsertSample = Compressed_UpsertSample,
@@ -48,11 +54,72 @@ static const ChunkFuncs comprChunk = {
     .GetLastTimestamp = Compressed_GetLastTimestamp,
     .GetLastValue = Compressed_GetLastValue,
     .GetFirstTimestamp = Compressed_GetFirstTimestamp,
+    .GetStats = Compressed_GetStats,
 
     .SaveToRDB = Compressed_SaveToRDB,
     .LoadFromRDB = Compressed_LoadFromRDB,
     .MRSerialize = Compressed_MRSerialize,
     .MRDeserialize = Compressed_MRDeserialize,
+
+    .DefragChunk = Compressed_DefragChunk,
+};
+
+// Same as comprChunk, the chunks store their values as decimals when possible
+static const ChunkFuncs decimalChunk = {
+    .NewChunk = Decimal_NewChunk,
+    .FreeChunk = Compressed_FreeChunk,
+    .CloneChunk = Compressed_CloneChunk,
+    .SplitChunk = Compressed_SplitChunk,
+    .MergeChunk = Compressed_MergeChunk,
+
+    .AddSample = Compressed_AddSample,
+    .UpsertSample = Compressed_UpsertSample,
+    .DelRange = Compressed_DelRange,
+
+    .ProcessChunk = Compressed_ProcessChunk,
+
+    .GetChunkSize = Compressed_GetChunkSize,
+    .GetNumOfSample = Compressed_ChunkNumOfSample,
+    .GetLastTimestamp = Compressed_GetLastTimestamp,
+    .GetLastValue = Compressed_GetLastValue,
+    .GetFirstTimestamp = Compressed_GetFirstTimestamp,
+    .GetStats = Compressed_GetStats,
+
+    .SaveToRDB = Compressed_SaveToRDB,
+    .LoadFromRDB = Decimal_LoadFromRDB,
+    .MRSerialize = Compressed_MRSerialize,
+    .MRDeserialize = Decimal_MRDeserialize,
+
+    .DefragChunk = Compressed_DefragChunk,
+};
+
+// Uncompressed chunks which are compressed once full, see hybrid_chunk.h
+static const ChunkFuncs hybridChunk = {
+    .NewChunk = Hybrid_NewChunk,
+    .FreeChunk = Hybrid_FreeChunk,
+    .CloneChunk = Hybrid_CloneChunk,
+    .SplitChunk = Hybrid_SplitChunk,
+    .MergeChunk = Hybrid_MergeChunk,
+
+    .AddSample = Hybrid_AddSample,
+    .UpsertSample = Hybrid_UpsertSample,
+    .DelRange = Hybrid_DelRange,
+
+    .ProcessChunk = Hybrid_ProcessChunk,
+
+    .GetChunkSize = Hybrid_GetChunkSize,
+    .GetNumOfSample = Hybrid_NumOfSample,
+    .GetLastTimestamp = Hybrid_GetLastTimestamp,
+    .GetLastValue = Hybrid_GetLastValue,
+    .GetFirstTimestamp = Hybrid_GetFirstTimestamp,
+    .GetStats = Hybrid_GetStats,
+
+    .SaveToRDB = Hybrid_SaveToRDB,
+    .LoadFromRDB = Hybrid_LoadFromRDB,
+    .MRSerialize = Hybrid_MRSerialize,
+    .MRDeserialize = Hybrid_MRDeserialize,
+
+    .DefragChunk = Hybrid_DefragChunk,
 };
 
 // This function will decide according to the policy how to handle duplicate sample, the `newSample`
@@ -97,6 +164,10 @@ const ChunkFuncs *GetChunkClass(CHUNK_TYPES_T chunkType) {
             return &regChunk;
         case CHUNK_COMPRESSED:
             return &comprChunk;
+        case CHUNK_COMPRESSED_DECIMAL:
+            return &decimalChunk;
+        case CHUNK_HYBRID:
+            return &hybridChunk;
     }
     return NULL;
 }
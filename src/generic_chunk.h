@@ -12,6 +12,7 @@
 #include "load_io_error_macros.h"
 #include "enriched_chunk.h"
 
+#include <math.h>   // isfinite
 #include <stdio.h>  // printf
 #include <stdlib.h> // malloc
 #include <string.h> // memcpy, memmove
@@ -19,6 +20,7 @@
 #include <rmutil/strings.h>
 
 struct RedisModuleIO;
+struct RedisModuleDefragCtx;
 
 typedef struct Sample
 {
@@ -26,19 +28,57 @@ typedef struct Sample
     double value;
 } Sample;
 
+// Summary of the samples of a chunk, maintained on append. When `valid` is false the summary is
+// stale and the chunk has to be decoded.
+typedef struct ChunkStats
+{
+    Sample first;
+    Sample last;
+    double min;
+    double max;
+    double sum;
+    u_int64_t count;
+    bool valid;
+} ChunkStats;
+
+static inline void ChunkStats_Reset(ChunkStats *stats) {
+    *stats = (ChunkStats){ .valid = true };
+}
+
+static inline void ChunkStats_Append(ChunkStats *stats, timestamp_t timestamp, double value) {
+    if (stats->count == 0) {
+        stats->first = (Sample){ .timestamp = timestamp, .value = value };
+        stats->min = stats->max = value;
+    } else if (value < stats->min) {
+        stats->min = value;
+    } else if (value > stats->max) {
+        stats->max = value;
+    }
+    stats->last = (Sample){ .timestamp = timestamp, .value = value };
+    stats->sum += value;
+    stats->count++;
+    if (unlikely(!isfinite(stats->sum))) {
+        stats->valid = false; // NaN, infinite values and overflows aren't summarized
+    }
+}
+
 typedef void Chunk_t;
 typedef void ChunkIter_t;
 
 typedef enum CHUNK_TYPES_T
 {
     CHUNK_REGULAR,
-    CHUNK_COMPRESSED
+    CHUNK_COMPRESSED,
+    CHUNK_COMPRESSED_DECIMAL,
+    CHUNK_HYBRID
 } CHUNK_TYPES_T;
 
 typedef struct UpsertCtx
 {
     Sample sample;
     Chunk_t *inChunk; // original chunk
+    bool replaced;    // set by UpsertSample when a sample with the same timestamp was replaced
+    double oldValue;  // value of the replaced sample
 } UpsertCtx;
 
 typedef struct ChunkFuncs
@@ -47,6 +87,9 @@ typedef struct ChunkFuncs
     void (*FreeChunk)(Chunk_t *chunk);
     Chunk_t *(*CloneChunk)(const Chunk_t *chunk);
     Chunk_t *(*SplitChunk)(Chunk_t *chunk);
+    // Returns a new chunk holding the samples of chunk followed by the samples of next, NULL when
+    // they don't fit in maxSize bytes. next must start after the end of chunk.
+    Chunk_t *(*MergeChunk)(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize);
 
     size_t (*DelRange)(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
     ChunkResult (*AddSample)(Chunk_t *chunk, Sample *sample);
@@ -63,11 +106,16 @@ typedef struct ChunkFuncs
     u_int64_t (*GetLastTimestamp)(Chunk_t *chunk);
     double (*GetLastValue)(Chunk_t *chunk);
     u_int64_t (*GetFirstTimestamp)(Chunk_t *chunk);
+    // Returns NULL when the chunk stats are stale
+    const ChunkStats *(*GetStats)(const Chunk_t *chunk);
 
     void (*SaveToRDB)(Chunk_t *chunk, struct RedisModuleIO *io);
     int (*LoadFromRDB)(Chunk_t **chunk, struct RedisModuleIO *io);
     void (*MRSerialize)(Chunk_t *chunk, WriteSerializationCtx *sctx);
     int (*MRDeserialize)(Chunk_t **chunk, ReaderSerializationCtx *sctx);
+
+    // Moves the chunk and its buffers during active defrag, returns the chunk's new address
+    Chunk_t *(*DefragChunk)(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
 } ChunkFuncs;
 
 ChunkResult handleDuplicateSample(DuplicatePolicy policy, Sample oldSample, Sample *newSample);
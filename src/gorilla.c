@@ -55,6 +55,17 @@
  *    000101100110110001111 *   0001011001101100 * 01111 * [-32768,32767] *    5740 *
  * 0x00000000000186A0 11111 * 0x00000000000186A0 * 11111 *  [Min64,Max64] *  100000 *
  ************************************************************************************
+ * Runs of timestamps
+ *
+ * Periodic series have a DoubleDelta of 0 for almost every timestamp. Once
+ * RUN_MIN_ZEROS consecutive timestamps were encoded with a single `0` bit, the
+ * next zero DoubleDelta is encoded as a run token instead: the smallest bucket
+ * with a value of 0, which is never used otherwise, followed by a counter of
+ * TIMESTAMP_RUN_BITS bits. The counter holds the number of samples in the run,
+ * the timestamps of the samples which follow the first one aren't encoded at
+ * all. While the run is the last one of the chunk, the encoder extends it by
+ * updating the counter in place.
+ ************************************************************************************
  * Compression of (XOR of) doubles
  *
  * Writing:
@@ -86,11 +97,26 @@
  * 0x0024b33333333333 01011 * 0x0024b33333333333 *  0 * 10 * 1 * 1 *  18.7 * 5.5 *
  *********************************************************************************
  * t=trailing, l=leading, p=use of previous params, 0=xor equal zero
+ *********************************************************************************
+ * Compression of decimals (VALUE_CODEC_DECIMAL)
+ *
+ * Counters and values with a fixed number of decimals, such as 5000 or 12.34, have a
+ * mantissa full of noise so their XOR is rarely small. The scale of the chunk is the
+ * smallest number of decimals which represents the first value exactly, the values are
+ * then stored as the integers value * 10^scale using the same DoubleDelta encoding as
+ * the timestamps. A value is representable when dividing the integer by 10^scale gives
+ * back the very same double.
+ *
+ * When a value needs more decimals while all the values in the chunk are still decimals,
+ * the chunk is re-encoded with a larger scale. Otherwise, the value and the ones that
+ * follow it in the chunk are stored as XOR of doubles, starting from the previous value.
  */
 
 #include "gorilla.h"
 
 #include <assert.h>
+#include <string.h>
+#include "rmutil/alloc.h"
 
 #define BIN_NUM_VALUES 64
 #define BINW BIN_NUM_VALUES
@@ -114,6 +140,12 @@
 #define CMPR_L4 15
 #define CMPR_L5 32
 
+// A run token is the CMPR_L1 bucket ('1', '0') with a value of 0
+#define RUN_TOKEN 0x01
+#define RUN_TOKEN_BITS (2 + CMPR_L1)
+// Number of zero delta of deltas encoded one by one before starting a run
+#define RUN_MIN_ZEROS 8
+
 // The powers of 2 from 0 to 63
 static u_int64_t bittt[] = {
     1ULL << 0,  1ULL << 1,  1ULL << 2,  1ULL << 3,  1ULL << 4,  1ULL << 5,  1ULL << 6,  1ULL << 7,
@@ -241,6 +273,21 @@ static inline void appendBits(binary_t *bins, globalbit_t *bit, binary_t data, u
     *bit += dataLen;
 }
 
+// Overwrite `dataLen` bits of `bins` at bit position `bit` with `data`
+static inline void writeBits(binary_t *bins, globalbit_t bit, binary_t data, u_int8_t dataLen) {
+    binary_t *bin_it = &bins[bit >> 6];
+    localbit_t lbit = localbit(bit);
+    localbit_t available = BINW - lbit;
+
+    if (available >= dataLen) {
+        *bin_it &= ~(bitmask[dataLen] << lbit);
+    } else {
+        *bin_it &= bitmask[lbit];
+        *(bin_it + 1) &= ~bitmask[dataLen - available];
+    }
+    appendBits(bins, &bit, data, dataLen);
+}
+
 // Read `dataLen` bits from `bins` at position `bit`
 static inline binary_t readBits(const binary_t *bins,
                                 globalbit_t start_pos,
@@ -261,24 +308,45 @@ static inline bool isSpaceAvailable(CompressedChunk *chunk, u_int8_t size) {
     return size <= available;
 }
 
-/***************************** APPEND ********************************/
-static ChunkResult appendInteger(CompressedChunk *chunk, timestamp_t timestamp) {
-#ifdef DEBUG
-    assert(timestamp >= chunk->prevTimestamp);
-#endif
-    timestamp_t curDelta = timestamp - chunk->prevTimestamp;
+/***************************** DECIMALS ********************************/
+static const double decimalScales[DECIMAL_MAX_SCALE + 1] = { 1e0, 1e1, 1e2, 1e3, 1e4,
+                                                            1e5, 1e6, 1e7, 1e8, 1e9 };
+
+// 2^53, larger integers can't all be represented by a double
+#define DECIMAL_MAX_ABS 9007199254740992.0
+
+static inline int64_t scaleDecimal(double value, u_int8_t scale) {
+    return llrint(value * decimalScales[scale]);
+}
 
+static inline double fromDecimal(int64_t n, u_int8_t scale) {
+    return (double)n / decimalScales[scale];
+}
+
+// Returns true if `value` is exactly represented by `*n` with `scale` decimals
+static inline bool toDecimal(double value, u_int8_t scale, int64_t *n) {
+    // also rejects NaN
+    if (!(fabs(value * decimalScales[scale]) <= DECIMAL_MAX_ABS)) {
+        return false;
+    }
+    union64bits orig = { .d = value };
+    union64bits back = { .d = fromDecimal(*n = scaleDecimal(value, scale), scale) };
+    return orig.u == back.u;
+}
+
+/***************************** APPEND ********************************/
+/*
+ * Append the DoubleDelta `dod`, `reserve` more bits must be available after it for the
+ * encoding to succeed.
+ */
+static ChunkResult appendDoubleDelta(CompressedChunk *chunk, int64_t dod, u_int8_t reserve) {
     union64bits doubleDelta;
-    doubleDelta.i = curDelta - chunk->prevTimestampDelta;
+    doubleDelta.i = dod;
     /*
-     * Before any insertion the code `CHECKSPACE` ensures there is enough space to
-     * encode timestamp and one additional bit which the minimum to encode the value.
-     * This is why we have `+ 1` in `CHECKSPACE`.
-     *
      * If doubleDelta == 0, 1 bit of value 0 is inserted.
      *
      * Else, `Bin_InRange` checks for the minimal number of bits required to represent
-     * `doubleDelta`, the delta of deltas between current and previous timestamps.
+     * `doubleDelta`, the delta of deltas between current and previous integers.
      * Then two values are being inserted.
        * The first value is, encoding for the lowest number of bits for which
          `Bin_InRange` returns `true`.
@@ -288,38 +356,86 @@ static ChunkResult appendInteger(CompressedChunk *chunk, timestamp_t timestamp)
     binary_t *bins = chunk->data;
     globalbit_t *bit = &chunk->idx;
     if (doubleDelta.i == 0) {
-        CHECKSPACE(chunk, 1 + 1); // CHECKSPACE adds 1 as minimum for double space
+        CHECKSPACE(chunk, 1 + reserve);
         appendBits(bins, bit, 0x00, 1);
     } else if (Bin_InRange(doubleDelta.i, CMPR_L1)) {
-        CHECKSPACE(chunk, 2 + CMPR_L1 + 1);
+        CHECKSPACE(chunk, 2 + CMPR_L1 + reserve);
         appendBits(bins, bit, 0x01, 2);
         appendBits(bins, bit, int2bin(doubleDelta.i, CMPR_L1), CMPR_L1);
     } else if (Bin_InRange(doubleDelta.i, CMPR_L2)) {
-        CHECKSPACE(chunk, 3 + CMPR_L2 + 1);
+        CHECKSPACE(chunk, 3 + CMPR_L2 + reserve);
         appendBits(bins, bit, 0x03, 3);
         appendBits(bins, bit, int2bin(doubleDelta.i, CMPR_L2), CMPR_L2);
     } else if (Bin_InRange(doubleDelta.i, CMPR_L3)) {
-        CHECKSPACE(chunk, 4 + CMPR_L3 + 1);
+        CHECKSPACE(chunk, 4 + CMPR_L3 + reserve);
         appendBits(bins, bit, 0x07, 4);
         appendBits(bins, bit, int2bin(doubleDelta.i, CMPR_L3), CMPR_L3);
     } else if (Bin_InRange(doubleDelta.i, CMPR_L4)) {
-        CHECKSPACE(chunk, 5 + CMPR_L4 + 1);
+        CHECKSPACE(chunk, 5 + CMPR_L4 + reserve);
         appendBits(bins, bit, 0x0f, 5);
         appendBits(bins, bit, int2bin(doubleDelta.i, CMPR_L4), CMPR_L4);
     } else if (Bin_InRange(doubleDelta.i, CMPR_L5)) {
-        CHECKSPACE(chunk, 6 + CMPR_L5 + 1);
+        CHECKSPACE(chunk, 6 + CMPR_L5 + reserve);
         appendBits(bins, bit, 0x1f, 6);
         appendBits(bins, bit, int2bin(doubleDelta.i, CMPR_L5), CMPR_L5);
     } else {
-        CHECKSPACE(chunk, 6 + 64 + 1);
+        CHECKSPACE(chunk, 6 + 64 + reserve);
         appendBits(bins, bit, 0x3f, 6);
         appendBits(bins, bit, doubleDelta.u, 64);
     }
+    return CR_OK;
+}
+
+static ChunkResult appendInteger(CompressedChunk *chunk, timestamp_t timestamp) {
+#ifdef DEBUG
+    assert(timestamp >= chunk->prevTimestamp);
+#endif
+    timestamp_t curDelta = timestamp - chunk->prevTimestamp;
+    int64_t doubleDelta = curDelta - chunk->prevTimestampDelta;
+    binary_t *bins = chunk->data;
+    // 1 bit is reserved as the minimum to encode the value
+    if (doubleDelta != 0) {
+        if (appendDoubleDelta(chunk, doubleDelta, 1) != CR_OK) {
+            return CR_ERR;
+        }
+        chunk->runIdx = 0;
+        chunk->runLength = 0;
+        chunk->zeroCount = 0;
+    } else if (chunk->runIdx != 0 && chunk->runLength < TIMESTAMP_RUN_MAX) {
+        // extend the run
+        CHECKSPACE(chunk, 1);
+        writeBits(bins, chunk->runIdx, ++chunk->runLength, TIMESTAMP_RUN_BITS);
+    } else if (chunk->runIdx != 0 || chunk->zeroCount >= RUN_MIN_ZEROS) {
+        // start a run
+        CHECKSPACE(chunk, RUN_TOKEN_BITS + TIMESTAMP_RUN_BITS + 1);
+        appendBits(bins, &chunk->idx, RUN_TOKEN, RUN_TOKEN_BITS);
+        chunk->runIdx = chunk->idx;
+        chunk->runLength = 1;
+        appendBits(bins, &chunk->idx, chunk->runLength, TIMESTAMP_RUN_BITS);
+    } else {
+        if (appendDoubleDelta(chunk, 0, 1) != CR_OK) {
+            return CR_ERR;
+        }
+        chunk->zeroCount++;
+    }
     chunk->prevTimestampDelta = curDelta;
     chunk->prevTimestamp = timestamp;
     return CR_OK;
 }
 
+// Append `value`, represented by `n` with the chunk's scale
+static ChunkResult appendDecimal(CompressedChunk *chunk, int64_t n, double value) {
+    int64_t curDelta = n - chunk->prevDecimal;
+    if (appendDoubleDelta(chunk, curDelta - chunk->prevDecimalDelta, 0) != CR_OK) {
+        return CR_ERR;
+    }
+    chunk->prevDecimalDelta = curDelta;
+    chunk->prevDecimal = n;
+    // the XOR of the first value which isn't a decimal is taken from the last decimal
+    chunk->prevValue.d = value;
+    return CR_OK;
+}
+
 static ChunkResult appendFloat(CompressedChunk *chunk, double value) {
     union64bits val;
     val.d = value;
@@ -405,7 +521,254 @@ static void zero_bits(u_int64_t *data, size_t data_size, globalbit_t start, glob
     }
 }
 
-ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, double value) {
+/***************************** CHECKPOINTS ********************************/
+/*
+ * Every COMPRESSED_CHECKPOINT_INTERVAL samples the encoder state, which is also the decoder state,
+ * is saved along with the bit offset of the next sample. Readers look up the last checkpoint
+ * preceding the timestamp they are interested in and start decoding from there instead of from
+ * the beginning of the chunk.
+ */
+static inline void appendCheckpoint(CompressedChunk *chunk) {
+    chunk->checkpoints = realloc(chunk->checkpoints,
+                                 (chunk->checkpointsCount + 1) * sizeof(CompressedCheckpoint));
+    chunk->checkpoints[chunk->checkpointsCount++] = (CompressedCheckpoint){
+        .idx = chunk->idx,
+        .prevTimestamp = chunk->prevTimestamp,
+        .prevTimestampDelta = chunk->prevTimestampDelta,
+        .prevValue = chunk->prevValue,
+        .prevDecimal = chunk->prevDecimal,
+        .prevDecimalDelta = chunk->prevDecimalDelta,
+        .runIdx = chunk->runIdx,
+        .runLength = chunk->runLength,
+        .count = chunk->count,
+        .prevLeading = chunk->prevLeading,
+        .prevTrailing = chunk->prevTrailing,
+    };
+}
+
+int64_t Compressed_FindCheckpoint(const CompressedChunk *chunk, timestamp_t timestamp) {
+    // samples are sorted, so are the checkpoints
+    int64_t low = 0;
+    int64_t high = (int64_t)chunk->checkpointsCount - 1;
+    int64_t found = -1;
+    while (low <= high) {
+        int64_t mid = low + (high - low) / 2;
+        if (chunk->checkpoints[mid].prevTimestamp < timestamp) {
+            found = mid;
+            low = mid + 1;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return found;
+}
+
+void Compressed_ChunkIteratorSeek(Compressed_Iterator *iter, int64_t checkpoint) {
+    const CompressedChunk *chunk = iter->chunk;
+    if (checkpoint < 0) {
+        iter->idx = 0;
+        iter->count = 0;
+        iter->prevDelta = 0;
+        iter->prevTS = chunk->baseTimestamp;
+        iter->runIdx = 0;
+        iter->runLength = 0;
+        iter->runTotal = 0;
+        iter->prevValue = chunk->baseValue;
+        iter->leading = 32;
+        iter->trailing = 32;
+        iter->blocksize = 0;
+        iter->prevDecimal = chunk->decimalCount > 0 ? scaleDecimal(chunk->baseValue.d, chunk->scale)
+                                                    : 0;
+        iter->prevDecimalDelta = 0;
+        return;
+    }
+    const CompressedCheckpoint *cp = &chunk->checkpoints[checkpoint];
+    iter->idx = cp->idx;
+    iter->count = cp->count;
+    iter->prevDelta = cp->prevTimestampDelta;
+    iter->prevTS = cp->prevTimestamp;
+    // the run may have been extended since the checkpoint was recorded
+    iter->runIdx = cp->runIdx;
+    iter->runLength = cp->runLength;
+    iter->runTotal =
+        cp->runIdx != 0 ? readBits(chunk->data, cp->runIdx, TIMESTAMP_RUN_BITS) : 0;
+    iter->prevValue = cp->prevValue;
+    iter->leading = cp->prevLeading;
+    iter->trailing = cp->prevTrailing;
+    iter->blocksize = BINW - cp->prevLeading - cp->prevTrailing;
+    iter->prevDecimal = cp->prevDecimal;
+    iter->prevDecimalDelta = cp->prevDecimalDelta;
+}
+
+void Compressed_RebuildMetadata(CompressedChunk *chunk) {
+    free(chunk->checkpoints);
+    chunk->checkpoints = NULL;
+    chunk->checkpointsCount = 0;
+    chunk->runIdx = 0;
+    chunk->runLength = 0;
+    chunk->zeroCount = 0;
+    ChunkStats_Reset(&chunk->stats);
+    if (chunk->count == 0) {
+        return;
+    }
+
+    size_t n = (chunk->count - 1) / COMPRESSED_CHECKPOINT_INTERVAL;
+    chunk->checkpoints = n > 0 ? malloc(n * sizeof(CompressedCheckpoint)) : NULL;
+    Compressed_Iterator iter = { .chunk = chunk };
+    Compressed_ChunkIteratorSeek(&iter, -1);
+    timestamp_t timestamps[COMPRESSED_CHECKPOINT_INTERVAL];
+    double values[COMPRESSED_CHECKPOINT_INTERVAL];
+    u_int64_t decoded;
+    while ((decoded = Compressed_ChunkIteratorGetNextBlock(
+                &iter, timestamps, values, COMPRESSED_CHECKPOINT_INTERVAL)) > 0) {
+        for (u_int64_t i = 0; i < decoded; ++i) {
+            ChunkStats_Append(&chunk->stats, timestamps[i], values[i]);
+        }
+        if (iter.count == chunk->count) {
+            // a run which ends the chunk can be extended
+            chunk->runIdx = iter.runIdx;
+            chunk->runLength = iter.runLength;
+            break;
+        }
+        chunk->checkpoints[chunk->checkpointsCount++] = (CompressedCheckpoint){
+            .idx = iter.idx,
+            .prevTimestamp = iter.prevTS,
+            .prevTimestampDelta = iter.prevDelta,
+            .prevValue = iter.prevValue,
+            .prevDecimal = iter.prevDecimal,
+            .prevDecimalDelta = iter.prevDecimalDelta,
+            .runIdx = iter.runIdx,
+            .runLength = iter.runLength,
+            .count = iter.count,
+            .prevLeading = iter.leading,
+            .prevTrailing = iter.trailing,
+        };
+    }
+}
+
+// Summarize the first `count` samples of the chunk
+static void rebuildStats(CompressedChunk *chunk, u_int64_t count) {
+    ChunkStats_Reset(&chunk->stats);
+    Compressed_Iterator iter = { .chunk = chunk };
+    Compressed_ChunkIteratorSeek(&iter, -1);
+    timestamp_t timestamps[COMPRESSED_CHECKPOINT_INTERVAL];
+    double values[COMPRESSED_CHECKPOINT_INTERVAL];
+    while (iter.count < count) {
+        u_int64_t decoded = Compressed_ChunkIteratorGetNextBlock(
+            &iter, timestamps, values, min(count - iter.count, COMPRESSED_CHECKPOINT_INTERVAL));
+        for (u_int64_t i = 0; i < decoded; ++i) {
+            ChunkStats_Append(&chunk->stats, timestamps[i], values[i]);
+        }
+    }
+}
+
+void Compressed_Truncate(CompressedChunk *chunk, const Compressed_Iterator *iter) {
+#ifdef DEBUG
+    assert(iter->chunk == chunk);
+    assert(iter->idx <= chunk->idx);
+#endif
+    // the kept samples are summarized before the bitstream which follows them is dropped
+    rebuildStats(chunk, iter->count);
+    zero_bits(chunk->data, chunk->size, iter->idx, chunk->idx);
+    chunk->idx = iter->idx;
+    chunk->count = iter->count;
+    chunk->prevTimestamp = iter->prevTS;
+    chunk->prevTimestampDelta = iter->prevDelta;
+    chunk->runIdx = iter->runIdx;
+    chunk->runLength = iter->runLength;
+    chunk->zeroCount = 0;
+    if (iter->runIdx != 0) {
+        // the run ends at the truncation point
+        writeBits(chunk->data, iter->runIdx, iter->runLength, TIMESTAMP_RUN_BITS);
+    }
+    chunk->prevValue = iter->prevValue;
+    chunk->prevLeading = iter->leading;
+    chunk->prevTrailing = iter->trailing;
+    chunk->decimalCount = min(chunk->decimalCount, iter->count);
+    chunk->prevDecimal = iter->prevDecimal;
+    chunk->prevDecimalDelta = iter->prevDecimalDelta;
+
+    // a checkpoint at the truncation point is recorded again by the next append
+    while (chunk->checkpointsCount > 0 &&
+           chunk->checkpoints[chunk->checkpointsCount - 1].count >= iter->count) {
+        chunk->checkpointsCount--;
+    }
+}
+
+// Pick the scale of the chunk from its first value, the scale never decreases
+static void startDecimal(CompressedChunk *chunk, double value) {
+    int64_t n;
+    chunk->decimalCount = 0;
+    for (u_int8_t scale = chunk->scale; scale <= DECIMAL_MAX_SCALE; ++scale) {
+        if (toDecimal(value, scale, &n)) {
+            chunk->scale = scale;
+            chunk->decimalCount = 1;
+            chunk->prevDecimal = n;
+            chunk->prevDecimalDelta = 0;
+            return;
+        }
+    }
+}
+
+static ChunkResult appendSample(CompressedChunk *chunk,
+                                timestamp_t timestamp,
+                                double value,
+                                bool rescale);
+
+/*
+ * Re-encode a chunk holding only decimals with the smallest scale larger than the current one
+ * which represents `value`. The chunk is left untouched if there is no such scale, if the
+ * re-encoded samples don't fit in the chunk or if they aren't all decimals anymore.
+ */
+static bool rescaleDecimal(CompressedChunk *chunk, double value) {
+    int64_t n;
+    u_int8_t scale = chunk->scale + 1;
+    while (scale <= DECIMAL_MAX_SCALE && !toDecimal(value, scale, &n)) {
+        scale++;
+    }
+    if (scale > DECIMAL_MAX_SCALE) {
+        return false;
+    }
+
+    const u_int64_t count = chunk->count;
+    timestamp_t *timestamps = malloc(count * sizeof(timestamp_t));
+    double *values = malloc(count * sizeof(double));
+    Compressed_Iterator iter = { .chunk = chunk };
+    Compressed_ChunkIteratorSeek(&iter, -1);
+    Compressed_ChunkIteratorGetNextBlock(&iter, timestamps, values, count);
+
+    CompressedChunk saved = *chunk;
+    u_int64_t *data = malloc(chunk->size);
+    memcpy(data, chunk->data, chunk->size);
+
+    Compressed_ChunkIteratorSeek(&iter, -1);
+    Compressed_Truncate(chunk, &iter);
+    chunk->scale = scale;
+    bool ok = true;
+    for (u_int64_t i = 0; ok && i < count; ++i) {
+        ok = appendSample(chunk, timestamps[i], values[i], false) == CR_OK;
+    }
+    ok = ok && chunk->decimalCount == count;
+
+    if (!ok) {
+        CompressedCheckpoint *checkpoints = chunk->checkpoints;
+        u_int64_t *newData = chunk->data;
+        *chunk = saved;
+        chunk->checkpoints = checkpoints;
+        memcpy(newData, data, chunk->size);
+        chunk->data = newData;
+        Compressed_RebuildMetadata(chunk);
+    }
+    free(data);
+    free(timestamps);
+    free(values);
+    return ok;
+}
+
+static ChunkResult appendSample(CompressedChunk *chunk,
+                                timestamp_t timestamp,
+                                double value,
+                                bool rescale) {
 #ifdef DEBUG
     assert(chunk);
 #endif
@@ -414,51 +777,119 @@ ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, dou
         chunk->baseValue.d = chunk->prevValue.d = value;
         chunk->baseTimestamp = chunk->prevTimestamp = timestamp;
         chunk->prevTimestampDelta = 0;
+        if (chunk->codec == VALUE_CODEC_DECIMAL) {
+            startDecimal(chunk, value);
+        }
     } else {
+        // only a chunk with the decimal codec may hold decimals
+        int64_t n = 0;
+        bool decimal = chunk->decimalCount == chunk->count &&
+                       (toDecimal(value, chunk->scale, &n) ||
+                        (rescale && rescaleDecimal(chunk, value) &&
+                         toDecimal(value, chunk->scale, &n)));
+
         u_int64_t idx = chunk->idx;
         u_int64_t prevTimestamp = chunk->prevTimestamp;
         int64_t prevTimestampDelta = chunk->prevTimestampDelta;
-        if (appendInteger(chunk, timestamp) != CR_OK || appendFloat(chunk, value) != CR_OK) {
+        u_int64_t runIdx = chunk->runIdx;
+        u_int32_t runLength = chunk->runLength;
+        u_int32_t zeroCount = chunk->zeroCount;
+        bool checkpoint = chunk->count % COMPRESSED_CHECKPOINT_INTERVAL == 0;
+        if (unlikely(checkpoint)) {
+            appendCheckpoint(chunk);
+        }
+        if (appendInteger(chunk, timestamp) != CR_OK ||
+            (decimal ? appendDecimal(chunk, n, value) : appendFloat(chunk, value)) != CR_OK) {
             zero_bits(chunk->data, chunk->size, idx, chunk->idx);
             chunk->idx = idx;
             chunk->prevTimestamp = prevTimestamp;
             chunk->prevTimestampDelta = prevTimestampDelta;
+            if (runIdx != 0) {
+                writeBits(chunk->data, runIdx, runLength, TIMESTAMP_RUN_BITS);
+            }
+            chunk->runIdx = runIdx;
+            chunk->runLength = runLength;
+            chunk->zeroCount = zeroCount;
+            if (unlikely(checkpoint)) {
+                chunk->checkpointsCount--;
+            }
             return CR_END;
         }
+        if (decimal) {
+            chunk->decimalCount++;
+        }
     }
     chunk->count++;
+    ChunkStats_Append(&chunk->stats, timestamp, value);
     return CR_OK;
 }
 
+ChunkResult Compressed_Append(CompressedChunk *chunk, timestamp_t timestamp, double value) {
+    return appendSample(chunk, timestamp, value, true);
+}
+
 /********************************** READ *********************************/
 /*
- * This function decodes timestamps inserted by appendInteger.
+ * This function decodes a non zero doubleDelta inserted by appendDoubleDelta,
+ * the first control bit ('1') was already consumed.
  *
  * It checks for an OFF bit to decode the doubleDelta with the right size,
- * then decodes the value back to an int64 and calculate the original value
- * using `prevTS` and `prevDelta`.
+ * then decodes the value back to an int64.
  */
-static inline u_int64_t readInteger(Compressed_Iterator *iter, const uint64_t *bins) {
-    if (Bins_bitoff(bins, iter->idx++)) {
-        iter->prevDelta += bin2int(readBits(bins, iter->idx, CMPR_L1), CMPR_L1);
-        iter->idx += CMPR_L1;
-    } else if (Bins_bitoff(bins, iter->idx++)) {
-        iter->prevDelta += bin2int(readBits(bins, iter->idx, CMPR_L2), CMPR_L2);
-        iter->idx += CMPR_L2;
-    } else if (Bins_bitoff(bins, iter->idx++)) {
-        iter->prevDelta += bin2int(readBits(bins, iter->idx, CMPR_L3), CMPR_L3);
-        iter->idx += CMPR_L3;
-    } else if (Bins_bitoff(bins, iter->idx++)) {
-        iter->prevDelta += bin2int(readBits(bins, iter->idx, CMPR_L4), CMPR_L4);
-        iter->idx += CMPR_L4;
-    } else if (Bins_bitoff(bins, iter->idx++)) {
-        iter->prevDelta += bin2int(readBits(bins, iter->idx, CMPR_L5), CMPR_L5);
-        iter->idx += CMPR_L5;
+static inline int64_t readDoubleDelta(globalbit_t *idx, const uint64_t *bins) {
+    int64_t doubleDelta;
+    if (Bins_bitoff(bins, (*idx)++)) {
+        doubleDelta = bin2int(readBits(bins, *idx, CMPR_L1), CMPR_L1);
+        *idx += CMPR_L1;
+    } else if (Bins_bitoff(bins, (*idx)++)) {
+        doubleDelta = bin2int(readBits(bins, *idx, CMPR_L2), CMPR_L2);
+        *idx += CMPR_L2;
+    } else if (Bins_bitoff(bins, (*idx)++)) {
+        doubleDelta = bin2int(readBits(bins, *idx, CMPR_L3), CMPR_L3);
+        *idx += CMPR_L3;
+    } else if (Bins_bitoff(bins, (*idx)++)) {
+        doubleDelta = bin2int(readBits(bins, *idx, CMPR_L4), CMPR_L4);
+        *idx += CMPR_L4;
+    } else if (Bins_bitoff(bins, (*idx)++)) {
+        doubleDelta = bin2int(readBits(bins, *idx, CMPR_L5), CMPR_L5);
+        *idx += CMPR_L5;
     } else {
-        iter->prevDelta += readBits(bins, iter->idx, 64);
-        iter->idx += 64;
+        doubleDelta = readBits(bins, *idx, 64);
+        *idx += 64;
     }
-    return iter->prevDelta;
+    return doubleDelta;
+}
+
+/*
+ * This function decodes timestamps inserted by appendInteger and calculates the
+ * original delta using `prevDelta`. A run token starts a run of samples whose
+ * timestamps aren't encoded.
+ */
+static inline u_int64_t readInteger(Compressed_Iterator *iter, const uint64_t *bins) {
+    if (Bins_bitoff(bins, iter->idx) && readBits(bins, iter->idx + 1, CMPR_L1) == 0) {
+        // run token, the first control bit was already consumed
+        iter->idx += RUN_TOKEN_BITS - 1;
+        iter->runIdx = iter->idx;
+        iter->runTotal = readBits(bins, iter->idx, TIMESTAMP_RUN_BITS);
+        iter->runLength = 1;
+        iter->idx += TIMESTAMP_RUN_BITS;
+        return iter->prevDelta;
+    }
+    iter->runIdx = 0;
+    iter->runLength = iter->runTotal = 0;
+    return iter->prevDelta += readDoubleDelta(&iter->idx, bins);
+}
+
+/*
+ * This function decodes values inserted by appendDecimal, using `prevDecimal` and
+ * `prevDecimalDelta`.
+ */
+static inline double readDecimal(Compressed_Iterator *iter, const uint64_t *bins) {
+    if (!Bins_bitoff(bins, iter->idx++)) {
+        iter->prevDecimalDelta += readDoubleDelta(&iter->idx, bins);
+    }
+    iter->prevDecimal += iter->prevDecimalDelta;
+    return iter->prevValue.d = fromDecimal(iter->prevDecimal, iter->chunk->scale);
 }
 
 /*
@@ -507,6 +938,212 @@ static inline double readFloat(Compressed_Iterator *iter, const uint64_t *data)
     return iter->prevValue.d = rv.d;
 }
 
+/*
+ * Block decoding.
+ *
+ * Compressed_ChunkIteratorGetNextBlock decodes a run of samples in one call instead of one sample
+ * per call. The reader state (bit position, previous timestamp/delta/value and the XOR block
+ * parameters) is kept in locals for the whole block and written back to the iterator once.
+ *
+ * Control bits are read from a 64 bit window taken at the current position. A DoD which is not
+ * zero starts with a '1' bit, the 5 bits that follow it are enough to know the bucket, so a
+ * single lookup in `dodControl` gives both the number of prefix bits and the payload length
+ * instead of testing the prefix bit by bit as readInteger does.
+ */
+typedef struct DoDControl
+{
+    u_int8_t prefix;  // number of control bits, including the leading '1'
+    u_int8_t payload; // number of bits of the encoded DoD
+} DoDControl;
+
+#define DOD_L1 { 2, CMPR_L1 }
+#define DOD_L2 { 3, CMPR_L2 }
+#define DOD_L3 { 4, CMPR_L3 }
+#define DOD_L4 { 5, CMPR_L4 }
+#define DOD_L5 { 6, CMPR_L5 }
+#define DOD_L6 { 6, BINW }
+
+// Indexed by the 5 bits which follow the first control bit ('1').
+// The bucket is determined by the number of consecutive '1's (LSB first).
+static const DoDControl dodControl[32] = {
+    DOD_L1, DOD_L2, DOD_L1, DOD_L3, DOD_L1, DOD_L2, DOD_L1, DOD_L4,
+    DOD_L1, DOD_L2, DOD_L1, DOD_L3, DOD_L1, DOD_L2, DOD_L1, DOD_L5,
+    DOD_L1, DOD_L2, DOD_L1, DOD_L3, DOD_L1, DOD_L2, DOD_L1, DOD_L4,
+    DOD_L1, DOD_L2, DOD_L1, DOD_L3, DOD_L1, DOD_L2, DOD_L1, DOD_L6,
+};
+
+// Read the 64 bits starting at position `bit`. Bits beyond the end of `bins` are read as 0.
+static inline binary_t peekBits(const binary_t *bins, globalbit_t bit, u_int64_t nbins) {
+    const u_int64_t i = bit / BINW;
+    const localbit_t lbit = localbit(bit);
+    binary_t window = bins[i] >> lbit;
+    if (lbit && i + 1 < nbins) {
+        window |= bins[i + 1] << (BINW - lbit);
+    }
+    return window;
+}
+
+/*
+ * Decode the DoubleDelta at `*idx`, `*window` holds the bits starting at `*idx`.
+ * Both are advanced past it, `*window` then holds at least 63 valid bits.
+ */
+static inline int64_t peekDoubleDelta(const binary_t *bins,
+                                      u_int64_t nbins,
+                                      globalbit_t *idx,
+                                      binary_t *window) {
+    // control bit '0' means the delta didn't change
+    if (!(*window & 1)) {
+        (*idx)++;
+        *window >>= 1;
+        return 0;
+    }
+    int64_t doubleDelta;
+    const DoDControl ctrl = dodControl[LSB(*window >> 1, 5)];
+    if (likely(ctrl.payload != BINW)) {
+        doubleDelta = bin2int(LSB(*window >> ctrl.prefix, ctrl.payload), ctrl.payload);
+    } else {
+        doubleDelta = readBits(bins, *idx + ctrl.prefix, BINW);
+    }
+    *idx += ctrl.prefix + ctrl.payload;
+    *window = peekBits(bins, *idx, nbins);
+    return doubleDelta;
+}
+
+typedef struct TimestampRun
+{
+    u_int64_t idx;
+    u_int32_t length;
+    u_int32_t total;
+} TimestampRun;
+
+/*
+ * Decode the timestamp delta at `*idx`, same as peekDoubleDelta.
+ * Within a run the delta didn't change and nothing is read.
+ */
+static inline int64_t peekTimestampDelta(const binary_t *bins,
+                                         u_int64_t nbins,
+                                         globalbit_t *idx,
+                                         binary_t *window,
+                                         TimestampRun *run,
+                                         int64_t prevDelta) {
+    if (run->length < run->total) {
+        run->length++;
+        return prevDelta;
+    }
+    if (LSB(*window, RUN_TOKEN_BITS) == RUN_TOKEN) {
+        run->idx = *idx + RUN_TOKEN_BITS;
+        run->total = LSB(*window >> RUN_TOKEN_BITS, TIMESTAMP_RUN_BITS);
+        run->length = 1;
+        *idx += RUN_TOKEN_BITS + TIMESTAMP_RUN_BITS;
+        *window >>= RUN_TOKEN_BITS + TIMESTAMP_RUN_BITS;
+        return prevDelta;
+    }
+    // a run is always followed by a run token or a delta of deltas which isn't 0
+    run->idx = 0;
+    run->length = run->total = 0;
+    return prevDelta + peekDoubleDelta(bins, nbins, idx, window);
+}
+
+u_int64_t Compressed_ChunkIteratorGetNextBlock(ChunkIter_t *abstractIter,
+                                               timestamp_t *timestamps,
+                                               double *values,
+                                               u_int64_t max) {
+    Compressed_Iterator *iter = (Compressed_Iterator *)abstractIter;
+#ifdef DEBUG
+    assert(iter);
+    assert(iter->chunk);
+#endif
+    const CompressedChunk *chunk = iter->chunk;
+    const u_int64_t n = min(max, chunk->count - iter->count);
+    u_int64_t i = 0;
+    if (unlikely(n == 0)) {
+        return 0;
+    }
+    // First sample
+    if (unlikely(iter->count == 0)) {
+        timestamps[0] = chunk->baseTimestamp;
+        values[0] = chunk->baseValue.d;
+        i = 1;
+    }
+
+    const binary_t *bins = chunk->data;
+    const u_int64_t nbins = chunk->size / sizeof(binary_t);
+    globalbit_t idx = iter->idx;
+    timestamp_t prevTS = iter->prevTS;
+    int64_t prevDelta = iter->prevDelta;
+    TimestampRun run = { .idx = iter->runIdx, .length = iter->runLength, .total = iter->runTotal };
+    union64bits prevValue = iter->prevValue;
+    u_int8_t leading = iter->leading;
+    u_int8_t trailing = iter->trailing;
+    u_int8_t blocksize = iter->blocksize;
+
+    // decimals are always a prefix of the chunk
+    if (chunk->decimalCount > iter->count) {
+        const u_int64_t decimals = min(n, chunk->decimalCount - iter->count);
+        const u_int8_t scale = chunk->scale;
+        int64_t prevDecimal = iter->prevDecimal;
+        int64_t prevDecimalDelta = iter->prevDecimalDelta;
+        for (; i < decimals; ++i) {
+            binary_t window = peekBits(bins, idx, nbins);
+            prevDelta = peekTimestampDelta(bins, nbins, &idx, &window, &run, prevDelta);
+            prevTS += prevDelta;
+            timestamps[i] = prevTS;
+            prevDecimalDelta += peekDoubleDelta(bins, nbins, &idx, &window);
+            prevDecimal += prevDecimalDelta;
+            values[i] = fromDecimal(prevDecimal, scale);
+        }
+        prevValue.d = values[i - 1];
+        iter->prevDecimal = prevDecimal;
+        iter->prevDecimalDelta = prevDecimalDelta;
+    }
+
+    for (; i < n; ++i) {
+        binary_t window = peekBits(bins, idx, nbins);
+
+        // timestamp
+        prevDelta = peekTimestampDelta(bins, nbins, &idx, &window, &run, prevDelta);
+        prevTS += prevDelta;
+        timestamps[i] = prevTS;
+
+        // value, control bit '0' means the value didn't change
+        if (window & 1) {
+            if (!(window & 2)) {
+                // '10' use the previous block information
+                prevValue.u ^= readBits(bins, idx + 2, blocksize) << trailing;
+                idx += 2 + blocksize;
+            } else {
+                // '11' leading zeros and block size follow
+                leading = LSB(window >> 2, DOUBLE_LEADING);
+                blocksize = LSB(window >> (2 + DOUBLE_LEADING), DOUBLE_BLOCK_SIZE) +
+                            DOUBLE_BLOCK_ADJUST;
+#ifdef DEBUG
+                assert(leading + blocksize <= BINW);
+#endif
+                trailing = BINW - leading - blocksize;
+                idx += 2 + DOUBLE_LEADING + DOUBLE_BLOCK_SIZE;
+                prevValue.u ^= readBits(bins, idx, blocksize) << trailing;
+                idx += blocksize;
+            }
+        } else {
+            idx++;
+        }
+        values[i] = prevValue.d;
+    }
+
+    iter->idx = idx;
+    iter->prevTS = prevTS;
+    iter->prevDelta = prevDelta;
+    iter->runIdx = run.idx;
+    iter->runLength = run.length;
+    iter->runTotal = run.total;
+    iter->prevValue = prevValue;
+    iter->leading = leading;
+    iter->trailing = trailing;
+    iter->blocksize = blocksize;
+    iter->count += n;
+    return n;
+}
+
 ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *abstractIter, Sample *sample) {
     Compressed_Iterator *iter = (Compressed_Iterator *)abstractIter;
 #ifdef DEBUG
@@ -528,8 +1165,19 @@ ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *abstractIter, Sample *s
     //
     // control bit ‘0’
     // Read stored double delta value
-    sample->timestamp = iter->prevTS +=
-        Bins_bitoff(bins, iter->idx++) ? iter->prevDelta : readInteger(iter, bins);
+    if (iter->runLength < iter->runTotal) {
+        // within a run the timestamp isn't encoded
+        iter->runLength++;
+        sample->timestamp = iter->prevTS += iter->prevDelta;
+    } else {
+        sample->timestamp = iter->prevTS +=
+            Bins_bitoff(bins, iter->idx++) ? iter->prevDelta : readInteger(iter, bins);
+    }
+    if (iter->count < iter->chunk->decimalCount) {
+        sample->value = readDecimal(iter, bins);
+        iter->count++;
+        return CR_OK;
+    }
     // Check if value was changed
     // control bit ‘0’ (case a)
     sample->value = Bins_bitoff(bins, iter->idx++) ? iter->prevValue.d : readFloat(iter, bins);
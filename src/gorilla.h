@@ -25,6 +25,40 @@ typedef union
     u_int64_t u;
 } union64bits;
 
+// Value codecs, the timestamps are always encoded as delta of deltas
+typedef enum CompressedValueCodec
+{
+    VALUE_CODEC_GORILLA = 0, // XOR of consecutive doubles
+    // Delta of deltas of the values scaled to integers by 10^scale, XOR from the first value which
+    // can't be scaled to the chunk scale
+    VALUE_CODEC_DECIMAL = 1,
+} CompressedValueCodec;
+
+#define DECIMAL_MAX_SCALE 9
+
+// Number of bits of the sample counter of a run of timestamps with a zero delta of deltas
+#define TIMESTAMP_RUN_BITS 10
+#define TIMESTAMP_RUN_MAX ((1 << TIMESTAMP_RUN_BITS) - 1)
+
+// A checkpoint is recorded every COMPRESSED_CHECKPOINT_INTERVAL samples
+#define COMPRESSED_CHECKPOINT_INTERVAL 256
+
+// Decoder state right before the sample at position `count`, which starts at bit `idx`
+typedef struct CompressedCheckpoint
+{
+    u_int64_t idx;
+    u_int64_t prevTimestamp;
+    int64_t prevTimestampDelta;
+    union64bits prevValue;
+    int64_t prevDecimal;
+    int64_t prevDecimalDelta;
+    u_int64_t runIdx;
+    u_int32_t runLength;
+    u_int32_t count;
+    u_int8_t prevLeading;
+    u_int8_t prevTrailing;
+} CompressedCheckpoint;
+
 typedef struct CompressedChunk
 {
     u_int64_t size;
@@ -38,10 +72,28 @@ typedef struct CompressedChunk
 
     u_int64_t prevTimestamp;
     int64_t prevTimestampDelta;
+    // open run of timestamps: bit position of its counter (0 if none) and number of samples,
+    // not persisted, rebuilt on load
+    u_int64_t runIdx;
+    u_int32_t runLength;
+    // number of trailing zero delta of deltas encoded without a run
+    u_int32_t zeroCount;
 
     union64bits prevValue;
     u_int8_t prevLeading;
     u_int8_t prevTrailing;
+
+    // VALUE_CODEC_DECIMAL: the first `decimalCount` values are stored as value * 10^scale
+    u_int8_t codec;
+    u_int8_t scale;
+    u_int64_t decimalCount;
+    int64_t prevDecimal;
+    int64_t prevDecimalDelta;
+
+    // checkpoint table and stats, not persisted, rebuilt on load
+    CompressedCheckpoint *checkpoints;
+    u_int32_t checkpointsCount;
+    ChunkStats stats;
 } CompressedChunk;
 
 typedef struct Compressed_Iterator
@@ -53,15 +105,36 @@ typedef struct Compressed_Iterator
     // timestamp vars
     u_int64_t prevTS;
     int64_t prevDelta;
+    u_int64_t runIdx;
+    u_int32_t runLength;
+    u_int32_t runTotal;
 
     // value vars
     union64bits prevValue;
     u_int8_t leading;
     u_int8_t trailing;
     u_int8_t blocksize;
+    int64_t prevDecimal;
+    int64_t prevDecimalDelta;
 } Compressed_Iterator;
 
 ChunkResult Compressed_Append(CompressedChunk *chunk, u_int64_t timestamp, double value);
+
+// Checkpoints
+// Rebuild the checkpoint table and the stats in a single pass over the chunk
+void Compressed_RebuildMetadata(CompressedChunk *chunk);
+// Returns the index of the last checkpoint preceding `timestamp`, -1 if there is none
+int64_t Compressed_FindCheckpoint(const CompressedChunk *chunk, timestamp_t timestamp);
+// Position the iterator at checkpoint `checkpoint`, -1 resets the iterator
+void Compressed_ChunkIteratorSeek(Compressed_Iterator *iter, int64_t checkpoint);
+// Drop the samples from the iterator's position onward, the encoder resumes from that state.
+// The stats are recomputed over the kept samples.
+void Compressed_Truncate(CompressedChunk *chunk, const Compressed_Iterator *iter);
 ChunkResult Compressed_ChunkIteratorGetNext(ChunkIter_t *iter, Sample *sample);
+// Decode up to `max` samples into `timestamps` and `values`, returns the number of decoded samples
+u_int64_t Compressed_ChunkIteratorGetNextBlock(ChunkIter_t *iter,
+                                               timestamp_t *timestamps,
+                                               double *values,
+                                               u_int64_t max);
 
 #endif
@@ -0,0 +1,334 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#include "hybrid_chunk.h"
+
+#include "chunk.h"
+#include "chunk_pool.h"
+#include "compressed_chunk.h"
+#include "load_io_error_macros.h"
+
+#include "rmutil/alloc.h"
+
+// interval of the sealing timer and maximal number of chunks sealed by a single tick
+#define HYBRID_SEAL_INTERVAL_MS 100
+#define HYBRID_SEAL_BATCH 256
+
+typedef enum HybridState
+{
+    HYBRID_HEAD = 0, // written to, uncompressed
+    HYBRID_PENDING,  // full, queued for sealing
+    HYBRID_SEALED,   // done, compressed unless the compressed encoding didn't fit
+} HybridState;
+
+typedef struct HybridChunk
+{
+    Chunk_t *chunk;
+    bool compressed;
+    u_int8_t state;
+    // queue of the pending chunks
+    struct HybridChunk *prev;
+    struct HybridChunk *next;
+} HybridChunk;
+
+static HybridChunk *pendingHead = NULL;
+static HybridChunk *pendingTail = NULL;
+static size_t pendingCount = 0;
+
+static inline const ChunkFuncs *innerFuncs(const HybridChunk *chunk) {
+    return GetChunkClass(chunk->compressed ? CHUNK_COMPRESSED : CHUNK_REGULAR);
+}
+
+static HybridChunk *wrapChunk(Chunk_t *inner, bool compressed, HybridState state) {
+    HybridChunk *chunk = (HybridChunk *)ChunkPool_Calloc(sizeof(HybridChunk));
+    chunk->chunk = inner;
+    chunk->compressed = compressed;
+    chunk->state = state;
+    return chunk;
+}
+
+static void enqueue(HybridChunk *chunk) {
+    chunk->state = HYBRID_PENDING;
+    chunk->next = NULL;
+    chunk->prev = pendingTail;
+    if (pendingTail) {
+        pendingTail->next = chunk;
+    } else {
+        pendingHead = chunk;
+    }
+    pendingTail = chunk;
+    pendingCount++;
+}
+
+static void dequeue(HybridChunk *chunk) {
+    if (chunk->prev) {
+        chunk->prev->next = chunk->next;
+    } else {
+        pendingHead = chunk->next;
+    }
+    if (chunk->next) {
+        chunk->next->prev = chunk->prev;
+    } else {
+        pendingTail = chunk->prev;
+    }
+    chunk->prev = chunk->next = NULL;
+    pendingCount--;
+}
+
+// Re-encode an uncompressed chunk as a compressed chunk. The chunk stays uncompressed if the
+// compressed encoding is larger than the samples.
+static void sealChunk(HybridChunk *chunk) {
+    if (chunk->state == HYBRID_PENDING) {
+        dequeue(chunk);
+    }
+    chunk->state = HYBRID_SEALED;
+    if (chunk->compressed) {
+        return;
+    }
+
+    Chunk *regChunk = chunk->chunk;
+    size_t size = regChunk->num_samples * SAMPLE_SIZE;
+    size += sizeof(binary_t) - (size % sizeof(binary_t));
+    CompressedChunk *cmpChunk = Compressed_NewChunk(size);
+    for (size_t i = 0; i < regChunk->num_samples; ++i) {
+        Sample sample = { .timestamp = regChunk->timestamps[i], .value = regChunk->values[i] };
+        if (Compressed_AddSample(cmpChunk, &sample) != CR_OK) {
+            Compressed_FreeChunk(cmpChunk);
+            return;
+        }
+    }
+    Compressed_TrimChunk(cmpChunk);
+
+    Uncompressed_FreeChunk(regChunk);
+    chunk->chunk = cmpChunk;
+    chunk->compressed = true;
+}
+
+size_t Hybrid_SealPending(size_t maxChunks) {
+    for (size_t i = 0; i < maxChunks && pendingHead != NULL; ++i) {
+        sealChunk(pendingHead);
+    }
+    return pendingCount;
+}
+
+void Hybrid_SealChunk(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    if (hybridChunk->state == HYBRID_PENDING) {
+        sealChunk(hybridChunk);
+    }
+}
+
+static void sealTimerCallback(RedisModuleCtx *ctx, void *data) {
+    Hybrid_SealPending(HYBRID_SEAL_BATCH);
+    RedisModule_CreateTimer(ctx, HYBRID_SEAL_INTERVAL_MS, sealTimerCallback, NULL);
+}
+
+void Hybrid_StartSealTimer(RedisModuleCtx *ctx) {
+    RedisModule_CreateTimer(ctx, HYBRID_SEAL_INTERVAL_MS, sealTimerCallback, NULL);
+}
+
+bool Hybrid_IsSealed(const Chunk_t *chunk) {
+    return ((const HybridChunk *)chunk)->state == HYBRID_SEALED;
+}
+
+/*********************
+ *  Chunk functions  *
+ *********************/
+Chunk_t *Hybrid_NewChunk(size_t size) {
+    return wrapChunk(Uncompressed_NewChunk(size), false, HYBRID_HEAD);
+}
+
+void Hybrid_FreeChunk(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    if (hybridChunk->state == HYBRID_PENDING) {
+        dequeue(hybridChunk);
+    }
+    innerFuncs(hybridChunk)->FreeChunk(hybridChunk->chunk);
+    ChunkPool_Free(hybridChunk, sizeof(HybridChunk));
+}
+
+Chunk_t *Hybrid_CloneChunk(const Chunk_t *chunk) {
+    const HybridChunk *src = chunk;
+    // clones may be released by LibMR threads, they are never queued
+    HybridState state = src->state == HYBRID_PENDING ? HYBRID_SEALED : src->state;
+    HybridChunk *dst = wrapChunk(innerFuncs(src)->CloneChunk(src->chunk), src->compressed, state);
+    if (src->state == HYBRID_PENDING) {
+        sealChunk(dst);
+    }
+    return dst;
+}
+
+Chunk_t *Hybrid_SplitChunk(Chunk_t *chunk) {
+    HybridChunk *curChunk = chunk;
+    Chunk_t *inner = innerFuncs(curChunk)->SplitChunk(curChunk->chunk);
+    if (inner == NULL) {
+        return NULL;
+    }
+    HybridChunk *newChunk = wrapChunk(inner, curChunk->compressed, curChunk->state);
+    if (newChunk->state == HYBRID_PENDING) {
+        enqueue(newChunk);
+    } else if (curChunk->state == HYBRID_HEAD) {
+        // the second half becomes the head, the first half won't be written to anymore
+        enqueue(curChunk);
+    }
+    return newChunk;
+}
+
+Chunk_t *Hybrid_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize) {
+    const HybridChunk *first = chunk, *second = next;
+    // a pending chunk is merged once it is sealed
+    if (first->compressed != second->compressed) {
+        return NULL;
+    }
+    Chunk_t *inner = innerFuncs(first)->MergeChunk(first->chunk, second->chunk, maxSize);
+    if (inner == NULL) {
+        return NULL;
+    }
+    HybridChunk *merged = wrapChunk(inner, first->compressed, HYBRID_SEALED);
+    if (!merged->compressed && (first->state != HYBRID_SEALED || second->state != HYBRID_SEALED)) {
+        enqueue(merged);
+    }
+    return merged;
+}
+
+ChunkResult Hybrid_AddSample(Chunk_t *chunk, Sample *sample) {
+    HybridChunk *hybridChunk = chunk;
+    ChunkResult res = innerFuncs(hybridChunk)->AddSample(hybridChunk->chunk, sample);
+    if (res == CR_END && hybridChunk->state == HYBRID_HEAD) {
+        enqueue(hybridChunk);
+    }
+    return res;
+}
+
+ChunkResult Hybrid_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy) {
+    HybridChunk *hybridChunk = uCtx->inChunk;
+    UpsertCtx innerCtx = { .sample = uCtx->sample, .inChunk = hybridChunk->chunk };
+    ChunkResult res = innerFuncs(hybridChunk)->UpsertSample(&innerCtx, size, duplicatePolicy);
+    uCtx->sample = innerCtx.sample;
+    uCtx->replaced = innerCtx.replaced;
+    uCtx->oldValue = innerCtx.oldValue;
+    return res;
+}
+
+size_t Hybrid_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs) {
+    HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->DelRange(hybridChunk->chunk, startTs, endTs);
+}
+
+void Hybrid_ProcessChunk(const Chunk_t *chunk,
+                         uint64_t start,
+                         uint64_t end,
+                         EnrichedChunk *enrichedChunk,
+                         bool reverse) {
+    const HybridChunk *hybridChunk = chunk;
+    innerFuncs(hybridChunk)->ProcessChunk(hybridChunk->chunk, start, end, enrichedChunk, reverse);
+}
+
+size_t Hybrid_GetChunkSize(Chunk_t *chunk, bool includeStruct) {
+    HybridChunk *hybridChunk = chunk;
+    size_t size = innerFuncs(hybridChunk)->GetChunkSize(hybridChunk->chunk, includeStruct);
+    return size + (includeStruct ? sizeof(HybridChunk) : 0);
+}
+
+u_int64_t Hybrid_NumOfSample(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->GetNumOfSample(hybridChunk->chunk);
+}
+
+timestamp_t Hybrid_GetFirstTimestamp(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->GetFirstTimestamp(hybridChunk->chunk);
+}
+
+timestamp_t Hybrid_GetLastTimestamp(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->GetLastTimestamp(hybridChunk->chunk);
+}
+
+double Hybrid_GetLastValue(Chunk_t *chunk) {
+    HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->GetLastValue(hybridChunk->chunk);
+}
+
+const ChunkStats *Hybrid_GetStats(const Chunk_t *chunk) {
+    const HybridChunk *hybridChunk = chunk;
+    return innerFuncs(hybridChunk)->GetStats(hybridChunk->chunk);
+}
+
+/*********************
+ *  Serialization    *
+ *********************/
+void Hybrid_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io) {
+    HybridChunk *hybridChunk = chunk;
+    RedisModule_SaveUnsigned(io, hybridChunk->state);
+    RedisModule_SaveUnsigned(io, hybridChunk->compressed);
+    innerFuncs(hybridChunk)->SaveToRDB(hybridChunk->chunk, io);
+}
+
+int Hybrid_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io) {
+    HybridState state = LoadUnsigned_IOError(io, goto err);
+    bool compressed = LoadUnsigned_IOError(io, goto err);
+    Chunk_t *inner = NULL;
+    const ChunkFuncs *funcs = GetChunkClass(compressed ? CHUNK_COMPRESSED : CHUNK_REGULAR);
+    if (funcs->LoadFromRDB(&inner, io) != TSDB_OK) {
+        goto err;
+    }
+    HybridChunk *hybridChunk = wrapChunk(inner, compressed, HYBRID_SEALED);
+    if (state == HYBRID_PENDING) {
+        enqueue(hybridChunk);
+    } else {
+        hybridChunk->state = state;
+    }
+    *chunk = hybridChunk;
+    return TSDB_OK;
+
+err:
+    *chunk = NULL;
+    return TSDB_ERROR;
+}
+
+void Hybrid_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx) {
+    HybridChunk *hybridChunk = chunk;
+    MR_SerializationCtxWriteLongLongWrapper(sctx, hybridChunk->state);
+    MR_SerializationCtxWriteLongLongWrapper(sctx, hybridChunk->compressed);
+    innerFuncs(hybridChunk)->MRSerialize(hybridChunk->chunk, sctx);
+}
+
+int Hybrid_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx) {
+    HybridState state = MR_SerializationCtxReadeLongLongWrapper(sctx);
+    bool compressed = MR_SerializationCtxReadeLongLongWrapper(sctx);
+    Chunk_t *inner = NULL;
+    const ChunkFuncs *funcs = GetChunkClass(compressed ? CHUNK_COMPRESSED : CHUNK_REGULAR);
+    if (funcs->MRDeserialize(&inner, sctx) != TSDB_OK) {
+        *chunk = NULL;
+        return TSDB_ERROR;
+    }
+    // records are read-only copies, they are never queued
+    *chunk = wrapChunk(inner, compressed, state == HYBRID_PENDING ? HYBRID_SEALED : state);
+    return TSDB_OK;
+}
+
+/*********************
+ *  Defrag           *
+ *********************/
+Chunk_t *Hybrid_DefragChunk(RedisModuleDefragCtx *ctx, Chunk_t *chunk) {
+    HybridChunk *hybridChunk = ChunkPool_Defrag(ctx, chunk);
+    if (hybridChunk != chunk && hybridChunk->state == HYBRID_PENDING) {
+        // relink the queue to the new address
+        if (hybridChunk->prev) {
+            hybridChunk->prev->next = hybridChunk;
+        } else {
+            pendingHead = hybridChunk;
+        }
+        if (hybridChunk->next) {
+            hybridChunk->next->prev = hybridChunk;
+        } else {
+            pendingTail = hybridChunk;
+        }
+    }
+    hybridChunk->chunk = innerFuncs(hybridChunk)->DefragChunk(ctx, hybridChunk->chunk);
+    return hybridChunk;
+}
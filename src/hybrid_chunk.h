@@ -0,0 +1,63 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#ifndef HYBRID_CHUNK_H
+#define HYBRID_CHUNK_H
+
+#include "generic_chunk.h"
+
+#include <stdbool.h>   // bool
+#include <sys/types.h> // u_int_t
+
+// Hybrid chunks are written as uncompressed chunks. Once a chunk is full it is queued and later
+// sealed: re-encoded as a compressed chunk by a timer on the main thread. The chunk pointer is
+// kept across sealing so the chunk directory and lastChunk stay valid.
+Chunk_t *Hybrid_NewChunk(size_t size);
+void Hybrid_FreeChunk(Chunk_t *chunk);
+Chunk_t *Hybrid_CloneChunk(const Chunk_t *chunk);
+Chunk_t *Hybrid_SplitChunk(Chunk_t *chunk);
+Chunk_t *Hybrid_MergeChunk(const Chunk_t *chunk, const Chunk_t *next, size_t maxSize);
+
+ChunkResult Hybrid_AddSample(Chunk_t *chunk, Sample *sample);
+ChunkResult Hybrid_UpsertSample(UpsertCtx *uCtx, int *size, DuplicatePolicy duplicatePolicy);
+size_t Hybrid_DelRange(Chunk_t *chunk, timestamp_t startTs, timestamp_t endTs);
+
+void Hybrid_ProcessChunk(const Chunk_t *chunk,
+                         uint64_t start,
+                         uint64_t end,
+                         EnrichedChunk *enrichedChunk,
+                         bool reverse);
+
+// Miscellaneous
+size_t Hybrid_GetChunkSize(Chunk_t *chunk, bool includeStruct);
+u_int64_t Hybrid_NumOfSample(Chunk_t *chunk);
+timestamp_t Hybrid_GetFirstTimestamp(Chunk_t *chunk);
+timestamp_t Hybrid_GetLastTimestamp(Chunk_t *chunk);
+double Hybrid_GetLastValue(Chunk_t *chunk);
+const ChunkStats *Hybrid_GetStats(const Chunk_t *chunk);
+
+// RDB
+void Hybrid_SaveToRDB(Chunk_t *chunk, struct RedisModuleIO *io);
+int Hybrid_LoadFromRDB(Chunk_t **chunk, struct RedisModuleIO *io);
+
+// LibMR
+void Hybrid_MRSerialize(Chunk_t *chunk, WriteSerializationCtx *sctx);
+int Hybrid_MRDeserialize(Chunk_t **chunk, ReaderSerializationCtx *sctx);
+
+// Defrag
+Chunk_t *Hybrid_DefragChunk(struct RedisModuleDefragCtx *ctx, Chunk_t *chunk);
+
+// Seal up to maxChunks queued chunks, returns the number of chunks left in the queue
+size_t Hybrid_SealPending(size_t maxChunks);
+// Seal the chunk now if it's queued
+void Hybrid_SealChunk(Chunk_t *chunk);
+// Start the main thread timer sealing the queued chunks
+void Hybrid_StartSealTimer(RedisModuleCtx *ctx);
+
+/* Used in tests */
+bool Hybrid_IsSealed(const Chunk_t *chunk);
+
+#endif // HYBRID_CHUNK_H
@@ -658,6 +658,16 @@ static void *ListRecord_Deserialize(ReaderSerializationCtx *sctx, MRError **erro
     return r;
 }
 
+// Appends clones of the chunks to the record and frees them, clones are never queued for sealing
+// and can be released by the LibMR threads
+static void appendClones(SeriesRecord *out, Chunk_t **chunks, size_t numChunks, int *index) {
+    for (size_t i = 0; i < numChunks; i++) {
+        out->chunks[(*index)++] = out->funcs->CloneChunk(chunks[i]);
+        out->funcs->FreeChunk(chunks[i]);
+    }
+    free(chunks);
+}
+
 Record *SeriesRecord_New(Series *series,
                          timestamp_t startTimestamp,
                          timestamp_t endTimestamp,
@@ -666,6 +676,10 @@ Record *SeriesRecord_New(Series *series,
     out->keyName = RedisModule_CreateStringFromString(NULL, series->keyName);
     if (series->options & SERIES_OPT_UNCOMPRESSED) {
         out->chunkType = CHUNK_REGULAR;
+    } else if (series->options & SERIES_OPT_COMPRESSED_DECIMAL) {
+        out->chunkType = CHUNK_COMPRESSED_DECIMAL;
+    } else if (series->options & SERIES_OPT_HYBRID) {
+        out->chunkType = CHUNK_HYBRID;
     } else {
         out->chunkType = CHUNK_COMPRESSED;
     }
@@ -678,26 +692,51 @@ Record *SeriesRecord_New(Series *series,
     }
 
     // clone chunks
-    out->chunks = calloc(RedisModule_DictSize(series->chunks) + 1,
-                         sizeof(Chunk_t *)); // + 1 in case of latest flag
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    Chunk_t *chunk = NULL;
+    size_t capacity = SeriesChunkCount(series) + 1; // + 1 in case of latest flag
+    out->chunks = calloc(capacity, sizeof(Chunk_t *));
     int index = 0;
-    while (RedisModule_DictNextC(iter, NULL, &chunk)) {
-        if (series->funcs->GetNumOfSample(chunk) == 0) {
-            if (unlikely(series->totalSamples != 0)) { // empty chunks are being removed
-                RedisModule_Log(
-                    mr_staticCtx, "error", "Empty chunk in a non empty series is invalid");
+    if (SeriesIsInline(series)) {
+        // the inline samples of a small series are sent as regular chunks
+        Chunk_t **inlineChunks;
+        size_t numChunks = SeriesInlineChunks(series, &inlineChunks);
+        capacity += numChunks;
+        out->chunks = realloc(out->chunks, capacity * sizeof(Chunk_t *));
+        appendClones(out, inlineChunks, numChunks, &index);
+    } else {
+        // chunks before the floor of startTimestamp end before it
+        for (size_t i = ChunkDir_Floor(series->chunks, startTimestamp);
+             i < ChunkDir_Size(series->chunks);
+             i++) {
+            const ChunkDirEntry *entry = ChunkDir_At(series->chunks, i);
+            if (entry->count == 0) {
+                if (unlikely(series->totalSamples != 0)) { // empty chunks are being removed
+                    RedisModule_Log(
+                        mr_staticCtx, "error", "Empty chunk in a non empty series is invalid");
+                }
+                break;
             }
-            break;
-        }
-        if (series->funcs->GetLastTimestamp(chunk) >= startTimestamp) {
-            if (series->funcs->GetFirstTimestamp(chunk) > endTimestamp) {
+            if (i > 0 && entry->firstTs > endTimestamp) {
                 break;
             }
-
-            out->chunks[index] = out->funcs->CloneChunk(chunk);
-            index++;
+            size_t stagedBegin, stagedEnd;
+            SeriesStagedSlot(series, i, &stagedBegin, &stagedEnd);
+            if (stagedBegin < stagedEnd) {
+                // the staged samples are sent merged into the chunks
+                Chunk_t **merged;
+                u_int64_t numSamples;
+                size_t numMerged = SeriesMergeStaged(
+                    series, i, stagedBegin, stagedEnd - stagedBegin, &merged, &numSamples);
+                capacity += numMerged - 1;
+                out->chunks = realloc(out->chunks, capacity * sizeof(Chunk_t *));
+                appendClones(out, merged, numMerged, &index);
+            } else if (entry->lastTs >= startTimestamp) {
+                if (entry->firstTs > endTimestamp) {
+                    break;
+                }
+
+                out->chunks[index] = out->funcs->CloneChunk(entry->chunk);
+                index++;
+            }
         }
     }
 
@@ -712,7 +751,6 @@ Record *SeriesRecord_New(Series *series,
         }
     }
     out->chunkCount = index;
-    RedisModule_DictIteratorStop(iter);
     return &out->base;
 }
 
@@ -793,10 +831,7 @@ Series *SeriesRecord_IntoSeries(SeriesRecord *record) {
     for (int chunk_index = 0; chunk_index < record->chunkCount; chunk_index++) {
         chunk = record->chunks[chunk_index];
         s->totalSamples += s->funcs->GetNumOfSample(chunk);
-        dictOperator(s->chunks,
-                     s->funcs->CloneChunk(chunk),
-                     record->funcs->GetFirstTimestamp(chunk),
-                     DICT_OP_SET);
+        ChunkDir_Insert(s->chunks, s->funcs->CloneChunk(chunk), s->funcs);
     }
     if (chunk != NULL) {
         s->lastTimestamp = s->funcs->GetLastTimestamp(chunk);
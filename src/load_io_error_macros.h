@@ -20,6 +20,15 @@
         (res);                                                                                     \
     })
 
+#define LoadSigned_IOError(rdb, cleanup_exp)                                                       \
+    __extension__({                                                                                \
+        int64_t res = RedisModule_LoadSigned((rdb));                                               \
+        if (RedisModule_IsIOError(rdb)) {                                                          \
+            cleanup_exp;                                                                           \
+        }                                                                                          \
+        (res);                                                                                     \
+    })
+
 #define LoadString_IOError(rdb, cleanup_exp)                                                       \
     __extension__({                                                                                \
         RedisModuleString *res = RedisModule_LoadString((rdb));                                    \
@@ -11,10 +11,12 @@
 #include "LibMR/src/cluster.h"
 #include "LibMR/src/mr.h"
 #include "RedisModulesSDK/redismodule.h"
+#include "chunk_pool.h"
 #include "common.h"
 #include "compaction.h"
 #include "config.h"
 #include "fast_double_parser_c/fast_double_parser_c.h"
+#include "hybrid_chunk.h"
 #include "indexer.h"
 #include "libmr_commands.h"
 #include "libmr_integration.h"
@@ -43,6 +45,25 @@ RedisModuleType *SeriesType;
 RedisModuleCtx *rts_staticCtx; // global redis ctx
 bool isTrimming = false;
 
+static void ReplyWithChunkInfo(RedisModuleCtx *ctx,
+                               timestamp_t firstTs,
+                               timestamp_t lastTs,
+                               u_int64_t numOfSamples,
+                               size_t chunkSize) {
+    RedisModule_ReplyWithArray(ctx, 5 * 2);
+    RedisModule_ReplyWithSimpleString(ctx, "startTimestamp");
+    RedisModule_ReplyWithLongLong(ctx, numOfSamples == 0 ? -1 : firstTs);
+    RedisModule_ReplyWithSimpleString(ctx, "endTimestamp");
+    RedisModule_ReplyWithLongLong(ctx, numOfSamples == 0 ? -1 : lastTs);
+    RedisModule_ReplyWithSimpleString(ctx, "samples");
+    RedisModule_ReplyWithLongLong(ctx, numOfSamples);
+    RedisModule_ReplyWithSimpleString(ctx, "size");
+    RedisModule_ReplyWithLongLong(ctx, chunkSize);
+    RedisModule_ReplyWithSimpleString(ctx, "bytesPerSample");
+    RedisModule_ReplyWithDouble(ctx,
+                                (numOfSamples == 0) ? (float)0 : (float)chunkSize / numOfSamples);
+}
+
 int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_AutoMemory(ctx);
 
@@ -58,11 +79,10 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     int is_debug = RMUtil_ArgExists("DEBUG", argv, argc, 1);
-    if (is_debug) {
-        RedisModule_ReplyWithArray(ctx, 14 * 2);
-    } else {
-        RedisModule_ReplyWithArray(ctx, 12 * 2);
-    }
+    bool autoChunkSize = series->options & SERIES_OPT_AUTO_CHUNK_SIZE;
+    bool rollupQueries = series->rollupQueries > 0;
+    RedisModule_ReplyWithArray(
+        ctx, (12 + (is_debug ? 2 : 0) + (autoChunkSize ? 1 : 0) + (rollupQueries ? 2 : 0)) * 2);
 
     long long skippedSamples;
     long long firstTimestamp = getFirstValidTimestamp(series, &skippedSamples);
@@ -78,9 +98,13 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModule_ReplyWithSimpleString(ctx, "retentionTime");
     RedisModule_ReplyWithLongLong(ctx, series->retentionTime);
     RedisModule_ReplyWithSimpleString(ctx, "chunkCount");
-    RedisModule_ReplyWithLongLong(ctx, RedisModule_DictSize(series->chunks));
+    RedisModule_ReplyWithLongLong(ctx, SeriesChunkCount(series));
     RedisModule_ReplyWithSimpleString(ctx, "chunkSize");
     RedisModule_ReplyWithLongLong(ctx, series->chunkSizeBytes);
+    if (autoChunkSize) {
+        RedisModule_ReplyWithSimpleString(ctx, "chunkSizeReason");
+        RedisModule_ReplyWithSimpleString(ctx, SeriesChunkSizeReasonToString(series));
+    }
     RedisModule_ReplyWithSimpleString(ctx, "chunkType");
     RedisModule_ReplyWithSimpleString(ctx, ChunkTypeToString(series->options));
     RedisModule_ReplyWithSimpleString(ctx, "duplicatePolicy");
@@ -116,35 +140,38 @@ int TSDB_info(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
     RedisModule_ReplySetArrayLength(ctx, ruleCount);
 
+    if (rollupQueries) {
+        RedisModule_ReplyWithSimpleString(ctx, "rollupQueries");
+        RedisModule_ReplyWithLongLong(ctx, series->rollupQueries);
+        RedisModule_ReplyWithSimpleString(ctx, "rollupHits");
+        RedisModule_ReplyWithLongLong(ctx, series->rollupHits);
+    }
+
     if (is_debug) {
-        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, ">", "", 0);
-        Chunk_t *chunk = NULL;
-        int chunkCount = 0;
         RedisModule_ReplyWithSimpleString(ctx, "keySelfName");
         RedisModule_ReplyWithString(ctx, series->keyName);
         RedisModule_ReplyWithSimpleString(ctx, "Chunks");
-        RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
-        while (RedisModule_DictNextC(iter, NULL, (void *)&chunk)) {
-            u_int64_t numOfSamples = series->funcs->GetNumOfSample(chunk);
-            size_t chunkSize = series->funcs->GetChunkSize(chunk, FALSE);
-            RedisModule_ReplyWithArray(ctx, 5 * 2);
-            RedisModule_ReplyWithSimpleString(ctx, "startTimestamp");
-            RedisModule_ReplyWithLongLong(
-                ctx, numOfSamples == 0 ? -1 : series->funcs->GetFirstTimestamp(chunk));
-            RedisModule_ReplyWithSimpleString(ctx, "endTimestamp");
-            RedisModule_ReplyWithLongLong(
-                ctx, numOfSamples == 0 ? -1 : series->funcs->GetLastTimestamp(chunk));
-            RedisModule_ReplyWithSimpleString(ctx, "samples");
-            RedisModule_ReplyWithLongLong(ctx, numOfSamples);
-            RedisModule_ReplyWithSimpleString(ctx, "size");
-            RedisModule_ReplyWithLongLong(ctx, chunkSize);
-            RedisModule_ReplyWithSimpleString(ctx, "bytesPerSample");
-            RedisModule_ReplyWithDouble(
-                ctx, (numOfSamples == 0) ? (float)0 : (float)chunkSize / numOfSamples);
-            chunkCount++;
+        if (SeriesIsInline(series)) {
+            // the inline samples are listed as a single chunk of the inline area
+            uint32_t count = series->inlineCount;
+            RedisModule_ReplyWithArray(ctx, 1);
+            ReplyWithChunkInfo(ctx,
+                               count == 0 ? 0 : series->inlineSamples[0].timestamp,
+                               count == 0 ? 0 : series->inlineSamples[count - 1].timestamp,
+                               count,
+                               series->inlineCapacity * sizeof(Sample));
+        } else {
+            size_t chunkCount = ChunkDir_Size(series->chunks);
+            RedisModule_ReplyWithArray(ctx, chunkCount);
+            for (size_t i = 0; i < chunkCount; i++) {
+                const ChunkDirEntry *entry = ChunkDir_At(series->chunks, i);
+                ReplyWithChunkInfo(ctx,
+                                   entry->firstTs,
+                                   entry->lastTs,
+                                   entry->count,
+                                   series->funcs->GetChunkSize(entry->chunk, FALSE));
+            }
         }
-        RedisModule_DictIteratorStop(iter);
-        RedisModule_ReplySetArrayLength(ctx, chunkCount);
     }
     RedisModule_CloseKey(key);
 
@@ -448,6 +475,7 @@ static void handleCompaction(RedisModuleCtx *ctx,
             // key doesn't exist anymore and we don't do anything
             return;
         }
+        destSeries = SeriesReleaseInlineArea(key, destSeries);
 
         if (rule->aggClass->type == TS_AGG_TWA) {
             rule->aggClass->addNextBucketFirstSample(rule->aggContext, value, timestamp);
@@ -568,7 +596,7 @@ static inline int add(RedisModuleCtx *ctx,
         RTS_ReplyGeneralError(ctx, "TSDB: the key is not a TSDB key");
         return REDISMODULE_ERR;
     } else {
-        series = RedisModule_ModuleTypeGetValue(key);
+        series = SeriesReleaseInlineArea(key, RedisModule_ModuleTypeGetValue(key));
         //  overwride key and database configuration for DUPLICATE_POLICY
         if (argv != NULL &&
             ParseDuplicatePolicy(ctx, argv, argc, TS_ADD_DUPLICATE_POLICY_ARG, &dp) != TSDB_OK) {
@@ -601,6 +629,8 @@ int TSDB_madd(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
             replication_count += 3;
         }
     }
+    // the closed buckets the samples went into are written once
+    SeriesFlushDirtyBuckets();
 
     if (replication_count > 0) {
         // we want to replicate only successful sample inserts to avoid errors on the replica, when
@@ -629,6 +659,7 @@ int TSDB_add(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     RedisModuleString *valueStr = argv[3];
 
     int result = add(ctx, keyName, timestampStr, valueStr, argv, argc);
+    SeriesFlushDirtyBuckets();
     if (result == REDISMODULE_OK) {
         RedisModule_ReplicateVerbatim(ctx);
     }
@@ -716,7 +747,13 @@ int TSDB_alter(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     if (RMUtil_ArgIndex("CHUNK_SIZE", argv, argc) > 0) {
-        series->chunkSizeBytes = cCtx.chunkSizeBytes;
+        if (cCtx.chunkSizeBytes == CHUNK_SIZE_AUTO) {
+            // the current size is kept until the next chunk is sized
+            series->options |= SERIES_OPT_AUTO_CHUNK_SIZE;
+        } else {
+            series->options &= ~SERIES_OPT_AUTO_CHUNK_SIZE;
+            series->chunkSizeBytes = cCtx.chunkSizeBytes;
+        }
     }
 
     if (RMUtil_ArgIndex("DUPLICATE_POLICY", argv, argc) > 0) {
@@ -807,8 +844,8 @@ int TSDB_createRule(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     api_timestamp_t bucketDuration;
     int aggType;
     timestamp_t alignmentTS;
-    const int result =
-        _parseAggregationArgs(ctx, argv, argc, &bucketDuration, &aggType, NULL, NULL, &alignmentTS);
+    const int result = _parseAggregationArgs(
+        ctx, argv, argc, &bucketDuration, &aggType, NULL, NULL, NULL, &alignmentTS);
     if (result == TSDB_NOTEXISTS) {
         return RedisModule_WrongArity(ctx);
     }
@@ -912,7 +949,7 @@ int TSDB_incrby(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
         return RTS_ReplyGeneralError(ctx, REDISMODULE_ERRORMSG_WRONGTYPE);
     }
 
-    series = RedisModule_ModuleTypeGetValue(key);
+    series = SeriesReleaseInlineArea(key, RedisModule_ModuleTypeGetValue(key));
 
     double incrby = 0;
     if (RMUtil_ParseArgs(argv, argc, 2, "d", &incrby) != REDISMODULE_OK) {
@@ -943,6 +980,7 @@ int TSDB_incrby(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     int rv = internalAdd(ctx, series, currentUpdatedTime, result, DP_LAST, true);
+    SeriesFlushDirtyBuckets();
     RedisModule_ReplicateVerbatim(ctx);
     RedisModule_CloseKey(key);
 
@@ -1144,6 +1182,7 @@ int TSDB_delete(RedisModuleCtx *ctx, RedisModuleString **argv, int argc) {
     }
 
     size_t deleted = SeriesDelRange(series, args.startTimestamp, args.endTimestamp);
+    SeriesFlushDirtyBuckets();
 
     RedisModule_ReplyWithLongLong(ctx, deleted);
     RedisModule_ReplicateVerbatim(ctx);
@@ -1158,6 +1197,11 @@ void FlushEventCallback(RedisModuleCtx *ctx, RedisModuleEvent eid, uint64_t sube
         subevent == REDISMODULE_SUBEVENT_FLUSHDB_END) {
         RemoveAllIndexedMetrics();
     }
+    if ((!memcmp(&eid, &RedisModuleEvent_FlushDB, sizeof(eid))) &&
+        subevent == REDISMODULE_SUBEVENT_FLUSHDB_START) {
+        // an async flush frees the series on another thread, empty the sealing queue first
+        Hybrid_SealPending(SIZE_MAX);
+    }
 }
 
 void swapDbEventCallback(RedisModuleCtx *ctx, RedisModuleEvent e, uint64_t sub, void *data) {
@@ -1337,6 +1381,29 @@ void Initialize_RdbNotifications(RedisModuleCtx *ctx) {
     }
 }
 
+static void moduleInfoCallback(RedisModuleInfoCtx *ctx, int for_crash_report) {
+    ChunkPoolStats stats;
+    ChunkPool_GetStats(&stats);
+    RedisModule_InfoAddSection(ctx, "chunk_pool");
+    RedisModule_InfoAddFieldULongLong(ctx, "allocations", stats.allocations);
+    RedisModule_InfoAddFieldULongLong(ctx, "reused", stats.reused);
+    RedisModule_InfoAddFieldULongLong(ctx, "frees", stats.frees);
+    RedisModule_InfoAddFieldULongLong(ctx, "cached_buffers", stats.cachedBuffers);
+    RedisModule_InfoAddFieldULongLong(ctx, "cached_bytes", stats.cachedBytes);
+
+    ChunkCoalesceStats coalesceStats;
+    SeriesGetCoalesceStats(&coalesceStats);
+    RedisModule_InfoAddSection(ctx, "chunk_coalescer");
+    RedisModule_InfoAddFieldULongLong(ctx, "merged_chunks", coalesceStats.mergedChunks);
+    RedisModule_InfoAddFieldULongLong(ctx, "bytes_saved", coalesceStats.bytesSaved);
+}
+
+// The cached buffers would keep the pages they sit on alive, they are given back before the
+// allocations are moved
+static void chunkPoolDefragCallback(RedisModuleDefragCtx *ctx) {
+    ChunkPool_Trim();
+}
+
 __attribute__((weak)) int (*RedisModule_SetDataTypeExtensions)(
     RedisModuleCtx *ctx,
     RedisModuleType *mt,
@@ -1412,7 +1479,10 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
                                   .aof_rewrite = RMUtil_DefaultAofRewrite,
                                   .mem_usage = SeriesMemUsage,
                                   .copy = CopySeries,
-                                  .free = FreeSeries };
+                                  .free = FreeSeries,
+                                  .free_effort = SeriesFreeEffort,
+                                  .unlink = UnlinkSeries,
+                                  .defrag = DefragSeries };
 
     SeriesType = RedisModule_CreateDataType(ctx, "TSDB-TYPE", TS_LATEST_ENCVER, &tm);
     if (SeriesType == NULL)
@@ -1482,5 +1552,13 @@ int RedisModule_OnLoad(RedisModuleCtx *ctx, RedisModuleString **argv, int argc)
 
     Initialize_RdbNotifications(ctx);
 
+    RedisModule_RegisterInfoFunc(ctx, moduleInfoCallback);
+    if (RedisModule_RegisterDefragFunc) {
+        RedisModule_RegisterDefragFunc(ctx, chunkPoolDefragCallback);
+    }
+
+    Hybrid_StartSealTimer(ctx);
+    SeriesStartRetentionSweeper(ctx);
+
     return REDISMODULE_OK;
 }
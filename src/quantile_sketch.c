@@ -0,0 +1,203 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#include "quantile_sketch.h"
+
+#include <math.h>
+#include <stdlib.h> // malloc
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define QUANTILE_SKETCH_GAMMA                                                                      \
+    ((1 + QUANTILE_SKETCH_RELATIVE_ACCURACY) / (1 - QUANTILE_SKETCH_RELATIVE_ACCURACY))
+// the finite doubles map to about +-37000, infinities are clamped
+#define QUANTILE_SKETCH_MAX_INDEX (1 << 20)
+
+static inline int32_t binIndex(double magnitude) {
+    double index = ceil(log(magnitude) / log(QUANTILE_SKETCH_GAMMA));
+    if (index > QUANTILE_SKETCH_MAX_INDEX) {
+        return QUANTILE_SKETCH_MAX_INDEX;
+    }
+    return index < -QUANTILE_SKETCH_MAX_INDEX ? -QUANTILE_SKETCH_MAX_INDEX : (int32_t)index;
+}
+
+// The value within the relative accuracy of all the magnitudes of the bin
+static inline double binValue(int32_t index) {
+    return 2 * pow(QUANTILE_SKETCH_GAMMA, index) / (QUANTILE_SKETCH_GAMMA + 1);
+}
+
+static void storeReserve(QuantileStore *store, uint32_t length) {
+    if (length <= store->capacity) {
+        return;
+    }
+    uint32_t capacity = store->capacity ? store->capacity * 2 : 16;
+    if (capacity < length) {
+        capacity = length;
+    }
+    if (capacity > QUANTILE_SKETCH_MAX_BINS) {
+        capacity = QUANTILE_SKETCH_MAX_BINS;
+    }
+    store->counts = realloc(store->counts, capacity * sizeof(uint64_t));
+    store->capacity = capacity;
+}
+
+// Merges the lowest bins into the bin at offset + shift, which becomes the lowest one
+static void storeCollapse(QuantileStore *store, uint32_t shift) {
+    uint64_t collapsed = 0;
+    uint32_t kept = shift < store->length ? store->length - shift : 0;
+    for (uint32_t i = 0; i < store->length - kept; i++) {
+        collapsed += store->counts[i];
+    }
+    memmove(store->counts, &store->counts[store->length - kept], kept * sizeof(uint64_t));
+    if (kept == 0) {
+        kept = 1;
+        store->counts[0] = 0;
+    }
+    store->counts[0] += collapsed;
+    store->offset += shift;
+    store->length = kept;
+}
+
+static void storeAdd(QuantileStore *store, int32_t index, uint64_t count) {
+    if (store->length == 0) {
+        storeReserve(store, 1);
+        store->offset = index;
+        store->length = 1;
+        store->counts[0] = count;
+        return;
+    }
+
+    int64_t high = (int64_t)store->offset + store->length - 1;
+    if (index < store->offset) {
+        uint32_t length = high - index + 1;
+        if (length > QUANTILE_SKETCH_MAX_BINS) {
+            // the lowest bin already holds the collapsed magnitudes
+            store->counts[0] += count;
+            return;
+        }
+        uint32_t shift = store->offset - index;
+        storeReserve(store, length);
+        memmove(&store->counts[shift], store->counts, store->length * sizeof(uint64_t));
+        memset(store->counts, 0, shift * sizeof(uint64_t));
+        store->offset = index;
+        store->length = length;
+    } else if (index > high) {
+        int64_t length = (int64_t)index - store->offset + 1;
+        if (length > QUANTILE_SKETCH_MAX_BINS) {
+            storeCollapse(store, length - QUANTILE_SKETCH_MAX_BINS);
+            length = QUANTILE_SKETCH_MAX_BINS;
+        }
+        storeReserve(store, length);
+        memset(&store->counts[store->length], 0, (length - store->length) * sizeof(uint64_t));
+        store->length = length;
+    }
+    store->counts[index - store->offset] += count;
+}
+
+QuantileSketch *QuantileSketch_New(void) {
+    QuantileSketch *sketch = (QuantileSketch *)calloc(1, sizeof(QuantileSketch));
+    QuantileSketch_Reset(sketch);
+    return sketch;
+}
+
+void QuantileSketch_Free(QuantileSketch *sketch) {
+    free(sketch->positive.counts);
+    free(sketch->negative.counts);
+    free(sketch);
+}
+
+void QuantileSketch_Reset(QuantileSketch *sketch) {
+    sketch->positive.length = 0;
+    sketch->negative.length = 0;
+    sketch->zeroCount = 0;
+    sketch->count = 0;
+    sketch->min = INFINITY;
+    sketch->max = -INFINITY;
+}
+
+void QuantileSketch_Add(QuantileSketch *sketch, double value) {
+    if (isnan(value)) {
+        return;
+    }
+    if (value > 0) {
+        storeAdd(&sketch->positive, binIndex(value), 1);
+    } else if (value < 0) {
+        storeAdd(&sketch->negative, binIndex(-value), 1);
+    } else {
+        sketch->zeroCount++;
+    }
+    sketch->count++;
+    sketch->min = fmin(sketch->min, value);
+    sketch->max = fmax(sketch->max, value);
+}
+
+void QuantileSketch_AddBin(QuantileSketch *sketch, bool negative, int32_t index, uint64_t count) {
+    if (count == 0) {
+        return;
+    }
+    storeAdd(negative ? &sketch->negative : &sketch->positive, index, count);
+    sketch->count += count;
+}
+
+static void mergeStore(QuantileStore *dest, const QuantileStore *src) {
+    // from the highest bin, the lowest ones are the ones collapsed when dest is full
+    for (int64_t i = (int64_t)src->length - 1; i >= 0; i--) {
+        if (src->counts[i] > 0) {
+            storeAdd(dest, src->offset + (int32_t)i, src->counts[i]);
+        }
+    }
+}
+
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src) {
+    mergeStore(&dest->positive, &src->positive);
+    mergeStore(&dest->negative, &src->negative);
+    dest->zeroCount += src->zeroCount;
+    dest->count += src->count;
+    dest->min = fmin(dest->min, src->min);
+    dest->max = fmax(dest->max, src->max);
+}
+
+double QuantileSketch_Quantile(const QuantileSketch *sketch, double q) {
+    if (sketch->count == 0) {
+        return NAN;
+    }
+    if (q <= 0) {
+        return sketch->min;
+    }
+    if (q >= 1) {
+        return sketch->max;
+    }
+
+    // the first bin, in increasing order of the values, whose cumulative count passes the rank
+    double rank = q * (sketch->count - 1);
+    uint64_t cumulative = 0;
+    double value = sketch->max;
+    bool found = false;
+    const QuantileStore *negative = &sketch->negative;
+    for (int64_t i = (int64_t)negative->length - 1; i >= 0 && !found; i--) {
+        cumulative += negative->counts[i];
+        if (cumulative > rank) {
+            value = -binValue(negative->offset + (int32_t)i);
+            found = true;
+        }
+    }
+    if (!found) {
+        cumulative += sketch->zeroCount;
+        if (cumulative > rank) {
+            value = 0;
+            found = true;
+        }
+    }
+    const QuantileStore *positive = &sketch->positive;
+    for (uint32_t i = 0; i < positive->length && !found; i++) {
+        cumulative += positive->counts[i];
+        if (cumulative > rank) {
+            value = binValue(positive->offset + (int32_t)i);
+            found = true;
+        }
+    }
+    return fmin(fmax(value, sketch->min), sketch->max);
+}
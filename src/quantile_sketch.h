@@ -0,0 +1,55 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#ifndef QUANTILE_SKETCH_H
+#define QUANTILE_SKETCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Quantiles reported by the sketch are within this relative error of the exact ones
+#define QUANTILE_SKETCH_RELATIVE_ACCURACY 0.01
+// Bins kept per sign. Once a sketch needs more, the bins of the smallest magnitudes are merged, so
+// only the quantiles falling there lose their accuracy.
+#define QUANTILE_SKETCH_MAX_BINS 1024
+
+// Counts of the values whose magnitude falls in the bin [gamma^(i-1), gamma^i), for the indexes in
+// [offset, offset + length)
+typedef struct QuantileStore
+{
+    uint64_t *counts;
+    int32_t offset;
+    uint32_t length;
+    uint32_t capacity;
+} QuantileStore;
+
+// DDSketch of a set of values: logarithmic bins with a bounded relative error, two sketches are
+// merged by adding up their bins. NaN values are ignored.
+typedef struct QuantileSketch
+{
+    QuantileStore positive;
+    QuantileStore negative; // by magnitude
+    uint64_t zeroCount;
+    uint64_t count;
+    double min;
+    double max;
+} QuantileSketch;
+
+QuantileSketch *QuantileSketch_New(void);
+void QuantileSketch_Free(QuantileSketch *sketch);
+// Empties the sketch, the bins stay allocated
+void QuantileSketch_Reset(QuantileSketch *sketch);
+
+void QuantileSketch_Add(QuantileSketch *sketch, double value);
+// Adds count values to the bin at index, of the negative values if negative
+void QuantileSketch_AddBin(QuantileSketch *sketch, bool negative, int32_t index, uint64_t count);
+// Adds all the values of src to dest
+void QuantileSketch_Merge(QuantileSketch *dest, const QuantileSketch *src);
+
+// Value of rank q * (count - 1) among the values, q in [0, 1]. NaN for an empty sketch.
+double QuantileSketch_Quantile(const QuantileSketch *sketch, double q);
+
+#endif // QUANTILE_SKETCH_H
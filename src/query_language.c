@@ -7,6 +7,7 @@
 
 #include <limits.h>
 #include <ctype.h>
+#include <string.h>
 #include "rmutil/alloc.h"
 #include "rmutil/strings.h"
 #include "rmutil/util.h"
@@ -91,7 +92,13 @@ int ParseChunkSize(RedisModuleCtx *ctx,
                    int argc,
                    const char *arg_prefix,
                    long long *chunkSizeBytes) {
-    if (RMUtil_ArgIndex(arg_prefix, argv, argc) >= 0) {
+    int index = RMUtil_ArgIndex(arg_prefix, argv, argc);
+    if (index >= 0) {
+        const char *value = index + 1 < argc ? RedisModule_StringPtrLen(argv[index + 1], NULL) : "";
+        if (strcasecmp(value, CHUNK_SIZE_AUTO_ARG_STR) == 0) {
+            *chunkSizeBytes = CHUNK_SIZE_AUTO;
+            return TSDB_OK;
+        }
         if (RMUtil_ParseArgsAfter(arg_prefix, argv, argc, "l", chunkSizeBytes) != REDISMODULE_OK) {
             RTS_ReplyGeneralError(ctx, "TSDB: Couldn't parse CHUNK_SIZE");
             return TSDB_ERROR;
@@ -183,13 +190,21 @@ int parseEncodingArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, i
 
         const char *encoding = RedisModule_StringPtrLen(argv[encoding_location + 1], NULL);
         if (strcasecmp(encoding, UNCOMPRESSED_ARG_STR) == 0) {
-            *options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            *options &= ~SERIES_OPT_ENCODING_MASK;
             *options |= SERIES_OPT_UNCOMPRESSED;
             return TSDB_OK;
         } else if (strcasecmp(encoding, COMPRESSED_GORILLA_ARG_STR) == 0) {
-            *options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            *options &= ~SERIES_OPT_ENCODING_MASK;
             *options |= SERIES_OPT_COMPRESSED_GORILLA;
             return TSDB_OK;
+        } else if (strcasecmp(encoding, COMPRESSED_DECIMAL_ARG_STR) == 0) {
+            *options &= ~SERIES_OPT_ENCODING_MASK;
+            *options |= SERIES_OPT_COMPRESSED_DECIMAL;
+            return TSDB_OK;
+        } else if (strcasecmp(encoding, HYBRID_ARG_STR) == 0) {
+            *options &= ~SERIES_OPT_ENCODING_MASK;
+            *options |= SERIES_OPT_HYBRID;
+            return TSDB_OK;
         } else {
             RTS_ReplyGeneralError(ctx, "TSDB: unknown ENCODING parameter");
             return TSDB_ERROR;
@@ -197,11 +212,11 @@ int parseEncodingArgs(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, i
     } else {
         // backwards compatible UNCOMPRESSED/COMPRESSED parsing
         if (RMUtil_ArgIndex(UNCOMPRESSED_ARG_STR, argv, argc) > 0) {
-            *options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            *options &= ~SERIES_OPT_ENCODING_MASK;
             *options |= SERIES_OPT_UNCOMPRESSED;
         }
         if (RMUtil_ArgIndex(COMPRESSED_GORILLA_ARG_STR, argv, argc) > 0) {
-            *options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
+            *options &= ~SERIES_OPT_ENCODING_MASK;
             *options |= SERIES_OPT_COMPRESSED_GORILLA;
         }
     }
@@ -270,11 +285,49 @@ static int _parseAlignmentTS(RedisModuleCtx *ctx,
     return TSDB_OK;
 }
 
+// Parses the comma separated aggregation types of aggTypeStr into agg_types, at most
+// max_agg_types of them
+static int parseAggTypes(RedisModuleCtx *ctx,
+                         RedisModuleString *aggTypeStr,
+                         int *agg_types,
+                         size_t max_agg_types,
+                         size_t *count) {
+    size_t len;
+    const char *cur = RedisModule_StringPtrLen(aggTypeStr, &len);
+    const char *end = cur + len;
+    *count = 0;
+    while (true) {
+        const char *comma = memchr(cur, ',', end - cur);
+        const char *tokenEnd = comma ? comma : end;
+        if (*count == max_agg_types) {
+            if (max_agg_types == 1) {
+                RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+            } else {
+                RTS_ReplyGeneralError(ctx, "TSDB: too many aggregation types");
+            }
+            return TSDB_ERROR;
+        }
+        int agg_type = StringLenAggTypeToEnum(cur, tokenEnd - cur);
+        if (agg_type < 0 || agg_type >= TS_AGG_TYPES_MAX) {
+            RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+            return TSDB_ERROR;
+        }
+        agg_types[(*count)++] = agg_type;
+        if (!comma) {
+            return TSDB_OK;
+        }
+        cur = comma + 1;
+    }
+}
+
+// When num_agg_types is set AGGREGATION takes a comma separated list of up to MAX_AGGREGATIONS
+// aggregation types, which are stored in the agg_type array
 int _parseAggregationArgs(RedisModuleCtx *ctx,
                           RedisModuleString **argv,
                           int argc,
                           api_timestamp_t *time_delta,
                           int *agg_type,
+                          size_t *num_agg_types,
                           bool *empty,
                           BucketTimestamp *bucketTS,
                           timestamp_t *alignmetTS) {
@@ -293,12 +346,15 @@ int _parseAggregationArgs(RedisModuleCtx *ctx,
             return TSDB_ERROR;
         }
 
-        *agg_type = RMStringLenAggTypeToEnum(aggTypeStr);
-
-        if (*agg_type < 0 || *agg_type >= TS_AGG_TYPES_MAX) {
-            RTS_ReplyGeneralError(ctx, "TSDB: Unknown aggregation type");
+        size_t count;
+        if (parseAggTypes(
+                ctx, aggTypeStr, agg_type, num_agg_types ? MAX_AGGREGATIONS : 1, &count) !=
+            TSDB_OK) {
             return TSDB_ERROR;
         }
+        if (num_agg_types) {
+            *num_agg_types = count;
+        }
 
         if (temp_time_delta <= 0) {
             RTS_ReplyGeneralError(ctx, "TSDB: bucketDuration must be greater than zero");
@@ -346,22 +402,31 @@ int parseAggregationArgs(RedisModuleCtx *ctx,
                          RedisModuleString **argv,
                          int argc,
                          AggregationArgs *out) {
-    int agg_type;
+    int agg_types[MAX_AGGREGATIONS];
     AggregationArgs aggregationArgs = { 0 };
     int result = _parseAggregationArgs(ctx,
                                        argv,
                                        argc,
                                        &aggregationArgs.timeDelta,
-                                       &agg_type,
+                                       agg_types,
+                                       &aggregationArgs.numAggregations,
                                        &aggregationArgs.empty,
                                        &aggregationArgs.bucketTS,
                                        NULL);
     if (result == TSDB_OK) {
-        aggregationArgs.aggregationClass = GetAggClass(agg_type);
-        if (aggregationArgs.aggregationClass == NULL) {
-            RTS_ReplyGeneralError(ctx, "TSDB: Failed to retrieve aggregation class");
-            return TSDB_ERROR;
+        for (size_t i = 0; i < aggregationArgs.numAggregations; ++i) {
+            if (agg_types[i] == TS_AGG_TWA && aggregationArgs.numAggregations > 1) {
+                RTS_ReplyGeneralError(ctx,
+                                      "TSDB: TWA can't be combined with other aggregation types");
+                return TSDB_ERROR;
+            }
+            aggregationArgs.aggregationClasses[i] = GetAggClass(agg_types[i]);
+            if (aggregationArgs.aggregationClasses[i] == NULL) {
+                RTS_ReplyGeneralError(ctx, "TSDB: Failed to retrieve aggregation class");
+                return TSDB_ERROR;
+            }
         }
+        aggregationArgs.aggregationClass = aggregationArgs.aggregationClasses[0];
         *out = aggregationArgs;
         return TSDB_OK;
     } else {
@@ -533,6 +598,19 @@ int parseLatestArg(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool
     return REDISMODULE_OK;
 }
 
+// ROLLUP and NOROLLUP override ROLLUP_QUERIES
+static int parseRollupArg(RedisModuleCtx *ctx, RedisModuleString **argv, int argc, bool *rollup) {
+    bool optIn = RMUtil_ArgIndex("ROLLUP", argv, argc) > 0;
+    bool optOut = RMUtil_ArgIndex("NOROLLUP", argv, argc) > 0;
+    if (optIn && optOut) {
+        RTS_ReplyGeneralError(ctx, "TSDB: ROLLUP and NOROLLUP can't be used together");
+        return REDISMODULE_ERR;
+    }
+    *rollup = optIn || (TSGlobalConfig.rollupQueries && !optOut);
+
+    return REDISMODULE_OK;
+}
+
 int parseRangeArguments(RedisModuleCtx *ctx,
                         int start_index,
                         RedisModuleString **argv,
@@ -574,6 +652,10 @@ int parseRangeArguments(RedisModuleCtx *ctx,
         return REDISMODULE_ERR;
     }
 
+    if (parseRollupArg(ctx, argv, argc, &args.rollup) != REDISMODULE_OK) {
+        return REDISMODULE_ERR;
+    }
+
     args.count = -1;
     if (parseCountArgument(ctx, argv, argc, &args.count) != REDISMODULE_OK) {
         return REDISMODULE_ERR;
@@ -883,6 +965,12 @@ int parseMRangeCommand(RedisModuleCtx *ctx, RedisModuleString **argv, int argc,
             QueryPredicateList_Free(queries);
             return REDISMODULE_ERR;
         }
+        if (args.rangeArgs.aggregationArgs.numAggregations > 1) {
+            RTS_ReplyGeneralError(ctx,
+                                  "TSDB: GROUPBY can't be used with several aggregation types");
+            QueryPredicateList_Free(queries);
+            return REDISMODULE_ERR;
+        }
     }
     *out = args;
     return REDISMODULE_OK;
@@ -29,7 +29,10 @@ typedef struct AggregationArgs
     bool empty; // Should return empty buckets
     api_timestamp_t timeDelta;
     BucketTimestamp bucketTS;
-    AggregationClass *aggregationClass;
+    AggregationClass *aggregationClass; // the first of aggregationClasses
+    // AGGREGATION takes a comma separated list of aggregators, one value of each per bucket
+    AggregationClass *aggregationClasses[MAX_AGGREGATIONS];
+    size_t numAggregations;
 } AggregationArgs;
 
 // GroupBy reducer args
@@ -68,6 +71,7 @@ typedef struct RangeArgs
     api_timestamp_t startTimestamp;
     api_timestamp_t endTimestamp;
     bool latest;     // get also the latest unfinalized bucket from the src series
+    bool rollup;     // the aggregation may be read from a compaction of the series
     long long count; // AKA limit
     AggregationArgs aggregationArgs;
     FilterByValueArgs filterByValueArgs;
@@ -132,6 +136,7 @@ int _parseAggregationArgs(RedisModuleCtx *ctx,
                           int argc,
                           api_timestamp_t *time_delta,
                           int *agg_type,
+                          size_t *num_agg_types,
                           bool *empty,
                           BucketTimestamp *bucketTS,
                           timestamp_t *alignmetTS);
@@ -6,7 +6,6 @@
 #include "rdb.h"
 
 #include "consts.h"
-#include "endianconv.h"
 #include "load_io_error_macros.h"
 #include "module.h"
 
@@ -68,6 +67,8 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
 
     uint64_t rulesCount = LoadUnsigned_IOError(io, goto err);
 
+    // a series too big for the inline samples is loaded without spare inline capacity
+    cCtx.skipChunkCreation = encver >= TS_SIZE_RDB_VER && totalSamples > SERIES_INLINE_SAMPLES;
     series = NewSeries(keyName, &cCtx);
 
     CompactionRule *lastRule = NULL;
@@ -110,20 +111,16 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
         }
     } else {
         Chunk_t *chunk = NULL;
-        // Free the default allocated chunk given LoadFromRDB will allocate a proper sized chunk
-        timestamp_t rax_key = htonu64(0);
-        chunk = (Chunk_t *)RedisModule_DictGetC(series->chunks, &rax_key, sizeof(rax_key), NULL);
-        if (chunk != NULL) {
-            series->funcs->FreeChunk(chunk);
+        // a small series is moved back inline once loaded
+        if (SeriesIsInline(series)) {
+            series->chunks = ChunkDir_New();
         }
-        dictOperator(series->chunks, NULL, 0, DICT_OP_DEL);
         uint64_t numChunks = LoadUnsigned_IOError(io, goto err);
         for (int i = 0; i < numChunks; ++i) {
             if (series->funcs->LoadFromRDB(&chunk, io)) {
                 goto err;
             }
-            dictOperator(
-                series->chunks, chunk, series->funcs->GetFirstTimestamp(chunk), DICT_OP_SET);
+            ChunkDir_Insert(series->chunks, chunk, series->funcs);
         }
         series->totalSamples = totalSamples;
         series->duplicatePolicy = duplicatePolicy;
@@ -132,6 +129,29 @@ void *series_rdb_load(RedisModuleIO *io, int encver) {
         series->lastTimestamp = lastTimestamp;
         series->lastValue = lastValue;
         series->lastChunk = chunk;
+
+        if (encver >= TS_STAGING_VER) {
+            uint64_t numStaged = LoadUnsigned_IOError(io, goto err);
+            for (uint64_t i = 0; i < numStaged; ++i) {
+                Sample sample;
+                sample.timestamp = LoadUnsigned_IOError(io, goto err);
+                sample.value = LoadDouble_IOError(io, goto err);
+                DuplicatePolicy policy = LoadUnsigned_IOError(io, goto err);
+                SeriesStageSample(series, sample, policy);
+            }
+            if (numStaged > 0) {
+                series->staged->since = LoadUnsigned_IOError(io, goto err);
+            }
+        }
+        if (encver >= TS_ROLLUP_VER) {
+            series->rollupStart = LoadUnsigned_IOError(io, goto err);
+        } else {
+            // the rule has been feeding the buckets after the last one it wrote, the older ones may
+            // miss the samples added before the rule
+            series->rollupStart = totalSamples > 0 ? lastTimestamp + 1 : UINT64_MAX;
+        }
+        SeriesShrinkToInline(series);
+        series = SeriesReleaseInlineArea(NULL, series);
     }
 
     return series;
@@ -222,13 +242,33 @@ void series_rdb_save(RedisModuleIO *io, void *value) {
         RedisModule_SaveUnsigned(io, 0);
     }
 
-    Chunk_t *chunk;
-    uint64_t numChunks = RedisModule_DictSize(series->chunks);
-    RedisModule_SaveUnsigned(io, numChunks);
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    while (RedisModule_DictNextC(iter, NULL, &chunk)) {
-        series->funcs->SaveToRDB(chunk, io);
-        numChunks--;
+    if (SeriesIsInline(series)) {
+        // the inline samples are saved as regular chunks
+        Chunk_t **chunks;
+        size_t numChunks = SeriesInlineChunks(series, &chunks);
+        RedisModule_SaveUnsigned(io, numChunks);
+        for (size_t i = 0; i < numChunks; i++) {
+            series->funcs->SaveToRDB(chunks[i], io);
+            series->funcs->FreeChunk(chunks[i]);
+        }
+        free(chunks);
+    } else {
+        uint64_t numChunks = ChunkDir_Size(series->chunks);
+        RedisModule_SaveUnsigned(io, numChunks);
+        for (size_t i = 0; i < numChunks; i++) {
+            series->funcs->SaveToRDB(ChunkDir_At(series->chunks, i)->chunk, io);
+        }
+    }
+
+    const StagingBuffer *staged = series->staged;
+    RedisModule_SaveUnsigned(io, staged ? staged->count : 0);
+    for (size_t i = 0; staged && i < staged->count; i++) {
+        RedisModule_SaveUnsigned(io, staged->timestamps[i]);
+        RedisModule_SaveDouble(io, staged->values[i]);
+        RedisModule_SaveUnsigned(io, staged->policies[i]);
+    }
+    if (staged) {
+        RedisModule_SaveUnsigned(io, staged->since);
     }
-    RedisModule_DictIteratorStop(iter);
+    RedisModule_SaveUnsigned(io, series->rollupStart);
 }
@@ -17,9 +17,13 @@
 #define TS_REPLICAOF_SUPPORT_VER 5
 #define TS_ALIGNMENT_TS_VER 6
 #define TS_LAST_AGGREGATION_EMPTY 7
+#define TS_DECIMAL_CHUNK_VER 8
+#define TS_HYBRID_CHUNK_VER 9
+#define TS_STAGING_VER 10
+#define TS_ROLLUP_VER 11
 
 // This flag should be updated whenever a new rdb version is introduced
-#define TS_LATEST_ENCVER TS_LAST_AGGREGATION_EMPTY
+#define TS_LATEST_ENCVER TS_ROLLUP_VER
 
 extern int last_rdb_load_version;
 
@@ -42,19 +42,36 @@ int ReplySeriesRange(RedisModuleCtx *ctx, Series *series, const RangeArgs *args,
         _count = args->count;
     }
 
-    AbstractIterator *iter = SeriesQuery(series, args, reverse, true);
+    RangeArgs rollupArgs;
+    RedisModuleKey *rollupKey = NULL;
+    Series *rollup = SeriesSelectRollup(ctx, series, args, &rollupArgs, &rollupKey);
+    AbstractIterator *iter = rollup ? SeriesQuery(rollup, &rollupArgs, reverse, true)
+                                    : SeriesQuery(series, args, reverse, true);
     EnrichedChunk *enrichedChunk;
     RedisModule_ReplyWithArray(ctx, REDISMODULE_POSTPONED_ARRAY_LEN);
 
     while ((arraylen < _count) && (enrichedChunk = iter->GetNext(iter))) {
         n = (unsigned int)min(_count - arraylen, enrichedChunk->samples.num_samples);
-        for (size_t i = 0; i < n; ++i) {
-            ReplyWithSample(
-                ctx, enrichedChunk->samples.timestamps[i], enrichedChunk->samples.values[i]);
+        if (enrichedChunk->aggValues) {
+            size_t numValues = enrichedChunk->numAggValues;
+            for (size_t i = 0; i < n; ++i) {
+                ReplyWithSampleValues(ctx,
+                                      enrichedChunk->samples.timestamps[i],
+                                      &enrichedChunk->aggValues[i * numValues],
+                                      numValues);
+            }
+        } else {
+            for (size_t i = 0; i < n; ++i) {
+                ReplyWithSample(
+                    ctx, enrichedChunk->samples.timestamps[i], enrichedChunk->samples.values[i]);
+            }
         }
         arraylen += n;
     }
     iter->Close(iter);
+    if (rollupKey) {
+        RedisModule_CloseKey(rollupKey);
+    }
 
     RedisModule_ReplySetArrayLength(ctx, arraylen);
     return REDISMODULE_OK;
@@ -117,6 +134,19 @@ void ReplyWithSample(RedisModuleCtx *ctx, u_int64_t timestamp, double value) {
     RedisModule_ReplyWithSimpleString(ctx, buf);
 }
 
+void ReplyWithSampleValues(RedisModuleCtx *ctx,
+                           u_int64_t timestamp,
+                           const double *values,
+                           size_t numValues) {
+    RedisModule_ReplyWithArray(ctx, numValues + 1);
+    RedisModule_ReplyWithLongLong(ctx, timestamp);
+    char buf[MAX_VAL_LEN + 1];
+    for (size_t i = 0; i < numValues; ++i) {
+        dragonbox_double_to_chars(values[i], buf);
+        RedisModule_ReplyWithSimpleString(ctx, buf);
+    }
+}
+
 void ReplyWithSeriesLastDatapoint(RedisModuleCtx *ctx, const Series *series) {
     if (SeriesGetNumSamples(series) == 0) {
         RedisModule_ReplyWithArray(ctx, 0);
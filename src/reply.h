@@ -33,6 +33,11 @@ void ReplyWithSeriesLabelsWithLimitC(RedisModuleCtx *ctx,
                                      ushort limitLabelsSize);
 
 void ReplyWithSample(RedisModuleCtx *ctx, u_int64_t timestamp, double value);
+// Replies [timestamp, values[0], ..., values[numValues - 1]]
+void ReplyWithSampleValues(RedisModuleCtx *ctx,
+                           u_int64_t timestamp,
+                           const double *values,
+                           size_t numValues);
 
 void ReplyWithSeriesLastDatapoint(RedisModuleCtx *ctx, const Series *series);
 
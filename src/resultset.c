@@ -50,13 +50,10 @@ void FreeTempSeries(Series *s) {
         return;
     RedisModule_FreeString(NULL, s->keyName);
     if (s->chunks) {
-        RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(s->chunks, "^", NULL, 0);
-        Chunk_t *currentChunk;
-        while (RedisModule_DictNextC(iter, NULL, (void **)&currentChunk) != NULL) {
-            s->funcs->FreeChunk(currentChunk);
+        for (size_t i = 0; i < ChunkDir_Size(s->chunks); i++) {
+            s->funcs->FreeChunk(ChunkDir_At(s->chunks, i)->chunk);
         }
-        RedisModule_DictIteratorStop(iter);
-        RedisModule_FreeDict(NULL, s->chunks);
+        ChunkDir_Free(s->chunks);
     }
     if (s->labels) {
         FreeLabels(s->labels, s->labelsCount);
@@ -8,6 +8,7 @@
 #include "abstract_iterator.h"
 #include "filter_iterator.h"
 #include "tsdb.h"
+#include "chunk.h"
 #include "enriched_chunk.h"
 
 EnrichedChunk *SeriesIteratorGetNextChunk(AbstractIterator *iterator);
@@ -27,29 +28,30 @@ AbstractIterator *SeriesIterator_New(Series *series,
     iter->base.input = NULL;
     iter->currentChunk = NULL;
     iter->enrichedChunk = NewEnrichedChunk();
+    iter->enrichedChunkAux = NULL;
     iter->series = series;
     iter->minTimestamp = start_ts;
     iter->maxTimestamp = end_ts;
     iter->reverse = rev;
     iter->reverse_chunk = rev_chunk;
     iter->latest = latest;
-
-    timestamp_t rax_key;
-
-    if (!rev) {
-        iter->DictGetNext = RedisModule_DictNextC;
-        seriesEncodeTimestamp(&rax_key, iter->minTimestamp);
-    } else {
-        iter->DictGetNext = RedisModule_DictPrevC;
-        seriesEncodeTimestamp(&rax_key, iter->maxTimestamp);
+    iter->valueFilter = (FilterByValueArgs){ .hasValue = false };
+    iter->summaryBucketDuration = 0;
+    iter->summaryAlignment = 0;
+    iter->chunkIdx = 0;
+    iter->inlineDone = false;
+    if (SeriesIsInline(series)) {
+        return (AbstractIterator *)iter;
     }
 
     // get first chunk within query range
-    iter->dictIter =
-        RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
-    if (!iter->DictGetNext(iter->dictIter, NULL, (void *)&iter->currentChunk)) {
-        RedisModule_DictIteratorReseekC(iter->dictIter, "^", NULL, 0);
-        iter->DictGetNext(iter->dictIter, NULL, (void *)&iter->currentChunk);
+    ChunkDir *chunks = series->chunks;
+    // staged samples may follow the last sample of the chunk before minTimestamp
+    iter->chunkIdx = (rev || series->staged) ? ChunkDir_Floor(chunks, rev ? iter->maxTimestamp
+                                                                            : iter->minTimestamp)
+                                               : ChunkDir_Ceil(chunks, iter->minTimestamp);
+    if (iter->chunkIdx < ChunkDir_Size(chunks)) {
+        iter->currentChunk = ChunkDir_At(chunks, iter->chunkIdx)->chunk;
     }
 
     return (AbstractIterator *)iter;
@@ -57,8 +59,10 @@ AbstractIterator *SeriesIterator_New(Series *series,
 
 void SeriesIteratorClose(AbstractIterator *iterator) {
     SeriesIterator *self = (SeriesIterator *)iterator;
-    RedisModule_DictIteratorStop(self->dictIter);
     FreeEnrichedChunk(self->enrichedChunk);
+    if (self->enrichedChunkAux) {
+        FreeEnrichedChunk(self->enrichedChunkAux);
+    }
     free(iterator);
 }
 
@@ -69,6 +73,131 @@ extern RedisModuleCtx *rts_staticCtx; // global redis ctx
     ((iter)->latest && (iter)->series->srcKey &&                                                   \
      (iter)->maxTimestamp > (iter)->series->lastTimestamp)
 
+// Moves to the next chunk in iteration order, NULL when there are no more chunks
+static inline Chunk_t *nextChunk(SeriesIterator *iter) {
+    ChunkDir *chunks = iter->series->chunks;
+    if (!iter->reverse && iter->chunkIdx + 1 < ChunkDir_Size(chunks)) {
+        iter->currentChunk = ChunkDir_At(chunks, ++iter->chunkIdx)->chunk;
+    } else if (iter->reverse && iter->chunkIdx > 0) {
+        iter->currentChunk = ChunkDir_At(chunks, --iter->chunkIdx)->chunk;
+    } else {
+        iter->currentChunk = NULL;
+    }
+    return iter->currentChunk;
+}
+
+// Range [begin, end) of the staged samples of the current chunk slot within the query range
+static inline bool stagedInSlot(const SeriesIterator *iter, size_t *begin, size_t *end) {
+    const StagingBuffer *buf = iter->series->staged;
+    if (!buf) {
+        return false;
+    }
+    SeriesStagedSlot(iter->series, iter->chunkIdx, begin, end);
+    *begin = max(*begin, StagingBuffer_LowerBound(buf, iter->minTimestamp));
+    while (*end > *begin && buf->timestamps[*end - 1] > iter->maxTimestamp) {
+        (*end)--;
+    }
+    return *begin < *end;
+}
+
+// Merges the staged samples [begin, end) into the decoded chunk, in place of the samples they
+// replace
+static void mergeStaged(SeriesIterator *iter, size_t begin, size_t end) {
+    const StagingBuffer *buf = iter->series->staged;
+    const Samples *decoded = &iter->enrichedChunk->samples;
+    if (!iter->enrichedChunkAux) {
+        iter->enrichedChunkAux = NewEnrichedChunk();
+    }
+    EnrichedChunk *merged = iter->enrichedChunkAux;
+    size_t maxSamples = decoded->num_samples + (end - begin);
+    if (maxSamples > merged->samples.size) {
+        ReallocSamplesArray(&merged->samples, maxSamples);
+    }
+    ResetEnrichedChunk(merged);
+
+    size_t i = 0, j = begin, n = 0;
+    while (i < decoded->num_samples || j < end) {
+        Sample sample;
+        if (j == end || (i < decoded->num_samples && decoded->timestamps[i] < buf->timestamps[j])) {
+            sample = (Sample){ .timestamp = decoded->timestamps[i], .value = decoded->values[i] };
+            i++;
+        } else {
+            sample = (Sample){ .timestamp = buf->timestamps[j], .value = buf->values[j] };
+            if (i < decoded->num_samples && decoded->timestamps[i] == sample.timestamp) {
+                Sample old = { .timestamp = decoded->timestamps[i], .value = decoded->values[i] };
+                if (handleDuplicateSample(buf->policies[j], old, &sample) != CR_OK) {
+                    sample = old;
+                }
+                i++;
+            }
+            j++;
+        }
+        merged->samples.timestamps[n] = sample.timestamp;
+        merged->samples.values[n] = sample.value;
+        n++;
+    }
+    merged->samples.num_samples = n;
+
+    iter->enrichedChunkAux = iter->enrichedChunk;
+    iter->enrichedChunk = merged;
+    if (iter->reverse_chunk) {
+        reverseEnrichedChunk(merged);
+    }
+}
+
+// Passes on the inline samples of a small series within the query range
+static void processInline(SeriesIterator *iter) {
+    const Series *series = iter->series;
+    if (series->inlineCount > iter->enrichedChunk->samples.size) {
+        ReallocSamplesArray(&iter->enrichedChunk->samples, series->inlineCount);
+    }
+    ResetEnrichedChunk(iter->enrichedChunk);
+    iter->enrichedChunk->rev = iter->reverse_chunk;
+    Samples *samples = &iter->enrichedChunk->samples;
+    size_t n = 0;
+    for (uint32_t i = 0; i < series->inlineCount; i++) {
+        const Sample *sample =
+            &series->inlineSamples[iter->reverse_chunk ? series->inlineCount - 1 - i : i];
+        if (sample->timestamp >= iter->minTimestamp && sample->timestamp <= iter->maxTimestamp) {
+            samples->timestamps[n] = sample->timestamp;
+            samples->values[n] = sample->value;
+            n++;
+        }
+    }
+    samples->num_samples = n;
+}
+
+// True when none of the chunk samples passes the value filter
+static inline bool filteredOutByValue(const SeriesIterator *iter, const ChunkStats *stats) {
+    return iter->valueFilter.hasValue && stats && stats->count > 0 &&
+           (stats->max < iter->valueFilter.min || stats->min > iter->valueFilter.max);
+}
+
+// Returns the chunk stats when the chunk can be passed on summarized: all its samples are within
+// the query range and the value filter, and fall in a single aggregation bucket.
+static inline const ChunkStats *summarizeChunk(const SeriesIterator *iter, Chunk_t *chunk) {
+    if (iter->summaryBucketDuration <= 0) {
+        return NULL;
+    }
+    const ChunkStats *stats = iter->series->funcs->GetStats(chunk);
+    if (!stats || stats->count == 0 || stats->first.timestamp < iter->minTimestamp ||
+        stats->last.timestamp > iter->maxTimestamp) {
+        return NULL;
+    }
+    if (iter->valueFilter.hasValue &&
+        (stats->min < iter->valueFilter.min || stats->max > iter->valueFilter.max)) {
+        return NULL;
+    }
+    if (CalcBucketStart(stats->first.timestamp,
+                        iter->summaryBucketDuration,
+                        iter->summaryAlignment) != CalcBucketStart(stats->last.timestamp,
+                                                                   iter->summaryBucketDuration,
+                                                                   iter->summaryAlignment)) {
+        return NULL;
+    }
+    return stats;
+}
+
 // Fills sample from chunk. If all samples were extracted from the chunk, we
 // move to the next chunk.
 EnrichedChunk *SeriesIteratorGetNextChunk(AbstractIterator *abstractIterator) {
@@ -76,11 +205,43 @@ EnrichedChunk *SeriesIteratorGetNextChunk(AbstractIterator *abstractIterator) {
     Sample *sample_ptr = &sample;
     SeriesIterator *iter = (SeriesIterator *)abstractIterator;
     Chunk_t *curChunk = iter->currentChunk;
+    const ChunkStats *stats;
+    size_t stagedBegin = 0, stagedEnd = 0;
 
     if (unlikely(iter->reverse && should_finalize_last_bucket(iter))) {
         goto _handle_latest;
     }
 
+    if (SeriesIsInline(iter->series)) {
+        if (!iter->inlineDone) {
+            iter->inlineDone = true;
+            processInline(iter);
+            if (iter->enrichedChunk->samples.num_samples > 0) {
+                goto _out;
+            }
+        }
+        if (should_finalize_last_bucket(iter)) {
+            iter->enrichedChunk->samples.num_samples = 0;
+            goto _handle_latest;
+        }
+        return NULL;
+    }
+
+    // chunks without any sample passing the value filter aren't decoded at all
+    while (curChunk && filteredOutByValue(iter, iter->series->funcs->GetStats(curChunk)) &&
+           !stagedInSlot(iter, &stagedBegin, &stagedEnd)) {
+        curChunk = nextChunk(iter);
+    }
+    bool hasStaged = curChunk && stagedInSlot(iter, &stagedBegin, &stagedEnd);
+    // the remaining chunks are all past the query range
+    if (curChunk && !hasStaged) {
+        const ChunkDirEntry *entry = ChunkDir_At(iter->series->chunks, iter->chunkIdx);
+        if (entry->count > 0 && (iter->reverse ? entry->lastTs < iter->minTimestamp
+                                               : entry->firstTs > iter->maxTimestamp)) {
+            curChunk = iter->currentChunk = NULL;
+        }
+    }
+
     if (!curChunk || iter->series->funcs->GetNumOfSample(curChunk) == 0) {
         if (unlikely(curChunk && iter->series->funcs->GetNumOfSample(curChunk) > 0 &&
                      iter->series->totalSamples == 0)) { // empty chunks are being removed
@@ -93,18 +254,35 @@ EnrichedChunk *SeriesIteratorGetNextChunk(AbstractIterator *abstractIterator) {
         return NULL;
     }
 
-    u_int64_t n_samples = iter->series->funcs->GetNumOfSample(curChunk);
+    u_int64_t n_samples = ChunkDir_At(iter->series->chunks, iter->chunkIdx)->count;
     if (n_samples > iter->enrichedChunk->samples.size) {
         ReallocSamplesArray(&iter->enrichedChunk->samples, n_samples);
     }
-    iter->series->funcs->ProcessChunk(
-        curChunk, iter->minTimestamp, iter->maxTimestamp, iter->enrichedChunk, iter->reverse_chunk);
-    if (!iter->DictGetNext(iter->dictIter, NULL, (void *)&iter->currentChunk)) {
-        iter->currentChunk = NULL;
+    if (hasStaged) {
+        iter->series->funcs->ProcessChunk(
+            curChunk, iter->minTimestamp, iter->maxTimestamp, iter->enrichedChunk, false);
+        mergeStaged(iter, stagedBegin, stagedEnd);
+    } else if ((stats = summarizeChunk(iter, curChunk))) {
+        // pass on the first sample in iteration order along with the stats of the whole chunk
+        const Sample *first = iter->reverse_chunk ? &stats->last : &stats->first;
+        ResetEnrichedChunk(iter->enrichedChunk);
+        iter->enrichedChunk->rev = iter->reverse_chunk;
+        iter->enrichedChunk->stats = stats;
+        iter->enrichedChunk->samples.num_samples = 1;
+        *iter->enrichedChunk->samples.timestamps = first->timestamp;
+        *iter->enrichedChunk->samples.values = first->value;
+    } else {
+        iter->series->funcs->ProcessChunk(curChunk,
+                                          iter->minTimestamp,
+                                          iter->maxTimestamp,
+                                          iter->enrichedChunk,
+                                          iter->reverse_chunk);
     }
+    timestamp_t curChunkLastTs = ChunkDir_At(iter->series->chunks, iter->chunkIdx)->lastTs;
+    nextChunk(iter);
 
-    if (unlikely(!iter->reverse &&
-                 iter->series->funcs->GetLastTimestamp(curChunk) < iter->minTimestamp)) {
+    if (unlikely(!iter->reverse && curChunkLastTs < iter->minTimestamp &&
+                 iter->enrichedChunk->samples.num_samples == 0)) {
         // In forward iterator it's possible that the minTimestamp is located between the 1st chunk
         // and the 2nd in this case the first proces chunk will result in an empty result and we
         // need to continue to process the 2nd chunk
@@ -15,7 +15,8 @@ typedef struct SeriesIterator
 {
     AbstractIterator base;
     Series *series;
-    RedisModuleDictIter *dictIter; // iterator over chunks
+    size_t chunkIdx; // index of the current chunk in the chunk directory
+    bool inlineDone; // the inline samples of a small series were passed on
     Chunk_t *currentChunk;
     EnrichedChunk *enrichedChunk;
     EnrichedChunk *enrichedChunkAux; // auxiliary chunk to represent reverse chunk
@@ -24,7 +25,11 @@ typedef struct SeriesIterator
     bool reverse;
     bool reverse_chunk;
     bool latest;
-    void *(*DictGetNext)(RedisModuleDictIter *di, size_t *keylen, void **dataptr);
+    // chunks without any sample matching the filter are skipped without being decoded
+    FilterByValueArgs valueFilter;
+    // when set, chunks within a single bucket are summarized by their stats instead of decoded
+    int64_t summaryBucketDuration;
+    timestamp_t summaryAlignment;
 } SeriesIterator;
 
 struct AbstractIterator *SeriesIterator_New(Series *series,
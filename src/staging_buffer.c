@@ -0,0 +1,90 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#include "staging_buffer.h"
+
+#include <string.h>
+#include "rmutil/alloc.h"
+
+#define STAGING_BUFFER_INIT_CAPACITY 8
+
+static void reallocSamples(StagingBuffer *buf, size_t capacity) {
+    buf->timestamps = (timestamp_t *)realloc(buf->timestamps, capacity * sizeof(timestamp_t));
+    buf->values = (double *)realloc(buf->values, capacity * sizeof(double));
+    buf->policies = (u_int8_t *)realloc(buf->policies, capacity * sizeof(u_int8_t));
+    buf->capacity = capacity;
+}
+
+StagingBuffer *StagingBuffer_New() {
+    StagingBuffer *buf = (StagingBuffer *)calloc(1, sizeof(StagingBuffer));
+    reallocSamples(buf, STAGING_BUFFER_INIT_CAPACITY);
+    return buf;
+}
+
+void StagingBuffer_Free(StagingBuffer *buf) {
+    free(buf->timestamps);
+    free(buf->values);
+    free(buf->policies);
+    free(buf);
+}
+
+StagingBuffer *StagingBuffer_Clone(const StagingBuffer *buf) {
+    StagingBuffer *clone = StagingBuffer_New();
+    if (buf->count > clone->capacity) {
+        reallocSamples(clone, buf->count);
+    }
+    memcpy(clone->timestamps, buf->timestamps, buf->count * sizeof(timestamp_t));
+    memcpy(clone->values, buf->values, buf->count * sizeof(double));
+    memcpy(clone->policies, buf->policies, buf->count * sizeof(u_int8_t));
+    clone->count = buf->count;
+    clone->newSamples = buf->newSamples;
+    clone->since = buf->since;
+    return clone;
+}
+
+size_t StagingBuffer_LowerBound(const StagingBuffer *buf, timestamp_t ts) {
+    size_t lo = 0, hi = buf->count;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (buf->timestamps[mid] < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+ChunkResult StagingBuffer_Add(StagingBuffer *buf, Sample sample, DuplicatePolicy policy) {
+    size_t idx = StagingBuffer_LowerBound(buf, sample.timestamp);
+    if (idx < buf->count && buf->timestamps[idx] == sample.timestamp) {
+        Sample staged = { .timestamp = buf->timestamps[idx], .value = buf->values[idx] };
+        if (handleDuplicateSample(policy, staged, &sample) != CR_OK) {
+            return CR_ERR;
+        }
+        buf->values[idx] = sample.value;
+        buf->policies[idx] = policy;
+        return CR_OK;
+    }
+
+    if (buf->count == buf->capacity) {
+        reallocSamples(buf, buf->capacity * 2);
+    }
+    size_t tail = buf->count - idx;
+    memmove(&buf->timestamps[idx + 1], &buf->timestamps[idx], tail * sizeof(timestamp_t));
+    memmove(&buf->values[idx + 1], &buf->values[idx], tail * sizeof(double));
+    memmove(&buf->policies[idx + 1], &buf->policies[idx], tail * sizeof(u_int8_t));
+    buf->timestamps[idx] = sample.timestamp;
+    buf->values[idx] = sample.value;
+    buf->policies[idx] = policy;
+    buf->count++;
+    return CR_OK;
+}
+
+size_t StagingBuffer_MemUsage(const StagingBuffer *buf) {
+    return sizeof(*buf) +
+           buf->capacity * (sizeof(timestamp_t) + sizeof(double) + sizeof(u_int8_t));
+}
@@ -0,0 +1,41 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+
+#ifndef STAGING_BUFFER_H
+#define STAGING_BUFFER_H
+
+#include "generic_chunk.h"
+
+#include <stddef.h>    // size_t
+#include <sys/types.h> // u_int_t
+
+// Out of order samples of a series waiting to be merged into its chunks, sorted by timestamp.
+// Each sample keeps the duplicate policy it was added with, it is applied when it is merged. A
+// series only has a buffer while it has staged samples.
+typedef struct StagingBuffer
+{
+    timestamp_t *timestamps;
+    double *values;
+    u_int8_t *policies;
+    size_t count;
+    size_t capacity;
+    size_t newSamples; // staged samples whose timestamp isn't in the chunks, set by the series
+    timestamp_t since; // last timestamp of the series when the first sample was staged
+} StagingBuffer;
+
+StagingBuffer *StagingBuffer_New();
+void StagingBuffer_Free(StagingBuffer *buf);
+StagingBuffer *StagingBuffer_Clone(const StagingBuffer *buf);
+
+// Index of the first sample whose timestamp is >= ts, count if there is none
+size_t StagingBuffer_LowerBound(const StagingBuffer *buf, timestamp_t ts);
+// Stages the sample. A sample staged with the same timestamp is replaced according to the policy,
+// returns CR_ERR if the policy rejects the sample. Duplicates must be staged under the same policy,
+// their combined value is merged into the chunks under it.
+ChunkResult StagingBuffer_Add(StagingBuffer *buf, Sample sample, DuplicatePolicy policy);
+size_t StagingBuffer_MemUsage(const StagingBuffer *buf);
+
+#endif // STAGING_BUFFER_H
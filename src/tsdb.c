@@ -7,8 +7,8 @@
 
 #include "config.h"
 #include "consts.h"
-#include "endianconv.h"
 #include "filter_iterator.h"
+#include "hybrid_chunk.h"
 #include "indexer.h"
 #include "module.h"
 #include "series_iterator.h"
@@ -21,12 +21,31 @@
 #include <math.h>
 #include <stdlib.h>
 #include <assert.h> // assert
+#include <time.h>
 #include "rmutil/alloc.h"
 #include "rmutil/logging.h"
 #include "rmutil/strings.h"
 
+// interval of the retention sweeper and time it may spend per tick, it only trims the keys idle
+// for RETENTION_SWEEP_IDLE_MS
+#define RETENTION_SWEEP_INTERVAL_MS 100
+#define RETENTION_SWEEP_BUDGET_US 1000
+#define RETENTION_SWEEP_IDLE_MS 1000
+// CHUNK_SIZE AUTO picks power of two sizes in [AUTO_CHUNK_MIN_SIZE, AUTO_CHUNK_MAX_SIZE] so that a
+// chunk spans about AUTO_CHUNK_FILL_MS of sample timestamps
+#define AUTO_CHUNK_MIN_SIZE 256
+#define AUTO_CHUNK_MAX_SIZE (64 * 1024)
+#define AUTO_CHUNK_FILL_MS (60 * 1000)
+
 static RedisModuleString *renameFromKey = NULL;
 
+static void freeStaged(Series *series) {
+    if (series->staged) {
+        StagingBuffer_Free(series->staged);
+        series->staged = NULL;
+    }
+}
+
 void deleteReferenceToDeletedSeries(RedisModuleCtx *ctx, Series *series) {
     Series *_series;
     RedisModuleKey *_key;
@@ -104,24 +123,12 @@ int GetSeries(RedisModuleCtx *ctx,
     return TRUE;
 }
 
-int dictOperator(RedisModuleDict *d, void *chunk, timestamp_t ts, DictOp op) {
-    timestamp_t rax_key = htonu64(ts);
-    switch (op) {
-        case DICT_OP_SET:
-            return RedisModule_DictSetC(d, &rax_key, sizeof(rax_key), chunk);
-        case DICT_OP_REPLACE:
-            return RedisModule_DictReplaceC(d, &rax_key, sizeof(rax_key), chunk);
-        case DICT_OP_DEL:
-            return RedisModule_DictDelC(d, &rax_key, sizeof(rax_key), NULL);
-    }
-    chunk = NULL;
-    return REDISMODULE_OK; // silence compiler
-}
-
 Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx) {
-    Series *newSeries = (Series *)calloc(1, sizeof(Series));
+    // a series created without a chunk is filled with chunks by the caller
+    size_t inlineCapacity = cCtx->skipChunkCreation ? 0 : SERIES_INLINE_SAMPLES;
+    Series *newSeries = (Series *)calloc(1, sizeof(Series) + inlineCapacity * sizeof(Sample));
     newSeries->keyName = keyName;
-    newSeries->chunks = RedisModule_CreateDict(NULL);
+    newSeries->inlineCapacity = inlineCapacity;
     newSeries->chunkSizeBytes = cCtx->chunkSizeBytes;
     newSeries->retentionTime = cCtx->retentionTime;
     newSeries->srcKey = NULL;
@@ -134,65 +141,95 @@ Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx) {
     newSeries->options = cCtx->options;
     newSeries->duplicatePolicy = cCtx->duplicatePolicy;
     newSeries->in_ram = true;
+    if (newSeries->chunkSizeBytes == CHUNK_SIZE_AUTO) {
+        newSeries->options |= SERIES_OPT_AUTO_CHUNK_SIZE;
+        newSeries->chunkSizeBytes = Chunk_SIZE_BYTES_SECS;
+    }
 
     if (newSeries->options & SERIES_OPT_UNCOMPRESSED) {
         newSeries->options |= SERIES_OPT_UNCOMPRESSED;
         newSeries->funcs = GetChunkClass(CHUNK_REGULAR);
+    } else if (newSeries->options & SERIES_OPT_COMPRESSED_DECIMAL) {
+        newSeries->funcs = GetChunkClass(CHUNK_COMPRESSED_DECIMAL);
+    } else if (newSeries->options & SERIES_OPT_HYBRID) {
+        newSeries->funcs = GetChunkClass(CHUNK_HYBRID);
     } else {
         newSeries->options |= SERIES_OPT_COMPRESSED_GORILLA;
         newSeries->funcs = GetChunkClass(CHUNK_COMPRESSED);
     }
 
-    if (!cCtx->skipChunkCreation) {
-        Chunk_t *newChunk = newSeries->funcs->NewChunk(newSeries->chunkSizeBytes);
-        dictOperator(newSeries->chunks, newChunk, 0, DICT_OP_SET);
-        newSeries->lastChunk = newChunk;
-    } else {
-        newSeries->lastChunk = NULL;
+    // the samples start inline, the chunks are allocated once they outgrow the series
+    if (cCtx->skipChunkCreation) {
+        newSeries->chunks = ChunkDir_New();
     }
+    newSeries->lastChunk = NULL;
 
     return newSeries;
 }
 
 void SeriesTrim(Series *series, timestamp_t startTs, timestamp_t endTs) {
     // if not causedByRetention, caused by ts.del
-    if (series->retentionTime == 0) {
+    // the inline samples are kept like the last chunk
+    if (series->retentionTime == 0 || SeriesIsInline(series)) {
         return;
     }
 
-    // start iterator from smallest key
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-
-    Chunk_t *currentChunk;
-    void *currentKey;
-    size_t keyLen;
     timestamp_t minTimestamp = series->lastTimestamp > series->retentionTime
                                    ? series->lastTimestamp - series->retentionTime
                                    : 0;
 
-    const ChunkFuncs *funcs = series->funcs;
-    while ((currentKey = RedisModule_DictNextC(iter, &keyLen, (void *)&currentChunk))) {
-        if (funcs->GetLastTimestamp(currentChunk) >= minTimestamp) {
-            break;
-        }
+    // the chunks ending before the retention window are all at the start of the directory, the
+    // last chunk is always kept
+    size_t expired = ChunkDir_Ceil(series->chunks, minTimestamp);
+    if (expired == ChunkDir_Size(series->chunks)) {
+        expired--;
+    }
+    for (size_t i = 0; i < expired; i++) {
+        ChunkDirEntry *entry = ChunkDir_At(series->chunks, i);
+        series->totalSamples -= entry->count;
+        series->funcs->FreeChunk(entry->chunk);
+    }
+    ChunkDir_Remove(series->chunks, 0, expired);
+}
 
-        RedisModule_DictDelC(series->chunks, currentKey, keyLen, NULL);
-        // reseek iterator since we modified the dict,
-        // go to first element that is bigger than current key
-        RedisModule_DictIteratorReseekC(iter, ">", currentKey, keyLen);
+static ChunkCoalesceStats coalesceStats = { 0 };
 
-        series->totalSamples -= funcs->GetNumOfSample(currentChunk);
-        funcs->FreeChunk(currentChunk);
+size_t SeriesCoalesceChunks(Series *series) {
+    if (SeriesIsInline(series)) {
+        return 0;
     }
-
-    RedisModule_DictIteratorStop(iter);
+    const ChunkFuncs *funcs = series->funcs;
+    ChunkDir *chunks = series->chunks;
+    size_t merged = 0;
+    size_t i = 0;
+    // the last chunk is still being filled, the merged chunk is tried again with the next one
+    while (i + 2 < ChunkDir_Size(chunks)) {
+        ChunkDirEntry *entry = ChunkDir_At(chunks, i);
+        ChunkDirEntry *next = ChunkDir_At(chunks, i + 1);
+        Chunk_t *chunk = funcs->MergeChunk(entry->chunk, next->chunk, series->chunkSizeBytes);
+        if (chunk == NULL) {
+            i++;
+            continue;
+        }
+        size_t oldSize =
+            funcs->GetChunkSize(entry->chunk, true) + funcs->GetChunkSize(next->chunk, true);
+        size_t newSize = funcs->GetChunkSize(chunk, true);
+        if (oldSize > newSize) {
+            coalesceStats.bytesSaved += oldSize - newSize;
+        }
+        funcs->FreeChunk(entry->chunk);
+        funcs->FreeChunk(next->chunk);
+        entry->chunk = chunk;
+        ChunkDir_Refresh(chunks, i, funcs);
+        ChunkDir_Remove(chunks, i + 1, 1);
+        merged++;
+    }
+    coalesceStats.mergedChunks += merged;
+    return merged;
 }
 
-// Encode timestamps as bigendian to allow correct lexical sorting
-void seriesEncodeTimestamp(void *buf, timestamp_t timestamp) {
-    uint64_t e;
-    e = htonu64(timestamp);
-    memcpy(buf, &e, sizeof(e));
+void SeriesGetCoalesceStats(ChunkCoalesceStats *stats) {
+    *stats = coalesceStats;
 }
 
 void RestoreKey(RedisModuleCtx *ctx, RedisModuleString *keyname) {
@@ -346,8 +383,12 @@ cleanup:
 
 void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const void *value) {
     Series *src = (Series *)value;
-    Series *dst = (Series *)calloc(1, sizeof(Series));
-    memcpy(dst, src, sizeof(Series));
+    // the inline capacity of a series which outgrew it isn't copied
+    uint32_t inlineCapacity = SeriesIsInline(src) ? src->inlineCapacity : 0;
+    size_t size = sizeof(Series) + inlineCapacity * sizeof(Sample);
+    Series *dst = (Series *)malloc(size);
+    memcpy(dst, src, size);
+    dst->inlineCapacity = inlineCapacity;
     RedisModule_RetainString(NULL, tokey);
     dst->keyName = tokey;
 
@@ -361,23 +402,26 @@ void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const voi
     }
 
     // Copy chunks
-    dst->chunks = RedisModule_CreateDict(NULL);
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(src->chunks, "^", NULL, 0);
-    Chunk_t *curChunk;
-    char *curKey;
-    size_t keylen;
-    while ((curKey = RedisModule_DictNextC(iter, &keylen, &curChunk)) != NULL) {
-        Chunk_t *newChunk = src->funcs->CloneChunk(curChunk);
-        RedisModule_DictSetC(dst->chunks, curKey, keylen, newChunk);
-        if (src->lastChunk == curChunk) {
-            dst->lastChunk = newChunk;
+    if (!SeriesIsInline(src)) {
+        dst->chunks = ChunkDir_New();
+        for (size_t i = 0; i < ChunkDir_Size(src->chunks); i++) {
+            Chunk_t *curChunk = ChunkDir_At(src->chunks, i)->chunk;
+            Chunk_t *newChunk = src->funcs->CloneChunk(curChunk);
+            ChunkDir_Insert(dst->chunks, newChunk, src->funcs);
+            if (src->lastChunk == curChunk) {
+                dst->lastChunk = newChunk;
+            }
         }
     }
 
-    RedisModule_DictIteratorStop(iter);
+    if (src->staged) {
+        dst->staged = StagingBuffer_Clone(src->staged);
+    }
 
     dst->srcKey = NULL;
     dst->rules = NULL;
+    dst->rollupQueries = 0;
+    dst->rollupHits = 0;
 
     RemoveIndexedMetric(tokey); // in case of replace
     if (dst->labelsCount > 0) {
@@ -396,17 +440,16 @@ void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const voi
 // notification.
 void FreeSeries(void *value) {
     Series *series = (Series *)value;
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    Chunk_t *currentChunk;
-    while (RedisModule_DictNextC(iter, NULL, (void *)&currentChunk) != NULL) {
-        series->funcs->FreeChunk(currentChunk);
+    if (!SeriesIsInline(series)) {
+        for (size_t i = 0; i < ChunkDir_Size(series->chunks); i++) {
+            series->funcs->FreeChunk(ChunkDir_At(series->chunks, i)->chunk);
+        }
+        ChunkDir_Free(series->chunks);
     }
-    RedisModule_DictIteratorStop(iter);
+    freeStaged(series);
 
     FreeLabels(series->labels, series->labelsCount);
 
-    RedisModule_FreeDict(NULL, series->chunks);
-
     CompactionRule *rule = series->rules;
     while (rule != NULL) {
         CompactionRule *nextRule = rule->nextRule;
@@ -424,6 +467,21 @@ void FreeSeries(void *value) {
     free(series);
 }
 
+// Called on the main thread when the key is removed. A large series is then released by a
+// background thread, it's detached from the module's lists first. The series may also live on under
+// another key (RENAME, MOVE), so nothing is dropped: the staged samples are merged, the dirty
+// buckets are written and the queued chunks are sealed.
+void UnlinkSeries(RedisModuleString *key, const void *value) {
+    Series *series = (Series *)value;
+    SeriesFlushStaged(series);
+    SeriesFlushDirtyBuckets();
+    if ((series->options & SERIES_OPT_HYBRID) && !SeriesIsInline(series)) {
+        for (size_t i = 0; i < ChunkDir_Size(series->chunks); i++) {
+            Hybrid_SealChunk(ChunkDir_At(series->chunks, i)->chunk);
+        }
+    }
+}
+
 void FreeCompactionRule(void *value) {
     CompactionRule *rule = (CompactionRule *)value;
     RedisModule_FreeString(NULL, rule->destKey);
@@ -432,13 +490,11 @@ void FreeCompactionRule(void *value) {
 }
 
 size_t SeriesGetChunksSize(Series *series) {
+    // the inline samples are accounted as part of the series
     size_t size = 0;
-    Chunk_t *currentChunk;
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
-    while (RedisModule_DictNextC(iter, NULL, (void *)&currentChunk)) {
-        size += series->funcs->GetChunkSize(currentChunk, true);
+    for (size_t i = 0; !SeriesIsInline(series) && i < ChunkDir_Size(series->chunks); i++) {
+        size += series->funcs->GetChunkSize(ChunkDir_At(series->chunks, i)->chunk, true);
     }
-    RedisModule_DictIteratorStop(iter);
     return size;
 }
 
@@ -473,14 +529,92 @@ size_t SeriesMemUsage(const void *value) {
         rule = rule->nextRule;
     }
 
-    return sizeof(series) + rulesSize + labelsLen + sizeof(Label) * series->labelsCount +
-           SeriesGetChunksSize(series);
+    size_t stagedSize = series->staged ? StagingBuffer_MemUsage(series->staged) : 0;
+
+    return sizeof(series) + series->inlineCapacity * sizeof(Sample) + rulesSize + labelsLen +
+           sizeof(Label) * series->labelsCount + SeriesGetChunksSize(series) + stagedSize;
+}
+
+size_t SeriesFreeEffort(RedisModuleString *key, const void *value) {
+    const Series *series = value;
+    return 1 + series->labelsCount + SeriesChunkCount(series);
+}
+
+// Returns ptr when it wasn't moved
+static void *defragAlloc(RedisModuleDefragCtx *ctx, void *ptr) {
+    void *moved = ptr ? RedisModule_DefragAlloc(ctx, ptr) : NULL;
+    return moved ? moved : ptr;
+}
+
+static RedisModuleString *defragString(RedisModuleDefragCtx *ctx, RedisModuleString *str) {
+    RedisModuleString *moved = str ? RedisModule_DefragRedisModuleString(ctx, str) : NULL;
+    return moved ? moved : str;
+}
+
+static void defragStaged(RedisModuleDefragCtx *ctx, Series *series) {
+    StagingBuffer *buf = defragAlloc(ctx, series->staged);
+    buf->timestamps = defragAlloc(ctx, buf->timestamps);
+    buf->values = defragAlloc(ctx, buf->values);
+    buf->policies = defragAlloc(ctx, buf->policies);
+    series->staged = buf;
+}
+
+// Moves the series and everything it owns but the chunks, returns the series' new address
+static Series *defragSeriesMeta(RedisModuleDefragCtx *ctx, Series *series) {
+    series = defragAlloc(ctx, series);
+    if (series->staged) {
+        defragStaged(ctx, series);
+    }
+    series->keyName = defragString(ctx, series->keyName);
+    series->srcKey = defragString(ctx, series->srcKey);
+
+    series->labels = defragAlloc(ctx, series->labels);
+    for (size_t i = 0; i < series->labelsCount; i++) {
+        series->labels[i].key = defragString(ctx, series->labels[i].key);
+        series->labels[i].value = defragString(ctx, series->labels[i].value);
+    }
+
+    for (CompactionRule **rule = &series->rules; *rule; rule = &(*rule)->nextRule) {
+        *rule = defragAlloc(ctx, *rule);
+        (*rule)->destKey = defragString(ctx, (*rule)->destKey);
+    }
+
+    if (!SeriesIsInline(series)) {
+        series->chunks = ChunkDir_Defrag(ctx, series->chunks);
+    }
+    return series;
+}
+
+int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value) {
+    // there is a cursor only when the series is defragmented in steps, it's the next chunk
+    unsigned long cursor = 0;
+    RedisModule_DefragCursorGet(ctx, &cursor);
+
+    Series *series = *value;
+    if (cursor == 0) {
+        series = defragSeriesMeta(ctx, series);
+        *value = series;
+    }
+
+    for (size_t i = cursor; !SeriesIsInline(series) && i < ChunkDir_Size(series->chunks); i++) {
+        if (i > cursor && RedisModule_DefragShouldStop(ctx)) {
+            RedisModule_DefragCursorSet(ctx, i);
+            return 1;
+        }
+        ChunkDirEntry *entry = ChunkDir_At(series->chunks, i);
+        Chunk_t *chunk = series->funcs->DefragChunk(ctx, entry->chunk);
+        if (entry->chunk == series->lastChunk) {
+            series->lastChunk = chunk;
+        }
+        entry->chunk = chunk;
+    }
+    return 0;
 }
 
 size_t SeriesGetNumSamples(const Series *series) {
     size_t numSamples = 0;
     if (series != NULL) {
-        numSamples = series->totalSamples;
+        numSamples = series->totalSamples + (series->staged ? series->staged->newSamples : 0);
     }
     return numSamples;
 }
@@ -528,92 +662,624 @@ static bool RuleSeriesUpsertSample(RedisModuleCtx *ctx,
     return true;
 }
 
-static void upsertCompaction(Series *series, UpsertCtx *uCtx) {
-    if (series->rules == NULL) {
+// Value of the sample at timestamp, false if there is none
+static bool seriesValueAt(Series *series, timestamp_t timestamp, double *value) {
+    RangeArgs args = { .aggregationArgs = { 0 },
+                       .filterByValueArgs = { 0 },
+                       .filterByTSArgs = { 0 },
+                       .startTimestamp = timestamp,
+                       .endTimestamp = timestamp };
+    Sample sample;
+    AbstractSampleIterator *iterator = SeriesCreateSampleIterator(series, &args, false, false);
+    bool found = iterator->GetNext(iterator, &sample) == CR_OK;
+    iterator->Close(iterator);
+    if (found) {
+        *value = sample.value;
+    }
+    return found;
+}
+
+// A closed bucket of a rule that late samples went into. The bucket is written to the dest once,
+// at the end of the command, whatever the number of samples.
+typedef struct DirtyBucket
+{
+    Series *series;
+    CompactionRule *rule;
+    timestamp_t start;
+    // the sample the bucket was marked for, it's folded into the value the rule already wrote
+    // unless more samples went into the bucket
+    bool recompute;
+    bool replaced;
+    double value;
+    double oldValue;
+} DirtyBucket;
+
+// sorted by series, rule and start so the buckets of a rule are written with one open of its dest
+static DirtyBucket *dirtyBuckets = NULL;
+static size_t dirtyCount = 0;
+static size_t dirtyCapacity = 0;
+
+static int compareDirtyBucket(const DirtyBucket *bucket,
+                              const Series *series,
+                              const CompactionRule *rule,
+                              timestamp_t start) {
+    if (bucket->series != series) {
+        return (uintptr_t)bucket->series < (uintptr_t)series ? -1 : 1;
+    }
+    if (bucket->rule != rule) {
+        return (uintptr_t)bucket->rule < (uintptr_t)rule ? -1 : 1;
+    }
+    return bucket->start < start ? -1 : bucket->start > start;
+}
+
+// Marks the closed bucket of the rule starting at start, uCtx is the upsert that went into it or
+// NULL when it has to be recomputed
+static void markDirtyBucket(Series *series,
+                            CompactionRule *rule,
+                            timestamp_t start,
+                            const UpsertCtx *uCtx) {
+    size_t lo = 0, hi = dirtyCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (compareDirtyBucket(&dirtyBuckets[mid], series, rule, start) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    if (lo < dirtyCount && compareDirtyBucket(&dirtyBuckets[lo], series, rule, start) == 0) {
+        dirtyBuckets[lo].recompute = true;
         return;
     }
-    deleteReferenceToDeletedSeries(rts_staticCtx, series);
-    CompactionRule *rule = series->rules;
-    const timestamp_t upsertTimestamp = uCtx->sample.timestamp;
-    const timestamp_t seriesLastTimestamp = series->lastTimestamp;
-    while (rule != NULL) {
-        const timestamp_t ruleTimebucket = rule->bucketDuration;
-        const timestamp_t curAggWindowStart =
-            CalcBucketStart(seriesLastTimestamp, ruleTimebucket, rule->timestampAlignment);
-        const timestamp_t curAggWindowStartNormalized = BucketStartNormalize(curAggWindowStart);
-        if (upsertTimestamp >= curAggWindowStartNormalized) {
-            // upsert in latest timebucket
-            const int rv = SeriesCalcRange(series,
-                                           curAggWindowStartNormalized,
-                                           curAggWindowStart + ruleTimebucket - 1,
+
+    if (dirtyCount == dirtyCapacity) {
+        dirtyCapacity = dirtyCapacity ? dirtyCapacity * 2 : 16;
+        dirtyBuckets = realloc(dirtyBuckets, dirtyCapacity * sizeof(DirtyBucket));
+    }
+    memmove(&dirtyBuckets[lo + 1], &dirtyBuckets[lo], (dirtyCount - lo) * sizeof(DirtyBucket));
+    dirtyBuckets[lo] = (DirtyBucket){ .series = series,
+                                      .rule = rule,
+                                      .start = start,
+                                      .recompute = uCtx == NULL,
+                                      .replaced = uCtx && uCtx->replaced,
+                                      .value = uCtx ? uCtx->sample.value : 0,
+                                      .oldValue = uCtx ? uCtx->oldValue : 0 };
+    dirtyCount++;
+}
+
+// Folds the sample the bucket was marked for into the value the rule already wrote to the dest,
+// instead of aggregating all the samples of the bucket again. Returns false when the bucket has to
+// be recomputed, that is when the aggregation needs more than its result, the dest has no value
+// for the bucket yet or the value may lack samples added before the rule.
+static bool updateDirtyBucket(const DirtyBucket *bucket, Series *destSeries, double *val) {
+    const Series *series = bucket->series;
+    const timestamp_t startNormalized = BucketStartNormalize(bucket->start);
+    if (bucket->recompute || bucket->rule->aggClass->updateFinalized == NULL ||
+        isnan(bucket->value) || (bucket->replaced && isnan(bucket->oldValue)) ||
+        startNormalized < destSeries->rollupStart) {
+        return false;
+    }
+    if (series->retentionTime > 0 && series->lastTimestamp > series->retentionTime &&
+        startNormalized < series->lastTimestamp - series->retentionTime) {
+        // a recompute would only aggregate the samples within the retention
+        return false;
+    }
+    return seriesValueAt(destSeries, startNormalized, val) &&
+           bucket->rule->aggClass->updateFinalized(
+               val, bucket->value, bucket->replaced, bucket->oldValue);
+}
+
+// Writes the dirty buckets of a rule, they all go to the same dest
+static void flushRuleBuckets(const DirtyBucket *buckets, size_t count) {
+    CompactionRule *rule = buckets[0].rule;
+    RedisModuleKey *key;
+    Series *destSeries;
+    if (!GetSeries(rts_staticCtx,
+                   rule->destKey,
+                   &key,
+                   &destSeries,
+                   REDISMODULE_READ | REDISMODULE_WRITE,
+                   false,
+                   false)) {
+        RedisModule_Log(rts_staticCtx, "verbose", "%s", "Failed to retrieve downsample series");
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        const timestamp_t start = buckets[i].start;
+        const timestamp_t startNormalized = BucketStartNormalize(start);
+        double val = 0;
+        if (!updateDirtyBucket(&buckets[i], destSeries, &val)) {
+            // ensure last include/exclude
+            const int rv = SeriesCalcRange(buckets[i].series,
+                                           startNormalized,
+                                           start + rule->bucketDuration - 1,
                                            rule,
-                                           NULL,
+                                           &val,
                                            NULL);
             if (rv == TSDB_ERROR) {
                 RedisModule_Log(
                     rts_staticCtx, "verbose", "%s", "Failed to calculate range for downsample");
                 continue;
             }
+        }
+
+        if (destSeries->totalSamples == 0) {
+            SeriesAddSample(destSeries, startNormalized, val);
         } else {
-            const timestamp_t start =
-                CalcBucketStart(upsertTimestamp, ruleTimebucket, rule->timestampAlignment);
-            const timestamp_t startNormalized = BucketStartNormalize(start);
-            // ensure last include/exclude
-            double val = 0;
-            const int rv = SeriesCalcRange(
-                series, startNormalized, start + ruleTimebucket - 1, rule, &val, NULL);
-            if (rv == TSDB_ERROR) {
-                RedisModule_Log(
-                    rts_staticCtx, "verbose", "%s", "Failed to calculate range for downsample");
-                continue;
+            SeriesUpsertSample(destSeries, startNormalized, val, DP_LAST);
+        }
+    }
+    RedisModule_CloseKey(key);
+}
+
+void SeriesFlushDirtyBuckets(void) {
+    // writing to a dest may mark the buckets of its own rules, they are flushed on the next round
+    while (dirtyCount > 0) {
+        DirtyBucket *buckets = dirtyBuckets;
+        size_t count = dirtyCount;
+        dirtyBuckets = NULL;
+        dirtyCount = dirtyCapacity = 0;
+
+        size_t begin = 0;
+        for (size_t i = 1; i <= count; i++) {
+            if (i == count || buckets[i].series != buckets[begin].series ||
+                buckets[i].rule != buckets[begin].rule) {
+                flushRuleBuckets(&buckets[begin], i - begin);
+                begin = i;
+            }
+        }
+        free(buckets);
+    }
+}
+
+// Updates the bucket of the rule holding timestamp. The latest bucket is aggregated again in the
+// rule's context, a closed one is marked dirty.
+static void upsertRuleBucket(Series *series,
+                             CompactionRule *rule,
+                             timestamp_t timestamp,
+                             const UpsertCtx *uCtx) {
+    const timestamp_t ruleTimebucket = rule->bucketDuration;
+    const timestamp_t curAggWindowStart =
+        CalcBucketStart(series->lastTimestamp, ruleTimebucket, rule->timestampAlignment);
+    const timestamp_t curAggWindowStartNormalized = BucketStartNormalize(curAggWindowStart);
+    if (timestamp >= curAggWindowStartNormalized) {
+        // upsert in latest timebucket
+        const int rv = SeriesCalcRange(series,
+                                       curAggWindowStartNormalized,
+                                       curAggWindowStart + ruleTimebucket - 1,
+                                       rule,
+                                       NULL,
+                                       NULL);
+        if (rv == TSDB_ERROR) {
+            RedisModule_Log(
+                rts_staticCtx, "verbose", "%s", "Failed to calculate range for downsample");
+        }
+    } else {
+        markDirtyBucket(series,
+                        rule,
+                        CalcBucketStart(timestamp, ruleTimebucket, rule->timestampAlignment),
+                        uCtx);
+    }
+}
+
+static void upsertCompaction(Series *series, UpsertCtx *uCtx) {
+    if (series->rules == NULL) {
+        return;
+    }
+    deleteReferenceToDeletedSeries(rts_staticCtx, series);
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        upsertRuleBucket(series, rule, uCtx->sample.timestamp, uCtx);
+    }
+}
+
+void SeriesStagedSlot(const Series *series, size_t idx, size_t *begin, size_t *end) {
+    const StagingBuffer *buf = series->staged;
+    if (!buf) {
+        *begin = *end = 0;
+        return;
+    }
+    // staged samples older than the first chunk are merged into it
+    *begin = idx == 0 ? 0 : StagingBuffer_LowerBound(buf, ChunkDir_At(series->chunks, idx)->firstTs);
+    *end = idx + 1 < ChunkDir_Size(series->chunks)
+               ? StagingBuffer_LowerBound(buf, ChunkDir_At(series->chunks, idx + 1)->firstTs)
+               : buf->count;
+}
+
+static inline void appendMerged(const ChunkFuncs *funcs,
+                                size_t chunkSizeBytes,
+                                Sample *sample,
+                                Chunk_t ***out,
+                                size_t *numChunks) {
+    if (funcs->AddSample((*out)[*numChunks - 1], sample) == CR_END) {
+        *out = (Chunk_t **)realloc(*out, (*numChunks + 1) * sizeof(Chunk_t *));
+        (*out)[(*numChunks)++] = funcs->NewChunk(chunkSizeBytes);
+        funcs->AddSample((*out)[*numChunks - 1], sample);
+    }
+}
+
+size_t SeriesInlineChunks(const Series *series, Chunk_t ***out) {
+    *out = NULL;
+    if (series->inlineCount == 0) {
+        return 0;
+    }
+    size_t numChunks = 1;
+    *out = (Chunk_t **)malloc(sizeof(Chunk_t *));
+    (*out)[0] = series->funcs->NewChunk(series->chunkSizeBytes);
+    for (uint32_t i = 0; i < series->inlineCount; i++) {
+        Sample sample = series->inlineSamples[i];
+        appendMerged(series->funcs, series->chunkSizeBytes, &sample, out, &numChunks);
+    }
+    return numChunks;
+}
+
+void SeriesPromoteInline(Series *series) {
+    Chunk_t **chunks;
+    size_t numChunks = SeriesInlineChunks(series, &chunks);
+    series->chunks = ChunkDir_New();
+    if (numChunks == 0) {
+        series->lastChunk = series->funcs->NewChunk(series->chunkSizeBytes);
+        ChunkDir_Insert(series->chunks, series->lastChunk, series->funcs);
+    } else {
+        for (size_t i = 0; i < numChunks; i++) {
+            ChunkDir_Insert(series->chunks, chunks[i], series->funcs);
+        }
+        series->lastChunk = chunks[numChunks - 1];
+    }
+    free(chunks);
+    series->inlineCount = 0;
+}
+
+Series *SeriesReleaseInlineArea(RedisModuleKey *key, Series *series) {
+    // the dirty buckets keep pointers to their series until the end of the command
+    if (SeriesIsInline(series) || series->inlineCapacity == 0 || dirtyCount > 0) {
+        return series;
+    }
+    series = (Series *)realloc(series, sizeof(Series));
+    series->inlineCapacity = 0;
+    if (key != NULL) {
+        RedisModule_ModuleTypeReplaceValue(key, SeriesType, series, NULL);
+    }
+    return series;
+}
+
+void SeriesShrinkToInline(Series *series) {
+    if (SeriesIsInline(series) || series->staged) {
+        return;
+    }
+    size_t numSamples = 0;
+    for (size_t i = 0; i < ChunkDir_Size(series->chunks); i++) {
+        numSamples += ChunkDir_At(series->chunks, i)->count;
+    }
+    if (numSamples > series->inlineCapacity) {
+        return;
+    }
+
+    EnrichedChunk *decoded = NewEnrichedChunk();
+    uint32_t count = 0;
+    for (size_t i = 0; i < ChunkDir_Size(series->chunks); i++) {
+        const ChunkDirEntry *entry = ChunkDir_At(series->chunks, i);
+        if (entry->count > 0) {
+            ReallocSamplesArray(&decoded->samples, entry->count);
+            series->funcs->ProcessChunk(entry->chunk, 0, UINT64_MAX, decoded, false);
+            const Samples *samples = &decoded->samples;
+            for (size_t j = 0; j < samples->num_samples; j++) {
+                series->inlineSamples[count++] =
+                    (Sample){ .timestamp = samples->timestamps[j], .value = samples->values[j] };
+            }
+        }
+        series->funcs->FreeChunk(entry->chunk);
+    }
+    FreeEnrichedChunk(decoded);
+    ChunkDir_Free(series->chunks);
+    series->chunks = NULL;
+    series->lastChunk = NULL;
+    series->inlineCount = count;
+}
+
+size_t SeriesChunkCount(const Series *series) {
+    return SeriesIsInline(series) ? 1 : ChunkDir_Size(series->chunks);
+}
+
+// Index of the first inline sample whose timestamp is >= ts
+static size_t inlineLowerBound(const Series *series, timestamp_t ts) {
+    size_t lo = 0, hi = series->inlineCount;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (series->inlineSamples[mid].timestamp < ts) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Upserts the sample at idx of the inline samples, the series has room for it unless it replaces
+// an existing sample
+static int upsertInline(Series *series, size_t idx, Sample sample, DuplicatePolicy dp_policy) {
+    Sample *samples = series->inlineSamples;
+    UpsertCtx uCtx = { .inChunk = NULL, .sample = sample };
+    if (idx < series->inlineCount && samples[idx].timestamp == sample.timestamp) {
+        if (handleDuplicateSample(dp_policy, samples[idx], &uCtx.sample) != CR_OK) {
+            return CR_ERR;
+        }
+        uCtx.replaced = true;
+        uCtx.oldValue = samples[idx].value;
+        samples[idx].value = uCtx.sample.value;
+    } else {
+        memmove(&samples[idx + 1], &samples[idx], (series->inlineCount - idx) * sizeof(Sample));
+        samples[idx] = sample;
+        series->inlineCount++;
+        series->totalSamples++;
+    }
+    if (sample.timestamp == series->lastTimestamp) {
+        series->lastValue = uCtx.sample.value;
+    }
+    upsertCompaction(series, &uCtx);
+    return CR_OK;
+}
+
+size_t SeriesMergeStaged(const Series *series,
+                         size_t idx,
+                         size_t begin,
+                         size_t count,
+                         Chunk_t ***out,
+                         u_int64_t *numSamples) {
+    const ChunkFuncs *funcs = series->funcs;
+    const StagingBuffer *buf = series->staged;
+    const ChunkDirEntry *entry = ChunkDir_At(series->chunks, idx);
+
+    EnrichedChunk *decoded = NewEnrichedChunk();
+    ReallocSamplesArray(&decoded->samples, max(entry->count, 1));
+    funcs->ProcessChunk(entry->chunk, 0, UINT64_MAX, decoded, false);
+    const Samples *samples = &decoded->samples;
+
+    size_t numChunks = 1;
+    *out = (Chunk_t **)malloc(sizeof(Chunk_t *));
+    (*out)[0] = funcs->NewChunk(series->chunkSizeBytes);
+    *numSamples = 0;
+
+    size_t i = 0, j = begin, end = begin + count;
+    while (i < samples->num_samples || j < end) {
+        Sample sample;
+        if (j == end || (i < samples->num_samples && samples->timestamps[i] < buf->timestamps[j])) {
+            sample = (Sample){ .timestamp = samples->timestamps[i], .value = samples->values[i] };
+            i++;
+        } else {
+            sample = (Sample){ .timestamp = buf->timestamps[j], .value = buf->values[j] };
+            if (i < samples->num_samples && samples->timestamps[i] == sample.timestamp) {
+                Sample old = { .timestamp = samples->timestamps[i], .value = samples->values[i] };
+                if (handleDuplicateSample(buf->policies[j], old, &sample) != CR_OK) {
+                    sample = old;
+                }
+                i++;
             }
+            j++;
+        }
+        appendMerged(funcs, series->chunkSizeBytes, &sample, out, &numChunks);
+        (*numSamples)++;
+    }
+
+    FreeEnrichedChunk(decoded);
+    return numChunks;
+}
+
+void SeriesFlushStaged(Series *series) {
+    StagingBuffer *buf = series->staged;
+    if (!buf) {
+        return;
+    }
 
-            if (!RuleSeriesUpsertSample(rts_staticCtx, series, rule, startNormalized, val)) {
+    // one rewrite per chunk, from the last one so the indexes of the ones left stay valid
+    const ChunkFuncs *funcs = series->funcs;
+    size_t end = buf->count;
+    while (end > 0) {
+        size_t idx = ChunkDir_Floor(series->chunks, buf->timestamps[end - 1]);
+        size_t begin, slotEnd;
+        SeriesStagedSlot(series, idx, &begin, &slotEnd);
+
+        Chunk_t **merged;
+        u_int64_t numSamples;
+        size_t numChunks = SeriesMergeStaged(series, idx, begin, end - begin, &merged, &numSamples);
+
+        ChunkDirEntry *entry = ChunkDir_At(series->chunks, idx);
+        series->totalSamples += numSamples - entry->count;
+        if (entry->chunk == series->lastChunk) {
+            series->lastChunk = merged[numChunks - 1];
+        }
+        funcs->FreeChunk(entry->chunk);
+        entry->chunk = merged[0];
+        ChunkDir_Refresh(series->chunks, idx, funcs);
+        for (size_t i = 1; i < numChunks; i++) {
+            ChunkDir_Insert(series->chunks, merged[i], funcs);
+        }
+        free(merged);
+        end = begin;
+    }
+
+    // the compactions read the merged chunks
+    series->staged = NULL;
+
+    // one recompute per touched bucket
+    if (series->rules) {
+        deleteReferenceToDeletedSeries(rts_staticCtx, series);
+    }
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        timestamp_t bucketEnd = 0;
+        for (size_t i = 0; i < buf->count; i++) {
+            if (i > 0 && buf->timestamps[i] < bucketEnd) {
                 continue;
             }
+            upsertRuleBucket(series, rule, buf->timestamps[i], NULL);
+            bucketEnd = CalcBucketStart(
+                            buf->timestamps[i], rule->bucketDuration, rule->timestampAlignment) +
+                        rule->bucketDuration;
         }
-        rule = rule->nextRule;
     }
+
+    StagingBuffer_Free(buf);
+    SeriesFlushDirtyBuckets();
+}
+
+// The staged samples are merged by the first sample appended OOO_STAGING_MAX_AGE past them. The
+// merge happens within the command, so it replicates with it, and it doesn't depend on the clock.
+static inline void flushAgedStaged(Series *series, timestamp_t timestamp) {
+    if (series->staged && timestamp >= series->staged->since + TSGlobalConfig.oooStagingMaxAge) {
+        SeriesFlushStaged(series);
+    }
+}
+
+// The sweeper walks a database at a time, it resumes where the previous tick stopped
+static RedisModuleScanCursor *sweepCursor = NULL;
+static int sweepDb = 0;
+
+static uint64_t monotonicMicros() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void sweepKey(RedisModuleCtx *ctx,
+                     RedisModuleString *keyName,
+                     RedisModuleKey *key,
+                     void *privdata) {
+    if (key == NULL || RedisModule_ModuleTypeGetType(key) != SeriesType) {
+        return;
+    }
+    // the written keys are trimmed on chunk rollover, the idle time is unknown (-1) under LFU
+    mstime_t idle;
+    if (RedisModule_GetLRU(key, &idle) == REDISMODULE_OK && idle >= 0 &&
+        idle < RETENTION_SWEEP_IDLE_MS) {
+        return;
+    }
+    Series *series = RedisModule_ModuleTypeGetValue(key);
+    if (series->in_ram) {
+        SeriesTrim(series, 0, 0);
+        SeriesCoalesceChunks(series);
+    }
+}
+
+static void retentionSweepCallback(RedisModuleCtx *ctx, void *data) {
+    uint64_t deadline = monotonicMicros() + RETENTION_SWEEP_BUDGET_US;
+    if (RedisModule_SelectDb(ctx, sweepDb) != REDISMODULE_OK) {
+        // past the last database
+        sweepDb = 0;
+        RedisModule_SelectDb(ctx, sweepDb);
+    }
+    while (monotonicMicros() < deadline) {
+        if (!RedisModule_Scan(ctx, sweepCursor, sweepKey, NULL)) {
+            RedisModule_ScanCursorRestart(sweepCursor);
+            sweepDb++;
+            break;
+        }
+    }
+    RedisModule_CreateTimer(ctx, RETENTION_SWEEP_INTERVAL_MS, retentionSweepCallback, NULL);
+}
+
+void SeriesStartRetentionSweeper(RedisModuleCtx *ctx) {
+    sweepCursor = RedisModule_ScanCursorCreate();
+    RedisModule_CreateTimer(ctx, RETENTION_SWEEP_INTERVAL_MS, retentionSweepCallback, NULL);
+}
+
+// Holds the lookups of chunksHaveTimestamp, it only grows
+static EnrichedChunk *lookupChunk = NULL;
+
+// Whether the chunks hold a sample at ts. Only the samples from the checkpoint before ts are
+// decoded, or none at all for uncompressed chunks.
+static bool chunksHaveTimestamp(const Series *series, timestamp_t ts) {
+    const ChunkDirEntry *entry = ChunkDir_At(series->chunks, ChunkDir_Floor(series->chunks, ts));
+    if (entry->count == 0 || ts < entry->firstTs || ts > entry->lastTs) {
+        return false;
+    }
+    if (lookupChunk == NULL) {
+        lookupChunk = NewEnrichedChunk();
+    }
+    if (lookupChunk->samples.size < entry->count) {
+        ReallocSamplesArray(&lookupChunk->samples, entry->count);
+    }
+    series->funcs->ProcessChunk(entry->chunk, ts, ts, lookupChunk, false);
+    return lookupChunk->samples.num_samples > 0;
 }
 
-// update chunk in dictionary if first timestamp changed
-static inline void update_chunk_in_dict(RedisModuleDict *chunks,
-                                        Chunk_t *chunk,
-                                        timestamp_t chunkOrigFirstTS,
-                                        timestamp_t chunkFirstTSAfterOp) {
-    if (dictOperator(chunks, NULL, chunkOrigFirstTS, DICT_OP_DEL) == REDISMODULE_ERR) {
-        dictOperator(chunks, NULL, 0, DICT_OP_DEL); // The first chunk is a special case
+void SeriesStageSample(Series *series, Sample sample, DuplicatePolicy policy) {
+    if (!series->staged) {
+        series->staged = StagingBuffer_New();
+        series->staged->since = series->lastTimestamp;
+    }
+    StagingBuffer *buf = series->staged;
+    size_t idx = StagingBuffer_LowerBound(buf, sample.timestamp);
+    bool staged = idx < buf->count && buf->timestamps[idx] == sample.timestamp;
+    if (!staged && !chunksHaveTimestamp(series, sample.timestamp)) {
+        buf->newSamples++;
     }
-    dictOperator(chunks, chunk, chunkFirstTSAfterOp, DICT_OP_SET);
+    StagingBuffer_Add(buf, sample, policy);
+}
+
+// Stages an out of order sample, returns false if it has to be upserted right away
+static bool stageSample(Series *series, Sample sample, DuplicatePolicy dp_policy) {
+    // a blocked duplicate must be reported, the latest sample sets lastValue
+    if (TSGlobalConfig.oooStagingSize == 0 || dp_policy == DP_BLOCK ||
+        series->totalSamples == 0 || sample.timestamp >= series->lastTimestamp) {
+        return false;
+    }
+    const StagingBuffer *buf = series->staged;
+    size_t idx = buf ? StagingBuffer_LowerBound(buf, sample.timestamp) : 0;
+    if (buf && idx < buf->count && buf->timestamps[idx] == sample.timestamp &&
+        buf->policies[idx] != dp_policy) {
+        // staged duplicates are combined before they meet the chunk's sample, which is only right
+        // under a single policy
+        SeriesFlushStaged(series);
+        return false;
+    }
+    SeriesStageSample(series, sample, dp_policy);
+    if (series->staged->count >= TSGlobalConfig.oooStagingSize) {
+        SeriesFlushStaged(series);
+    }
+    return true;
 }
 
 int SeriesUpsertSample(Series *series,
                        api_timestamp_t timestamp,
                        double value,
                        DuplicatePolicy dp_override) {
+    // Use module level configuration if key level configuration doesn't exists
+    DuplicatePolicy dp_policy;
+    if (dp_override != DP_NONE) {
+        dp_policy = dp_override;
+    } else if (series->duplicatePolicy != DP_NONE) {
+        dp_policy = series->duplicatePolicy;
+    } else {
+        dp_policy = TSGlobalConfig.duplicatePolicy;
+    }
+
+    Sample sample = { .timestamp = timestamp, .value = value };
+    if (SeriesIsInline(series)) {
+        size_t idx = inlineLowerBound(series, timestamp);
+        if (series->inlineCount < series->inlineCapacity ||
+            (idx < series->inlineCount && series->inlineSamples[idx].timestamp == timestamp)) {
+            return upsertInline(series, idx, sample, dp_policy);
+        }
+        SeriesPromoteInline(series);
+    }
+    if (stageSample(series, sample, dp_policy)) {
+        return REDISMODULE_OK;
+    }
+    if (series->staged && timestamp < series->lastTimestamp) {
+        // the sample may replace a staged one
+        SeriesFlushStaged(series);
+    }
+
     bool latestChunk = true;
-    void *chunkKey = NULL;
     const ChunkFuncs *funcs = series->funcs;
+    size_t chunkIdx = ChunkDir_Size(series->chunks) - 1;
     Chunk_t *chunk = series->lastChunk;
-    timestamp_t chunkFirstTS = funcs->GetFirstTimestamp(series->lastChunk);
 
-    if (timestamp < chunkFirstTS && RedisModule_DictSize(series->chunks) > 1) {
+    if (timestamp < ChunkDir_At(series->chunks, chunkIdx)->firstTs && chunkIdx > 0) {
         // Upsert in an older chunk
         latestChunk = false;
-        timestamp_t rax_key;
-        seriesEncodeTimestamp(&rax_key, timestamp);
-        RedisModuleDictIter *dictIter =
-            RedisModule_DictIteratorStartC(series->chunks, "<=", &rax_key, sizeof(rax_key));
-        chunkKey = RedisModule_DictNextC(dictIter, NULL, (void *)&chunk);
-        if (chunkKey == NULL) {
-            RedisModule_DictIteratorReseekC(dictIter, "^", NULL, 0);
-            chunkKey = RedisModule_DictNextC(dictIter, NULL, (void *)&chunk);
-        }
-        RedisModule_DictIteratorStop(dictIter);
-        if (chunkKey == NULL) {
-            return REDISMODULE_ERR;
-        }
-        chunkFirstTS = funcs->GetFirstTimestamp(chunk);
+        chunkIdx = ChunkDir_Floor(series->chunks, timestamp);
+        chunk = ChunkDir_At(series->chunks, chunkIdx)->chunk;
     }
 
     // Split chunks
@@ -622,11 +1288,11 @@ int SeriesUpsertSample(Series *series,
         if (newChunk == NULL) {
             return REDISMODULE_ERR;
         }
-        timestamp_t newChunkFirstTS = funcs->GetFirstTimestamp(newChunk);
-        dictOperator(series->chunks, newChunk, newChunkFirstTS, DICT_OP_SET);
-        if (timestamp >= newChunkFirstTS) {
+        ChunkDir_Refresh(series->chunks, chunkIdx, funcs);
+        size_t newChunkIdx = ChunkDir_Insert(series->chunks, newChunk, funcs);
+        if (timestamp >= ChunkDir_At(series->chunks, newChunkIdx)->firstTs) {
             chunk = newChunk;
-            chunkFirstTS = newChunkFirstTS;
+            chunkIdx = newChunkIdx;
         }
         if (latestChunk) { // split of latest chunk
             series->lastChunk = newChunk;
@@ -640,45 +1306,78 @@ int SeriesUpsertSample(Series *series,
 
     int size = 0;
 
-    // Use module level configuration if key level configuration doesn't exists
-    DuplicatePolicy dp_policy;
-    if (dp_override != DP_NONE) {
-        dp_policy = dp_override;
-    } else if (series->duplicatePolicy != DP_NONE) {
-        dp_policy = series->duplicatePolicy;
-    } else {
-        dp_policy = TSGlobalConfig.duplicatePolicy;
-    }
-
     ChunkResult rv = funcs->UpsertSample(&uCtx, &size, dp_policy);
     if (rv == CR_OK) {
         series->totalSamples += size;
         if (timestamp == series->lastTimestamp) {
             series->lastValue = uCtx.sample.value;
         }
-        timestamp_t chunkFirstTSAfterOp = funcs->GetFirstTimestamp(uCtx.inChunk);
-        if (chunkFirstTSAfterOp != chunkFirstTS) {
-            update_chunk_in_dict(series->chunks, uCtx.inChunk, chunkFirstTS, chunkFirstTSAfterOp);
-        }
+        ChunkDir_Refresh(series->chunks, chunkIdx, funcs);
 
         upsertCompaction(series, &uCtx);
     }
     return rv;
 }
 
+static size_t roundChunkSize(double size) {
+    size_t rounded = AUTO_CHUNK_MIN_SIZE;
+    while (rounded < size && rounded < AUTO_CHUNK_MAX_SIZE) {
+        rounded *= 2;
+    }
+    return rounded;
+}
+
+// Sizes the next chunk of a CHUNK_SIZE AUTO series after the last chunk, which is full. The rate
+// is measured in sample timestamps, so a replica or an AOF reload picks the same sizes.
+static void pickChunkSize(Series *series) {
+    const ChunkDirEntry *last = ChunkDir_Last(series->chunks);
+    if (last->count < 2 || last->lastTs == last->firstTs) {
+        return;
+    }
+    double bytesPerSample =
+        (double)series->funcs->GetChunkSize(last->chunk, false) / last->count;
+    // as many samples as the last chunk had per AUTO_CHUNK_FILL_MS
+    double size =
+        bytesPerSample * last->count * AUTO_CHUNK_FILL_MS / (last->lastTs - last->firstTs);
+    series->chunkSizeReason = CHUNK_SIZE_REASON_INGEST_RATE;
+    series->chunkSizeBytes = roundChunkSize(size);
+}
+
+const char *SeriesChunkSizeReasonToString(const Series *series) {
+    switch (series->chunkSizeReason) {
+        case CHUNK_SIZE_REASON_INGEST_RATE:
+            return "ingest rate";
+        default:
+            return "default";
+    }
+}
+
 int SeriesAddSample(Series *series, api_timestamp_t timestamp, double value) {
+    flushAgedStaged(series, timestamp);
     // backfilling or update
     Sample sample = { .timestamp = timestamp, .value = value };
-    ChunkResult ret = series->funcs->AddSample(series->lastChunk, &sample);
+    if (SeriesIsInline(series) && series->inlineCount == series->inlineCapacity) {
+        SeriesPromoteInline(series);
+    }
 
-    if (ret == CR_END) {
-        // When a new chunk is created trim the series
-        SeriesTrim(series, 0, 0);
+    if (SeriesIsInline(series)) {
+        series->inlineSamples[series->inlineCount++] = sample;
+    } else {
+        ChunkResult ret = series->funcs->AddSample(series->lastChunk, &sample);
+        if (ret == CR_END) {
+            // When a new chunk is created trim the series, the sweeper trims the idle ones
+            SeriesTrim(series, 0, 0);
 
-        Chunk_t *newChunk = series->funcs->NewChunk(series->chunkSizeBytes);
-        dictOperator(series->chunks, newChunk, timestamp, DICT_OP_SET);
-        ret = series->funcs->AddSample(newChunk, &sample);
-        series->lastChunk = newChunk;
+            if (series->options & SERIES_OPT_AUTO_CHUNK_SIZE) {
+                pickChunkSize(series);
+            }
+            Chunk_t *newChunk = series->funcs->NewChunk(series->chunkSizeBytes);
+            series->funcs->AddSample(newChunk, &sample);
+            ChunkDir_Insert(series->chunks, newChunk, series->funcs);
+            series->lastChunk = newChunk;
+        } else if (ret == CR_OK) {
+            ChunkDir_Append(series->chunks, timestamp);
+        }
     }
     series->lastTimestamp = timestamp;
     series->lastValue = value;
@@ -832,89 +1531,86 @@ void CompactionDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts
     }
 }
 
-size_t SeriesDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts) {
-    // start iterator from smallest key
-    RedisModuleDictIter *iter = RedisModule_DictIteratorStartC(series->chunks, "^", NULL, 0);
+static size_t delRangeInline(Series *series, timestamp_t start_ts, timestamp_t end_ts) {
+    size_t begin = inlineLowerBound(series, start_ts);
+    size_t end = begin;
+    while (end < series->inlineCount && series->inlineSamples[end].timestamp <= end_ts) {
+        end++;
+    }
+    memmove(&series->inlineSamples[begin],
+            &series->inlineSamples[end],
+            (series->inlineCount - end) * sizeof(Sample));
+    series->inlineCount -= end - begin;
+    return end - begin;
+}
 
-    Chunk_t *currentChunk;
-    void *currentKey;
-    size_t keyLen;
+static size_t delRangeChunks(Series *series, timestamp_t start_ts, timestamp_t end_ts) {
+    ChunkDir *chunks = series->chunks;
     size_t deletedSamples = 0;
     const ChunkFuncs *funcs = series->funcs;
-    while ((currentKey = RedisModule_DictNextC(iter, &keyLen, (void *)&currentChunk))) {
+    // chunks before the floor of start_ts end before it
+    size_t i = ChunkDir_Floor(chunks, start_ts);
+    while (i < ChunkDir_Size(chunks)) {
+        ChunkDirEntry *entry = ChunkDir_At(chunks, i);
         // We deleted the latest samples, no more chunks/samples to delete or cur chunk start_ts is
         // larger than end_ts
-        if (!currentKey || (funcs->GetNumOfSample(currentChunk) == 0) ||
-            funcs->GetFirstTimestamp(currentChunk) > end_ts) {
+        if (entry->count == 0 || entry->firstTs > end_ts) {
             // Having empty chunk means the series is empty
             break;
         }
 
-        if (funcs->GetLastTimestamp(currentChunk) < start_ts) {
+        if (entry->lastTs < start_ts) {
+            i++;
             continue;
         }
 
-        bool is_only_chunk =
-            ((funcs->GetNumOfSample(currentChunk) + deletedSamples) == series->totalSamples);
+        bool is_only_chunk = ((entry->count + deletedSamples) == series->totalSamples);
         // Should we delete the all chunk?
+        // We assume at least one allocated chunk in the series
         bool ts_delCondition =
-            (funcs->GetFirstTimestamp(currentChunk) >= start_ts &&
-             funcs->GetLastTimestamp(currentChunk) <= end_ts) &&
-            (!is_only_chunk); // We assume at least one allocated chunk in the series
+            (entry->firstTs >= start_ts && entry->lastTs <= end_ts) && (!is_only_chunk);
 
         if (!ts_delCondition) {
-            timestamp_t chunkFirstTS = funcs->GetFirstTimestamp(currentChunk);
-            deletedSamples += funcs->DelRange(currentChunk, start_ts, end_ts);
-            timestamp_t chunkFirstTSAfterOp = funcs->GetFirstTimestamp(currentChunk);
-            if (chunkFirstTSAfterOp != chunkFirstTS) {
-                update_chunk_in_dict(
-                    series->chunks, currentChunk, chunkFirstTS, chunkFirstTSAfterOp);
-                // reseek iterator since we modified the dict,
-                // go to first element that is bigger than current key
-                timestamp_t rax_key;
-                seriesEncodeTimestamp(&rax_key, chunkFirstTSAfterOp);
-                RedisModule_DictIteratorReseekC(iter, ">", &rax_key, sizeof(rax_key));
-            }
+            deletedSamples += funcs->DelRange(entry->chunk, start_ts, end_ts);
+            ChunkDir_Refresh(chunks, i, funcs);
+            i++;
             continue;
         }
 
-        bool isLastChunkDeleted = (currentChunk == series->lastChunk);
-        RedisModule_DictDelC(series->chunks, currentKey, keyLen, NULL);
-        deletedSamples += funcs->GetNumOfSample(currentChunk);
-        funcs->FreeChunk(currentChunk);
+        bool isLastChunkDeleted = (entry->chunk == series->lastChunk);
+        deletedSamples += entry->count;
+        funcs->FreeChunk(entry->chunk);
+        ChunkDir_Remove(chunks, i, 1);
 
         if (isLastChunkDeleted) {
-            Chunk_t *lastChunk;
-            RedisModuleDictIter *lastChunkIter =
-                RedisModule_DictIteratorStartC(series->chunks, "$", NULL, 0);
-            RedisModule_DictNextC(lastChunkIter, NULL, (void *)&lastChunk);
-            series->lastChunk = lastChunk;
-            RedisModule_DictIteratorStop(lastChunkIter);
+            series->lastChunk = ChunkDir_Last(chunks)->chunk;
         }
-
-        // reseek iterator since we modified the dict,
-        // go to first element that is bigger than current key
-        RedisModule_DictIteratorReseekC(iter, ">", currentKey, keyLen);
     }
-    series->totalSamples -= deletedSamples;
+    return deletedSamples;
+}
 
-    RedisModule_DictIteratorStop(iter);
+size_t SeriesDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts) {
+    SeriesFlushStaged(series);
+    size_t deletedSamples = SeriesIsInline(series) ? delRangeInline(series, start_ts, end_ts)
+                                                   : delRangeChunks(series, start_ts, end_ts);
+    series->totalSamples -= deletedSamples;
 
     CompactionDelRange(series, start_ts, end_ts);
 
     // Check if last timestamp deleted
     if (end_ts >= series->lastTimestamp && start_ts <= series->lastTimestamp) {
-        iter = RedisModule_DictIteratorStartC(series->chunks, "$", NULL, 0);
-        currentKey = RedisModule_DictNextC(iter, &keyLen, (void *)&currentChunk);
-        if (!currentKey || (funcs->GetNumOfSample(currentChunk) == 0)) {
+        ChunkDirEntry *last = SeriesIsInline(series) ? NULL : ChunkDir_Last(series->chunks);
+        if (last ? last->count == 0 : series->inlineCount == 0) {
             // No samples in the series
             series->lastTimestamp = 0;
             series->lastValue = 0;
+        } else if (!last) {
+            series->lastTimestamp = series->inlineSamples[series->inlineCount - 1].timestamp;
+            series->lastValue = series->inlineSamples[series->inlineCount - 1].value;
         } else {
-            series->lastTimestamp = funcs->GetLastTimestamp(currentChunk);
-            series->lastValue = funcs->GetLastValue(currentChunk);
+            series->lastTimestamp = last->lastTs;
+            series->lastValue = series->funcs->GetLastValue(last->chunk);
         }
-        RedisModule_DictIteratorStop(iter);
     }
     return deletedSamples;
 }
@@ -931,6 +1627,12 @@ CompactionRule *SeriesAddRule(RedisModuleCtx *ctx,
         return NULL;
     }
     RedisModule_RetainString(ctx, destSeries->keyName);
+    // the buckets before the one of the next sample lack the samples the series already has
+    destSeries->rollupStart =
+        series->totalSamples == 0
+            ? 0
+            : CalcBucketStart(series->lastTimestamp, bucketDuration, timestampAlignment) +
+                  bucketDuration;
     if (series->rules == NULL) {
         series->rules = rule;
     } else {
@@ -1000,7 +1702,8 @@ int SeriesCreateRulesFromGlobalConfig(RedisModuleCtx *ctx,
 
         int rules_options = TSGlobalConfig.options;
         rules_options &= ~SERIES_OPT_DEFAULT_COMPRESSION;
-        rules_options &= SERIES_OPT_UNCOMPRESSED;
+        rules_options &=
+            SERIES_OPT_UNCOMPRESSED | SERIES_OPT_COMPRESSED_DECIMAL | SERIES_OPT_HYBRID;
 
         CreateCtx cCtx = {
             .retentionTime = rule->retentionSizeMillisec,
@@ -1184,18 +1887,34 @@ timestamp_t getFirstValidTimestamp(Series *series, long long *skipped) {
     return sample.timestamp;
 }
 
+// In case a retention is set shouldn't return chunks older than the retention
+static timestamp_t retentionStart(const Series *series, timestamp_t startTimestamp) {
+    if (series->retentionTime > 0 && series->lastTimestamp > series->retentionTime) {
+        return max(startTimestamp, series->lastTimestamp - series->retentionTime);
+    }
+    return startTimestamp;
+}
+
+static timestamp_t queryAlignment(const RangeArgs *args) {
+    switch (args->alignment) {
+        case StartAlignment:
+            // args-startTimestamp can hold an older timestamp than what we currently have or just 0
+            return args->startTimestamp;
+        case EndAlignment:
+            return args->endTimestamp;
+        case TimestampAlignment:
+            return args->timestampAlignment;
+        default:
+            return 0;
+    }
+}
+
 AbstractIterator *SeriesQuery(Series *series,
                               const RangeArgs *args,
                               bool reverse,
                               bool check_retention) {
-    // In case a retention is set shouldn't return chunks older than the retention
-    timestamp_t startTimestamp = args->startTimestamp;
-    if (check_retention && series->retentionTime > 0) {
-        startTimestamp =
-            series->lastTimestamp > series->retentionTime
-                ? max(args->startTimestamp, series->lastTimestamp - series->retentionTime)
-                : args->startTimestamp;
-    }
+    timestamp_t startTimestamp =
+        check_retention ? retentionStart(series, args->startTimestamp) : args->startTimestamp;
 
     // When there is a TS filter because we wanted the logic to be one for both reverse and non
     // reverse chunk, if the requested range should be reverse, we reverse it after the filter, and
@@ -1203,6 +1922,7 @@ AbstractIterator *SeriesQuery(Series *series,
     bool should_reverse_chunk = reverse && (!args->filterByTSArgs.hasValue);
     AbstractIterator *chain = SeriesIterator_New(
         series, startTimestamp, args->endTimestamp, reverse, should_reverse_chunk, args->latest);
+    SeriesIterator *seriesIterator = (SeriesIterator *)chain;
 
     if (args->filterByTSArgs.hasValue) {
         chain =
@@ -1211,36 +1931,30 @@ AbstractIterator *SeriesQuery(Series *series,
 
     if (args->filterByValueArgs.hasValue) {
         chain = (AbstractIterator *)SeriesFilterValIterator_New(chain, args->filterByValueArgs);
+        seriesIterator->valueFilter = args->filterByValueArgs;
     }
 
-    timestamp_t timestampAlignment;
-    switch (args->alignment) {
-        case StartAlignment:
-            // args-startTimestamp can hold an older timestamp than what we currently have or just 0
-            timestampAlignment = args->startTimestamp;
-            break;
-        case EndAlignment:
-            timestampAlignment = args->endTimestamp;
-            break;
-        case TimestampAlignment:
-            timestampAlignment = args->timestampAlignment;
-            break;
-        default:
-            timestampAlignment = 0;
-            break;
-    }
-
+    timestamp_t timestampAlignment = queryAlignment(args);
     if (args->aggregationArgs.aggregationClass != NULL) {
-        chain = (AbstractIterator *)AggregationIterator_New(chain,
-                                                            args->aggregationArgs.aggregationClass,
-                                                            args->aggregationArgs.timeDelta,
-                                                            timestampAlignment,
-                                                            reverse,
-                                                            args->aggregationArgs.empty,
-                                                            args->aggregationArgs.bucketTS,
-                                                            series,
-                                                            args->startTimestamp,
-                                                            args->endTimestamp);
+        AggregationIterator *aggregationIterator =
+            AggregationIterator_New(chain,
+                                    args->aggregationArgs.aggregationClasses,
+                                    args->aggregationArgs.numAggregations,
+                                    args->aggregationArgs.timeDelta,
+                                    timestampAlignment,
+                                    reverse,
+                                    args->aggregationArgs.empty,
+                                    args->aggregationArgs.bucketTS,
+                                    series,
+                                    args->startTimestamp,
+                                    args->endTimestamp);
+        // chunks within a single bucket are folded into it by their stats, the TS filter needs the
+        // samples themselves
+        if (aggregationIterator->aggregation->appendChunkStats && !args->filterByTSArgs.hasValue) {
+            seriesIterator->summaryBucketDuration = args->aggregationArgs.timeDelta;
+            seriesIterator->summaryAlignment = timestampAlignment;
+        }
+        chain = (AbstractIterator *)aggregationIterator;
     }
 
     return chain;
@@ -1254,6 +1968,145 @@ AbstractSampleIterator *SeriesCreateSampleIterator(Series *series,
     return (AbstractSampleIterator *)SeriesSampleIterator_New(chain);
 }
 
+// Whether the series has samples in [start, end], regardless of its retention
+static bool seriesHasSamples(Series *series, timestamp_t start, timestamp_t end) {
+    if (start > end) {
+        return false;
+    }
+    RangeArgs args = { .aggregationArgs = { 0 },
+                       .filterByValueArgs = { 0 },
+                       .filterByTSArgs = { 0 },
+                       .startTimestamp = start,
+                       .endTimestamp = end };
+    Sample sample;
+    AbstractSampleIterator *iterator = SeriesCreateSampleIterator(series, &args, false, false);
+    bool found = iterator->GetNext(iterator, &sample) == CR_OK;
+    iterator->Close(iterator);
+    return found;
+}
+
+// The aggregation which gives the query's aggregation from the buckets of a rule, TS_AGG_INVALID
+// when they can't. Buckets as long as the query's are the result, longer ones are combined.
+static int rollupAggregation(int queryType, int ruleType, bool sameBucket) {
+    if (sameBucket && queryType == ruleType) {
+        switch (queryType) {
+            case TS_AGG_SUM:
+            case TS_AGG_COUNT:
+                // an empty bucket is 0
+                return TS_AGG_SUM;
+            case TS_AGG_LAST:
+                // an empty bucket is the value of the previous one
+                return TS_AGG_LAST;
+            default:
+                return TS_AGG_FIRST;
+        }
+    }
+    switch (queryType) {
+        case TS_AGG_MIN:
+        case TS_AGG_MAX:
+        case TS_AGG_SUM:
+        case TS_AGG_FIRST:
+        case TS_AGG_LAST:
+            return queryType == ruleType ? queryType : TS_AGG_INVALID;
+        case TS_AGG_COUNT:
+            return ruleType == TS_AGG_COUNT ? TS_AGG_SUM : TS_AGG_INVALID;
+        default:
+            return TS_AGG_INVALID;
+    }
+}
+
+Series *SeriesSelectRollup(RedisModuleCtx *ctx,
+                           Series *series,
+                           const RangeArgs *args,
+                           RangeArgs *rollupArgs,
+                           RedisModuleKey **key) {
+    const AggregationArgs *aggArgs = &args->aggregationArgs;
+    if (!args->rollup || series->rules == NULL || aggArgs->numAggregations != 1 ||
+        aggArgs->aggregationClass->type == TS_AGG_TWA || args->filterByValueArgs.hasValue ||
+        args->filterByTSArgs.hasValue || args->latest || series->totalSamples == 0 ||
+        (series->staged && series->staged->count > 0)) {
+        return NULL;
+    }
+    series->rollupQueries++;
+
+    const timestamp_t start = retentionStart(series, args->startTimestamp);
+    const timestamp_t end = args->endTimestamp;
+    const timestamp_t alignment = queryAlignment(args);
+    const timestamp_t bucketDuration = aggArgs->timeDelta;
+    if (end < start) {
+        return NULL;
+    }
+    // the rule buckets are read from the start of the first bucket of the query
+    const timestamp_t bucketStart =
+        BucketStartNormalize(CalcBucketStart(start, bucketDuration, alignment));
+    if (aggArgs->empty &&
+        bucketStart !=
+            BucketStartNormalize(CalcBucketStart(args->startTimestamp, bucketDuration, alignment))) {
+        // the empty buckets are reported from the requested start
+        return NULL;
+    }
+    // the samples the retention trimmed from the first bucket are still in the rule's
+    if (bucketStart < start && series->retentionTime > 0 &&
+        (bucketStart == 0 || !seriesHasSamples(series, 0, bucketStart - 1))) {
+        return NULL;
+    }
+
+    // the rule with the longest buckets which hold all the samples of the range and only them
+    CompactionRule *best = NULL;
+    Series *bestDest = NULL;
+    int bestType = TS_AGG_INVALID;
+    for (CompactionRule *rule = series->rules; rule != NULL; rule = rule->nextRule) {
+        const uint64_t ruleBucket = rule->bucketDuration;
+        // a rule which got no sample yet has no bucket for LATEST
+        if (rule->startCurrentTimeBucket == -1LL || bucketDuration % ruleBucket != 0 ||
+            alignment % ruleBucket != rule->timestampAlignment % ruleBucket ||
+            (best != NULL && best->bucketDuration >= ruleBucket)) {
+            continue;
+        }
+        int type = rollupAggregation(
+            aggArgs->aggregationClass->type, rule->aggType, ruleBucket == bucketDuration);
+        RedisModuleKey *destKey;
+        Series *dest;
+        if (type == TS_AGG_INVALID ||
+            !GetSeries(ctx, rule->destKey, &destKey, &dest, REDISMODULE_READ, false, true)) {
+            continue;
+        }
+        const timestamp_t completeStart = max(start, dest->rollupStart);
+        const timestamp_t lastRuleBucket =
+            CalcBucketStart(end, ruleBucket, rule->timestampAlignment);
+        if ((completeStart > bucketStart &&
+             seriesHasSamples(series, bucketStart, completeStart - 1)) ||
+            (dest->retentionTime > 0 && dest->lastTimestamp > dest->retentionTime &&
+             bucketStart < dest->lastTimestamp - dest->retentionTime) ||
+            (end < series->lastTimestamp &&
+             seriesHasSamples(series, end + 1, lastRuleBucket + ruleBucket - 1))) {
+            RedisModule_CloseKey(destKey);
+            continue;
+        }
+        if (best != NULL) {
+            RedisModule_CloseKey(*key);
+        }
+        best = rule;
+        bestDest = dest;
+        bestType = type;
+        *key = destKey;
+    }
+    if (best == NULL) {
+        return NULL;
+    }
+
+    *rollupArgs = *args;
+    rollupArgs->startTimestamp = bucketStart;
+    rollupArgs->alignment = TimestampAlignment;
+    rollupArgs->timestampAlignment = alignment;
+    // the bucket the rule is still aggregating
+    rollupArgs->latest = true;
+    rollupArgs->aggregationArgs.aggregationClass = GetAggClass(bestType);
+    rollupArgs->aggregationArgs.aggregationClasses[0] = rollupArgs->aggregationArgs.aggregationClass;
+    series->rollupHits++;
+    return bestDest;
+}
+
 // returns sample iterator over multiple series
 AbstractMultiSeriesSampleIterator *MultiSeriesCreateSampleIterator(Series **series,
                                                                    size_t n_series,
@@ -1313,7 +2166,7 @@ void calculate_latest_sample(Sample **sample, const Series *series) {
         (*sample)->timestamp = rule->startCurrentTimeBucket;
         (*sample)->value = aggVal;
 
-        free(clonedContext);
+        rule->aggClass->freeContext(clonedContext);
     }
 
     if (srcKey) {
@@ -7,12 +7,14 @@
 #define TSDB_H
 
 #include "abstract_iterator.h"
+#include "chunk_dir.h"
 #include "compaction.h"
 #include "consts.h"
 #include "generic_chunk.h"
 #include "indexer.h"
 #include "query_language.h"
 #include "redismodule.h"
+#include "staging_buffer.h"
 
 typedef struct CompactionRule
 {
@@ -27,9 +29,16 @@ typedef struct CompactionRule
                                         // matter the alignment
 } CompactionRule;
 
+// Why a CHUNK_SIZE AUTO series picked its current chunk size
+typedef enum ChunkSizeReason
+{
+    CHUNK_SIZE_REASON_DEFAULT = 0, // nothing was measured yet
+    CHUNK_SIZE_REASON_INGEST_RATE, // sized to span about AUTO_CHUNK_FILL_MS
+} ChunkSizeReason;
+
 typedef struct Series
 {
-    RedisModuleDict *chunks;
+    ChunkDir *chunks; // lastChunk is always the last entry, NULL while the samples are inline
     Chunk_t *lastChunk;
     uint64_t retentionTime;
     long long chunkSizeBytes;
@@ -44,9 +53,26 @@ typedef struct Series
     const ChunkFuncs *funcs;
     size_t totalSamples;
     DuplicatePolicy duplicatePolicy;
-    bool in_ram; // false if the key is on flash (relevant only for RoF)
+    bool in_ram;           // false if the key is on flash (relevant only for RoF)
+    StagingBuffer *staged; // out of order samples not merged into the chunks yet
+    u_int8_t chunkSizeReason; // why CHUNK_SIZE AUTO picked the current chunk size
+    // As a compaction, the buckets of the source starting from rollupStart are all complete, the
+    // older ones may lack the samples added to the source before the rule
+    timestamp_t rollupStart;
+    // aggregated range queries which looked for a compaction to read, and those which found one
+    uint64_t rollupQueries;
+    uint64_t rollupHits;
+    // A small series keeps its samples sorted in the series allocation, without any chunk, until
+    // it outgrows inlineCapacity
+    uint32_t inlineCapacity;
+    uint32_t inlineCount;
+    Sample inlineSamples[];
 } Series;
 
+static inline bool SeriesIsInline(const Series *series) {
+    return series->chunks == NULL;
+}
+
 // process C's modulo result to translate from a negative modulo to a positive
 #define modulo(x, N) ((x % N + N) % N)
 
@@ -65,6 +91,7 @@ static inline timestamp_t BucketStartNormalize(timestamp_t bucketTS) {
 
 Series *NewSeries(RedisModuleString *keyName, CreateCtx *cCtx);
 void FreeSeries(void *value);
+void UnlinkSeries(RedisModuleString *key, const void *value);
 void *CopySeries(RedisModuleString *fromkey, RedisModuleString *tokey, const void *value);
 void RenameSeriesFrom(RedisModuleCtx *ctx, RedisModuleString *key);
 void IndexMetricFromName(RedisModuleCtx *ctx, RedisModuleString *keyname);
@@ -91,6 +118,14 @@ AbstractSampleIterator *SeriesCreateSampleIterator(Series *series,
                                                    const RangeArgs *args,
                                                    bool reverse,
                                                    bool check_retention);
+// With args->rollup, looks for a compaction of the series whose buckets give the aggregation of
+// the range exactly. Returns it opened in key, with the arguments to query it set in rollupArgs, or
+// NULL when the range has to be aggregated from the samples of the series.
+Series *SeriesSelectRollup(RedisModuleCtx *ctx,
+                           Series *series,
+                           const RangeArgs *args,
+                           RangeArgs *rollupArgs,
+                           RedisModuleKey **key);
 
 AbstractMultiSeriesSampleIterator *MultiSeriesCreateSampleIterator(Series **series,
                                                                    size_t n_series,
@@ -107,6 +142,12 @@ AbstractSampleIterator *MultiSeriesCreateAggDupSampleIterator(Series **series,
 
 void FreeCompactionRule(void *value);
 size_t SeriesMemUsage(const void *value);
+// Number of allocations of the series, large series are defragmented in steps
+size_t SeriesFreeEffort(RedisModuleString *key, const void *value);
+// Active defrag callback of the series type. The series itself, its labels, rules and staged
+// samples are moved by the first step, the chunks are moved until the step runs out of time.
+// Returns 1 when the chunks aren't all done yet.
+int DefragSeries(RedisModuleDefragCtx *ctx, RedisModuleString *key, void **value);
 
 int SeriesAddSample(Series *series, api_timestamp_t timestamp, double value);
 int SeriesUpsertSample(Series *series,
@@ -114,6 +155,52 @@ int SeriesUpsertSample(Series *series,
                        double value,
                        DuplicatePolicy dp_override);
 
+// Moves the inline samples of a small series into chunks
+void SeriesPromoteInline(Series *series);
+// Reallocates a series which outgrew its inline samples without their area. Returns the series'
+// new address, which is set as the value of the key when there is one, the key is open for writing.
+Series *SeriesReleaseInlineArea(RedisModuleKey *key, Series *series);
+// Moves the samples back inline when they all fit, used when loading a small series
+void SeriesShrinkToInline(Series *series);
+// Builds the chunks holding the inline samples. Returns the number of chunks, out is allocated by
+// the callee.
+size_t SeriesInlineChunks(const Series *series, Chunk_t ***out);
+// Number of chunks reported for the series, the inline samples count as one
+size_t SeriesChunkCount(const Series *series);
+
+// Merges the staged out of order samples into the chunks
+void SeriesFlushStaged(Series *series);
+// Stages an out of order sample, the series must have chunks
+void SeriesStageSample(Series *series, Sample sample, DuplicatePolicy policy);
+// Writes the closed compaction buckets late samples went into since the last flush, each bucket is
+// aggregated once. Called at the end of the commands that add samples.
+void SeriesFlushDirtyBuckets(void);
+// Start the main thread timer walking the keyspace, it frees the chunks past the retention and
+// coalesces the undersized chunks
+void SeriesStartRetentionSweeper(RedisModuleCtx *ctx);
+
+typedef struct ChunkCoalesceStats
+{
+    size_t mergedChunks; // chunks merged into the chunk preceding them
+    size_t bytesSaved;   // memory released by the merges
+} ChunkCoalesceStats;
+
+// Merges the adjacent chunks which fit together in chunkSizeBytes, the last chunk is left alone.
+// Returns the number of merges.
+size_t SeriesCoalesceChunks(Series *series);
+void SeriesGetCoalesceStats(ChunkCoalesceStats *stats);
+// Builds the chunks holding the samples of the chunk at idx merged with the staged samples
+// [begin, begin + count). Returns the number of chunks, out is allocated by the callee.
+size_t SeriesMergeStaged(const Series *series,
+                         size_t idx,
+                         size_t begin,
+                         size_t count,
+                         Chunk_t ***out,
+                         u_int64_t *numSamples);
+// Range [begin, end) of the staged samples falling in the slot of the chunk at idx: from its first
+// timestamp to the first timestamp of the next chunk.
+void SeriesStagedSlot(const Series *series, size_t idx, size_t *begin, size_t *end);
+
 int SeriesDeleteRule(Series *series, RedisModuleString *destKey);
 void SeriesSetSrcRule(RedisModuleCtx *ctx, Series *series, RedisModuleString *srcKeyName);
 int SeriesDeleteSrcRule(Series *series, RedisModuleString *srctKey);
@@ -131,6 +218,8 @@ int SeriesCreateRulesFromGlobalConfig(RedisModuleCtx *ctx,
                                       size_t labelsCount);
 size_t SeriesGetNumSamples(const Series *series);
 
+const char *SeriesChunkSizeReasonToString(const Series *series);
+
 char *SeriesGetCStringLabelValue(const Series *series, const char *labelKey);
 size_t SeriesDelRange(Series *series, timestamp_t start_ts, timestamp_t end_ts);
 const char *SeriesChunkTypeToString(const Series *series);
@@ -151,17 +240,6 @@ CompactionRule *NewRule(RedisModuleString *destKey,
                         uint64_t bucketDuration,
                         timestamp_t timestampAlignment);
 
-// set/delete/replace a chunk in a dictionary
-typedef enum
-{
-    DICT_OP_SET = 0,
-    DICT_OP_REPLACE = 1,
-    DICT_OP_DEL = 2
-} DictOp;
-int dictOperator(RedisModuleDict *d, void *chunk, timestamp_t ts, DictOp op);
-
-void seriesEncodeTimestamp(void *buf, timestamp_t timestamp);
-
 CompactionRule *find_rule(CompactionRule *rules, RedisModuleString *keyName);
 
 #define should_finalize_last_bucket_get(latest, series) ((latest) && (series)->srcKey)
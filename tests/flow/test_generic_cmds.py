@@ -242,3 +242,39 @@ def test_copy_compressed_uncompressed():
                                                  [b't{1}_copied', [], [1638305649, b'999']],
                                                  [b't{1}_agg_copied', [], [1638305630, b'984.5']]]
                                                 ))
+
+def test_active_defrag():
+    env = Env()
+    env.skipOnCluster()
+    skip_on_rlec()
+    env.skipOnVersionSmaller("7.0.0")
+    with env.getClusterConnectionIfNeeded() as r:
+        try:
+            r.execute_command('CONFIG', 'SET', 'activedefrag', 'yes')
+        except redis.exceptions.ResponseError:
+            env.skip() # not built with jemalloc
+            return
+        for i in range(100):
+            r.execute_command('TS.CREATE', 't{%d}' % i, 'CHUNK_SIZE', '128', 'LABELS', 'name', 'n%d' % (i % 2))
+            for ts in range(1, 201):
+                r.execute_command('TS.ADD', 't{%d}' % i, ts, i)
+        # fragment the heap and defrag the remaining series in steps
+        for i in range(0, 100, 2):
+            r.execute_command('DEL', 't{%d}' % i)
+        r.execute_command('CONFIG', 'SET', 'active-defrag-max-scan-fields', '1')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-ignore-bytes', '1')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-threshold-lower', '0')
+        r.execute_command('CONFIG', 'SET', 'active-defrag-cycle-min', '50')
+        for _ in range(50):
+            if r.execute_command('INFO', 'stats')['active_defrag_hits'] > 0:
+                break
+            time.sleep(0.1)
+        r.execute_command('CONFIG', 'SET', 'activedefrag', 'no')
+
+        for i in range(1, 100, 2):
+            res = r.execute_command('TS.RANGE', 't{%d}' % i, '-', '+')
+            env.assertEqual(len(res), 200)
+            env.assertEqual(res[-1], [200, str(i).encode()])
+            r.execute_command('TS.ADD', 't{%d}' % i, 201, i)
+            env.assertEqual(r.execute_command('TS.GET', 't{%d}' % i), [201, str(i).encode()])
+        env.assertEqual(len(r.execute_command('TS.QUERYINDEX', 'name=n1')), 50)
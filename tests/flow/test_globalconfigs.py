@@ -45,6 +45,80 @@ def test_encoding_compressed():
         r.execute_command('TS.ADD', 't1', '1', 1.0)
         assert TSInfo(r.execute_command('TS.INFO', 't1_MAX_1000')).chunk_type == b'compressed'
 
+
+def test_encoding_decimal():
+    Env().skipOnCluster()
+    skip_on_rlec()
+    env = Env(moduleArgs='ENCODING decimal; COMPACTION_POLICY max:1s:1m')
+    with env.getConnection() as r:
+        r.execute_command('FLUSHALL')
+        r.execute_command('TS.ADD', 't1', '1', 1.5)
+        assert TSInfo(r.execute_command('TS.INFO', 't1')).chunk_type == b'decimal'
+        assert TSInfo(r.execute_command('TS.INFO', 't1_MAX_1000')).chunk_type == b'decimal'
+        r.execute_command('TS.ADD', 't1', '2', 2.25)
+        assert r.execute_command('TS.RANGE', 't1', '-', '+') == [[1, b'1.5'], [2, b'2.25']]
+
+def test_ooo_staging():
+    Env().skipOnCluster()
+    skip_on_rlec()
+    env = Env(moduleArgs='OOO_STAGING_SIZE 8; OOO_STAGING_MAX_AGE 100; DUPLICATE_POLICY SUM')
+    with env.getConnection() as r:
+        r.execute_command('FLUSHALL')
+        r.execute_command('TS.CREATE', 't1', 'CHUNK_SIZE', 128)
+        r.execute_command('TS.CREATE', 't1_sum')
+        r.execute_command('TS.CREATERULE', 't1', 't1_sum', 'AGGREGATION', 'sum', 100)
+        expected = {}
+        for ts in range(0, 1000, 10):
+            r.execute_command('TS.ADD', 't1', ts, 1)
+            expected[ts] = 1
+        # late samples, new ones and duplicates, are staged and read merged
+        for ts in [985, 5, 500, 500, 15, 300]:
+            r.execute_command('TS.ADD', 't1', ts, 2)
+            expected[ts] = expected.get(ts, 0) + 2
+        # staged samples replacing existing ones aren't counted
+        assert r.execute_command('TS.INFO', 't1')[1] == len(expected)
+        samples = [[ts, str(val).encode()] for ts, val in sorted(expected.items())]
+        assert r.execute_command('TS.RANGE', 't1', '-', '+') == samples
+        assert r.execute_command('TS.REVRANGE', 't1', '-', '+') == samples[::-1]
+        assert r.execute_command('TS.RANGE', 't1', 1, 20) == [[5, b'2'], [10, b'1'], [15, b'2'], [20, b'1']]
+        dump = r.execute_command('DUMP', 't1')
+        restored = samples
+
+        # the staged samples are merged by a sample OOO_STAGING_MAX_AGE past them, along with the
+        # compactions
+        r.execute_command('TS.ADD', 't1', 1050, 1)
+        assert r.execute_command('TS.RANGE', 't1_sum', 0, 0) == [[0, b'10']]
+        r.execute_command('TS.ADD', 't1', 1090, 1)
+        expected[1050] = expected[1090] = 1
+        samples = [[ts, str(val).encode()] for ts, val in sorted(expected.items())]
+        assert r.execute_command('TS.INFO', 't1')[1] == len(expected)
+        assert r.execute_command('TS.RANGE', 't1', '-', '+') == samples
+        assert r.execute_command('TS.RANGE', 't1_sum', 0, 0) == [[0, b'14']]
+        assert r.execute_command('TS.RANGE', 't1_sum', 500, 500) == [[500, b'14']]
+
+        r.execute_command('RESTORE', 't2', 0, dump)
+        assert r.execute_command('TS.RANGE', 't2', '-', '+') == restored
+        del expected[1050], expected[1090]
+
+        # reaching the size threshold merges right away
+        for ts in range(1, 80, 10):
+            r.execute_command('TS.ADD', 't2', ts, 3)
+            expected[ts] = 3
+        samples = [[ts, str(val).encode()] for ts, val in sorted(expected.items())]
+        assert r.execute_command('TS.INFO', 't2')[1] == len(expected)
+        assert r.execute_command('TS.RANGE', 't2', '-', '+') == samples
+
+        # duplicates staged under different policies apply in order
+        for ts in range(0, 1000, 10):
+            r.execute_command('TS.ADD', 't3', ts, 5)
+        r.execute_command('TS.ADD', 't3', 10, 3, 'ON_DUPLICATE', 'LAST')
+        r.execute_command('TS.ADD', 't3', 10, 4, 'ON_DUPLICATE', 'SUM')
+        assert r.execute_command('TS.RANGE', 't3', 10, 10) == [[10, b'7']]
+        r.execute_command('TS.ADD', 't3', 10, 6, 'ON_DUPLICATE', 'MIN')
+        r.execute_command('TS.ADD', 't3', 10, 2, 'ON_DUPLICATE', 'MAX')
+        assert r.execute_command('TS.RANGE', 't3', 10, 10) == [[10, b'6']]
+
+
 def test_uncompressed():
     Env().skipOnCluster()
     skip_on_rlec()
@@ -75,7 +149,9 @@ def test_compressed_debug():
         r.execute_command('TS.ADD', 't1', '3000', 1.0)
         r.execute_command('TS.ADD', 't1', '5000', 1.0)
 
-        assert TSInfo(r.execute_command('TS.INFO', 't1_MAX_1000', 'DEBUG')).chunks == [[b'startTimestamp', 0, b'endTimestamp', 3000, b'samples', 2, b'size', 4096, b'bytesPerSample', b'2048']]
+        # the samples are inline, listed as a chunk of the 512 bytes inline area instead of a 4096
+        # bytes chunk
+        assert TSInfo(r.execute_command('TS.INFO', 't1_MAX_1000', 'DEBUG')).chunks == [[b'startTimestamp', 0, b'endTimestamp', 3000, b'samples', 2, b'size', 512, b'bytesPerSample', b'256']]
 
 def test_timestamp_alignment():
     Env().skipOnCluster()
@@ -90,14 +166,17 @@ def test_timestamp_alignment():
         res.sort()
         assert res == [b't1', b't1_MAX_1000_500']
 
+        # the samples of these small series are inline: a 512 bytes area instead of a 4096 bytes
+        # chunk and its header, the memory usage was 4201 for the compaction and 4248 for t1, and
+        # DEBUG listed a 4096 bytes chunk
         info = r.execute_command('TS.INFO', 't1_MAX_1000_500')
-        assert info == [b'totalSamples', 2, b'memoryUsage', 4201, b'firstTimestamp', 0, b'lastTimestamp', 2500, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'uncompressed', b'duplicatePolicy', None, b'labels', [[b'aggregation', b'MAX'], [b'time_bucket', b'1000']], b'sourceKey', b't1', b'rules', []]
+        assert info == [b'totalSamples', 2, b'memoryUsage', 585, b'firstTimestamp', 0, b'lastTimestamp', 2500, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'uncompressed', b'duplicatePolicy', None, b'labels', [[b'aggregation', b'MAX'], [b'time_bucket', b'1000']], b'sourceKey', b't1', b'rules', []]
 
         info = r.execute_command('TS.INFO', 't1', 'DEBUG')
-        assert info == [b'totalSamples', 3, b'memoryUsage', 4248, b'firstTimestamp', 1, b'lastTimestamp', 5000, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'compressed', b'duplicatePolicy', None, b'labels', [], b'sourceKey', None, b'rules', [[b't1_MAX_1000_500', 1000, b'MAX', 500]], b'keySelfName', b't1', b'Chunks', [[b'startTimestamp', 1, b'endTimestamp', 5000, b'samples', 3, b'size', 4096, b'bytesPerSample', b'1365.3333740234375']]]
+        assert info == [b'totalSamples', 3, b'memoryUsage', 584, b'firstTimestamp', 1, b'lastTimestamp', 5000, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'compressed', b'duplicatePolicy', None, b'labels', [], b'sourceKey', None, b'rules', [[b't1_MAX_1000_500', 1000, b'MAX', 500]], b'keySelfName', b't1', b'Chunks', [[b'startTimestamp', 1, b'endTimestamp', 5000, b'samples', 3, b'size', 512, b'bytesPerSample', b'170.66667175292969']]]
 
         info = r.execute_command('TS.INFO', 't1')
-        assert info == [b'totalSamples', 3, b'memoryUsage', 4248, b'firstTimestamp', 1, b'lastTimestamp', 5000, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'compressed', b'duplicatePolicy', None, b'labels', [], b'sourceKey', None, b'rules', [[b't1_MAX_1000_500', 1000, b'MAX', 500]]]
+        assert info == [b'totalSamples', 3, b'memoryUsage', 584, b'firstTimestamp', 1, b'lastTimestamp', 5000, b'retentionTime', 0, b'chunkCount', 1, b'chunkSize', 4096, b'chunkType', b'compressed', b'duplicatePolicy', None, b'labels', [], b'sourceKey', None, b'rules', [[b't1_MAX_1000_500', 1000, b'MAX', 500]]]
 
 class testGlobalConfigTests():
 
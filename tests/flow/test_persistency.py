@@ -1,3 +1,5 @@
+import time
+
 from RLTest import Env
 from test_helper_classes import ALLOWED_ERROR, _insert_data, _get_ts_info
 from includes import *
@@ -124,6 +126,50 @@ def test_dump_trimmed_series(self):
         assert r.execute_command('ts.range', 'test_key', '-', '+') == before
 
 
+def test_decimal_dump_restore():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('ts.create', 'test_key', 'ENCODING', 'DECIMAL', 'CHUNK_SIZE', 128)
+        # integers, then 2 decimals, then values which aren't decimals
+        for i in range(1, 500):
+            value = i * 7 if i < 100 else i / 100 if i < 300 else i / 3
+            r.execute_command('ts.add', 'test_key', i * 1000, value)
+        r.execute_command('ts.add', 'test_key', 1500, 0.25)
+        before = r.execute_command('ts.range', 'test_key', '-', '+')
+        assert len(before) == 500
+        assert before[1] == [1500, b'0.25']
+        dump = r.execute_command('dump', 'test_key')
+        r.execute_command('del', 'test_key')
+        r.execute_command('restore', 'test_key', 0, dump)
+        assert r.execute_command('ts.range', 'test_key', '-', '+') == before
+        assert _get_ts_info(r, 'test_key').chunk_type == b'decimal'
+        r.execute_command('ts.add', 'test_key', 500000, 12.34)
+        assert r.execute_command('ts.get', 'test_key') == [500000, b'12.34']
+
+
+def test_hybrid_dump_restore():
+    with Env().getClusterConnectionIfNeeded() as r:
+        for key, encoding in [('raw_key{a}', 'UNCOMPRESSED'), ('test_key{a}', 'HYBRID')]:
+            r.execute_command('ts.create', key, 'ENCODING', encoding, 'CHUNK_SIZE', 1024)
+            for i in range(1, 1000):
+                r.execute_command('ts.add', key, i * 1000, i % 10)
+            r.execute_command('ts.add', key, 1500, 42)
+        before = r.execute_command('ts.range', 'raw_key{a}', '-', '+')
+        assert r.execute_command('ts.range', 'test_key{a}', '-', '+') == before
+        # full chunks are compressed by a timer
+        time.sleep(0.5)
+        raw_info = _get_ts_info(r, 'raw_key{a}')
+        info = _get_ts_info(r, 'test_key{a}')
+        assert info.chunk_type == b'hybrid'
+        assert info.memory_usage < raw_info.memory_usage / 2
+        assert r.execute_command('ts.range', 'test_key{a}', '-', '+') == before
+        dump = r.execute_command('dump', 'test_key{a}')
+        r.execute_command('del', 'test_key{a}')
+        r.execute_command('restore', 'test_key{a}', 0, dump)
+        assert r.execute_command('ts.range', 'test_key{a}', '-', '+') == before
+        r.execute_command('ts.add', 'test_key{a}', 2500, 7)
+        assert r.execute_command('ts.range', 'test_key{a}', 2500, 2500) == [[2500, b'7']]
+
+
 def test_empty_series():
     with Env().getClusterConnectionIfNeeded() as r:
         assert r.execute_command('TS.CREATE', 'tester')
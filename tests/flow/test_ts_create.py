@@ -96,7 +96,9 @@ def test_uncompressed():
         assert [[1, b'3.5'], [2, b'4.5'], [3, b'5.5']] == \
                r.execute_command('ts.range', 'not_compressed', 0, '+')
         info = _get_ts_info(r, 'not_compressed')
-        assert info.total_samples == 3 and info.memory_usage == 4136
+        # the samples are inline: a 512 bytes area instead of a 4096 bytes chunk and its header, the
+        # memory usage was 4136
+        assert info.total_samples == 3 and info.memory_usage == 520
 
         # rdb load
         data = r.execute_command('dump', 'not_compressed')
@@ -107,11 +109,41 @@ def test_uncompressed():
         assert [[1, b'3.5'], [2, b'4.5'], [3, b'5.5']] == \
                r.execute_command('ts.range', 'not_compressed', 0, "+")
         info = _get_ts_info(r, 'not_compressed')
-        assert info.total_samples == 3 and info.memory_usage == 4136
+        assert info.total_samples == 3 and info.memory_usage == 520
         # test deletion
         assert r.delete('not_compressed')
 
 
+def test_small_series_inline():
+    with Env().getClusterConnectionIfNeeded() as r:
+        r.execute_command('ts.create', 'small', 'DUPLICATE_POLICY', 'SUM')
+        for ts in range(10, 110, 10):
+            r.execute_command('ts.add', 'small', ts, 1)
+        # out of order samples and duplicates are upserted inline
+        r.execute_command('ts.add', 'small', 5, 2)
+        r.execute_command('ts.add', 'small', 50, 2)
+        assert r.execute_command('ts.del', 'small', 20, 30) == 2
+        expected = [[5, b'2'], [10, b'1'], [40, b'1'], [50, b'3'], [60, b'1'], [70, b'1'], [80, b'1'],
+                    [90, b'1'], [100, b'1']]
+        assert r.execute_command('ts.range', 'small', '-', '+') == expected
+        assert r.execute_command('ts.revrange', 'small', 45, 65) == [[60, b'1'], [50, b'3']]
+        info = _get_ts_info(r, 'small')
+        assert info.total_samples == 9 and info.chunk_count == 1 and info.memory_usage == 520
+
+        data = r.execute_command('dump', 'small')
+        r.execute_command('restore', 'small_restored', 0, data)
+        assert r.execute_command('ts.range', 'small_restored', '-', '+') == expected
+        assert _get_ts_info(r, 'small_restored').memory_usage == 520
+
+        # growing past the inline samples moves them into chunks
+        for ts in range(110, 1000, 10):
+            r.execute_command('ts.add', 'small', ts, 1)
+        r.execute_command('ts.add', 'small', 15, 2)
+        expected = sorted(expected + [[15, b'2']] + [[ts, b'1'] for ts in range(110, 1000, 10)])
+        assert r.execute_command('ts.range', 'small', '-', '+') == expected
+        assert _get_ts_info(r, 'small').total_samples == len(expected)
+
+
 def test_trim():
     with Env().getClusterConnectionIfNeeded() as r:
         for mode in ["UNCOMPRESSED", "COMPRESSED"]:
@@ -180,12 +212,46 @@ def test_expire():
         assert r.execute_command('keys', '*') == []
 
 def test_ts_create_encoding():
-    for ENCODING in ['compressed','uncompressed']:
+    for ENCODING in ['compressed','uncompressed','decimal','hybrid']:
         e = Env()
         e.flush()
         with e.getClusterConnectionIfNeeded() as r:
             r.execute_command('ts.create', 't1', 'ENCODING', ENCODING)
             e.assertEqual(TSInfo(r.execute_command('TS.INFO', 't1')).chunk_type, ENCODING.encode())
+            if ENCODING in ['decimal', 'hybrid']:
+                continue
             # backwards compatible check
             r.execute_command('ts.create', 't1_bc', ENCODING)
             e.assertEqual(TSInfo(r.execute_command('TS.INFO', 't1_bc')).chunk_type, ENCODING.encode())
+
+def test_chunk_size_auto():
+    e = Env()
+    with e.getClusterConnectionIfNeeded() as r:
+        def info(key):
+            res = r.execute_command('TS.INFO', key)
+            return dict(zip(res[::2], res[1::2]))
+
+        r.execute_command('TS.CREATE', 'fast{1}', 'ENCODING', 'uncompressed', 'CHUNK_SIZE', 'AUTO')
+        e.assertEqual(info('fast{1}')[b'chunkSize'], 4096)
+        e.assertEqual(info('fast{1}')[b'chunkSizeReason'], b'default')
+        # a sample per millisecond, the next chunks get the largest size
+        for ts in range(1, 601):
+            r.execute_command('TS.ADD', 'fast{1}', ts, ts)
+        e.assertEqual(info('fast{1}')[b'chunkSize'], 65536)
+        e.assertEqual(info('fast{1}')[b'chunkSizeReason'], b'ingest rate')
+
+        # a sample per second, a minute of 16 bytes samples takes 960 bytes
+        r.execute_command('TS.CREATE', 'slow{1}', 'ENCODING', 'uncompressed', 'CHUNK_SIZE', 'AUTO')
+        for ts in range(1, 601):
+            r.execute_command('TS.ADD', 'slow{1}', ts * 1000, ts)
+        e.assertEqual(info('slow{1}')[b'chunkSize'], 1024)
+        e.assertEqual(info('slow{1}')[b'chunkSizeReason'], b'ingest rate')
+        e.assertEqual(len(r.execute_command('TS.RANGE', 'slow{1}', '-', '+')), 600)
+
+        # a fixed size turns AUTO off
+        r.execute_command('TS.ALTER', 'slow{1}', 'CHUNK_SIZE', '2048')
+        e.assertEqual(info('slow{1}')[b'chunkSize'], 2048)
+        e.assertFalse(b'chunkSizeReason' in info('slow{1}'))
+        r.execute_command('TS.ALTER', 'slow{1}', 'CHUNK_SIZE', 'auto')
+        e.assertEqual(info('slow{1}')[b'chunkSize'], 2048)
+        e.assertTrue(b'chunkSizeReason' in info('slow{1}'))
@@ -353,6 +353,79 @@ def test_backfill_downsampling(self):
                 r.execute_command('DEL', agg_key)
 
 
+def test_upsert_closed_bucket(self):
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        key = 'tester{a}'
+        for agg in ['sum', 'count', 'min', 'max', 'avg']:
+            agg_key = '{}_{}{{a}}'.format(key, agg)
+            r.execute_command('TS.CREATE', key, 'DUPLICATE_POLICY', 'LAST')
+            r.execute_command('TS.CREATE', agg_key)
+            r.execute_command('TS.CREATERULE', key, agg_key, 'AGGREGATION', agg, 10)
+            for ts in range(0, 100, 2):
+                r.execute_command('TS.ADD', key, ts, ts % 7)
+
+            # new samples, replacements of the bucket's min and max and of other samples
+            for ts, value in [(11, 3), (13, -5), (21, 100), (20, 4), (22, 6), (30, 1),
+                              (32, -1), (38, 0), (40, 6), (47, 2), (48, 3)]:
+                r.execute_command('TS.ADD', key, ts, value)
+                expected_result = r.execute_command('TS.RANGE', key, 0, 89, 'aggregation', agg, 10)
+                actual_result = r.execute_command('TS.RANGE', agg_key, 0, 89)
+                env.assertEqual(expected_result, actual_result)
+            r.execute_command('DEL', key)
+            r.execute_command('DEL', agg_key)
+
+
+def test_madd_backfill_closed_buckets(self):
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        key = 'tester{a}'
+        aggs = ['sum', 'count', 'min', 'max', 'avg', 'last']
+        r.execute_command('TS.CREATE', key, 'DUPLICATE_POLICY', 'LAST')
+        for agg in aggs:
+            r.execute_command('TS.CREATE', '{}_{}{{a}}'.format(key, agg))
+            r.execute_command('TS.CREATERULE', key, '{}_{}{{a}}'.format(key, agg), 'AGGREGATION', agg, 10)
+        # a rule of a dest is updated by the writes of the buckets
+        r.execute_command('TS.CREATE', 'sum_100{a}')
+        r.execute_command('TS.CREATERULE', '{}_sum{{a}}'.format(key), 'sum_100{a}', 'AGGREGATION', 'sum', 100)
+        for ts in range(0, 1000, 5):
+            r.execute_command('TS.ADD', key, ts, ts % 11)
+
+        args = []
+        for ts in range(1, 600, 3):
+            args += [key, ts, ts % 13]
+        args += [key, 20, 7, key, 20, 8]
+        r.execute_command('TS.MADD', *args)
+
+        for agg in aggs:
+            expected_result = r.execute_command('TS.RANGE', key, 0, 989, 'aggregation', agg, 10)
+            actual_result = r.execute_command('TS.RANGE', '{}_{}{{a}}'.format(key, agg), 0, 989)
+            env.assertEqual(expected_result, actual_result)
+        expected_result = r.execute_command('TS.RANGE', '{}_sum{{a}}'.format(key), 0, 899, 'aggregation', 'sum', 100)
+        env.assertEqual(expected_result, r.execute_command('TS.RANGE', 'sum_100{a}', 0, 899))
+
+
+def test_upsert_partial_bucket(self):
+    env = Env()
+    with env.getClusterConnectionIfNeeded() as r:
+        key = 'tester{a}'
+        for agg, expected in [('max', b'100'), ('sum', b'106'), ('count', b'3')]:
+            agg_key = '{}_{}{{a}}'.format(key, agg)
+            r.execute_command('TS.CREATE', key)
+            r.execute_command('TS.CREATE', agg_key)
+            # the rule is created in the middle of the first bucket, it only sees its later samples
+            r.execute_command('TS.ADD', key, 10, 100)
+            r.execute_command('TS.CREATERULE', key, agg_key, 'AGGREGATION', agg, 100)
+            r.execute_command('TS.ADD', key, 20, 1)
+            r.execute_command('TS.ADD', key, 150, 0)
+
+            # a late sample into the first bucket aggregates all of its samples again
+            r.execute_command('TS.ADD', key, 30, 5)
+            env.assertEqual(r.execute_command('TS.RANGE', agg_key, 0, 0), [[0, expected]])
+            r.execute_command('DEL', key)
+            r.execute_command('DEL', agg_key)
+
+
 def test_rule_timebucket_64bit(self):
     Env().skipOnCluster()
     with Env().getClusterConnectionIfNeeded() as r:
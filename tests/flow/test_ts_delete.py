@@ -4,6 +4,7 @@ import redis
 from test_helper_classes import _get_ts_info, TSInfo
 from includes import *
 import random
+import time
 
 def test_ts_del_uncompressed():
     # total samples = 101
@@ -146,6 +147,35 @@ def test_ts_del_multi_chunk():
             e.assertEqual(len(res), 1)
         e.flush()
 
+def test_ts_del_coalesce_chunks():
+    e = Env()
+    e.skipOnCluster()
+    with e.getConnection() as r:
+        for CHUNK_TYPE in ["compressed", "uncompressed"]:
+            r.execute_command("ts.create", 'test_key', CHUNK_TYPE, 'CHUNK_SIZE', '128')
+            ts = 1
+            while _get_ts_info(r, 'test_key').chunk_count < 9:
+                r.execute_command("ts.add", 'test_key', ts, ts % 3)
+                ts += 1
+            # keep the first sample of each chunk but the last
+            info = TSInfo(r.execute_command("ts.info", 'test_key', 'DEBUG'))
+            starts = [chunk[1] for chunk in info.chunks]
+            for start, end in zip(starts[:-1], starts[1:]):
+                r.execute_command("ts.del", 'test_key', start + 1, end - 1)
+            expected = r.execute_command('ts.range', 'test_key', '-', '+')
+
+            merged_before = r.info('timeseries')['timeseries_merged_chunks']
+            # the undersized chunks are merged in the background
+            for _ in range(50):
+                if _get_ts_info(r, 'test_key').chunk_count == 2:
+                    break
+                time.sleep(0.1)
+            e.assertEqual(_get_ts_info(r, 'test_key').chunk_count, 2)
+            e.assertEqual(r.execute_command('ts.range', 'test_key', '-', '+'), expected)
+            merged = r.info('timeseries')['timeseries_merged_chunks'] - merged_before
+            e.assertGreaterEqual(merged, 7)
+            r.execute_command("del", 'test_key')
+
 def test_ts_del_with_plus():
     e = Env()
     with e.getClusterConnectionIfNeeded() as r:
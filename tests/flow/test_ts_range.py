@@ -9,6 +9,7 @@ from includes import *
 from ctypes import *
 from utils import timeit
 import random
+import statistics
 from datetime import datetime
 
 def test_range_query():
@@ -1274,6 +1275,223 @@ def test_max_extensive():
         print(seed)
         raise e
 
+def test_agg_chunk_stats():
+    # buckets wider than a chunk are folded using the chunk stats, the results must not change
+    env = Env(decodeResponses=True)
+    samples = [(ts, random.randint(-100, 100)) for ts in range(1, 2001, 2)]
+    aggs = {'min': min, 'max': max, 'sum': sum, 'count': len,
+            'avg': lambda v: sum(v) / len(v), 'range': lambda v: max(v) - min(v),
+            'first': lambda v: v[0], 'last': lambda v: v[-1]}
+    for ENCODING in ['uncompressed', 'compressed']:
+        env.flush()
+        with env.getClusterConnectionIfNeeded() as r:
+            assert r.execute_command('TS.CREATE', 't1', ENCODING, 'CHUNK_SIZE', '128')
+            for ts, value in samples:
+                r.execute_command('TS.ADD', 't1', ts, value)
+            # out of order sample and deletion
+            r.execute_command('TS.ADD', 't1', 500, 1000)
+            r.execute_command('TS.DEL', 't1', 1200, 1300)
+            series = sorted([s for s in samples if not 1200 <= s[0] <= 1300] + [(500, 1000)])
+            for bucket in [7, 100, 1000]:
+                for min_val, max_val in [(-1000, 1000), (0, 50), (200, 300)]:
+                    filtered = [s for s in series if min_val <= s[1] <= max_val]
+                    for agg, func in aggs.items():
+                        buckets = {}
+                        for ts, value in filtered:
+                            buckets.setdefault(ts - ts % bucket, []).append(value)
+                        expected = [[ts, func(buckets[ts])] for ts in sorted(buckets)]
+                        res = r.execute_command('TS.RANGE', 't1', '-', '+', 'FILTER_BY_VALUE',
+                                                min_val, max_val, 'AGGREGATION', agg, bucket)
+                        env.assertEqual([[ts, float(v)] for ts, v in res], expected)
+                        if agg in ['first', 'last']:
+                            continue
+                        rev_res = r.execute_command('TS.REVRANGE', 't1', '-', '+',
+                                                    'FILTER_BY_VALUE', min_val, max_val,
+                                                    'AGGREGATION', agg, bucket)
+                        env.assertEqual(rev_res, res[::-1])
+
+def test_agg_vectorized():
+    # the samples of a bucket are appended at once, by the vectorized kernels when there are some
+    env = Env(decodeResponses=True)
+    samples = [(ts, random.uniform(-1000, 1000)) for ts in range(0, 3000, 3)]
+    aggs = {'min': min, 'max': max, 'sum': sum, 'count': len,
+            'avg': statistics.mean, 'range': lambda v: max(v) - min(v),
+            'std.p': statistics.pstdev, 'std.s': statistics.stdev,
+            'var.p': statistics.pvariance, 'var.s': statistics.variance,
+            'first': lambda v: v[0], 'last': lambda v: v[-1]}
+    for ENCODING in ['uncompressed', 'compressed']:
+        env.flush()
+        with env.getClusterConnectionIfNeeded() as r:
+            assert r.execute_command('TS.CREATE', 't1', ENCODING, 'CHUNK_SIZE', '4096')
+            for ts, value in samples:
+                r.execute_command('TS.ADD', 't1', ts, value)
+            for bucket in [5, 24, 31, 100, 1000]:
+                buckets = {}
+                for ts, value in samples:
+                    buckets.setdefault(ts - ts % bucket, []).append(value)
+                for agg, func in aggs.items():
+                    res = r.execute_command('TS.RANGE', 't1', '-', '+', 'AGGREGATION', agg, bucket)
+                    env.assertEqual([ts for ts, _ in res], sorted(buckets))
+                    for ts, value in res:
+                        if agg == 'std.s' or agg == 'var.s':
+                            if len(buckets[ts]) < 2:
+                                continue
+                        expected = func(buckets[ts])
+                        env.assertLess(abs(float(value) - expected), ALLOWED_ERROR * max(1, abs(expected)))
+
+
+def test_multi_aggregation():
+    env = Env(decodeResponses=True)
+    aggs = ['min', 'max', 'avg', 'count', 'last']
+    with env.getClusterConnectionIfNeeded() as r:
+        assert r.execute_command('TS.CREATE', 't1{1}', 'LABELS', 'name', 'multi')
+        # leave gaps for the empty buckets
+        for ts in list(range(0, 500, 7)) + list(range(900, 1500, 11)):
+            r.execute_command('TS.ADD', 't1{1}', ts, random.uniform(-100, 100))
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for args in [['AGGREGATION', 'min,max,avg,count,last', 50],
+                         ['ALIGN', 3, 'AGGREGATION', 'min,max,avg,count,last', 50, 'BUCKETTIMESTAMP', 'mid', 'EMPTY']]:
+                res = r.execute_command(cmd, 't1{1}', '-', '+', *args)
+                singles = [r.execute_command(cmd, 't1{1}', '-', '+', *[agg if a == 'min,max,avg,count,last' else a for a in args])
+                           for agg in aggs]
+                env.assertEqual(len(res), len(singles[0]))
+                for i, bucket in enumerate(res):
+                    env.assertEqual(bucket, [singles[0][i][0]] + [single[i][1] for single in singles])
+
+        res = r.execute_command('TS.RANGE', 't1{1}', 0, 100, 'COUNT', 1, 'AGGREGATION', 'sum,count', 50)
+        env.assertEqual(len(res), 1)
+        env.assertEqual(res[0][0], 0)
+        env.assertEqual(res[0][2], '8')
+
+    res = env.getConnection().execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'max,min', 100, 'FILTER', 'name=multi')
+    env.assertEqual(res[0][2], [[ts, max_v, min_v] for (ts, max_v), (_, min_v) in zip(
+        env.getConnection().execute_command('TS.RANGE', 't1{1}', '-', '+', 'AGGREGATION', 'max', 100),
+        env.getConnection().execute_command('TS.RANGE', 't1{1}', '-', '+', 'AGGREGATION', 'min', 100))])
+
+    with env.getClusterConnectionIfNeeded() as r:
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 't1{1}', '-', '+', 'AGGREGATION', 'min,twa', 50)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 't1{1}', '-', '+', 'AGGREGATION', 'min,', 50)
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 't1{1}', '-', '+', 'AGGREGATION', 'min,foo', 50)
+        assert r.execute_command('TS.CREATE', 't2{1}')
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.CREATERULE', 't1{1}', 't2{1}', 'AGGREGATION', 'min,max', 50)
+    with pytest.raises(redis.ResponseError):
+        env.getConnection().execute_command('TS.MRANGE', '-', '+', 'AGGREGATION', 'max,min', 100,
+                                            'FILTER', 'name=multi', 'GROUPBY', 'name', 'REDUCE', 'max')
+
+
+def test_rollup_queries():
+    env = Env(decodeResponses=True)
+
+    def assert_same_range(r, cmd, key, *args):
+        rollup = r.execute_command(cmd, key, *args, 'ROLLUP')
+        raw = r.execute_command(cmd, key, *args, 'NOROLLUP')
+        env.assertEqual([ts for ts, _ in rollup], [ts for ts, _ in raw])
+        for (_, rollup_val), (_, raw_val) in zip(rollup, raw):
+            env.assertTrue(math.isclose(float(rollup_val), float(raw_val), rel_tol=1e-9) or
+                           (math.isnan(float(rollup_val)) and math.isnan(float(raw_val))))
+
+    def rollup_info(r, key):
+        info = r.execute_command('TS.INFO', key)
+        info = dict(zip(info[::2], info[1::2]))
+        return info.get('rollupQueries', 0), info.get('rollupHits', 0)
+
+    with env.getClusterConnectionIfNeeded() as r:
+        assert r.execute_command('TS.CREATE', 'src{3}')
+        for dest, agg, bucket in [('min{3}', 'min', 50), ('max{3}', 'max', 20),
+                                  ('count{3}', 'count', 20), ('avg{3}', 'avg', 50)]:
+            assert r.execute_command('TS.CREATE', dest)
+            assert r.execute_command('TS.CREATERULE', 'src{3}', dest, 'AGGREGATION', agg, bucket)
+        for ts in range(0, 2000, 3):
+            r.execute_command('TS.ADD', 'src{3}', ts, random.randint(-1000, 1000))
+        env.assertEqual(rollup_info(r, 'src{3}'), (0, 0))
+
+        for cmd in ['TS.RANGE', 'TS.REVRANGE']:
+            for agg, bucket in [('min', 100), ('max', 100), ('count', 60), ('avg', 50), ('sum', 100)]:
+                for start, end in [('-', '+'), (200, 1499), (233, 1400)]:
+                    assert_same_range(r, cmd, 'src{3}', start, end, 'AGGREGATION', agg, bucket)
+                    assert_same_range(r, cmd, 'src{3}', start, end, 'AGGREGATION', agg, bucket, 'EMPTY')
+        queries, hits = rollup_info(r, 'src{3}')
+        env.assertEqual(queries, 2 * 5 * 3 * 2)
+        env.assertTrue(0 < hits < queries)
+
+        # sum has no rule, an unaligned start leaves the first bucket partial
+        r.execute_command('TS.RANGE', 'src{3}', '-', '+', 'AGGREGATION', 'sum', 100, 'ROLLUP')
+        r.execute_command('TS.RANGE', 'src{3}', 233, '+', 'AGGREGATION', 'min', 100, 'ROLLUP')
+        env.assertEqual(rollup_info(r, 'src{3}'), (queries + 2, hits))
+        r.execute_command('TS.RANGE', 'src{3}', 200, '+', 'AGGREGATION', 'min', 100, 'ROLLUP')
+        env.assertEqual(rollup_info(r, 'src{3}'), (queries + 3, hits + 1))
+
+        # the buckets of a rule created after the samples lack them
+        assert r.execute_command('TS.CREATE', 'first{3}')
+        assert r.execute_command('TS.CREATERULE', 'src{3}', 'first{3}', 'AGGREGATION', 'first', 100)
+        for ts in range(2100, 2500, 7):
+            r.execute_command('TS.ADD', 'src{3}', ts, random.randint(-1000, 1000))
+        queries, hits = rollup_info(r, 'src{3}')
+        assert_same_range(r, 'TS.RANGE', 'src{3}', '-', '+', 'AGGREGATION', 'first', 100)
+        env.assertEqual(rollup_info(r, 'src{3}'), (queries + 1, hits))
+        assert_same_range(r, 'TS.RANGE', 'src{3}', 2100, '+', 'AGGREGATION', 'first', 100)
+        env.assertEqual(rollup_info(r, 'src{3}'), (queries + 2, hits + 1))
+
+        # only a single aggregation without filters is read from a rule
+        assert_same_range(r, 'TS.RANGE', 'src{3}', '-', '+', 'FILTER_BY_VALUE', 0, 1000, 'AGGREGATION', 'min', 100)
+        assert_same_range(r, 'TS.RANGE', 'src{3}', '-', '+', 'AGGREGATION', 'twa', 100)
+        env.assertEqual(rollup_info(r, 'src{3}'), (queries + 2, hits + 1))
+
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'src{3}', '-', '+', 'AGGREGATION', 'min', 100, 'ROLLUP', 'NOROLLUP')
+
+
+def test_quantile_aggregation():
+    env = Env(decodeResponses=True)
+    quantiles = {'p50': 0.5, 'p90': 0.9, 'p95': 0.95, 'p99': 0.99, 'p999': 0.999}
+    values = {}
+
+    def assert_quantiles(res, q, bucket):
+        for ts, value in res:
+            bucket_values = sorted(values[t] for t in range(ts, ts + bucket) if t in values)
+            exact = bucket_values[math.floor(q * (len(bucket_values) - 1))]
+            env.assertLessEqual(abs(float(value) - exact), exact * 0.01 + 1e-9)
+
+    with env.getClusterConnectionIfNeeded() as r:
+        assert r.execute_command('TS.CREATE', 'q{4}')
+        assert r.execute_command('TS.CREATE', 'q_p99{4}')
+        assert r.execute_command('TS.CREATERULE', 'q{4}', 'q_p99{4}', 'AGGREGATION', 'p99', 100)
+        for ts in range(0, 950):
+            values[ts] = random.uniform(1, 10000)
+            r.execute_command('TS.ADD', 'q{4}', ts, values[ts])
+
+        for agg, q in quantiles.items():
+            res = r.execute_command('TS.RANGE', 'q{4}', '-', '+', 'AGGREGATION', agg, 100)
+            env.assertEqual(len(res), 10)
+            assert_quantiles(res, q, 100)
+        res = r.execute_command('TS.REVRANGE', 'q{4}', 0, 1000, 'AGGREGATION', 'p90,p50', 300)
+        env.assertEqual([ts for ts, _, _ in res], [900, 600, 300, 0])
+        assert_quantiles([[ts, p90] for ts, p90, _ in res], 0.9, 300)
+        assert_quantiles([[ts, p50] for ts, _, p50 in res], 0.5, 300)
+
+        res = r.execute_command('TS.RANGE', 'q_p99{4}', '-', '+', 'LATEST')
+        env.assertEqual(len(res), 10)
+        assert_quantiles(res, 0.99, 100)
+
+    # the sketch of the open bucket is persisted
+    env.dumpAndReload()
+    with env.getClusterConnectionIfNeeded() as r:
+        for ts in range(950, 1001):
+            values[ts] = random.uniform(1, 10000)
+            r.execute_command('TS.ADD', 'q{4}', ts, values[ts])
+        res = r.execute_command('TS.RANGE', 'q_p99{4}', '-', '+')
+        env.assertEqual(len(res), 10)
+        assert_quantiles(res, 0.99, 100)
+
+        with pytest.raises(redis.ResponseError):
+            r.execute_command('TS.RANGE', 'q{4}', '-', '+', 'AGGREGATION', 'p98', 100)
+
+
 def build_expected_aligned_data(start_ts, end_ts, agg_size, alignment_ts):
     expected_data = []
     last_bucket = get_bucket(start_ts, alignment_ts, agg_size)
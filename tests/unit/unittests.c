@@ -8,9 +8,14 @@
 #include "minunit.h"
 
 #include "parse_policies.h"
+#include "unittests_chunk_dir.c"
+#include "unittests_chunk_pool.c"
 #include "unittests_compressed_chunk.c"
+#include "unittests_hybrid_chunk.c"
 #include "unittests_parse_duplicate_policy.c"
 #include "unittests_parse_policies.c"
+#include "unittests_quantile_sketch.c"
+#include "unittests_staging_buffer.c"
 #include "unittests_uncompressed_chunk.c"
 
 #include <stdio.h>
@@ -23,6 +28,11 @@ int main(int argc, char *argv[]) {
     MU_RUN_SUITE(parse_policies_test_suite);
     MU_RUN_SUITE(uncompressed_chunk_test_suite);
     MU_RUN_SUITE(compressed_chunk_test_suite);
+    MU_RUN_SUITE(hybrid_chunk_test_suite);
+    MU_RUN_SUITE(chunk_dir_test_suite);
+    MU_RUN_SUITE(chunk_pool_test_suite);
+    MU_RUN_SUITE(staging_buffer_test_suite);
+    MU_RUN_SUITE(quantile_sketch_test_suite);
     MU_RUN_SUITE(parse_duplicate_policy_test_suite);
     MU_REPORT();
     return minunit_fail;
@@ -0,0 +1,122 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "chunk_dir.h"
+#include "generic_chunk.h"
+#include "minunit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+// Chunk with the samples first..last, step apart
+static Chunk_t *newChunkWith(const ChunkFuncs *funcs,
+                             timestamp_t first,
+                             timestamp_t last,
+                             timestamp_t step) {
+    Chunk_t *chunk = funcs->NewChunk(4096);
+    for (timestamp_t ts = first; ts <= last; ts += step) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        funcs->AddSample(chunk, &sample);
+    }
+    return chunk;
+}
+
+MU_TEST(test_ChunkDir_insert_sorted) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_REGULAR);
+    ChunkDir *dir = ChunkDir_New();
+
+    // appended, then inserted out of order past the initial capacity
+    const timestamp_t firsts[] = { 100, 300, 500, 200, 0, 400, 600 };
+    for (size_t i = 0; i < sizeof(firsts) / sizeof(firsts[0]); i++) {
+        ChunkDir_Insert(dir, newChunkWith(funcs, firsts[i], firsts[i] + 90, 10), funcs);
+    }
+    mu_assert_int_eq(7, ChunkDir_Size(dir));
+    for (size_t i = 0; i < ChunkDir_Size(dir); i++) {
+        ChunkDirEntry *entry = ChunkDir_At(dir, i);
+        mu_assert_int_eq(i * 100, entry->firstTs);
+        mu_assert_int_eq(i * 100 + 90, entry->lastTs);
+        mu_assert_int_eq(10, entry->count);
+        mu_assert_int_eq(entry->firstTs, funcs->GetFirstTimestamp(entry->chunk));
+    }
+
+    for (size_t i = 0; i < ChunkDir_Size(dir); i++) {
+        funcs->FreeChunk(ChunkDir_At(dir, i)->chunk);
+    }
+    ChunkDir_Free(dir);
+}
+
+MU_TEST(test_ChunkDir_floor_ceil) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_REGULAR);
+    ChunkDir *dir = ChunkDir_New();
+    // chunks [100, 190], [200, 290], [300, 390]
+    for (timestamp_t first = 100; first <= 300; first += 100) {
+        ChunkDir_Insert(dir, newChunkWith(funcs, first, first + 90, 10), funcs);
+    }
+
+    mu_assert_int_eq(0, ChunkDir_Floor(dir, 0));
+    mu_assert_int_eq(0, ChunkDir_Floor(dir, 100));
+    mu_assert_int_eq(0, ChunkDir_Floor(dir, 195));
+    mu_assert_int_eq(1, ChunkDir_Floor(dir, 200));
+    mu_assert_int_eq(2, ChunkDir_Floor(dir, 1000));
+
+    mu_assert_int_eq(0, ChunkDir_Ceil(dir, 0));
+    mu_assert_int_eq(0, ChunkDir_Ceil(dir, 190));
+    mu_assert_int_eq(1, ChunkDir_Ceil(dir, 195));
+    mu_assert_int_eq(2, ChunkDir_Ceil(dir, 390));
+    mu_assert_int_eq(3, ChunkDir_Ceil(dir, 391));
+
+    for (size_t i = 0; i < ChunkDir_Size(dir); i++) {
+        funcs->FreeChunk(ChunkDir_At(dir, i)->chunk);
+    }
+    ChunkDir_Free(dir);
+}
+
+MU_TEST(test_ChunkDir_remove_refresh_append) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_REGULAR);
+    ChunkDir *dir = ChunkDir_New();
+    for (timestamp_t first = 0; first <= 300; first += 100) {
+        ChunkDir_Insert(dir, newChunkWith(funcs, first, first + 90, 10), funcs);
+    }
+
+    // remove the two middle chunks
+    funcs->FreeChunk(ChunkDir_At(dir, 1)->chunk);
+    funcs->FreeChunk(ChunkDir_At(dir, 2)->chunk);
+    ChunkDir_Remove(dir, 1, 2);
+    mu_assert_int_eq(2, ChunkDir_Size(dir));
+    mu_assert_int_eq(0, ChunkDir_At(dir, 0)->firstTs);
+    mu_assert_int_eq(300, ChunkDir_At(dir, 1)->firstTs);
+
+    // the first timestamp of a chunk changes after a delete
+    funcs->DelRange(ChunkDir_At(dir, 0)->chunk, 0, 40);
+    ChunkDir_Refresh(dir, 0, funcs);
+    mu_assert_int_eq(50, ChunkDir_At(dir, 0)->firstTs);
+    mu_assert_int_eq(5, ChunkDir_At(dir, 0)->count);
+
+    // samples appended to the last chunk
+    Chunk_t *empty = funcs->NewChunk(4096);
+    ChunkDir_Insert(dir, empty, funcs);
+    mu_assert_int_eq(3, ChunkDir_Size(dir));
+    mu_assert_int_eq(0, ChunkDir_Last(dir)->count);
+    for (timestamp_t ts = 500; ts <= 520; ts += 10) {
+        Sample sample = { .timestamp = ts, .value = ts };
+        funcs->AddSample(empty, &sample);
+        ChunkDir_Append(dir, ts);
+    }
+    mu_assert_int_eq(500, ChunkDir_Last(dir)->firstTs);
+    mu_assert_int_eq(520, ChunkDir_Last(dir)->lastTs);
+    mu_assert_int_eq(3, ChunkDir_Last(dir)->count);
+
+    for (size_t i = 0; i < ChunkDir_Size(dir); i++) {
+        funcs->FreeChunk(ChunkDir_At(dir, i)->chunk);
+    }
+    ChunkDir_Free(dir);
+}
+
+MU_TEST_SUITE(chunk_dir_test_suite) {
+    MU_RUN_TEST(test_ChunkDir_insert_sorted);
+    MU_RUN_TEST(test_ChunkDir_floor_ceil);
+    MU_RUN_TEST(test_ChunkDir_remove_refresh_append);
+}
@@ -0,0 +1,103 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "chunk_pool.h"
+#include "minunit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "rmutil/alloc.h"
+
+MU_TEST(test_ChunkPool_class_size) {
+    mu_assert_int_eq(16, ChunkPool_ClassSize(0));
+    mu_assert_int_eq(16, ChunkPool_ClassSize(1));
+    mu_assert_int_eq(32, ChunkPool_ClassSize(17));
+    mu_assert_int_eq(64, ChunkPool_ClassSize(64));
+    mu_assert_int_eq(80, ChunkPool_ClassSize(65));
+    mu_assert_int_eq(112, ChunkPool_ClassSize(100));
+    mu_assert_int_eq(128, ChunkPool_ClassSize(128));
+    mu_assert_int_eq(160, ChunkPool_ClassSize(129));
+    mu_assert_int_eq(4096, ChunkPool_ClassSize(4096));
+    mu_assert_int_eq(5120, ChunkPool_ClassSize(4097));
+    mu_assert_int_eq(CHUNK_POOL_MAX_SIZE, ChunkPool_ClassSize(CHUNK_POOL_MAX_SIZE));
+    // larger buffers aren't pooled
+    mu_assert_int_eq(CHUNK_POOL_MAX_SIZE + 1, ChunkPool_ClassSize(CHUNK_POOL_MAX_SIZE + 1));
+}
+
+MU_TEST(test_ChunkPool_reuse) {
+    ChunkPool_Trim();
+    ChunkPoolStats before, after;
+    ChunkPool_GetStats(&before);
+
+    void *buf = ChunkPool_Alloc(100);
+    ChunkPool_Free(buf, 100);
+    ChunkPool_GetStats(&after);
+    mu_assert_int_eq(1, after.cachedBuffers);
+    mu_assert_int_eq(112, after.cachedBytes);
+
+    // any size of the same class gets the cached buffer
+    void *other = ChunkPool_Calloc(110);
+    mu_check(other == buf);
+    for (size_t i = 0; i < 110; i++) {
+        mu_assert_int_eq(0, ((char *)other)[i]);
+    }
+    ChunkPool_GetStats(&after);
+    mu_assert_int_eq(2, after.allocations - before.allocations);
+    mu_assert_int_eq(1, after.reused - before.reused);
+    mu_assert_int_eq(1, after.frees - before.frees);
+    mu_assert_int_eq(0, after.cachedBuffers);
+    ChunkPool_Free(other, 110);
+    ChunkPool_Trim();
+}
+
+MU_TEST(test_ChunkPool_realloc) {
+    char *buf = ChunkPool_Alloc(80);
+    memset(buf, 'a', 80);
+    // same class, the buffer stays in place
+    mu_check(ChunkPool_Realloc(buf, 80, 70) == buf);
+    char *grown = ChunkPool_Realloc(buf, 70, 200);
+    mu_check(grown != buf);
+    for (size_t i = 0; i < 70; i++) {
+        mu_assert_int_eq('a', grown[i]);
+    }
+    // past the largest class
+    char *large = ChunkPool_Realloc(grown, 200, CHUNK_POOL_MAX_SIZE * 2);
+    mu_assert_int_eq('a', large[69]);
+    large = ChunkPool_Realloc(large, CHUNK_POOL_MAX_SIZE * 2, CHUNK_POOL_MAX_SIZE * 3);
+    mu_assert_int_eq('a', large[69]);
+    ChunkPool_Free(large, CHUNK_POOL_MAX_SIZE * 3);
+    ChunkPool_Trim();
+}
+
+MU_TEST(test_ChunkPool_bounded_cache) {
+    ChunkPool_Trim();
+    size_t n = CHUNK_POOL_CLASS_CACHE / 4096 + 4;
+    void **bufs = malloc(n * sizeof(void *));
+    for (size_t i = 0; i < n; i++) {
+        bufs[i] = ChunkPool_Alloc(4096);
+    }
+    for (size_t i = 0; i < n; i++) {
+        ChunkPool_Free(bufs[i], 4096);
+    }
+    free(bufs);
+
+    ChunkPoolStats stats;
+    ChunkPool_GetStats(&stats);
+    mu_assert_int_eq(CHUNK_POOL_CLASS_CACHE / 4096, stats.cachedBuffers);
+    mu_assert_int_eq(CHUNK_POOL_CLASS_CACHE, stats.cachedBytes);
+
+    ChunkPool_Trim();
+    ChunkPool_GetStats(&stats);
+    mu_assert_int_eq(0, stats.cachedBuffers);
+    mu_assert_int_eq(0, stats.cachedBytes);
+}
+
+MU_TEST_SUITE(chunk_pool_test_suite) {
+    MU_RUN_TEST(test_ChunkPool_class_size);
+    MU_RUN_TEST(test_ChunkPool_reuse);
+    MU_RUN_TEST(test_ChunkPool_realloc);
+    MU_RUN_TEST(test_ChunkPool_bounded_cache);
+}
@@ -5,6 +5,7 @@
  */
 #include "compaction.h"
 #include "compressed_chunk.h"
+#include "enriched_chunk.h"
 #include "gorilla.h"
 #include "minunit.h"
 #include "parse_policies.h"
@@ -12,6 +13,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <time.h>
 #include "rmutil/alloc.h"
 
 MU_TEST(test_compressed_upsert) {
@@ -196,10 +198,684 @@ MU_TEST(test_Compressed_SplitChunk_force_realloc) {
     Compressed_FreeChunk(chunk);
 }
 
+// Fill a chunk with timestamps covering all the DoD buckets and values covering all the XOR cases
+static CompressedChunk *fillRandomChunk(size_t max_samples) {
+    static const int64_t deltas[] = { 0, 1, 50, 500, 3000, 30000, 3000000, 1LL << 40 };
+    CompressedChunk *chunk = Compressed_NewChunk(4096);
+    timestamp_t ts = 1;
+    int64_t delta = 1;
+    double value = 1.5;
+    for (size_t i = 0; i < max_samples; i++) {
+        if (rand() % 4 == 0) {
+            delta = 1 + deltas[rand() % (sizeof(deltas) / sizeof(deltas[0]))];
+        }
+        ts += delta;
+        switch (rand() % 4) {
+            case 0:
+                break;
+            case 1:
+                value += 1;
+                break;
+            default:
+                value = (double)rand() / RAND_MAX * 1000.0;
+        }
+        Sample sample = { .timestamp = ts, .value = value };
+        if (Compressed_AddSample(chunk, &sample) != CR_OK) {
+            break;
+        }
+    }
+    return chunk;
+}
+
+MU_TEST(test_Compressed_ChunkIteratorGetNextBlock) {
+    srand((unsigned int)time(NULL));
+    for (size_t round = 0; round < 20; round++) {
+        CompressedChunk *chunk = fillRandomChunk(2000);
+        const u_int64_t count = chunk->count;
+        timestamp_t *timestamps = malloc(count * sizeof(timestamp_t));
+        double *values = malloc(count * sizeof(double));
+
+        // decode using blocks of different sizes
+        ChunkIter_t *blockIter = Compressed_NewChunkIterator(chunk);
+        u_int64_t decoded = 0;
+        u_int64_t blockSize = 1 + round * 7;
+        while (decoded < count) {
+            u_int64_t n = Compressed_ChunkIteratorGetNextBlock(
+                blockIter, timestamps + decoded, values + decoded, blockSize);
+            mu_assert(n > 0, "block decoder made progress");
+            decoded += n;
+        }
+        mu_assert_int_eq(count, decoded);
+        mu_assert_int_eq(0,
+                         Compressed_ChunkIteratorGetNextBlock(blockIter, timestamps, values, 1));
+
+        ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+        Sample sample;
+        for (u_int64_t i = 0; i < count; i++) {
+            mu_assert(Compressed_ChunkIteratorGetNext(iter, &sample) == CR_OK, "iterator");
+            mu_assert(sample.timestamp == timestamps[i], "timestamp matches iterator");
+            mu_assert(sample.value == values[i], "value matches iterator");
+        }
+        mu_assert_int_eq(getIterIdx(iter), getIterIdx(blockIter));
+        mu_assert_int_eq(chunk->idx, getIterIdx(blockIter));
+
+        // ProcessChunk over random ranges, both directions
+        EnrichedChunk *enrichedChunk = NewEnrichedChunk();
+        ReallocSamplesArray(&enrichedChunk->samples, count);
+        for (size_t q = 0; q < 50; q++) {
+            timestamp_t start = timestamps[rand() % count] - (rand() % 2);
+            timestamp_t end = start + (timestamp_t)(rand() % 3) * (timestamps[count - 1] / 2);
+            u_int64_t first = 0;
+            while (first < count && timestamps[first] < start) {
+                first++;
+            }
+            u_int64_t last = first;
+            while (last < count && timestamps[last] <= end) {
+                last++;
+            }
+
+            Compressed_ProcessChunk(chunk, start, end, enrichedChunk, false);
+            mu_assert_int_eq(last - first, enrichedChunk->samples.num_samples);
+            for (u_int64_t i = 0; i < enrichedChunk->samples.num_samples; i++) {
+                mu_assert(enrichedChunk->samples.timestamps[i] == timestamps[first + i],
+                          "forward timestamp");
+                mu_assert(enrichedChunk->samples.values[i] == values[first + i], "forward value");
+            }
+
+            Compressed_ProcessChunk(chunk, start, end, enrichedChunk, true);
+            mu_assert_int_eq(last - first, enrichedChunk->samples.num_samples);
+            for (u_int64_t i = 0; i < enrichedChunk->samples.num_samples; i++) {
+                mu_assert(enrichedChunk->samples.timestamps[i] == timestamps[last - 1 - i],
+                          "reverse timestamp");
+                mu_assert(enrichedChunk->samples.values[i] == values[last - 1 - i],
+                          "reverse value");
+            }
+        }
+
+        FreeEnrichedChunk(enrichedChunk);
+        Compressed_FreeChunkIterator(iter);
+        Compressed_FreeChunkIterator(blockIter);
+        free(timestamps);
+        free(values);
+        Compressed_FreeChunk(chunk);
+    }
+}
+
+// Compare the chunk content against the expected samples
+static bool chunkEquals(CompressedChunk *chunk,
+                        const timestamp_t *timestamps,
+                        const double *values,
+                        u_int64_t count) {
+    if (chunk->count != count) {
+        return false;
+    }
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+    Sample sample;
+    bool equal = true;
+    for (u_int64_t i = 0; i < count && equal; i++) {
+        Compressed_ChunkIteratorGetNext(iter, &sample);
+        equal = sample.timestamp == timestamps[i] && sample.value == values[i];
+    }
+    Compressed_FreeChunkIterator(iter);
+    return equal;
+}
+
+static bool checkpointsEqual(CompressedChunk *chunk) {
+    u_int32_t count = chunk->checkpointsCount;
+    CompressedCheckpoint *checkpoints = malloc(count * sizeof(CompressedCheckpoint) + 1);
+    memcpy(checkpoints, chunk->checkpoints, count * sizeof(CompressedCheckpoint));
+    Compressed_RebuildMetadata(chunk);
+    bool equal = count == chunk->checkpointsCount;
+    for (u_int32_t i = 0; i < count && equal; i++) {
+        CompressedCheckpoint *a = &checkpoints[i], *b = &chunk->checkpoints[i];
+        equal = a->idx == b->idx && a->count == b->count && a->prevTimestamp == b->prevTimestamp &&
+                a->prevTimestampDelta == b->prevTimestampDelta &&
+                a->prevValue.u == b->prevValue.u && a->prevLeading == b->prevLeading &&
+                a->prevTrailing == b->prevTrailing && a->prevDecimal == b->prevDecimal &&
+                a->prevDecimalDelta == b->prevDecimalDelta && a->runIdx == b->runIdx &&
+                a->runLength == b->runLength;
+    }
+    free(checkpoints);
+    return equal;
+}
+
+MU_TEST(test_Compressed_checkpoints) {
+    srand((unsigned int)time(NULL));
+    const u_int64_t total = 5000;
+    timestamp_t *timestamps = malloc((total + 1) * sizeof(timestamp_t));
+    double *values = malloc((total + 1) * sizeof(double));
+    CompressedChunk *chunk = Compressed_NewChunk(65536);
+    for (u_int64_t i = 0; i < total; i++) {
+        timestamps[i] = 1000 + i * 10 + rand() % 5;
+        values[i] = (rand() % 3 == 0) ? (double)rand() : (i > 0 ? values[i - 1] : 1.0);
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+    }
+    mu_assert_int_eq((total - 1) / COMPRESSED_CHECKPOINT_INTERVAL, chunk->checkpointsCount);
+    mu_assert(checkpointsEqual(chunk), "checkpoints after append match rebuild");
+
+    // seeking to a checkpoint resumes decoding at the right sample
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+    Sample sample;
+    for (u_int32_t i = 0; i < chunk->checkpointsCount; i++) {
+        timestamp_t ts = chunk->checkpoints[i].prevTimestamp + 1;
+        mu_assert_int_eq(i, Compressed_FindCheckpoint(chunk, ts));
+        Compressed_ChunkIteratorSeek(iter, i);
+        Compressed_ChunkIteratorGetNext(iter, &sample);
+        mu_assert(sample.timestamp == timestamps[chunk->checkpoints[i].count], "seek timestamp");
+        mu_assert(sample.value == values[chunk->checkpoints[i].count], "seek value");
+    }
+    mu_assert_int_eq(-1, Compressed_FindCheckpoint(chunk, timestamps[0]));
+    Compressed_FreeChunkIterator(iter);
+
+    // upsert: override existing samples and insert new ones
+    u_int64_t count = total;
+    int size;
+    for (size_t round = 0; round < 200; round++) {
+        u_int64_t pos = rand() % count;
+        Sample s = { .timestamp = timestamps[pos], .value = (double)rand() };
+        timestamp_t next = pos + 1 < count ? timestamps[pos + 1] : UINT64_MAX;
+        if (round % 2 == 0 && timestamps[pos] + 1 < next) {
+            s.timestamp++;
+            pos++;
+            memmove(timestamps + pos + 1, timestamps + pos, (count - pos) * sizeof(timestamp_t));
+            memmove(values + pos + 1, values + pos, (count - pos) * sizeof(double));
+            count++;
+            timestamps = realloc(timestamps, (count + 1) * sizeof(timestamp_t));
+            values = realloc(values, (count + 1) * sizeof(double));
+        }
+        timestamps[pos] = s.timestamp;
+        values[pos] = s.value;
+        UpsertCtx uCtx = { .inChunk = chunk, .sample = s };
+        mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert");
+    }
+    mu_assert(chunkEquals(chunk, timestamps, values, count), "chunk content after upserts");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after upsert match rebuild");
+
+    // delete ranges
+    for (size_t round = 0; round < 20 && count > 100; round++) {
+        u_int64_t first = rand() % (count - 50);
+        u_int64_t last = first + rand() % 50;
+        size_t deleted = Compressed_DelRange(chunk, timestamps[first], timestamps[last]);
+        mu_assert_int_eq(last - first + 1, deleted);
+        u_int64_t tail = count - last - 1;
+        memmove(timestamps + first, timestamps + last + 1, tail * sizeof(timestamp_t));
+        memmove(values + first, values + last + 1, tail * sizeof(double));
+        count -= deleted;
+    }
+    mu_assert_int_eq(0, Compressed_DelRange(chunk, 0, timestamps[0] - 1));
+    mu_assert(chunkEquals(chunk, timestamps, values, count), "chunk content after delete");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after delete match rebuild");
+
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_upsert_keeps_prefix) {
+    srand((unsigned int)time(NULL));
+    CompressedChunk *chunk = fillRandomChunk(300);
+    Sample tail = { .timestamp = chunk->prevTimestamp + 10, .value = 42 };
+    mu_assert(Compressed_AddSample(chunk, &tail) == CR_OK, "add sample");
+    const u_int64_t count = chunk->count;
+    CompressedChunk *clone = Compressed_CloneChunk(chunk);
+
+    // bit offset of the last sample
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+    Sample sample, last;
+    for (u_int64_t i = 0; i < count - 1; i++) {
+        Compressed_ChunkIteratorGetNext(iter, &sample);
+    }
+    u_int64_t prefixBits = getIterIdx(iter);
+    Compressed_ChunkIteratorGetNext(iter, &last);
+    Compressed_FreeChunkIterator(iter);
+
+    // a blocked duplicate leaves the chunk untouched
+    int size = 0;
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = last };
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_BLOCK) == CR_ERR, "blocked duplicate");
+    mu_assert_int_eq(clone->idx, chunk->idx);
+    mu_assert(memcmp(clone->data, chunk->data, chunk->size) == 0, "data untouched");
+
+    // insert before the last sample, the bitstream before it is kept as is
+    uCtx.sample.timestamp = last.timestamp - 1;
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert");
+    mu_assert_int_eq(1, size);
+    mu_assert_int_eq(count + 1, chunk->count);
+    mu_assert(memcmp(clone->data, chunk->data, prefixBits / 64 * sizeof(u_int64_t)) == 0,
+              "prefix untouched");
+    mu_assert_int_eq(last.timestamp, Compressed_GetLastTimestamp(chunk));
+
+    // insert before the first sample
+    uCtx.sample.timestamp = chunk->baseTimestamp - 1;
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert first");
+    mu_assert_int_eq(count + 2, chunk->count);
+    mu_assert_int_eq(uCtx.sample.timestamp, Compressed_GetFirstTimestamp(chunk));
+    mu_assert_int_eq(last.timestamp, Compressed_GetLastTimestamp(chunk));
+
+    Compressed_FreeChunk(clone);
+    Compressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Compressed_SplitChunk_keeps_first_half) {
+    srand((unsigned int)time(NULL));
+    const u_int64_t total = 3001;
+    timestamp_t *timestamps = malloc(total * sizeof(timestamp_t));
+    double *values = malloc(total * sizeof(double));
+    CompressedChunk *chunk = Compressed_NewChunk(65536);
+    for (u_int64_t i = 0; i < total; i++) {
+        timestamps[i] = 1000 + i * 10 + rand() % 5;
+        values[i] = (rand() % 3 == 0) ? (double)rand() : (i > 0 ? values[i - 1] : 1.0);
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+    }
+    CompressedChunk *clone = Compressed_CloneChunk(chunk);
+
+    CompressedChunk *chunk2 = Compressed_SplitChunk(chunk);
+    const u_int64_t firstHalf = total - total / 2;
+    mu_assert_int_eq(firstHalf, chunk->count);
+    mu_assert_int_eq(total / 2, chunk2->count);
+    mu_assert(chunkEquals(chunk, timestamps, values, firstHalf), "first half");
+    mu_assert(chunkEquals(chunk2, timestamps + firstHalf, values + firstHalf, total / 2),
+              "second half");
+    mu_assert(memcmp(clone->data, chunk->data, chunk->idx / 64 * sizeof(u_int64_t)) == 0,
+              "first half bitstream untouched");
+    mu_assert(chunk->size < clone->size, "first half trimmed");
+    mu_assert(checkpointsEqual(chunk), "first half checkpoints");
+    mu_assert(checkpointsEqual(chunk2), "second half checkpoints");
+
+    // both halves can still be written to
+    Sample sample = { .timestamp = timestamps[firstHalf - 1] + 1, .value = 1 };
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = sample };
+    int size = 0;
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert first half");
+    mu_assert_int_eq(firstHalf + 1, chunk->count);
+    uCtx.inChunk = chunk2;
+    uCtx.sample.timestamp = timestamps[total - 1] - 1;
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert second half");
+    mu_assert_int_eq(total / 2 + 1, chunk2->count);
+
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(clone);
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(chunk2);
+}
+
+MU_TEST(test_Compressed_MergeChunk) {
+    const u_int64_t total = 1000;
+    timestamp_t *timestamps = malloc(total * sizeof(timestamp_t));
+    double *values = malloc(total * sizeof(double));
+    CompressedChunk *chunk = Compressed_NewChunk(65536);
+    for (u_int64_t i = 0; i < total; i++) {
+        timestamps[i] = 1000 + i * 10 + i % 3;
+        values[i] = (double)(i % 17) / 4;
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+    }
+    CompressedChunk *chunk2 = Compressed_SplitChunk(chunk);
+    size_t maxSize = chunk->size + chunk2->size;
+
+    mu_check(Compressed_MergeChunk(chunk, chunk2, chunk->size / 2) == NULL);
+    CompressedChunk *merged = Compressed_MergeChunk(chunk, chunk2, maxSize);
+    mu_check(merged != NULL);
+    mu_assert_int_eq(total, merged->count);
+    mu_check(merged->size <= maxSize);
+    mu_assert(chunkEquals(merged, timestamps, values, total), "merged samples");
+    mu_assert(checkpointsEqual(merged), "merged checkpoints");
+    mu_assert_int_eq(total, Compressed_GetStats(merged)->count);
+    mu_assert_int_eq(timestamps[total - 1], Compressed_GetStats(merged)->last.timestamp);
+
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(merged);
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(chunk2);
+}
+
+static bool statsEqual(const ChunkStats *a, const ChunkStats *b) {
+    return a->count == b->count && a->min == b->min && a->max == b->max && a->sum == b->sum &&
+           a->first.timestamp == b->first.timestamp && a->first.value == b->first.value &&
+           a->last.timestamp == b->last.timestamp && a->last.value == b->last.value;
+}
+
+MU_TEST(test_Compressed_stats) {
+    srand((unsigned int)time(NULL));
+    CompressedChunk *chunk = fillRandomChunk(1000);
+    ChunkStats appended = chunk->stats;
+    mu_check(Compressed_GetStats(chunk) != NULL);
+    mu_assert_int_eq(chunk->count, appended.count);
+    mu_assert_int_eq(chunk->baseTimestamp, appended.first.timestamp);
+    mu_assert_int_eq(chunk->prevTimestamp, appended.last.timestamp);
+    mu_assert_double_eq(chunk->prevValue.d, appended.last.value);
+    Compressed_RebuildMetadata(chunk);
+    mu_check(statsEqual(&appended, Compressed_GetStats(chunk)));
+
+    // out of order insertions, deletions and splits keep the stats valid
+    timestamp_t middle = (chunk->baseTimestamp + chunk->prevTimestamp) / 2;
+    Sample sample = { .timestamp = middle, .value = 1e6 };
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = sample };
+    int size;
+    mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert");
+    appended = *Compressed_GetStats(chunk);
+    mu_assert_double_eq(1e6, appended.max);
+    Compressed_RebuildMetadata(chunk);
+    mu_check(statsEqual(&appended, Compressed_GetStats(chunk)));
+
+    mu_check(Compressed_DelRange(chunk, middle, middle + 100) > 0);
+    appended = *Compressed_GetStats(chunk);
+    mu_check(appended.max < 1e6);
+    Compressed_RebuildMetadata(chunk);
+    mu_check(statsEqual(&appended, Compressed_GetStats(chunk)));
+
+    CompressedChunk *second = Compressed_SplitChunk(chunk);
+    appended = *Compressed_GetStats(chunk);
+    ChunkStats secondAppended = *Compressed_GetStats(second);
+    mu_assert_int_eq(chunk->count, appended.count);
+    mu_assert_int_eq(chunk->prevTimestamp, appended.last.timestamp);
+    Compressed_RebuildMetadata(chunk);
+    Compressed_RebuildMetadata(second);
+    mu_check(statsEqual(&appended, Compressed_GetStats(chunk)));
+    mu_check(statsEqual(&secondAppended, Compressed_GetStats(second)));
+    Compressed_FreeChunk(second);
+
+    // emptied chunks have fresh stats
+    Compressed_DelRange(chunk, 0, UINT64_MAX);
+    mu_check(Compressed_GetStats(chunk) != NULL);
+    mu_assert_int_eq(0, Compressed_GetStats(chunk)->count);
+    Compressed_AddSample(chunk, &sample);
+    mu_assert_int_eq(1, Compressed_GetStats(chunk)->count);
+    mu_assert_double_eq(1e6, Compressed_GetStats(chunk)->sum);
+    Compressed_FreeChunk(chunk);
+}
+
+// Decode the whole chunk a block at a time
+static bool chunkBlocksEqual(CompressedChunk *chunk,
+                             const timestamp_t *timestamps,
+                             const double *values,
+                             u_int64_t blockSize) {
+    timestamp_t *blockTimestamps = malloc(blockSize * sizeof(timestamp_t));
+    double *blockValues = malloc(blockSize * sizeof(double));
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+    u_int64_t decoded = 0, n;
+    bool equal = true;
+    while (equal && (n = Compressed_ChunkIteratorGetNextBlock(
+                         iter, blockTimestamps, blockValues, blockSize)) > 0) {
+        for (u_int64_t i = 0; i < n && equal; i++, decoded++) {
+            equal = blockTimestamps[i] == timestamps[decoded] &&
+                    memcmp(&blockValues[i], &values[decoded], sizeof(double)) == 0;
+        }
+    }
+    Compressed_FreeChunkIterator(iter);
+    free(blockTimestamps);
+    free(blockValues);
+    return equal && decoded == chunk->count;
+}
+
+MU_TEST(test_Decimal_chunk) {
+    srand((unsigned int)time(NULL));
+    const u_int64_t total = 3000;
+    timestamp_t *timestamps = malloc((total + 1) * sizeof(timestamp_t));
+    double *values = malloc((total + 1) * sizeof(double));
+    CompressedChunk *chunk = Decimal_NewChunk(65536);
+    mu_assert_int_eq(VALUE_CODEC_DECIMAL, chunk->codec);
+
+    // integers, then values with 2 decimals, then a value which isn't a decimal
+    int64_t counter = -500;
+    for (u_int64_t i = 0; i < total; i++) {
+        counter += rand() % 100;
+        timestamps[i] = 1000 + i * 10 + rand() % 5;
+        values[i] = i < 1000 ? (double)counter : (double)counter / 100;
+        if (i == 2000) {
+            values[i] = 1.0 / 3;
+        }
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+        if (i == 999) {
+            mu_assert_int_eq(0, chunk->scale);
+            mu_assert_int_eq(1000, chunk->decimalCount);
+        }
+    }
+    // the chunk was re-encoded with 2 decimals and switched to XOR at the first non decimal
+    mu_assert_int_eq(2, chunk->scale);
+    mu_assert_int_eq(2000, chunk->decimalCount);
+    mu_assert(chunkEquals(chunk, timestamps, values, total), "chunk content");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 1), "blocks of 1");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 7), "blocks of 7");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, total), "single block");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after append match rebuild");
+
+    // NaN, negative zero and values with too many decimals aren't decimals
+    CompressedChunk *other = Decimal_NewChunk(4096);
+    double special[] = { 1.5, -0.0, NAN, 2.5, 1e-12 };
+    for (u_int64_t i = 0; i < 5; i++) {
+        Sample sample = { .timestamp = i, .value = special[i] };
+        mu_assert(Compressed_AddSample(other, &sample) == CR_OK, "add sample");
+    }
+    mu_assert_int_eq(1, other->decimalCount);
+    ChunkIter_t *iter = Compressed_NewChunkIterator(other);
+    Sample sample;
+    for (u_int64_t i = 0; i < 5; i++) {
+        Compressed_ChunkIteratorGetNext(iter, &sample);
+        mu_check(memcmp(&sample.value, &special[i], sizeof(double)) == 0);
+    }
+    Compressed_FreeChunkIterator(iter);
+    Compressed_FreeChunk(other);
+
+    // upserts and deletions in the decimal part and in the XOR part
+    u_int64_t count = total;
+    int size;
+    for (size_t round = 0; round < 100; round++) {
+        u_int64_t pos = rand() % count;
+        Sample s = { .timestamp = timestamps[pos], .value = (double)(rand() % 10000) / 100 };
+        timestamps[pos] = s.timestamp;
+        values[pos] = s.value;
+        UpsertCtx uCtx = { .inChunk = chunk, .sample = s };
+        mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert");
+    }
+    for (size_t round = 0; round < 10; round++) {
+        u_int64_t first = rand() % (count - 50);
+        u_int64_t last = first + rand() % 50;
+        size_t deleted = Compressed_DelRange(chunk, timestamps[first], timestamps[last]);
+        mu_assert_int_eq(last - first + 1, deleted);
+        u_int64_t tail = count - last - 1;
+        memmove(timestamps + first, timestamps + last + 1, tail * sizeof(timestamp_t));
+        memmove(values + first, values + last + 1, tail * sizeof(double));
+        count -= deleted;
+    }
+    mu_assert(chunkEquals(chunk, timestamps, values, count), "chunk content after updates");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 64), "blocks after updates");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after updates match rebuild");
+
+    // both halves of a split chunk keep the codec
+    u_int64_t split = count / 2;
+    CompressedChunk *newChunk = Compressed_SplitChunk(chunk);
+    mu_assert_int_eq(VALUE_CODEC_DECIMAL, newChunk->codec);
+    mu_assert(chunkEquals(chunk, timestamps, values, count - split), "first half");
+    mu_assert(chunkEquals(newChunk, timestamps + count - split, values + count - split, split),
+              "second half");
+    mu_assert(checkpointsEqual(newChunk), "checkpoints of the second half");
+
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(newChunk);
+}
+
+MU_TEST(test_Compressed_timestamp_runs) {
+    srand((unsigned int)time(NULL));
+    // a periodic series with a constant value takes about 1 bit per sample
+    CompressedChunk *periodic = Compressed_NewChunk(4096);
+    for (u_int64_t i = 0; i < 3 * TIMESTAMP_RUN_MAX; i++) {
+        Sample sample = { .timestamp = 1000 + i * 10000, .value = 1 };
+        mu_assert(Compressed_AddSample(periodic, &sample) == CR_OK, "add sample");
+    }
+    mu_assert(periodic->idx < periodic->count + 100, "timestamps of a periodic series are free");
+    Compressed_FreeChunk(periodic);
+
+    // regular intervals of different lengths with jitter in between
+    const u_int64_t total = 6000;
+    timestamp_t *timestamps = malloc((total + 1) * sizeof(timestamp_t));
+    double *values = malloc((total + 1) * sizeof(double));
+    CompressedChunk *chunk = Compressed_NewChunk(65536);
+    static const u_int64_t lengths[] = { 1, 3, 8, 9, 10, 100, TIMESTAMP_RUN_MAX + 10 };
+    timestamp_t ts = 1000;
+    for (u_int64_t i = 0, regular = 0; i < total; i++) {
+        if (regular == 0) {
+            regular = lengths[rand() % (sizeof(lengths) / sizeof(lengths[0]))];
+            ts += rand() % 7;
+        }
+        regular--;
+        timestamps[i] = ts += 10;
+        values[i] = (rand() % 4 == 0) ? (double)rand() : (i > 0 ? values[i - 1] : 1.0);
+        Sample sample = { .timestamp = timestamps[i], .value = values[i] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+    }
+    mu_assert(chunkEquals(chunk, timestamps, values, total), "chunk content");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 1), "blocks of 1");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 13), "blocks of 13");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, total), "single block");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after append match rebuild");
+
+    // upserts and deletions truncate runs, the encoder resumes them
+    u_int64_t count = total;
+    int size;
+    for (size_t round = 0; round < 100; round++) {
+        u_int64_t pos = rand() % count;
+        Sample s = { .timestamp = timestamps[pos], .value = (double)rand() };
+        values[pos] = s.value;
+        UpsertCtx uCtx = { .inChunk = chunk, .sample = s };
+        mu_assert(Compressed_UpsertSample(&uCtx, &size, DP_LAST) == CR_OK, "upsert");
+    }
+    for (size_t round = 0; round < 10; round++) {
+        u_int64_t first = rand() % (count - 50);
+        u_int64_t last = first + rand() % 50;
+        size_t deleted = Compressed_DelRange(chunk, timestamps[first], timestamps[last]);
+        mu_assert_int_eq(last - first + 1, deleted);
+        u_int64_t tail = count - last - 1;
+        memmove(timestamps + first, timestamps + last + 1, tail * sizeof(timestamp_t));
+        memmove(values + first, values + last + 1, tail * sizeof(double));
+        count -= deleted;
+    }
+    mu_assert(chunkEquals(chunk, timestamps, values, count), "chunk content after updates");
+    mu_assert(chunkBlocksEqual(chunk, timestamps, values, 64), "blocks after updates");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after updates match rebuild");
+
+    // a chunk truncated within a run keeps extending it
+    Compressed_DelRange(chunk, timestamps[count - 5], UINT64_MAX);
+    count -= 5;
+    for (u_int64_t i = 0; i < 20; i++, count++) {
+        timestamps[count] = timestamps[count - 1] + 10;
+        values[count] = values[count - 1];
+        Sample sample = { .timestamp = timestamps[count], .value = values[count] };
+        mu_assert(Compressed_AddSample(chunk, &sample) == CR_OK, "add sample");
+    }
+    mu_check(chunk->runIdx != 0);
+    mu_assert(chunkEquals(chunk, timestamps, values, count), "chunk content after truncation");
+    mu_assert(checkpointsEqual(chunk), "checkpoints after truncation match rebuild");
+
+    u_int64_t split = count / 2;
+    CompressedChunk *newChunk = Compressed_SplitChunk(chunk);
+    mu_assert(chunkEquals(chunk, timestamps, values, count - split), "first half");
+    mu_assert(chunkEquals(newChunk, timestamps + count - split, values + count - split, split),
+              "second half");
+
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(chunk);
+    Compressed_FreeChunk(newChunk);
+}
+
+MU_TEST(test_Decimal_chunk_size) {
+    srand((unsigned int)time(NULL));
+    CompressedChunk *gorilla[2] = { Compressed_NewChunk(65536), Compressed_NewChunk(65536) };
+    CompressedChunk *decimal[2] = { Decimal_NewChunk(65536), Decimal_NewChunk(65536) };
+    int64_t counter = 0;
+    for (u_int64_t i = 0; i < 2000; i++) {
+        counter += 100 + rand() % 10;
+        // a counter with a steady rate and a gauge with 2 decimals
+        Sample samples[2] = { { .timestamp = i * 1000, .value = counter },
+                              { .timestamp = i * 1000, .value = (2000 + rand() % 100) / 100.0 } };
+        for (int j = 0; j < 2; j++) {
+            mu_assert(Compressed_AddSample(gorilla[j], &samples[j]) == CR_OK, "add sample");
+            mu_assert(Compressed_AddSample(decimal[j], &samples[j]) == CR_OK, "add sample");
+        }
+    }
+    for (int j = 0; j < 2; j++) {
+        mu_assert_int_eq(gorilla[j]->count, decimal[j]->decimalCount);
+        mu_assert(decimal[j]->idx * 2 < gorilla[j]->idx, "decimal chunk is at least 2x smaller");
+        Compressed_FreeChunk(gorilla[j]);
+        Compressed_FreeChunk(decimal[j]);
+    }
+}
+
+#ifdef UNIT_BENCHMARKS
+static double elapsedSeconds(struct timespec *begin) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - begin->tv_sec) + (now.tv_nsec - begin->tv_nsec) / 1e9;
+}
+
+// Micro benchmark, prints the decoding throughput of the sample iterator vs the block decoder.
+// Built with BENCH=1.
+MU_TEST(test_Compressed_decode_benchmark) {
+    const size_t rounds = 2000;
+    CompressedChunk *chunk = fillRandomChunk(SIZE_MAX);
+    const u_int64_t count = chunk->count;
+    timestamp_t *timestamps = malloc(count * sizeof(timestamp_t));
+    double *values = malloc(count * sizeof(double));
+    ChunkIter_t *iter = Compressed_NewChunkIterator(chunk);
+    struct timespec begin;
+    Sample sample;
+    double sum = 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t r = 0; r < rounds; r++) {
+        Compressed_ResetChunkIterator(iter, chunk);
+        while (Compressed_ChunkIteratorGetNext(iter, &sample) == CR_OK) {
+            sum += sample.value;
+        }
+    }
+    double iterSecs = elapsedSeconds(&begin);
+
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t r = 0; r < rounds; r++) {
+        Compressed_ResetChunkIterator(iter, chunk);
+        Compressed_ChunkIteratorGetNextBlock(iter, timestamps, values, count);
+        sum += values[count - 1];
+    }
+    double blockSecs = elapsedSeconds(&begin);
+
+    printf("\ngorilla decode (%lu samples/chunk): iterator %.2f Msamples/sec, block %.2f "
+           "Msamples/sec (checksum %g)\n",
+           count,
+           count * rounds / iterSecs / 1e6,
+           count * rounds / blockSecs / 1e6,
+           sum);
+
+    Compressed_FreeChunkIterator(iter);
+    free(timestamps);
+    free(values);
+    Compressed_FreeChunk(chunk);
+}
+#endif
+
 MU_TEST_SUITE(compressed_chunk_test_suite) {
     MU_RUN_TEST(test_compressed_upsert);
     MU_RUN_TEST(test_compressed_fail_appendInteger);
     MU_RUN_TEST(test_Compressed_SplitChunk_empty);
     MU_RUN_TEST(test_Compressed_SplitChunk_odd);
     MU_RUN_TEST(test_Compressed_SplitChunk_force_realloc);
+    MU_RUN_TEST(test_Compressed_ChunkIteratorGetNextBlock);
+    MU_RUN_TEST(test_Compressed_checkpoints);
+    MU_RUN_TEST(test_Compressed_upsert_keeps_prefix);
+    MU_RUN_TEST(test_Compressed_SplitChunk_keeps_first_half);
+    MU_RUN_TEST(test_Compressed_MergeChunk);
+    MU_RUN_TEST(test_Compressed_stats);
+    MU_RUN_TEST(test_Decimal_chunk);
+    MU_RUN_TEST(test_Decimal_chunk_size);
+    MU_RUN_TEST(test_Compressed_timestamp_runs);
+#ifdef UNIT_BENCHMARKS
+    MU_RUN_TEST(test_Compressed_decode_benchmark);
+#endif
 }
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "enriched_chunk.h"
+#include "generic_chunk.h"
+#include "hybrid_chunk.h"
+#include "minunit.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+static void expectHybridSamples(const ChunkFuncs *funcs,
+                                Chunk_t *chunk,
+                                const Sample *samples,
+                                size_t count) {
+    EnrichedChunk *enrichedChunk = NewEnrichedChunk();
+    ReallocSamplesArray(&enrichedChunk->samples, count);
+    funcs->ProcessChunk(chunk, 0, UINT64_MAX, enrichedChunk, false);
+    mu_assert_int_eq(count, enrichedChunk->samples.num_samples);
+    for (size_t i = 0; i < count; i++) {
+        mu_assert(enrichedChunk->samples.timestamps[i] == samples[i].timestamp, "timestamp");
+        mu_assert(enrichedChunk->samples.values[i] == samples[i].value, "value");
+    }
+    FreeEnrichedChunk(enrichedChunk);
+}
+
+MU_TEST(test_Hybrid_seal) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_HYBRID);
+    const size_t count = 64;
+    Sample samples[65];
+    Chunk_t *chunk = funcs->NewChunk(count * SAMPLE_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        samples[i] = (Sample){ .timestamp = 1000 + i * 10, .value = i % 7 };
+        mu_assert_int_eq(CR_OK, funcs->AddSample(chunk, &samples[i]));
+    }
+    mu_check(!Hybrid_IsSealed(chunk));
+    mu_assert_int_eq(0, Hybrid_SealPending(16));
+    mu_check(!Hybrid_IsSealed(chunk));
+
+    // out of order samples are upserted in place before the chunk is full
+    int size = 0;
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 1005, .value = 42 } };
+    mu_assert_int_eq(CR_OK, funcs->UpsertSample(&uCtx, &size, DP_LAST));
+    mu_assert_int_eq(1, size);
+    uCtx.sample = (Sample){ .timestamp = 1005, .value = 43 };
+    mu_assert_int_eq(CR_OK, funcs->UpsertSample(&uCtx, &size, DP_LAST));
+    mu_assert_int_eq(0, size);
+    mu_assert_int_eq(count + 1, funcs->GetNumOfSample(chunk));
+    mu_assert_int_eq(1, funcs->DelRange(chunk, 1005, 1005));
+    mu_assert_int_eq(count, funcs->GetNumOfSample(chunk));
+
+    // the upsert grew the chunk by a sample, once full it is queued and compressed by the sealing
+    samples[count] = (Sample){ .timestamp = 5000, .value = 1 };
+    mu_assert_int_eq(CR_OK, funcs->AddSample(chunk, &samples[count]));
+    Sample extra = { .timestamp = 5010, .value = 1 };
+    mu_assert_int_eq(CR_END, funcs->AddSample(chunk, &extra));
+    mu_check(!Hybrid_IsSealed(chunk));
+    size_t rawSize = funcs->GetChunkSize(chunk, false);
+    mu_assert_int_eq(0, Hybrid_SealPending(16));
+    mu_check(Hybrid_IsSealed(chunk));
+    mu_check(funcs->GetChunkSize(chunk, false) < rawSize / 3);
+    mu_assert_int_eq(count + 1, funcs->GetNumOfSample(chunk));
+    mu_assert_int_eq(samples[0].timestamp, funcs->GetFirstTimestamp(chunk));
+    mu_assert_int_eq(samples[count].timestamp, funcs->GetLastTimestamp(chunk));
+    mu_assert_double_eq(samples[count].value, funcs->GetLastValue(chunk));
+    expectHybridSamples(funcs, chunk, samples, count + 1);
+
+    // sealed chunks keep accepting upserts
+    uCtx.sample = (Sample){ .timestamp = 1000, .value = -1 };
+    mu_assert_int_eq(CR_OK, funcs->UpsertSample(&uCtx, &size, DP_LAST));
+    samples[0].value = -1;
+    expectHybridSamples(funcs, chunk, samples, count + 1);
+
+    funcs->FreeChunk(chunk);
+}
+
+MU_TEST(test_Hybrid_pending_queue) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_HYBRID);
+    const size_t count = 32;
+    Sample samples[32];
+    Chunk_t *chunks[3];
+    for (size_t c = 0; c < 3; c++) {
+        chunks[c] = funcs->NewChunk(count * SAMPLE_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            samples[i] = (Sample){ .timestamp = c * 1000 + i, .value = i };
+            funcs->AddSample(chunks[c], &samples[i]);
+        }
+        Sample extra = { .timestamp = c * 1000 + count, .value = 0 };
+        mu_assert_int_eq(CR_END, funcs->AddSample(chunks[c], &extra));
+    }
+
+    // freeing or cloning a pending chunk takes it out of the queue
+    funcs->FreeChunk(chunks[1]);
+    Chunk_t *clone = funcs->CloneChunk(chunks[2]);
+    mu_check(Hybrid_IsSealed(clone));
+    mu_check(!Hybrid_IsSealed(chunks[2]));
+    expectHybridSamples(funcs, clone, samples, count);
+    funcs->FreeChunk(clone);
+
+    mu_assert_int_eq(1, Hybrid_SealPending(1));
+    mu_check(Hybrid_IsSealed(chunks[0]));
+    mu_assert_int_eq(0, Hybrid_SealPending(1));
+    mu_check(Hybrid_IsSealed(chunks[2]));
+    expectHybridSamples(funcs, chunks[2], samples, count);
+
+    // splitting the head queues its first half
+    Chunk_t *head = funcs->NewChunk(count * SAMPLE_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        funcs->AddSample(head, &samples[i]);
+    }
+    Chunk_t *newHead = funcs->SplitChunk(head);
+    mu_check(!Hybrid_IsSealed(newHead));
+    mu_assert_int_eq(count / 2, funcs->GetNumOfSample(newHead));
+    mu_assert_int_eq(0, Hybrid_SealPending(1));
+    mu_check(Hybrid_IsSealed(head));
+    mu_check(!Hybrid_IsSealed(newHead));
+    expectHybridSamples(funcs, head, samples, count / 2);
+    expectHybridSamples(funcs, newHead, samples + count / 2, count / 2);
+
+    funcs->FreeChunk(head);
+    funcs->FreeChunk(newHead);
+    funcs->FreeChunk(chunks[0]);
+    funcs->FreeChunk(chunks[2]);
+}
+
+MU_TEST(test_Hybrid_merge) {
+    const ChunkFuncs *funcs = GetChunkClass(CHUNK_HYBRID);
+    const size_t count = 32;
+    Sample samples[64];
+    Chunk_t *chunks[2];
+    for (size_t c = 0; c < 2; c++) {
+        chunks[c] = funcs->NewChunk(count * SAMPLE_SIZE);
+        for (size_t i = 0; i < count; i++) {
+            samples[c * count + i] = (Sample){ .timestamp = c * 1000 + i, .value = i % 5 };
+            funcs->AddSample(chunks[c], &samples[c * count + i]);
+        }
+        timestamp_t start = c * 1000 + count / 2;
+        mu_assert_int_eq(count / 2, funcs->DelRange(chunks[c], start, start + count));
+    }
+    // both are heads, the merged chunk is queued for sealing
+    Sample kept[32];
+    memcpy(kept, samples, count / 2 * sizeof(Sample));
+    memcpy(kept + count / 2, samples + count, count / 2 * sizeof(Sample));
+    mu_check(funcs->MergeChunk(chunks[0], chunks[1], count / 2 * SAMPLE_SIZE) == NULL);
+    Chunk_t *merged = funcs->MergeChunk(chunks[0], chunks[1], count * SAMPLE_SIZE);
+    mu_check(merged != NULL);
+    expectHybridSamples(funcs, merged, kept, count);
+    mu_assert_int_eq(0, Hybrid_SealPending(1));
+    mu_check(Hybrid_IsSealed(merged));
+    expectHybridSamples(funcs, merged, kept, count);
+
+    // a sealed chunk isn't merged with an uncompressed one
+    Chunk_t *head = funcs->NewChunk(count * SAMPLE_SIZE);
+    Sample sample = { .timestamp = 5000, .value = 1 };
+    funcs->AddSample(head, &sample);
+    mu_check(funcs->MergeChunk(merged, head, count * SAMPLE_SIZE * 4) == NULL);
+
+    funcs->FreeChunk(head);
+    funcs->FreeChunk(merged);
+    funcs->FreeChunk(chunks[0]);
+    funcs->FreeChunk(chunks[1]);
+}
+
+MU_TEST_SUITE(hybrid_chunk_test_suite) {
+    MU_RUN_TEST(test_Hybrid_seal);
+    MU_RUN_TEST(test_Hybrid_pending_queue);
+    MU_RUN_TEST(test_Hybrid_merge);
+}
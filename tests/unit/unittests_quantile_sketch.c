@@ -0,0 +1,97 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "quantile_sketch.h"
+#include "minunit.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+static int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void assertQuantile(const QuantileSketch *sketch, const double *sorted, size_t n, double q) {
+    double exact = sorted[(size_t)floor(q * (n - 1))];
+    double value = QuantileSketch_Quantile(sketch, q);
+    mu_check(fabs(value - exact) <= fabs(exact) * QUANTILE_SKETCH_RELATIVE_ACCURACY);
+}
+
+MU_TEST(test_QuantileSketch_accuracy) {
+    const size_t n = 10000;
+    double *values = malloc(n * sizeof(double));
+    QuantileSketch *sketch = QuantileSketch_New();
+    mu_check(isnan(QuantileSketch_Quantile(sketch, 0.5)));
+
+    srand(7);
+    for (size_t i = 0; i < n; i++) {
+        // six orders of magnitude, a quarter negative and some zeros
+        values[i] = exp((double)rand() / RAND_MAX * 14 - 7) * (rand() % 4 == 0 ? -1 : 1);
+        if (i % 20 == 0) {
+            values[i] = 0;
+        }
+        QuantileSketch_Add(sketch, values[i]);
+    }
+    QuantileSketch_Add(sketch, NAN);
+    mu_assert_int_eq(n, sketch->count);
+
+    qsort(values, n, sizeof(double), compareDoubles);
+    const double quantiles[] = { 0.01, 0.1, 0.2, 0.5, 0.9, 0.95, 0.99, 0.999 };
+    for (size_t i = 0; i < sizeof(quantiles) / sizeof(quantiles[0]); i++) {
+        assertQuantile(sketch, values, n, quantiles[i]);
+    }
+    mu_assert_double_eq(values[0], QuantileSketch_Quantile(sketch, 0));
+    mu_assert_double_eq(values[n - 1], QuantileSketch_Quantile(sketch, 1));
+
+    QuantileSketch_Reset(sketch);
+    mu_check(isnan(QuantileSketch_Quantile(sketch, 0.5)));
+    QuantileSketch_Add(sketch, 42);
+    mu_assert_double_eq(42, QuantileSketch_Quantile(sketch, 0.99));
+    QuantileSketch_Free(sketch);
+    free(values);
+}
+
+MU_TEST(test_QuantileSketch_merge) {
+    QuantileSketch *all = QuantileSketch_New();
+    QuantileSketch *odd = QuantileSketch_New();
+    QuantileSketch *even = QuantileSketch_New();
+    for (int i = -500; i < 3000; i++) {
+        double value = i * 1.5;
+        QuantileSketch_Add(all, value);
+        QuantileSketch_Add(i % 2 ? odd : even, value);
+    }
+    QuantileSketch_Merge(odd, even);
+    mu_assert_int_eq(all->count, odd->count);
+    mu_assert_double_eq(all->min, odd->min);
+    mu_assert_double_eq(all->max, odd->max);
+    for (double q = 0; q <= 1; q += 0.05) {
+        mu_assert_double_eq(QuantileSketch_Quantile(all, q), QuantileSketch_Quantile(odd, q));
+    }
+    QuantileSketch_Free(all);
+    QuantileSketch_Free(odd);
+    QuantileSketch_Free(even);
+}
+
+MU_TEST(test_QuantileSketch_bounded_bins) {
+    QuantileSketch *sketch = QuantileSketch_New();
+    for (int i = -100; i <= 100; i++) {
+        QuantileSketch_Add(sketch, pow(10, i));
+    }
+    mu_check(sketch->positive.length <= QUANTILE_SKETCH_MAX_BINS);
+    mu_assert_int_eq(201, sketch->count);
+    // the smallest magnitudes are collapsed, the high quantiles keep their accuracy
+    mu_check(fabs(QuantileSketch_Quantile(sketch, 0.99) - 1e98) <= 1e98 * QUANTILE_SKETCH_RELATIVE_ACCURACY);
+    mu_check(QuantileSketch_Quantile(sketch, 1) == 1e100);
+    QuantileSketch_Free(sketch);
+}
+
+MU_TEST_SUITE(quantile_sketch_test_suite) {
+    MU_RUN_TEST(test_QuantileSketch_accuracy);
+    MU_RUN_TEST(test_QuantileSketch_merge);
+    MU_RUN_TEST(test_QuantileSketch_bounded_bins);
+}
@@ -0,0 +1,61 @@
+/*
+ * Copyright 2018-2022 Redis Labs Ltd. and Contributors
+ *
+ * This file is available under the Redis Labs Source Available License Agreement
+ */
+#include "minunit.h"
+#include "staging_buffer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "rmutil/alloc.h"
+
+MU_TEST(test_StagingBuffer_sorted) {
+    StagingBuffer *buf = StagingBuffer_New();
+    // past the initial capacity, in reverse order
+    for (timestamp_t ts = 20; ts > 0; ts--) {
+        Sample sample = { .timestamp = ts * 10, .value = ts };
+        mu_assert_int_eq(CR_OK, StagingBuffer_Add(buf, sample, DP_LAST));
+    }
+    mu_assert_int_eq(20, buf->count);
+    for (size_t i = 0; i < buf->count; i++) {
+        mu_assert_int_eq((i + 1) * 10, buf->timestamps[i]);
+        mu_assert_double_eq(i + 1, buf->values[i]);
+    }
+
+    mu_assert_int_eq(0, StagingBuffer_LowerBound(buf, 0));
+    mu_assert_int_eq(0, StagingBuffer_LowerBound(buf, 10));
+    mu_assert_int_eq(1, StagingBuffer_LowerBound(buf, 15));
+    mu_assert_int_eq(20, StagingBuffer_LowerBound(buf, 201));
+
+    StagingBuffer *clone = StagingBuffer_Clone(buf);
+    mu_assert_int_eq(20, clone->count);
+    mu_assert_int_eq(200, clone->timestamps[19]);
+    StagingBuffer_Free(clone);
+    StagingBuffer_Free(buf);
+}
+
+MU_TEST(test_StagingBuffer_duplicates) {
+    StagingBuffer *buf = StagingBuffer_New();
+    Sample sample = { .timestamp = 100, .value = 1 };
+    mu_assert_int_eq(CR_OK, StagingBuffer_Add(buf, sample, DP_SUM));
+    sample.value = 2;
+    mu_assert_int_eq(CR_OK, StagingBuffer_Add(buf, sample, DP_SUM));
+    mu_assert_int_eq(1, buf->count);
+    mu_assert_double_eq(3, buf->values[0]);
+
+    // the policy of the latest sample is kept
+    sample.value = 1;
+    mu_assert_int_eq(CR_OK, StagingBuffer_Add(buf, sample, DP_MAX));
+    mu_assert_double_eq(3, buf->values[0]);
+    mu_assert_int_eq(DP_MAX, buf->policies[0]);
+
+    mu_assert_int_eq(CR_ERR, StagingBuffer_Add(buf, sample, DP_BLOCK));
+    mu_assert_int_eq(1, buf->count);
+    StagingBuffer_Free(buf);
+}
+
+MU_TEST_SUITE(staging_buffer_test_suite) {
+    MU_RUN_TEST(test_StagingBuffer_sorted);
+    MU_RUN_TEST(test_StagingBuffer_duplicates);
+}
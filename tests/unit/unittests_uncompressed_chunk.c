@@ -114,35 +114,271 @@ MU_TEST(test_Uncompressed_Uncompressed_UpsertSample_DuplicatePolicy) {
     mu_assert_int_eq(1, chunk->num_samples);
     const u_int64_t firstTs = Uncompressed_GetFirstTimestamp(chunk);
     mu_assert_int_eq(1, firstTs);
-    mu_assert_double_eq(-0.5, chunk->samples[0].value);
+    mu_assert_double_eq(-0.5, chunk->values[0]);
     // DP_MAX should keep -0.5 given that -0.4 is smaller
     uCtx.sample.value = -0.4;
     rv = Uncompressed_UpsertSample(&uCtx, &size, DP_MIN);
     mu_assert(rv == CR_OK, "duplicate min not changing old value");
     mu_assert_int_eq(1, chunk->num_samples);
-    mu_assert_double_eq(-0.5, chunk->samples[0].value);
+    mu_assert_double_eq(-0.5, chunk->values[0]);
     // DP_MIN should replace -0.5 by -0.6
     uCtx.sample.value = -0.6;
     rv = Uncompressed_UpsertSample(&uCtx, &size, DP_MIN);
     mu_assert(rv == CR_OK, "duplicate min changing old value");
     mu_assert_int_eq(1, chunk->num_samples);
-    mu_assert_double_eq(-0.6, chunk->samples[0].value);
+    mu_assert_double_eq(-0.6, chunk->values[0]);
     // DP_MAX should keep -0.6 given that -1 is smaller
     uCtx.sample.value = -1.0;
     rv = Uncompressed_UpsertSample(&uCtx, &size, DP_MAX);
     mu_assert(rv == CR_OK, "duplicate max not changing old value");
-    mu_assert_double_eq(-0.6, chunk->samples[0].value);
+    mu_assert_double_eq(-0.6, chunk->values[0]);
     // DP_MAX should replace -0.6 by -0.2
     uCtx.sample.value = -0.2;
     rv = Uncompressed_UpsertSample(&uCtx, &size, DP_MAX);
     mu_assert(rv == CR_OK, "duplicate max changing old value");
-    mu_assert_double_eq(-0.2, chunk->samples[0].value);
+    mu_assert_double_eq(-0.2, chunk->values[0]);
     Uncompressed_FreeChunk(chunk);
 }
 
+static void expectStats(const ChunkStats *stats, const Chunk *chunk) {
+    const size_t count = chunk->num_samples;
+    const double *values = chunk->values;
+    mu_check(stats != NULL);
+    mu_assert_int_eq(count, stats->count);
+    double min = values[0], max = values[0], sum = 0;
+    for (size_t i = 0; i < count; i++) {
+        min = values[i] < min ? values[i] : min;
+        max = values[i] > max ? values[i] : max;
+        sum += values[i];
+    }
+    mu_assert_double_eq(min, stats->min);
+    mu_assert_double_eq(max, stats->max);
+    mu_assert_double_eq(sum, stats->sum);
+    mu_assert_int_eq(chunk->timestamps[0], stats->first.timestamp);
+    mu_assert_double_eq(values[0], stats->first.value);
+    mu_assert_int_eq(chunk->timestamps[count - 1], stats->last.timestamp);
+    mu_assert_double_eq(values[count - 1], stats->last.value);
+}
+
+MU_TEST(test_Uncompressed_stats) {
+    Chunk *chunk = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    mu_assert_int_eq(0, Uncompressed_GetStats(chunk)->count);
+    for (size_t i = 0; i < 100; i++) {
+        Sample sample = { .timestamp = 10 * (i + 1), .value = (double)((i * 37) % 101) - 50 };
+        Uncompressed_AddSample(chunk, &sample);
+    }
+    expectStats(Uncompressed_GetStats(chunk), chunk);
+
+    // out of order insertion, duplicate
+    int size;
+    UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 5, .value = 1000 } };
+    Uncompressed_UpsertSample(&uCtx, &size, DP_LAST);
+    expectStats(Uncompressed_GetStats(chunk), chunk);
+    uCtx.sample = (Sample){ .timestamp = 500, .value = -1000 };
+    Uncompressed_UpsertSample(&uCtx, &size, DP_LAST);
+    expectStats(Uncompressed_GetStats(chunk), chunk);
+
+    Uncompressed_DelRange(chunk, 0, 5);
+    expectStats(Uncompressed_GetStats(chunk), chunk);
+
+    Chunk *newChunk = Uncompressed_SplitChunk(chunk);
+    expectStats(Uncompressed_GetStats(chunk), chunk);
+    expectStats(Uncompressed_GetStats(newChunk), newChunk);
+
+    Uncompressed_FreeChunk(chunk);
+    Uncompressed_FreeChunk(newChunk);
+}
+
+MU_TEST(test_Uncompressed_ProcessChunk) {
+    Chunk *chunk = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    for (size_t i = 0; i < 100; i++) {
+        Sample sample = { .timestamp = 10 * (i + 1), .value = (double)i / 4 };
+        Uncompressed_AddSample(chunk, &sample);
+    }
+    EnrichedChunk *enrichedChunk = NewEnrichedChunk();
+    ReallocSamplesArray(&enrichedChunk->samples, 100);
+
+    Uncompressed_ProcessChunk(chunk, 25, 200, enrichedChunk, false);
+    mu_assert_int_eq(18, enrichedChunk->samples.num_samples);
+    for (size_t i = 0; i < 18; i++) {
+        mu_assert_int_eq(30 + 10 * i, enrichedChunk->samples.timestamps[i]);
+        mu_assert_double_eq((double)(i + 2) / 4, enrichedChunk->samples.values[i]);
+    }
+
+    Uncompressed_ProcessChunk(chunk, 25, 200, enrichedChunk, true);
+    mu_assert_int_eq(18, enrichedChunk->samples.num_samples);
+    for (size_t i = 0; i < 18; i++) {
+        mu_assert_int_eq(200 - 10 * i, enrichedChunk->samples.timestamps[i]);
+        mu_assert_double_eq((double)(19 - i) / 4, enrichedChunk->samples.values[i]);
+    }
+
+    Uncompressed_ProcessChunk(chunk, 1001, 2000, enrichedChunk, false);
+    mu_assert_int_eq(0, enrichedChunk->samples.num_samples);
+
+    mu_assert_int_eq(0, Uncompressed_DelRange(chunk, 41, 49));
+    mu_assert_int_eq(3, Uncompressed_DelRange(chunk, 35, 64));
+    Uncompressed_ProcessChunk(chunk, 25, 80, enrichedChunk, false);
+    mu_assert_int_eq(3, enrichedChunk->samples.num_samples);
+    mu_assert_int_eq(30, enrichedChunk->samples.timestamps[0]);
+    mu_assert_int_eq(70, enrichedChunk->samples.timestamps[1]);
+    mu_assert_int_eq(80, enrichedChunk->samples.timestamps[2]);
+
+    FreeEnrichedChunk(enrichedChunk);
+    Uncompressed_FreeChunk(chunk);
+}
+
+MU_TEST(test_Uncompressed_MergeChunk) {
+    Chunk *first = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    Chunk *second = Uncompressed_NewChunk(100 * SAMPLE_SIZE);
+    for (size_t i = 0; i < 100; i++) {
+        Sample sample = { .timestamp = 10 * (i + 1), .value = (double)i / 4 };
+        Uncompressed_AddSample(i < 50 ? first : second, &sample);
+    }
+    mu_assert_int_eq(40, Uncompressed_DelRange(first, 110, 500));
+    mu_assert_int_eq(30, Uncompressed_DelRange(second, 710, 1000));
+
+    mu_check(Uncompressed_MergeChunk(first, second, 29 * SAMPLE_SIZE) == NULL);
+    Chunk *merged = Uncompressed_MergeChunk(first, second, 100 * SAMPLE_SIZE);
+    mu_check(merged != NULL);
+    mu_assert_int_eq(30, merged->num_samples);
+    mu_assert_int_eq(30 * SAMPLE_SIZE, Uncompressed_GetChunkSize(merged, false));
+    mu_assert_int_eq(10, Uncompressed_GetFirstTimestamp(merged));
+    mu_assert_int_eq(700, Uncompressed_GetLastTimestamp(merged));
+    mu_assert_int_eq(100, merged->timestamps[9]);
+    mu_assert_int_eq(510, merged->timestamps[10]);
+    mu_assert_int_eq(30, Uncompressed_GetStats(merged)->count);
+
+    Uncompressed_FreeChunk(merged);
+    Uncompressed_FreeChunk(first);
+    Uncompressed_FreeChunk(second);
+}
+
+// Backfills the gaps of a full chunk, from the newest to the oldest
+MU_TEST(test_Uncompressed_backfill) {
+    const size_t count = 100;
+    Chunk *chunk = Uncompressed_NewChunk(count * SAMPLE_SIZE);
+    for (size_t i = 0; i < count; i++) {
+        Sample sample = { .timestamp = 2 * i + 1, .value = i };
+        mu_assert_int_eq(CR_OK, Uncompressed_AddSample(chunk, &sample));
+    }
+    int size = 0;
+    for (size_t i = count; i > 0; i--) {
+        UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 2 * i, .value = i } };
+        mu_assert_int_eq(CR_OK, Uncompressed_UpsertSample(&uCtx, &size, DP_LAST));
+    }
+    mu_assert_int_eq(2 * count, chunk->num_samples);
+    for (size_t i = 0; i < 2 * count; i++) {
+        mu_assert_int_eq(i + 1, chunk->timestamps[i]);
+    }
+
+    EnrichedChunk *enrichedChunk = NewEnrichedChunk();
+    ReallocSamplesArray(&enrichedChunk->samples, 2 * count);
+    Uncompressed_ProcessChunk(chunk, 41, 50, enrichedChunk, false);
+    mu_assert_int_eq(10, enrichedChunk->samples.num_samples);
+    mu_assert_int_eq(41, enrichedChunk->samples.timestamps[0]);
+    mu_assert_int_eq(50, enrichedChunk->samples.timestamps[9]);
+
+    FreeEnrichedChunk(enrichedChunk);
+    Uncompressed_FreeChunk(chunk);
+}
+
+#ifdef UNIT_BENCHMARKS
+// Micro benchmark, prints the cost of backfilling and querying a 64KB chunk. Built with BENCH=1.
+MU_TEST(test_Uncompressed_backfill_benchmark) {
+    const size_t chunkSize = 64 * 1024;
+    const size_t count = chunkSize / SAMPLE_SIZE;
+    const size_t queries = 100000;
+    Chunk *chunk = Uncompressed_NewChunk(chunkSize);
+    for (size_t i = 0; i < count; i++) {
+        Sample sample = { .timestamp = 2 * i + 1, .value = i };
+        mu_assert_int_eq(CR_OK, Uncompressed_AddSample(chunk, &sample));
+    }
+    Sample extra = { .timestamp = 2 * count + 1, .value = 0 };
+    mu_assert_int_eq(CR_END, Uncompressed_AddSample(chunk, &extra));
+
+    // backfill the even timestamps, from the newest to the oldest
+    struct timespec begin;
+    int size = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t i = count; i > 0; i--) {
+        UpsertCtx uCtx = { .inChunk = chunk, .sample = { .timestamp = 2 * i, .value = i } };
+        Uncompressed_UpsertSample(&uCtx, &size, DP_LAST);
+    }
+    double upsertSecs = elapsedSeconds(&begin);
+    mu_assert_int_eq(2 * count, chunk->num_samples);
+    for (size_t i = 0; i < 2 * count; i++) {
+        mu_assert_int_eq(i + 1, chunk->timestamps[i]);
+    }
+
+    EnrichedChunk *enrichedChunk = NewEnrichedChunk();
+    ReallocSamplesArray(&enrichedChunk->samples, 2 * count);
+    size_t total = 0;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (size_t q = 0; q < queries; q++) {
+        timestamp_t start = (q * 7919) % (2 * count);
+        Uncompressed_ProcessChunk(chunk, start, start + 9, enrichedChunk, false);
+        total += enrichedChunk->samples.num_samples;
+    }
+    double processSecs = elapsedSeconds(&begin);
+
+    printf("\nuncompressed 64KB chunk: backfill %.0f ns/upsert, 10 samples range %.0f ns/query "
+           "(checksum %lu)\n",
+           upsertSecs * 1e9 / count,
+           processSecs * 1e9 / queries,
+           total);
+
+    FreeEnrichedChunk(enrichedChunk);
+    Uncompressed_FreeChunk(chunk);
+}
+#endif
+
+// Appending the stats of samples must be equivalent to appending the samples one by one
+MU_TEST(test_AppendChunkStats) {
+    const TS_AGG_TYPES_T types[] = { TS_AGG_AVG, TS_AGG_MAX,   TS_AGG_MIN,  TS_AGG_SUM,
+                                     TS_AGG_COUNT, TS_AGG_FIRST, TS_AGG_LAST, TS_AGG_RANGE };
+    const Sample samples[] = { { 10, 3 }, { 11, -2 }, { 15, 8 }, { 16, 1 } };
+    const size_t n = sizeof(samples) / sizeof(samples[0]);
+    ChunkStats stats;
+    ChunkStats_Reset(&stats);
+    for (size_t i = 0; i < n; i++) {
+        ChunkStats_Append(&stats, samples[i].timestamp, samples[i].value);
+    }
+
+    for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); t++) {
+        for (int reverse = 0; reverse <= 1; reverse++) {
+            AggregationClass *aggClass = GetAggClass(types[t]);
+            mu_check(aggClass->appendChunkStats != NULL);
+            void *byValue = aggClass->createContext(reverse);
+            void *byStats = aggClass->createContext(reverse);
+            aggClass->appendValue(byValue, 5, 1);
+            aggClass->appendValue(byStats, 5, 1);
+            for (size_t i = 0; i < n; i++) {
+                const Sample *sample = &samples[reverse ? n - 1 - i : i];
+                aggClass->appendValue(byValue, sample->value, sample->timestamp);
+            }
+            aggClass->appendChunkStats(byStats, &stats, reverse);
+            double expected, actual;
+            aggClass->finalize(byValue, &expected);
+            aggClass->finalize(byStats, &actual);
+            mu_assert_double_eq(expected, actual);
+            aggClass->freeContext(byValue);
+            aggClass->freeContext(byStats);
+        }
+    }
+    mu_check(GetAggClass(TS_AGG_TWA)->appendChunkStats == NULL);
+}
+
 MU_TEST_SUITE(uncompressed_chunk_test_suite) {
     MU_RUN_TEST(test_Uncompressed_NewChunk);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_AddSample);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_UpsertSample);
     MU_RUN_TEST(test_Uncompressed_Uncompressed_UpsertSample_DuplicatePolicy);
+    MU_RUN_TEST(test_Uncompressed_stats);
+    MU_RUN_TEST(test_Uncompressed_ProcessChunk);
+    MU_RUN_TEST(test_Uncompressed_MergeChunk);
+    MU_RUN_TEST(test_Uncompressed_backfill);
+#ifdef UNIT_BENCHMARKS
+    MU_RUN_TEST(test_Uncompressed_backfill_benchmark);
+#endif
+    MU_RUN_TEST(test_AppendChunkStats);
 }